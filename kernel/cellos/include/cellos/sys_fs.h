@@ -330,6 +330,13 @@ struct lv2_file final : lv2_fs_object {
     return op_write(file, buf, size);
   }
 
+  // Positional reading and writing through the asynchronous I/O engine, the
+  // calling thread waits for the completion
+  static u64 op_read_async(const fs::file &file, vm::ptr<void> buf, u64 size,
+                           u64 pos);
+  static u64 op_write_async(const fs::file &file, vm::cptr<void> buf,
+                            u64 size, u64 pos);
+
   // For MSELF support
   struct file_view;
 
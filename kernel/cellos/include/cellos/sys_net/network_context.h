@@ -15,14 +15,37 @@ struct base_network_thread {
   std::vector<ppu_thread *> ppu_to_awake;
 
   void wake_threads();
+
+#ifdef __linux__
+  // Socket readiness is delivered through epoll, wake_fd (eventfd) interrupts
+  // the wait on state changes
+  int epoll_fd = -1;
+  int wake_fd = -1;
+
+  base_network_thread();
+  ~base_network_thread();
+#endif
+
+  void wake_up();
 };
 
 struct network_thread : base_network_thread {
   shared_mutex mutex_thread_loop;
   atomic_t<u32> num_polls = 0;
 
+#ifdef __linux__
+  // Sockets with changed poll queue, their epoll registration is updated by
+  // the network thread
+  shared_mutex mutex_dirty_sockets;
+  std::vector<u32> dirty_sockets;
+#endif
+
   static constexpr auto thread_name = "Network Thread";
 
+  // Called when the poll queue of a native socket changes
+  void update_socket(u32 lv2_id);
+
+  network_thread &operator=(thread_state s) noexcept;
   void operator()();
 };
 
@@ -35,6 +58,8 @@ struct p2p_thread : base_network_thread {
 
   p2p_thread();
 
+  p2p_thread &operator=(thread_state s) noexcept;
+
   void create_p2p_port(u16 p2p_port);
 
   void bind_sce_np_port();
@@ -234,6 +234,13 @@ private:
   // Schedule the thread
   static bool awake_unlocked(cpu_thread *, s32 prio = enqueue_cmd);
 
+  // Insert the thread after the threads of the same priority in g_ppu,
+  // returns false if it is already queued
+  static bool enqueue_ppu(class ppu_thread *ppu);
+
+  // Remove the thread from g_ppu, returns false if it is not queued
+  static bool unqueue_ppu(class ppu_thread *ppu);
+
 public:
   static constexpr u64 max_timeout = u64{umax} / 1000;
 
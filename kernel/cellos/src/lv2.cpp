@@ -59,8 +59,10 @@
 #include "util/sysinfo.hpp"
 #include <algorithm>
 #include <deque>
+#include <map>
 #include <optional>
 #include <thread>
+#include <unordered_map>
 
 #if defined(ARCH_X64)
 #ifdef _MSC_VER
@@ -1581,8 +1583,28 @@ thread_local DECLARE(lv2_obj::g_to_notify){};
 thread_local DECLARE(lv2_obj::g_postpone_notify_barrier){};
 thread_local DECLARE(lv2_obj::g_to_awake);
 
-// Scheduler queue for timeouts (wait until -> thread)
-static std::deque<std::pair<u64, class cpu_thread *>> g_waiting;
+// Scheduler queue for timeouts (wait until -> thread), equal timeouts are
+// kept in registration order
+static std::multimap<u64, class cpu_thread *> g_waiting;
+
+// Registered timeout of each thread in g_waiting
+static std::unordered_map<class cpu_thread *, decltype(g_waiting)::iterator>
+    g_waiting_index;
+
+// First and last thread of each priority in g_ppu. The list itself stays
+// sorted by priority (readers walk it without the lock), the index locates
+// insertion and removal points without walking other priorities
+struct ppu_prio_range {
+  ppu_thread *first;
+  ppu_thread *last;
+};
+
+static std::map<s32, ppu_prio_range> g_ppu_prio;
+
+// Scheduler lock statistics (modified under the lock), reported on cleanup
+static u64 s_scheduler_locks = 0;
+static u64 s_scheduler_lock_contentions = 0;
+static u64 s_scheduler_lock_wait_tsc = 0;
 
 // Threads which must call lv2_obj::sleep before the scheduler starts
 static std::deque<class cpu_thread *> g_to_sleep;
@@ -1609,6 +1631,115 @@ std::string lv2_obj::name64(u64 name_u64) {
   return str;
 }
 
+static std::unique_lock<shared_mutex> lock_scheduler() {
+  std::unique_lock lock(lv2_obj::g_mutex, std::try_to_lock);
+
+  if (!lock) {
+    const u64 start_tsc = rx::get_tsc();
+    lock.lock();
+    s_scheduler_lock_contentions++;
+    s_scheduler_lock_wait_tsc += rx::get_tsc() - start_tsc;
+  }
+
+  s_scheduler_locks++;
+  return lock;
+}
+
+// Find the link pointing to the thread in the run queue and the previous
+// thread of the same priority (nullptr if the thread is first of them)
+static std::pair<ppu_thread **, ppu_thread *>
+find_queued_ppu(ppu_thread *&head, ppu_thread *ppu) {
+  const auto found = g_ppu_prio.find(ppu->prio.load().prio);
+
+  if (found == g_ppu_prio.end()) {
+    return {};
+  }
+
+  auto &range = found->second;
+
+  if (range.first == ppu) {
+    if (found == g_ppu_prio.begin()) {
+      return {&head, nullptr};
+    }
+
+    return {&std::prev(found)->second.last->next_ppu, nullptr};
+  }
+
+  for (auto prev = range.first; prev != range.last; prev = prev->next_ppu) {
+    if (prev->next_ppu == ppu) {
+      return {&prev->next_ppu, prev};
+    }
+  }
+
+  return {};
+}
+
+bool lv2_obj::enqueue_ppu(ppu_thread *ppu) {
+  if (find_queued_ppu(g_ppu, ppu).first) {
+    return false;
+  }
+
+  const auto [found, inserted] =
+      g_ppu_prio.try_emplace(ppu->prio.load().prio, ppu, ppu);
+
+  ppu_thread **link = &g_ppu;
+
+  if (!inserted) {
+    // Preserve FIFO order of the same priority
+    link = &std::exchange(found->second.last, ppu)->next_ppu;
+  } else if (found != g_ppu_prio.begin()) {
+    link = &std::prev(found)->second.last->next_ppu;
+  }
+
+  atomic_storage<ppu_thread *>::release(ppu->next_ppu, *link);
+  atomic_storage<ppu_thread *>::release(*link, ppu);
+  return true;
+}
+
+bool lv2_obj::unqueue_ppu(ppu_thread *ppu) {
+  const auto [link, prev] = find_queued_ppu(g_ppu, ppu);
+
+  if (!link) {
+    return false;
+  }
+
+  const auto found = g_ppu_prio.find(ppu->prio.load().prio);
+  auto &range = found->second;
+  const auto next = +ppu->next_ppu;
+
+  if (range.first == range.last) {
+    g_ppu_prio.erase(found);
+  } else if (range.first == ppu) {
+    range.first = next;
+  } else if (range.last == ppu) {
+    range.last = prev;
+  }
+
+  atomic_storage<ppu_thread *>::release(*link, next);
+  atomic_storage<ppu_thread *>::release(ppu->next_ppu, nullptr);
+  return true;
+}
+
+static void register_timeout(u64 wait_until, cpu_thread *cpu) {
+  // A thread has at most one timeout, it is replaced by the new one
+  if (const auto found = g_waiting_index.find(cpu);
+      found != g_waiting_index.end()) {
+    g_waiting.erase(found->second);
+    found->second = g_waiting.emplace(wait_until, cpu);
+    return;
+  }
+
+  g_waiting_index.emplace(cpu, g_waiting.emplace(wait_until, cpu));
+}
+
+static void unregister_timeout(cpu_thread *cpu) {
+  if (const auto found = g_waiting_index.find(cpu);
+      found != g_waiting_index.end()) {
+    g_waiting.erase(found->second);
+    g_waiting_index.erase(found);
+  }
+}
+
 bool lv2_obj::sleep(cpu_thread &cpu, const u64 timeout) {
   // Should already be performed when using this flag
   if (!g_postpone_notify_barrier) {
@@ -1640,7 +1771,7 @@ bool lv2_obj::sleep(cpu_thread &cpu, const u64 timeout) {
   bool result = false;
   const u64 current_time = get_guest_system_time();
   {
-    std::lock_guard lock{g_mutex};
+    const auto lock = lock_scheduler();
     result = sleep_unlocked(cpu, timeout, current_time);
 
     if (!g_to_awake.empty()) {
@@ -1684,7 +1815,7 @@ bool lv2_obj::awake(cpu_thread *thread, s32 prio) {
 
   bool result = false;
   {
-    std::lock_guard lock(g_mutex);
+    const auto lock = lock_scheduler();
     result = awake_unlocked(thread, prio);
     schedule_all();
   }
@@ -1782,7 +1913,7 @@ bool lv2_obj::sleep_unlocked(cpu_thread &thread, u64 timeout,
     }
 
     // Find and remove the thread
-    if (!unqueue(g_ppu, ppu, &ppu_thread::next_ppu)) {
+    if (!unqueue_ppu(ppu)) {
       if (auto it = std::find(g_to_sleep.begin(), g_to_sleep.end(), ppu);
           it != g_to_sleep.end()) {
         g_to_sleep.erase(it);
@@ -1815,12 +1946,7 @@ bool lv2_obj::sleep_unlocked(cpu_thread &thread, u64 timeout,
     const u64 wait_until = start_time + std::min<u64>(timeout, ~start_time);
 
     // Register timeout if necessary
-    for (auto it = g_waiting.cbegin(), end = g_waiting.cend();; it++) {
-      if (it == end || it->first > wait_until) {
-        g_waiting.emplace(it, wait_until, &thread);
-        break;
-      }
-    }
+    register_timeout(wait_until, &thread);
   }
 
   return return_val;
@@ -1830,8 +1956,6 @@ bool lv2_obj::awake_unlocked(cpu_thread *cpu, s32 prio) {
   // Check thread type
   AUDIT(!cpu || cpu->get_class() == thread_class::ppu);
 
-  bool push_first = false;
-
   switch (prio) {
   default: {
     // Priority set
@@ -1863,8 +1987,7 @@ bool lv2_obj::awake_unlocked(cpu_thread *cpu, s32 prio) {
       return true;
     }
 
-    if (!unqueue(g_ppu, static_cast<ppu_thread *>(cpu),
-                 &ppu_thread::next_ppu)) {
+    if (!unqueue_ppu(static_cast<ppu_thread *>(cpu))) {
       set_prio(static_cast<ppu_thread *>(cpu)->prio, prio, old_prio > prio,
                old_prio < prio);
       return true;
@@ -1874,51 +1997,44 @@ bool lv2_obj::awake_unlocked(cpu_thread *cpu, s32 prio) {
     break;
   }
   case yield_cmd: {
-    usz i = 0;
-
     // Yield command
-    for (auto ppu_next = &g_ppu;; i++) {
-      const auto ppu = +*ppu_next;
-
-      if (!ppu) {
-        return false;
-      }
+    const auto ppu = static_cast<ppu_thread *>(cpu);
+    const auto ppu_next = find_queued_ppu(g_ppu, ppu).first;
 
-      if (ppu == cpu) {
-        auto ppu2 = ppu->next_ppu;
+    if (!ppu_next) {
+      return false;
+    }
 
-        if (!ppu2 || ppu2->prio.load().prio != ppu->prio.load().prio) {
-          // Empty 'same prio' threads list
-          return false;
-        }
+    auto &range = g_ppu_prio.at(ppu->prio.load().prio);
+    const auto ppu2 = range.last;
 
-        for (i++;; i++) {
-          const auto next = ppu2->next_ppu;
+    if (ppu2 == ppu) {
+      // Empty 'same prio' threads list
+      return false;
+    }
 
-          if (!next || next->prio.load().prio != ppu->prio.load().prio) {
-            break;
-          }
+    if (range.first == ppu) {
+      range.first = ppu->next_ppu;
+    }
 
-          ppu2 = next;
-        }
+    range.last = ppu;
 
-        // Rotate current thread to the last position of the 'same prio' threads
-        // list Exchange forward pointers
-        *ppu_next =
-            std::exchange(ppu->next_ppu, std::exchange(ppu2->next_ppu, ppu));
+    // Rotate current thread to the last position of the 'same prio' threads
+    // list Exchange forward pointers
+    *ppu_next =
+        std::exchange(ppu->next_ppu, std::exchange(ppu2->next_ppu, ppu));
 
-        if (i < g_cfg.core.ppu_threads + 0u) {
-          // Threads were rotated, but no context switch was made
-          return false;
-        }
+    usz i = 0;
 
-        ppu->start_time = get_guest_system_time();
-        break;
+    for (auto target = +g_ppu; target && i < g_cfg.core.ppu_threads + 0u;
+         target = target->next_ppu, i++) {
+      if (target == ppu) {
+        // Threads were rotated, but no context switch was made
+        return false;
       }
-
-      ppu_next = &ppu->next_ppu;
     }
 
+    ppu->start_time = get_guest_system_time();
     break;
   }
   case enqueue_cmd: {
@@ -1926,45 +2042,21 @@ bool lv2_obj::awake_unlocked(cpu_thread *cpu, s32 prio) {
   }
   }
 
-  const auto emplace_thread = [push_first](cpu_thread *const cpu) {
-    for (auto it = &g_ppu;;) {
-      const auto next = +*it;
+  const auto emplace_thread = [](cpu_thread *const cpu) {
+    // Use priority, also preserve FIFO order
+    if (!enqueue_ppu(static_cast<ppu_thread *>(cpu))) {
+      ppu_log.trace("sleep() - suspended (p=%zu)", g_pending);
 
-      if (next == cpu) {
-        ppu_log.trace("sleep() - suspended (p=%zu)", g_pending);
-
-        if (static_cast<ppu_thread *>(cpu)->cancel_sleep == 1) {
-          // The next sleep call of the thread is cancelled
-          static_cast<ppu_thread *>(cpu)->cancel_sleep = 2;
-        }
-
-        return false;
+      if (static_cast<ppu_thread *>(cpu)->cancel_sleep == 1) {
+        // The next sleep call of the thread is cancelled
+        static_cast<ppu_thread *>(cpu)->cancel_sleep = 2;
       }
 
-      // Use priority, also preserve FIFO order
-      if (!next ||
-          (push_first ? next->prio.load().prio >=
-                            static_cast<ppu_thread *>(cpu)->prio.load().prio
-                      : next->prio.load().prio >
-                            static_cast<ppu_thread *>(cpu)->prio.load().prio)) {
-        atomic_storage<ppu_thread *>::release(
-            static_cast<ppu_thread *>(cpu)->next_ppu, next);
-        atomic_storage<ppu_thread *>::release(*it,
-                                              static_cast<ppu_thread *>(cpu));
-        break;
-      }
-
-      it = &next->next_ppu;
+      return false;
     }
 
     // Unregister timeout if necessary
-    for (auto it = g_waiting.cbegin(), end = g_waiting.cend(); it != end;
-         it++) {
-      if (it->second == cpu) {
-        g_waiting.erase(it);
-        break;
-      }
-    }
+    unregister_timeout(cpu);
 
     ppu_log.trace("awake(): %s", cpu->id);
     return true;
@@ -2055,10 +2147,25 @@ bool lv2_obj::awake_unlocked(cpu_thread *cpu, s32 prio) {
 }
 
 void lv2_obj::cleanup() {
+  if (s_scheduler_locks) {
+    ppu_log.notice("Scheduler lock: %u acquisitions, %u contended (%u%%), "
+                   "%u waiting cycles per contention",
+                   s_scheduler_locks, s_scheduler_lock_contentions,
+                   s_scheduler_lock_contentions * 100 / s_scheduler_locks,
+                   s_scheduler_lock_wait_tsc /
+                       std::max<u64>(s_scheduler_lock_contentions, 1));
+  }
+
+  s_scheduler_locks = 0;
+  s_scheduler_lock_contentions = 0;
+  s_scheduler_lock_wait_tsc = 0;
+
   g_ppu = nullptr;
+  g_ppu_prio.clear();
   g_scheduler_ready = false;
   g_to_sleep.clear();
   g_waiting.clear();
+  g_waiting_index.clear();
   g_pending = 0;
   s_yield_frequency = 0;
 }
@@ -2103,7 +2210,7 @@ void lv2_obj::schedule_all(u64 current_time) {
 
   // Check registered timeouts
   while (!g_waiting.empty()) {
-    const auto pair = &g_waiting.front();
+    const auto pair = g_waiting.begin();
 
     if (!current_time) {
       current_time = get_guest_system_time();
@@ -2111,7 +2218,8 @@ void lv2_obj::schedule_all(u64 current_time) {
 
     if (pair->first <= current_time) {
       const auto target = pair->second;
-      g_waiting.pop_front();
+      g_waiting_index.erase(target);
+      g_waiting.erase(pair);
 
       if (target != cpu_thread::get_current()) {
         // Change cpu_thread::state for the lightweight notification to work
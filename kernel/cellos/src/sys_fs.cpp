@@ -7,7 +7,9 @@
 
 #include "Crypto/unedat.h"
 #include "Emu/Cell/PPUThread.h"
+#include "Emu/Cell/timers.hpp"
 #include "Emu/IdManager.h"
+#include "Emu/Memory/vm_locking.h"
 #include "Emu/System.h"
 #include "Emu/VFS.h"
 #include "Emu/system_config.h"
@@ -15,9 +17,24 @@
 #include "Emu/vfs_config.h"
 #include "cellos/sys_process.h"
 
+#include <condition_variable>
+#include <deque>
 #include <filesystem>
+#include <mutex>
 #include <shared_mutex>
 #include <span>
+#include <thread>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 
 LOG_CHANNEL(sys_fs);
 
@@ -383,33 +400,488 @@ lv2_fs_object::lv2_fs_object(std::string_view filename)
 lv2_fs_object::lv2_fs_object(utils::serial &ar, bool)
     : name(ar), mp(g_fxo->get<lv2_fs_mount_info_map>().lookup(name.data())) {}
 
-u64 lv2_file::op_read(const fs::file &file, vm::ptr<void> buf, u64 size,
-                      u64 opt_pos) {
-  if (u64 region = buf.addr() >> 28,
-      region_end = (buf.addr() & 0xfff'ffff) + (size & 0xfff'ffff);
-      region == region_end && ((region >> 28) == 0 || region >= 0xC)) {
-    // Optimize reads from safe memory
-    return (opt_pos == umax ? file.read(buf.get_ptr(), size)
-                            : file.read_at(opt_pos, buf.get_ptr(), size));
+// Host I/O statistics of lv2 files, reported on emulation stop
+struct lv2_fs_io_stats {
+  atomic_t<u64> bytes_read = 0;
+  atomic_t<u64> bytes_written = 0;
+  atomic_t<u64> direct_ops = 0;
+  atomic_t<u64> bounced_ops = 0;
+  atomic_t<u64> async_ops = 0;
+  atomic_t<u32> queue_depth = 0;
+  atomic_t<u32> max_queue_depth = 0;
+  atomic_t<u64> busy_start = 0;
+  atomic_t<u64> busy_time = 0; // Microseconds with any operation in flight
+
+  lv2_fs_io_stats() = default;
+  lv2_fs_io_stats(const lv2_fs_io_stats &) = delete;
+
+  ~lv2_fs_io_stats() {
+    const u64 total = bytes_read + bytes_written;
+
+    if (!total) {
+      return;
+    }
+
+    const u64 time = std::max<u64>(busy_time, 1);
+
+    sys_fs.notice("I/O stats: read %u KiB, written %u KiB, %u KiB/s, max "
+                  "queue depth %u, %u direct, %u bounced and %u async ops",
+                  bytes_read / 1024, bytes_written / 1024,
+                  total * 1'000'000 / time / 1024, +max_queue_depth,
+                  +direct_ops, +bounced_ops, +async_ops);
+  }
+
+  // Operation in flight, counted for the queue depth and the busy time
+  class scope {
+    lv2_fs_io_stats &m_stats;
+
+  public:
+    explicit scope(lv2_fs_io_stats &stats) : m_stats(stats) {
+      const u32 depth = m_stats.queue_depth.add_fetch(1);
+      m_stats.max_queue_depth.fetch_op([&](u32 &value) {
+        if (value >= depth) {
+          return false;
+        }
+
+        value = depth;
+        return true;
+      });
+
+      if (depth == 1) {
+        m_stats.busy_start = get_system_time();
+      }
+    }
+
+    scope(const scope &) = delete;
+    scope &operator=(const scope &) = delete;
+
+    ~scope() {
+      const u64 start = m_stats.busy_start;
+
+      if (m_stats.queue_depth.sub_fetch(1) == 0) {
+        m_stats.busy_time += get_system_time() - start;
+      }
+    }
+  };
+};
+
+// Intermediate buffer of I/O which cannot access guest memory directly
+static uchar *get_bounce_buffer() {
+  thread_local std::unique_ptr<uchar[]> buffer;
+
+  if (!buffer) {
+    buffer = std::make_unique<uchar[]>(65536);
+  }
+
+  return buffer.get();
+}
+
+#ifndef _WIN32
+// Asynchronous host I/O of lv2 files. Requests are executed by io_uring if the
+// host supports it, otherwise by a small pool of threads. The backend is
+// started on first use.
+class lv2_fs_io_engine {
+public:
+  struct request {
+    int fd = -1;
+    void *data = nullptr;
+    u64 size = 0;
+    u64 offset = 0;
+    bool is_write = false;
+
+    atomic_t<u32> done = 0;
+    s64 result = 0;  // Transferred bytes or negative errno
+    ::iovec vec{};   // io_uring only
+  };
+
+  static constexpr u32 c_max_in_flight = 32;
+  static constexpr u32 c_pool_size = 4;
+
+  lv2_fs_io_engine() = default;
+  lv2_fs_io_engine(const lv2_fs_io_engine &) = delete;
+  ~lv2_fs_io_engine();
+
+  // Execute the request, the calling thread waits for the completion
+  void execute(request &req);
+
+private:
+  void start();
+  void complete(request &req, s64 result);
+  void pool_worker();
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::deque<request *> m_queue; // Thread pool only
+  std::vector<std::thread> m_threads;
+  bool m_started = false;
+  bool m_stopping = false;
+  atomic_t<u32> m_in_flight = 0;
+
+#ifdef __linux__
+  struct uring_t {
+    int fd = -1;
+    ::io_uring_params params{};
+    u8 *sq_ring = nullptr;
+    usz sq_ring_size = 0;
+    u8 *cq_ring = nullptr;
+    usz cq_ring_size = 0;
+    ::io_uring_sqe *sqes = nullptr;
+  } m_ring;
+
+  template <typename T> T *sq_field(u32 offset) {
+    return reinterpret_cast<T *>(m_ring.sq_ring + offset);
+  }
+
+  template <typename T> T *cq_field(u32 offset) {
+    return reinterpret_cast<T *>(m_ring.cq_ring + offset);
+  }
+
+  bool uring_setup();
+  void uring_submit(request *req); // Null request stops the completion thread
+  void uring_reap();
+#endif
+};
+
+lv2_fs_io_engine::~lv2_fs_io_engine() {
+  {
+    std::lock_guard lock(m_mutex);
+    m_stopping = true;
+
+#ifdef __linux__
+    if (m_ring.fd >= 0) {
+      uring_submit(nullptr);
+    }
+#endif
+  }
+
+  m_cv.notify_all();
+
+  for (auto &thread : m_threads) {
+    thread.join();
+  }
+
+#ifdef __linux__
+  if (m_ring.fd >= 0) {
+    ::munmap(m_ring.sqes, m_ring.params.sq_entries * sizeof(::io_uring_sqe));
+
+    if (m_ring.cq_ring != m_ring.sq_ring) {
+      ::munmap(m_ring.cq_ring, m_ring.cq_ring_size);
+    }
+
+    ::munmap(m_ring.sq_ring, m_ring.sq_ring_size);
+    ::close(m_ring.fd);
+  }
+#endif
+}
+
+void lv2_fs_io_engine::start() {
+  m_started = true;
+
+#ifdef __linux__
+  if (uring_setup()) {
+    sys_fs.notice("I/O engine: using io_uring");
+    m_threads.emplace_back([this] { uring_reap(); });
+    return;
+  }
+#endif
+
+  sys_fs.notice("I/O engine: using %u threads", c_pool_size);
+
+  for (u32 i = 0; i < c_pool_size; i++) {
+    m_threads.emplace_back([this] { pool_worker(); });
+  }
+}
+
+void lv2_fs_io_engine::execute(request &req) {
+  while (!m_in_flight.try_inc(c_max_in_flight)) {
+    m_in_flight.wait(c_max_in_flight);
+  }
+
+  {
+    std::lock_guard lock(m_mutex);
+
+    if (!m_started) {
+      start();
+    }
+
+#ifdef __linux__
+    if (m_ring.fd >= 0) {
+      uring_submit(&req);
+    } else
+#endif
+    {
+      m_queue.push_back(&req);
+      m_cv.notify_one();
+    }
+  }
+
+  req.done.wait(0);
+}
+
+void lv2_fs_io_engine::complete(request &req, s64 result) {
+  req.result = result;
+  req.done.release(1);
+  req.done.notify_one();
+
+  m_in_flight--;
+  m_in_flight.notify_one();
+}
+
+void lv2_fs_io_engine::pool_worker() {
+  while (true) {
+    request *req;
+
+    {
+      std::unique_lock lock(m_mutex);
+      m_cv.wait(lock, [&] { return m_stopping || !m_queue.empty(); });
+
+      if (m_queue.empty()) {
+        return;
+      }
+
+      req = m_queue.front();
+      m_queue.pop_front();
+    }
+
+    s64 result;
+
+    do {
+      result = req->is_write
+                   ? ::pwrite(req->fd, req->data, req->size, req->offset)
+                   : ::pread(req->fd, req->data, req->size, req->offset);
+    } while (result < 0 && errno == EINTR);
+
+    complete(*req, result < 0 ? -errno : result);
+  }
+}
+
+#ifdef __linux__
+bool lv2_fs_io_engine::uring_setup() {
+  auto &params = m_ring.params;
+  const int fd = static_cast<int>(
+      ::syscall(__NR_io_uring_setup, c_max_in_flight, &params));
+
+  if (fd < 0) {
+    sys_fs.notice("I/O engine: io_uring is not available (%s)",
+                  std::strerror(errno));
+    return false;
+  }
+
+  usz sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(u32);
+  usz cq_ring_size =
+      params.cq_off.cqes + params.cq_entries * sizeof(::io_uring_cqe);
+  const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+
+  if (single_mmap) {
+    sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+  }
+
+  const auto map = [&](usz size, u64 offset) {
+    void *ptr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd, offset);
+    return ptr == MAP_FAILED ? nullptr : static_cast<u8 *>(ptr);
+  };
+
+  const usz sqes_size = params.sq_entries * sizeof(::io_uring_sqe);
+  u8 *const sq_ring = map(sq_ring_size, IORING_OFF_SQ_RING);
+  u8 *const cq_ring =
+      single_mmap ? sq_ring : map(cq_ring_size, IORING_OFF_CQ_RING);
+  u8 *const sqes = map(sqes_size, IORING_OFF_SQES);
+
+  if (!sq_ring || !cq_ring || !sqes) {
+    sys_fs.error("I/O engine: failed to map io_uring");
+
+    for (auto [ptr, size] : {std::pair{sq_ring, sq_ring_size},
+                             std::pair{single_mmap ? nullptr : cq_ring,
+                                       cq_ring_size},
+                             std::pair{sqes, sqes_size}}) {
+      if (ptr) {
+        ::munmap(ptr, size);
+      }
+    }
+
+    ::close(fd);
+    return false;
+  }
+
+  m_ring.fd = fd;
+  m_ring.sq_ring = sq_ring;
+  m_ring.sq_ring_size = sq_ring_size;
+  m_ring.cq_ring = cq_ring;
+  m_ring.cq_ring_size = cq_ring_size;
+  m_ring.sqes = reinterpret_cast<::io_uring_sqe *>(sqes);
+  return true;
+}
+
+void lv2_fs_io_engine::uring_submit(request *req) {
+  // Submissions are serialized by m_mutex, the ring is never full because
+  // the requests in flight are limited to its size
+  const auto &off = m_ring.params.sq_off;
+  u32 *const sq_tail = sq_field<u32>(off.tail);
+  const u32 tail = *sq_tail;
+  const u32 index = tail & *sq_field<u32>(off.ring_mask);
+
+  ::io_uring_sqe &sqe = m_ring.sqes[index];
+  sqe = {};
+
+  if (req) {
+    req->vec = {req->data, req->size};
+    sqe.opcode = req->is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe.fd = req->fd;
+    sqe.addr = reinterpret_cast<u64>(&req->vec);
+    sqe.len = 1;
+    sqe.off = req->offset;
+    sqe.user_data = reinterpret_cast<u64>(req);
+  } else {
+    sqe.opcode = IORING_OP_NOP;
+  }
+
+  sq_field<u32>(off.array)[index] = index;
+  std::atomic_ref(*sq_tail).store(tail + 1, std::memory_order::release);
+
+  while (::syscall(__NR_io_uring_enter, m_ring.fd, 1, 0, 0, nullptr, 0) < 0) {
+    if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+      fmt::throw_exception("io_uring submission failed (%s)",
+                           std::strerror(errno));
+    }
+
+    std::this_thread::yield();
+  }
+}
+
+void lv2_fs_io_engine::uring_reap() {
+  const auto &off = m_ring.params.cq_off;
+  u32 *const cq_head = cq_field<u32>(off.head);
+  u32 *const cq_tail = cq_field<u32>(off.tail);
+  const u32 mask = *cq_field<u32>(off.ring_mask);
+  ::io_uring_cqe *const cqes = cq_field<::io_uring_cqe>(off.cqes);
+
+  for (bool stop = false; !stop;) {
+    if (::syscall(__NR_io_uring_enter, m_ring.fd, 0, 1,
+                  IORING_ENTER_GETEVENTS, nullptr, 0) < 0 &&
+        errno != EINTR) {
+      fmt::throw_exception("io_uring wait failed (%s)", std::strerror(errno));
+    }
+
+    u32 head = *cq_head;
+    const u32 tail = std::atomic_ref(*cq_tail).load(std::memory_order::acquire);
+
+    for (; head != tail; head++) {
+      const ::io_uring_cqe &cqe = cqes[head & mask];
+
+      if (cqe.user_data) {
+        complete(*reinterpret_cast<request *>(cqe.user_data), cqe.res);
+      } else {
+        stop = true;
+      }
+    }
+
+    std::atomic_ref(*cq_head).store(head, std::memory_order::release);
   }
+}
+#endif
+
+// Host file descriptor of a regular host file, virtual files have none
+static int get_native_fd(const fs::file &file) { return file.get_handle(); }
+
+// Transfer at the offset (umax means the current position), returns the
+// number of bytes or negative errno
+static s64 lv2_fs_host_io(int fd, void *data, u64 size, u64 offset,
+                          bool is_write, bool is_async) {
+  if (is_async) {
+    lv2_fs_io_engine::request req;
+    req.fd = fd;
+    req.data = data;
+    req.size = size;
+    req.offset = offset;
+    req.is_write = is_write;
 
-  // Copy data from intermediate buffer (avoid passing vm pointer to a native
-  // API)
-  std::vector<uchar> local_buf(std::min<u64>(size, 65536));
+    g_fxo->get<lv2_fs_io_engine>().execute(req);
+    return req.result;
+  }
+
+  s64 result;
+
+  do {
+    if (offset == umax) {
+      result = is_write ? ::write(fd, data, size) : ::read(fd, data, size);
+    } else {
+      result = is_write ? ::pwrite(fd, data, size, offset)
+                        : ::pread(fd, data, size, offset);
+    }
+  } while (result < 0 && errno == EINTR);
+
+  return result < 0 ? -errno : result;
+}
+
+// Range locks taken by direct I/O, the set is shared with SPU threads
+static atomic_t<u32> s_direct_io_locks = 0;
+constexpr u32 c_max_direct_io_locks = 8;
+
+// Range locks can't describe 512 MiB, bigger transfers are split
+constexpr u64 c_direct_io_chunk = 16 * 1024 * 1024;
+
+// Transfer between a host file and guest memory without the bounce buffer,
+// returns the number of bytes. A range lock keeps vm from changing the
+// protection of the pages or unmapping them during the syscall. The RSX
+// texture cache protects host pages on its own, the host then fails with
+// EFAULT or a short transfer: it stops there and the caller continues with the
+// bounce buffer, where the access faults and is handled as usual.
+static u64 lv2_fs_direct_io(int fd, u32 addr, u64 size, u64 offset,
+                            bool is_write, bool is_async) {
+  const u8 access = is_write ? vm::page_readable : vm::page_writable;
+
+  if (!size || size > 0xffff'ffffull - addr ||
+      !vm::check_addr(addr, access, static_cast<u32>(size))) {
+    return 0;
+  }
+
+  // Accesses of these pages must be notified, the host can't do that
+  for (u32 page = addr / 4096; page <= (addr + size - 1) / 4096; page++) {
+    if (vm::check_addr(page * 4096, vm::page_fault_notification)) {
+      return 0;
+    }
+  }
+
+  if (!s_direct_io_locks.try_inc(c_max_direct_io_locks)) {
+    return 0;
+  }
+
+  struct range_lock_t {
+    atomic_t<u64, 64> *const ptr = vm::alloc_range_lock();
+
+    ~range_lock_t() {
+      vm::free_range_lock(ptr);
+      s_direct_io_locks--;
+    }
+  } range_lock;
 
   u64 result = 0;
 
   while (result < size) {
-    const u64 block = std::min<u64>(size - result, local_buf.size());
-    const u64 nread = (opt_pos == umax ? file.read(local_buf.data(), block)
-                                       : file.read_at(opt_pos + result,
-                                                      local_buf.data(), block));
+    const u32 chunk_addr = static_cast<u32>(addr + result);
+    const u32 chunk = static_cast<u32>(std::min(size - result, c_direct_io_chunk));
+
+    vm::range_lock(range_lock.ptr, chunk_addr, chunk);
 
-    std::memcpy(static_cast<uchar *>(buf.get_ptr()) + result, local_buf.data(),
-                nread);
-    result += nread;
+    // The protection can't change while the range is locked
+    s64 done = 0;
 
-    if (nread < block) {
+    if (vm::check_addr(chunk_addr, access, chunk)) {
+      done = lv2_fs_host_io(fd, vm::base(chunk_addr), chunk,
+                            offset == umax ? umax : offset + result, is_write,
+                            is_async);
+    }
+
+    range_lock.ptr->release(0);
+
+    if (done <= 0) {
+      break;
+    }
+
+    result += done;
+
+    if (static_cast<u64>(done) < chunk) {
       break;
     }
   }
@@ -417,24 +889,172 @@ u64 lv2_file::op_read(const fs::file &file, vm::ptr<void> buf, u64 size,
   return result;
 }
 
-u64 lv2_file::op_write(const fs::file &file, vm::cptr<void> buf, u64 size) {
-  // Copy data to intermediate buffer (avoid passing vm pointer to a native API)
-  std::vector<uchar> local_buf(std::min<u64>(size, 65536));
+// Transfer between a host file and guest memory, directly where possible and
+// through the bounce buffer for the rest
+static u64 lv2_fs_native_io(int fd, u32 addr, u64 size, u64 offset,
+                            bool is_write, bool is_async) {
+  auto &stats = g_fxo->get<lv2_fs_io_stats>();
 
-  u64 result = 0;
+  u64 result = lv2_fs_direct_io(fd, addr, size, offset, is_write, is_async);
+
+  if (result) {
+    stats.direct_ops++;
+  }
+
+  if (result == size) {
+    return result;
+  }
+
+  stats.bounced_ops++;
+  uchar *const local_buf = get_bounce_buffer();
 
   while (result < size) {
-    const u64 block = std::min<u64>(size - result, local_buf.size());
-    std::memcpy(local_buf.data(),
-                static_cast<const uchar *>(buf.get_ptr()) + result, block);
-    const u64 nwrite = file.write(+local_buf.data(), block);
-    result += nwrite;
+    const u64 block = std::min<u64>(size - result, 65536);
 
-    if (nwrite < block) {
+    if (is_write) {
+      std::memcpy(local_buf, vm::base(static_cast<u32>(addr + result)), block);
+    }
+
+    const s64 done =
+        lv2_fs_host_io(fd, local_buf, block,
+                       offset == umax ? umax : offset + result, is_write,
+                       is_async);
+
+    if (done < 0) {
+      sys_fs.error("Host %s failed (%s)", is_write ? "write" : "read",
+                   std::strerror(static_cast<int>(-done)));
       break;
     }
+
+    if (!is_write) {
+      std::memcpy(vm::base(static_cast<u32>(addr + result)), local_buf, done);
+    }
+
+    result += done;
+
+    if (static_cast<u64>(done) < block) {
+      break;
+    }
+  }
+
+  return result;
+}
+#else
+static int get_native_fd(const fs::file &) { return -1; }
+
+static u64 lv2_fs_native_io(int, u32, u64, u64, bool, bool) { return 0; }
+#endif
+
+u64 lv2_file::op_read(const fs::file &file, vm::ptr<void> buf, u64 size,
+                      u64 opt_pos) {
+  auto &stats = g_fxo->get<lv2_fs_io_stats>();
+  const lv2_fs_io_stats::scope scope(stats);
+
+  u64 result = 0;
+
+  if (const int fd = get_native_fd(file); fd >= 0) {
+    result = lv2_fs_native_io(fd, buf.addr(), size, opt_pos, false, false);
+  } else if (u64 region = buf.addr() >> 28,
+             region_end = (buf.addr() & 0xfff'ffff) + (size & 0xfff'ffff);
+             region == region_end && ((region >> 28) == 0 || region >= 0xC)) {
+    // Optimize reads from safe memory, virtual files copy the data themselves
+    stats.direct_ops++;
+    result = opt_pos == umax ? file.read(buf.get_ptr(), size)
+                             : file.read_at(opt_pos, buf.get_ptr(), size);
+  } else {
+    // Copy data from intermediate buffer (avoid passing vm pointer to a
+    // native API)
+    stats.bounced_ops++;
+    uchar *const local_buf = get_bounce_buffer();
+
+    while (result < size) {
+      const u64 block = std::min<u64>(size - result, 65536);
+      const u64 nread =
+          (opt_pos == umax
+               ? file.read(local_buf, block)
+               : file.read_at(opt_pos + result, local_buf, block));
+
+      std::memcpy(static_cast<uchar *>(buf.get_ptr()) + result, local_buf,
+                  nread);
+      result += nread;
+
+      if (nread < block) {
+        break;
+      }
+    }
   }
 
+  stats.bytes_read += result;
+  return result;
+}
+
+u64 lv2_file::op_write(const fs::file &file, vm::cptr<void> buf, u64 size) {
+  auto &stats = g_fxo->get<lv2_fs_io_stats>();
+  const lv2_fs_io_stats::scope scope(stats);
+
+  u64 result = 0;
+
+  if (const int fd = get_native_fd(file); fd >= 0) {
+    result = lv2_fs_native_io(fd, buf.addr(), size, umax, true, false);
+  } else {
+    // Copy data to intermediate buffer (avoid passing vm pointer to a native
+    // API)
+    stats.bounced_ops++;
+    uchar *const local_buf = get_bounce_buffer();
+
+    while (result < size) {
+      const u64 block = std::min<u64>(size - result, 65536);
+      std::memcpy(local_buf,
+                  static_cast<const uchar *>(buf.get_ptr()) + result, block);
+      const u64 nwrite = file.write(+local_buf, block);
+      result += nwrite;
+
+      if (nwrite < block) {
+        break;
+      }
+    }
+  }
+
+  stats.bytes_written += result;
+  return result;
+}
+
+u64 lv2_file::op_read_async(const fs::file &file, vm::ptr<void> buf, u64 size,
+                            u64 pos) {
+  const int fd = get_native_fd(file);
+
+  if (fd < 0) {
+    return op_read(file, buf, size, pos);
+  }
+
+  auto &stats = g_fxo->get<lv2_fs_io_stats>();
+  const lv2_fs_io_stats::scope scope(stats);
+
+  stats.async_ops++;
+  const u64 result = lv2_fs_native_io(fd, buf.addr(), size, pos, false, true);
+  stats.bytes_read += result;
+  return result;
+}
+
+u64 lv2_file::op_write_async(const fs::file &file, vm::cptr<void> buf,
+                             u64 size, u64 pos) {
+  const int fd = get_native_fd(file);
+
+  if (fd < 0) {
+    // Virtual files are written at the current position
+    const u64 old_pos = file.pos();
+    file.seek(pos);
+    const u64 result = op_write(file, buf, size);
+    ensure(old_pos == file.seek(old_pos));
+    return result;
+  }
+
+  auto &stats = g_fxo->get<lv2_fs_io_stats>();
+  const lv2_fs_io_stats::scope scope(stats);
+
+  stats.async_ops++;
+  const u64 result = lv2_fs_native_io(fd, buf.addr(), size, pos, true, true);
+  stats.bytes_written += result;
   return result;
 }
 
@@ -1893,21 +2513,13 @@ error_code sys_fs_fcntl(ppu_thread &ppu, u32 fd, u32 op, vm::ptr<void> _arg,
       return CELL_EBUSY;
     }
 
-    u64 old_pos = umax;
     const u64 op_pos = arg->offset;
 
-    if (op == 0x8000000b) {
-      old_pos = file->file.pos();
-      file->file.seek(op_pos);
-    }
-
-    arg->out_size = op == 0x8000000a
-                        ? file->op_read(arg->buf, arg->size, op_pos)
-                        : file->op_write(arg->buf, arg->size);
-
-    if (op == 0x8000000b) {
-      ensure(old_pos == file->file.seek(old_pos));
-    }
+    arg->out_size =
+        op == 0x8000000a
+            ? lv2_file::op_read_async(file->file, arg->buf, arg->size, op_pos)
+            : lv2_file::op_write_async(file->file, arg->buf, arg->size,
+                                       op_pos);
 
     // TODO: EDATA corruption detection
 
@@ -1702,6 +1702,8 @@ error_code lv2_socket::abort_socket(s32 flags) {
     auto &nc = g_fxo->get<network_context>();
     const u32 prev_value = nc.num_polls.fetch_sub(num_waiters);
     ensure(prev_value >= num_waiters);
+
+    nc.update_socket(lv2_id);
   }
 
   lv2_obj::awake_all();
@@ -7,8 +7,21 @@
 #include "sys_net/network_context.h"
 #include "sys_net/sys_net_helpers.h"
 
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <unordered_map>
+#endif
+
 LOG_CHANNEL(sys_net);
 
+#ifdef __linux__
+// epoll data of the wake-up eventfd, other entries hold lv2 socket id or port
+static constexpr u64 wake_event_key = umax;
+#endif
+
 // Used by RPCN to send signaling packets to RPCN server(for UDP hole punching)
 bool send_packet_from_p2p_port_ipv4(const std::vector<u8> &data,
                                     const sockaddr_in &addr) {
@@ -155,13 +168,234 @@ void base_network_thread::wake_threads() {
   }
 }
 
+#ifdef __linux__
+base_network_thread::base_network_thread() {
+  ensure((epoll_fd = ::epoll_create1(EPOLL_CLOEXEC)) >= 0);
+  ensure((wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) >= 0);
+
+  epoll_event event{EPOLLIN, {}};
+  event.data.u64 = wake_event_key;
+  ensure(::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) == 0);
+}
+
+base_network_thread::~base_network_thread() {
+  ::close(wake_fd);
+  ::close(epoll_fd);
+}
+#endif
+
+void base_network_thread::wake_up() {
+#ifdef __linux__
+  const u64 value = 1;
+  ensure(::write(wake_fd, &value, sizeof(value)) == sizeof(value));
+#endif
+}
+
+#ifdef __linux__
+// Drain the wake-up eventfd, events with other keys are left in place
+static bool take_wake_event(int wake_fd, const epoll_event &event) {
+  if (event.data.u64 != wake_event_key) {
+    return false;
+  }
+
+  u64 value;
+  while (::read(wake_fd, &value, sizeof(value)) == sizeof(value))
+    ;
+
+  return true;
+}
+#endif
+
+void network_thread::update_socket([[maybe_unused]] u32 lv2_id) {
+#ifdef __linux__
+  {
+    std::lock_guard lock(mutex_dirty_sockets);
+    dirty_sockets.push_back(lv2_id);
+  }
+
+  wake_up();
+#endif
+}
+
+network_thread &network_thread::operator=(thread_state) noexcept {
+  wake_up();
+  return *this;
+}
+
 p2p_thread::p2p_thread() { np::init_np_handler_dependencies(); }
 
+p2p_thread &p2p_thread::operator=(thread_state) noexcept {
+  wake_up();
+  return *this;
+}
+
 void p2p_thread::bind_sce_np_port() {
   std::lock_guard list_lock(list_p2p_ports_mutex);
   create_p2p_port(SCE_NP_PORT);
 }
 
+#ifdef __linux__
+void network_thread::operator()() {
+  {
+    std::lock_guard lock(mutex_ppu_to_awake);
+    ppu_to_awake.clear();
+  }
+
+  struct registration {
+    socket_type fd;
+
+    // Receive or send timeout is set, callbacks check it on every iteration
+    bool timed;
+  };
+
+  // Sockets registered in epoll by lv2 id and their owners by native socket
+  // (a closed socket is removed from epoll by the kernel and its fd can be
+  // reused by another socket)
+  std::unordered_map<u32, registration> registered;
+  std::unordered_map<socket_type, u32> fd_owners;
+  u32 num_timed = 0;
+
+  std::vector<u32> dirty;
+  std::array<epoll_event, 64> events;
+
+  auto unregister = [&](u32 id) {
+    const auto found = registered.find(id);
+
+    if (found == registered.end()) {
+      return;
+    }
+
+    if (const auto owner = fd_owners.find(found->second.fd);
+        owner != fd_owners.end() && owner->second == id) {
+      ::epoll_ctl(epoll_fd, EPOLL_CTL_DEL, found->second.fd, nullptr);
+      fd_owners.erase(owner);
+    }
+
+    num_timed -= found->second.timed;
+    registered.erase(found);
+  };
+
+  // Sync epoll registration with the poll queue of the socket
+  auto update = [&](u32 id) {
+    const auto sock = idm::get_unlocked<lv2_socket>(id);
+    const auto selected = sock ? sock->get_events()
+                               : rx::EnumBitSet<lv2_socket::poll_t>{};
+    const socket_type fd = sock ? sock->get_socket() : 0;
+
+    if (const auto found = registered.find(id);
+        found != registered.end() && (found->second.fd != fd || !selected)) {
+      unregister(id);
+    }
+
+    if (!selected || fd <= 0) {
+      return;
+    }
+
+    // Modifying an edge-triggered registration reports the current readiness,
+    // so data that arrived before the socket was polled is not missed
+    epoll_event event{};
+    event.events = EPOLLET |
+                   (selected & lv2_socket::poll_t::read ? EPOLLIN : 0) |
+                   (selected & lv2_socket::poll_t::write ? EPOLLOUT : 0);
+    event.data.u64 = id;
+
+    const bool is_owner = fd_owners.contains(fd) && fd_owners[fd] == id;
+
+    if (::epoll_ctl(epoll_fd, is_owner ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd,
+                    &event) != 0 &&
+        ::epoll_ctl(epoll_fd, is_owner ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd,
+                    &event) != 0) {
+      sys_net.error("Failed to register socket %d in epoll: %s", id,
+                    get_last_error(false, false));
+      return;
+    }
+
+    fd_owners[fd] = id;
+
+    const bool timed = sock->so_rcvtimeo || sock->so_sendtimeo;
+    auto &reg = registered[id];
+    num_timed += timed;
+    num_timed -= reg.timed;
+    reg = {fd, timed};
+  };
+
+  while (thread_ctrl::state() != thread_state::aborting) {
+    // Without timeouts to check, sleep until an event or a state change
+    const int count = ::epoll_wait(epoll_fd, events.data(), ::size32(events),
+                                   num_timed ? 1 : -1);
+
+    if (count < 0 && errno != EINTR) {
+      sys_net.error("Error epoll_wait on network sockets: %s",
+                    get_last_error(false, false));
+    }
+
+    std::lock_guard lock(mutex_thread_loop);
+
+    for (int i = 0; i < count; i++) {
+      if (take_wake_event(wake_fd, events[i])) {
+        continue;
+      }
+
+      const u32 id = static_cast<u32>(events[i].data.u64);
+      const auto found = registered.find(id);
+
+      if (found == registered.end()) {
+        continue;
+      }
+
+      const auto sock = idm::get_unlocked<lv2_socket>(id);
+
+      if (!sock) {
+        unregister(id);
+        continue;
+      }
+
+      const u32 ev = events[i].events;
+
+      ::pollfd native_fd{};
+      native_fd.fd = found->second.fd;
+      native_fd.revents = static_cast<short>(
+          (ev & EPOLLIN ? POLLIN : 0) | (ev & EPOLLOUT ? POLLOUT : 0) |
+          (ev & EPOLLERR ? POLLERR : 0) | (ev & EPOLLHUP ? POLLHUP : 0));
+
+      sock->handle_events(native_fd);
+
+      // Handled events are reset, unsatisfied callbacks select them again
+      dirty.push_back(id);
+    }
+
+    if (num_timed) {
+      for (const auto &[id, reg] : registered) {
+        if (!reg.timed) {
+          continue;
+        }
+
+        if (const auto sock = idm::get_unlocked<lv2_socket>(id)) {
+          sock->handle_events(::pollfd{reg.fd, 0, 0});
+          dirty.push_back(id);
+        }
+      }
+    }
+
+    wake_threads();
+
+    {
+      std::lock_guard lock(mutex_dirty_sockets);
+      dirty.insert(dirty.end(), dirty_sockets.begin(), dirty_sockets.end());
+      dirty_sockets.clear();
+    }
+
+    std::sort(dirty.begin(), dirty.end());
+    dirty.erase(std::unique(dirty.begin(), dirty.end()), dirty.end());
+
+    for (u32 id : dirty) {
+      update(id);
+    }
+
+    dirty.clear();
+  }
+}
+#else
 void network_thread::operator()() {
   std::vector<shared_ptr<lv2_socket>> socklist;
   socklist.reserve(lv2_socket::id_count);
@@ -229,12 +463,29 @@ void network_thread::operator()() {
   }
 }
 
+#endif
+
 // Must be used under list_p2p_ports_mutex lock!
 void p2p_thread::create_p2p_port(u16 p2p_port) {
   if (!list_p2p_ports.contains(p2p_port)) {
-    list_p2p_ports.emplace(std::piecewise_construct,
-                           std::forward_as_tuple(p2p_port),
-                           std::forward_as_tuple(p2p_port));
+    auto &port = list_p2p_ports
+                     .emplace(std::piecewise_construct,
+                              std::forward_as_tuple(p2p_port),
+                              std::forward_as_tuple(p2p_port))
+                     .first->second;
+
+#ifdef __linux__
+    epoll_event event{EPOLLIN | EPOLLET, {}};
+    event.data.u64 = p2p_port;
+
+    if (::epoll_ctl(epoll_fd, EPOLL_CTL_ADD, port.p2p_socket, &event) != 0) {
+      sys_net.error("[P2P] Failed to register port %d in epoll: %s", p2p_port,
+                    get_last_error(false, false));
+    }
+#else
+    static_cast<void>(port);
+#endif
+
     const u32 prev_value = num_p2p_ports.fetch_add(1);
     if (!prev_value) {
       num_p2p_ports.notify_one();
@@ -242,6 +493,53 @@ void p2p_thread::create_p2p_port(u16 p2p_port) {
   }
 }
 
+#ifdef __linux__
+void p2p_thread::operator()() {
+  std::array<epoll_event, 16> events;
+
+  while (thread_ctrl::state() != thread_state::aborting) {
+    const int count =
+        ::epoll_wait(epoll_fd, events.data(), ::size32(events), -1);
+
+    if (count < 0) {
+      if (errno != EINTR) {
+        sys_net.error("[P2P] Error epoll_wait on P2P sockets: %s",
+                      get_last_error(false, false));
+      }
+
+      continue;
+    }
+
+    std::lock_guard lock(list_p2p_ports_mutex);
+
+    for (int i = 0; i < count; i++) {
+      if (take_wake_event(wake_fd, events[i])) {
+        continue;
+      }
+
+      const auto found =
+          list_p2p_ports.find(static_cast<u16>(events[i].data.u64));
+
+      if (found == list_p2p_ports.end()) {
+        continue;
+      }
+
+      auto &p2p_port = found->second;
+
+      while (p2p_port.recv_data())
+        ;
+
+      // Receiving may stop on an error before the socket is drained, re-arm
+      // the edge-triggered registration to be notified of the remaining data
+      epoll_event event{EPOLLIN | EPOLLET, {}};
+      event.data.u64 = found->first;
+      ::epoll_ctl(epoll_fd, EPOLL_CTL_MOD, p2p_port.p2p_socket, &event);
+    }
+
+    wake_threads();
+  }
+}
+#else
 void p2p_thread::operator()() {
   std::vector<::pollfd> p2p_fd(lv2_socket::id_count);
 
@@ -297,3 +595,4 @@ void p2p_thread::operator()() {
     }
   }
 }
+#endif
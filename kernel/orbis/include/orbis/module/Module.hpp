@@ -8,6 +8,7 @@
 
 #include "orbis-config.hpp"
 #include <string>
+#include <string_view>
 
 namespace orbis {
 struct Thread;
@@ -120,6 +121,12 @@ struct Module final {
   kvector<rx::Ref<Module>> namespaceModules;
   kvector<kstring> needed;
 
+  // Exported symbols by NID, symbolChain links the symbols with equal NID.
+  // Built once on load, so relocations of importing modules do not scan the
+  // whole symbol table
+  kunmap<std::uint64_t, std::uint32_t> symbolIndex;
+  kvector<std::uint32_t> symbolChain;
+
   std::atomic<unsigned> references{0};
 
   void incRef() {
@@ -135,6 +142,10 @@ struct Module final {
     }
   }
 
+  void buildSymbolIndex();
+  const Symbol *findExportedSymbol(std::uint64_t id,
+                                   std::string_view library) const;
+
   orbis::SysResult relocate(Process *process);
 
   void operator delete(void *pointer);
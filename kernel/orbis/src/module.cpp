@@ -1,6 +1,7 @@
 #include "module/Module.hpp"
 #include "KernelAllocator.hpp"
 #include "thread.hpp"
+#include <chrono>
 #include <utility>
 
 #include "thread/Process.hpp"
@@ -69,95 +70,113 @@ static void allocateTlsOffset(orbis::Process *process, orbis::Module *module) {
   module->isTlsDone = true;
 }
 
-static orbis::SysResult doPltRelocation(orbis::Process *process,
-                                        orbis::Module *module,
-                                        orbis::Relocation rel) {
-  auto symbol = module->symbols.at(rel.symbolIndex);
+static constexpr std::uint32_t kNoSymbol = ~static_cast<std::uint32_t>(0);
 
-  auto A = rel.addend;
-  auto B = reinterpret_cast<std::uint64_t>(module->base);
-  auto where = reinterpret_cast<std::uint64_t *>(B + rel.offset);
-  auto where32 = reinterpret_cast<std::uint32_t *>(B + rel.offset);
-  auto P = reinterpret_cast<std::uintptr_t>(where);
+void orbis::Module::buildSymbolIndex() {
+  symbolIndex.clear();
+  symbolIndex.reserve(symbols.size());
+  symbolChain.assign(symbols.size(), kNoSymbol);
 
-  auto findDefModule = [module,
-                        symbol] -> std::pair<orbis::Module *, std::uint64_t> {
-    if (symbol.moduleIndex == -1 || symbol.bind == orbis::SymbolBind::Local) {
-      return std::pair(module, symbol.address);
+  // walk in reverse order, so chains keep the symbol table order
+  for (std::size_t i = symbols.size(); i-- > 0;) {
+    auto &symbol = symbols[i];
+    if (symbol.bind == SymbolBind::Local ||
+        symbol.visibility == SymbolVisibility::Hidden ||
+        symbol.libraryIndex >= neededLibraries.size()) {
+      continue;
     }
 
-    auto &defModule = module->importedModules.at(symbol.moduleIndex);
-    if (!defModule) {
-      // std::printf(
-      //     "Delaying plt relocation '%s' ('%s'), symbol '%llx' in %s
-      //     module\n", module->moduleName, module->soName, (unsigned long
-      //     long)symbol.id,
-      //     module->neededModules[symbol.moduleIndex].name.c_str());
+    auto [it, inserted] =
+        symbolIndex.try_emplace(symbol.id, static_cast<std::uint32_t>(i));
+    if (!inserted) {
+      symbolChain[i] = std::exchange(it->second, static_cast<std::uint32_t>(i));
+    }
+  }
+}
+
+const orbis::Symbol *
+orbis::Module::findExportedSymbol(std::uint64_t id,
+                                  std::string_view library) const {
+  auto it = symbolIndex.find(id);
+  if (it == symbolIndex.end()) {
+    return nullptr;
+  }
 
-      return {};
+  for (auto index = it->second; index != kNoSymbol;
+       index = symbolChain[index]) {
+    auto &symbol = symbols[index];
+
+    if (std::string_view(neededLibraries[symbol.libraryIndex].name) ==
+        library) {
+      return &symbol;
     }
+  }
 
-    auto library = module->neededLibraries.at(symbol.libraryIndex);
+  return nullptr;
+}
 
-    std::vector<std::string> foundInLibs;
-    for (auto defSym : defModule->symbols) {
-      if (defSym.id != symbol.id || defSym.bind == orbis::SymbolBind::Local) {
-        continue;
-      }
+static std::pair<orbis::Module *, std::uint64_t>
+resolveSymbol(orbis::Module *module, const orbis::Symbol &symbol) {
+  if (symbol.moduleIndex == -1 || symbol.bind == orbis::SymbolBind::Local) {
+    return std::pair(module, symbol.address);
+  }
 
-      if (defSym.visibility == orbis::SymbolVisibility::Hidden) {
-        std::printf("Ignoring hidden symbol\n");
-        continue;
-      }
+  auto &defModule = module->importedModules.at(symbol.moduleIndex);
+  if (!defModule) {
+    // delay relocation until module is loaded
+    return {};
+  }
 
-      auto defLib = defModule->neededLibraries.at(defSym.libraryIndex);
+  auto &library = module->neededLibraries.at(symbol.libraryIndex);
 
-      if (defLib.name == library.name) {
-        return std::pair(defModule.get(), defSym.address);
-      }
+  if (auto defSym = defModule->findExportedSymbol(symbol.id, library.name)) {
+    return std::pair(defModule.get(), defSym->address);
+  }
 
-      foundInLibs.emplace_back(std::string_view(defLib.name));
+  for (auto &nsDefModule : defModule->namespaceModules) {
+    if (auto defSym =
+            nsDefModule->findExportedSymbol(symbol.id, library.name)) {
+      return std::pair(nsDefModule.get(), defSym->address);
     }
+  }
 
-    for (auto nsDefModule : defModule->namespaceModules) {
-      for (auto defSym : nsDefModule->symbols) {
-        if (defSym.id != symbol.id || defSym.bind == orbis::SymbolBind::Local) {
-          continue;
-        }
+  std::printf(
+      "'%s' ('%s') uses undefined symbol '%llx' in '%s' ('%s') module\n",
+      module->moduleName, module->soName, (unsigned long long)symbol.id,
+      defModule->moduleName, defModule->soName);
+
+  if (auto it = defModule->symbolIndex.find(symbol.id);
+      it != defModule->symbolIndex.end()) {
+    std::printf("Requested library is '%s', exists in libraries: [",
+                library.name.c_str());
+
+    for (auto index = it->second; index != kNoSymbol;
+         index = defModule->symbolChain[index]) {
+      auto &defSym = defModule->symbols[index];
+      std::printf(
+          "%s'%s'", index == it->second ? "" : ", ",
+          defModule->neededLibraries[defSym.libraryIndex].name.c_str());
+    }
 
-        if (defSym.visibility == orbis::SymbolVisibility::Hidden) {
-          std::printf("Ignoring hidden symbol\n");
-          continue;
-        }
+    std::printf("]\n");
+  }
 
-        auto defLib = nsDefModule->neededLibraries.at(defSym.libraryIndex);
+  return std::pair(module, symbol.address);
+}
 
-        if (defLib.name == library.name) {
-          return std::pair(nsDefModule.get(), defSym.address);
-        }
-      }
-    }
+static orbis::SysResult doPltRelocation(orbis::Process *process,
+                                        orbis::Module *module,
+                                        orbis::Relocation rel) {
+  auto symbol = module->symbols.at(rel.symbolIndex);
 
-    std::printf(
-        "'%s' ('%s') uses undefined symbol '%llx' in '%s' ('%s') module\n",
-        module->moduleName, module->soName, (unsigned long long)symbol.id,
-        defModule->moduleName, defModule->soName);
-    if (foundInLibs.size() > 0) {
-      std::printf("Requested library is '%s', exists in libraries: [",
-                  library.name.c_str());
-
-      for (bool isFirst = true; auto &lib : foundInLibs) {
-        if (isFirst) {
-          isFirst = false;
-        } else {
-          std::printf(", ");
-        }
-
-        std::printf("'%s'", lib.c_str());
-      }
-      std::printf("]\n");
-    }
-    return std::pair(module, symbol.address);
+  auto A = rel.addend;
+  auto B = reinterpret_cast<std::uint64_t>(module->base);
+  auto where = reinterpret_cast<std::uint64_t *>(B + rel.offset);
+  auto where32 = reinterpret_cast<std::uint32_t *>(B + rel.offset);
+  auto P = reinterpret_cast<std::uintptr_t>(where);
+
+  auto findDefModule = [module, &symbol] {
+    return resolveSymbol(module, symbol);
   };
 
   switch (rel.relType) {
@@ -195,86 +214,8 @@ static orbis::SysResult doRelocation(orbis::Process *process,
   auto where32 = reinterpret_cast<std::uint32_t *>(B + rel.offset);
   auto P = reinterpret_cast<std::uintptr_t>(where);
 
-  auto findDefModule = [module, symbol,
-                        rel] -> std::pair<orbis::Module *, std::uint64_t> {
-    if (symbol.moduleIndex == -1 || symbol.bind == orbis::SymbolBind::Local) {
-      return std::pair(module, symbol.address);
-    }
-
-    auto &defModule = module->importedModules.at(symbol.moduleIndex);
-    if (!defModule) {
-      // std::printf("'%s' ('%s') uses undefined symbol '%llx' in unloaded
-      // module "
-      //             "'%s', rel %u\n",
-      //             module->moduleName, module->soName,
-      //             (unsigned long long)symbol.id,
-      //             module->neededModules.at(symbol.moduleIndex).name.c_str(),
-      //             rel.relType);
-
-      return {};
-    }
-
-    auto library = module->neededLibraries.at(symbol.libraryIndex);
-
-    std::vector<std::string> foundInLibs;
-    for (auto defSym : defModule->symbols) {
-      if (defSym.id != symbol.id || defSym.bind == orbis::SymbolBind::Local) {
-        continue;
-      }
-
-      if (defSym.visibility == orbis::SymbolVisibility::Hidden) {
-        std::printf("Ignoring hidden symbol\n");
-        continue;
-      }
-
-      auto defLib = defModule->neededLibraries.at(defSym.libraryIndex);
-
-      if (defLib.name == library.name) {
-        return std::pair(defModule.get(), defSym.address);
-      }
-
-      foundInLibs.emplace_back(std::string_view(defLib.name));
-    }
-
-    for (auto nsDefModule : defModule->namespaceModules) {
-      for (auto defSym : nsDefModule->symbols) {
-        if (defSym.id != symbol.id || defSym.bind == orbis::SymbolBind::Local) {
-          continue;
-        }
-
-        if (defSym.visibility == orbis::SymbolVisibility::Hidden) {
-          std::printf("Ignoring hidden symbol\n");
-          continue;
-        }
-
-        auto defLib = nsDefModule->neededLibraries.at(defSym.libraryIndex);
-
-        if (defLib.name == library.name) {
-          return std::pair(nsDefModule.get(), defSym.address);
-        }
-      }
-    }
-
-    std::printf(
-        "'%s' ('%s') uses undefined symbol '%llx' in '%s' ('%s') module\n",
-        module->moduleName, module->soName, (unsigned long long)symbol.id,
-        defModule->moduleName, defModule->soName);
-    if (foundInLibs.size() > 0) {
-      std::printf("Requested library is '%s', exists in libraries: [",
-                  library.name.c_str());
-
-      for (bool isFirst = true; auto &lib : foundInLibs) {
-        if (isFirst) {
-          isFirst = false;
-        } else {
-          std::printf(", ");
-        }
-
-        std::printf("'%s'", lib.c_str());
-      }
-      std::printf("]\n");
-    }
-    return std::pair(module, symbol.address);
+  auto findDefModule = [module, &symbol] {
+    return resolveSymbol(module, symbol);
   };
 
   switch (rel.relType) {
@@ -366,46 +307,55 @@ static orbis::SysResult doRelocation(orbis::Process *process,
 }
 
 orbis::SysResult orbis::Module::relocate(Process *process) {
+  if (pltRelocations.empty() && nonPltRelocations.empty()) {
+    return {};
+  }
+
+  auto startTime = std::chrono::steady_clock::now();
+  std::size_t pltResolved = 0;
+  std::size_t pltDelayed = 0;
+  std::size_t nonPltResolved = 0;
+  std::size_t nonPltDelayed = 0;
+
   if (!pltRelocations.empty()) {
     kvector<Relocation> delayedRelocations;
-    std::size_t resolved = 0;
-    std::size_t delayed = 0;
     for (auto rel : pltRelocations) {
       auto result = doPltRelocation(process, this, rel);
 
       if (result.isError()) {
         delayedRelocations.push_back(rel);
-        ++delayed;
+        ++pltDelayed;
       } else {
-        ++resolved;
+        ++pltResolved;
       }
     }
 
-    std::printf("plt relocation of %s: delayed/resolved: %zu/%zu\n", moduleName,
-                delayed, resolved);
     pltRelocations = std::move(delayedRelocations);
   }
 
   if (!nonPltRelocations.empty()) {
     kvector<Relocation> delayedRelocations;
-    std::size_t resolved = 0;
-    std::size_t delayed = 0;
     for (auto rel : nonPltRelocations) {
       auto result = doRelocation(process, this, rel);
 
       if (result.isError()) {
         delayedRelocations.push_back(rel);
-        ++delayed;
+        ++nonPltDelayed;
       } else {
-        ++resolved;
+        ++nonPltResolved;
       }
     }
 
-    std::printf("non-plt relocation of %s: delayed/resolved: %zu/%zu\n",
-                moduleName, delayed, resolved);
     nonPltRelocations = std::move(delayedRelocations);
   }
 
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - startTime);
+
+  std::printf("relocation of %s: plt delayed/resolved: %zu/%zu, non-plt "
+              "delayed/resolved: %zu/%zu, %lld us\n",
+              moduleName, pltDelayed, pltResolved, nonPltDelayed,
+              nonPltResolved, static_cast<long long>(elapsed.count()));
   return {};
 }
 
@@ -2,14 +2,17 @@
 #include "Emu/System.h"
 #include "Emu/system_config.h"
 #include "Emu/Audio/audio_utils.h"
+#include "Emu/perf_meter.hpp"
 #include "Emu/Cell/PPUModule.h"
 #include "Emu/Cell/timers.hpp"
 #include "cellos/sys_process.h"
 #include "cellos/sys_event.h"
 #include "cellAudio.h"
+#include "util/simd.hpp"
 #include "util/video_provider.h"
 
 #include <cmath>
+#include <utility>
 
 LOG_CHANNEL(cellAudio);
 
@@ -1041,11 +1044,220 @@ audio_port* cell_audio_thread::open_port()
 	return nullptr;
 }
 
+// Downmix matrix coefficient of the input channel for the output channel.
+// 8 channel ports are ordered as L, R, C, LFE, SL, SR, RL, RR
+template <u32 in_channels, u32 out_channels, AudioChannelCnt downmix>
+static constexpr f32 get_mix_coef(u32 out, u32 in)
+{
+	constexpr f32 minus_3db = 0.707f; // value taken from https://www.dolby.com/us/en/technologies/a-guide-to-dolby-metadata.pdf
+
+	if (in_channels == 2 || out < 2)
+	{
+		if (in_channels == 8 && downmix == AudioChannelCnt::STEREO && out < 2)
+		{
+			// Don't mix in the lfe as per dolby specification and based on documentation
+			if (in == out)
+				return minus_3db;
+
+			return in == 2 || in == out + 4 || in == out + 6 ? 0.5f : 0.0f;
+		}
+
+		return in == out ? 1.0f : 0.0f;
+	}
+
+	// Only mix the surround channels into the output if surround output is configured
+	if (out_channels == 2 || downmix == AudioChannelCnt::STEREO)
+		return 0.0f;
+
+	if (out < 4)
+		return in == out ? 1.0f : 0.0f;
+
+	if (downmix == AudioChannelCnt::SURROUND_5_1)
+	{
+		// When using 7.1 ouput, the side channels are mixed into the last pair
+		const u32 side = out_channels == 6 ? 4 : 6;
+		return out >= side && (in == out - side + 4 || in == out - side + 6) ? 1.0f : 0.0f;
+	}
+
+	if (out_channels == 6)
+		return in == out ? 1.0f : 0.0f;
+
+	// 7.1 output has rear channels before the side ones
+	return in == (out < 6 ? out + 2 : out - 2) ? 1.0f : 0.0f;
+}
+
+static inline void transpose4(v128& a, v128& b, v128& c, v128& d)
+{
+	const v128 t0 = gv_unpacklo32(a, b);
+	const v128 t1 = gv_unpacklo32(c, d);
+	const v128 t2 = gv_unpackhi32(a, b);
+	const v128 t3 = gv_unpackhi32(c, d);
+
+	a = gv_shufflefs<0, 1, 0, 1>(t0, t1);
+	b = gv_shufflefs<2, 3, 2, 3>(t0, t1);
+	c = gv_shufflefs<0, 1, 0, 1>(t2, t3);
+	d = gv_shufflefs<2, 3, 2, 3>(t2, t3);
+}
+
+// Sum of the input channels weighted by the matrix row, added in the channel
+// order to match the results of the scalar mixer
+template <u32 in_channels, u32 out_channels, AudioChannelCnt downmix, u32 out, u32... in>
+static inline v128 mix_row(const v128 (&channels)[in_channels], std::integer_sequence<u32, in...>)
+{
+	v128 result = gv_bcst32(0);
+	bool is_empty = true;
+
+	const auto add = [&]<u32 index>()
+	{
+		constexpr f32 coef = get_mix_coef<in_channels, out_channels, downmix>(out, index);
+
+		if constexpr (coef != 0.0f)
+		{
+			const v128 value = coef == 1.0f ? channels[index] : gv_mulfs(channels[index], coef);
+			result = is_empty ? value : gv_addfs(result, value);
+			is_empty = false;
+		}
+	};
+
+	(add.template operator()<in>(), ...);
+	return result;
+}
+
+// Mixes big-endian port samples into the output buffer, 4 frames at a time.
+// Frames are transposed to per channel vectors, scaled by the frame volumes
+// and downmixed with the constant matrix
+template <u32 in_channels, u32 out_channels, AudioChannelCnt downmix>
+static void mix_port(const be_t<f32>* in_buffer, f32* out_buffer, const f32* volumes)
+{
+	for (u32 frame = 0; frame < AUDIO_BUFFER_SAMPLES; frame += 4)
+	{
+		const f32* in = reinterpret_cast<const f32*>(in_buffer + frame * in_channels);
+		f32* out = out_buffer + frame * out_channels;
+
+		v128 input[in_channels];
+
+		for (u32 i = 0; i < in_channels; i++)
+		{
+			input[i] = gv_to_be32(v128::loadu(in, i));
+		}
+
+		v128 channels[in_channels];
+
+		if constexpr (in_channels == 2)
+		{
+			channels[0] = gv_shufflefs<0, 2, 0, 2>(input[0], input[1]);
+			channels[1] = gv_shufflefs<1, 3, 1, 3>(input[0], input[1]);
+		}
+		else
+		{
+			channels[0] = input[0], channels[1] = input[2], channels[2] = input[4], channels[3] = input[6];
+			channels[4] = input[1], channels[5] = input[3], channels[6] = input[5], channels[7] = input[7];
+			transpose4(channels[0], channels[1], channels[2], channels[3]);
+			transpose4(channels[4], channels[5], channels[6], channels[7]);
+		}
+
+		const v128 volume = v128::loadu(volumes + frame);
+
+		for (v128& channel : channels)
+		{
+			channel = gv_mulfs(channel, volume);
+		}
+
+		v128 mixed[out_channels];
+
+		[&]<u32... out_index>(std::integer_sequence<u32, out_index...>)
+		{
+			((mixed[out_index] = mix_row<in_channels, out_channels, downmix, out_index>(channels, std::make_integer_sequence<u32, in_channels>{})), ...);
+		}(std::make_integer_sequence<u32, out_channels>{});
+
+		v128 output[out_channels];
+
+		if constexpr (out_channels == 2)
+		{
+			output[0] = gv_unpacklo32(mixed[0], mixed[1]);
+			output[1] = gv_unpackhi32(mixed[0], mixed[1]);
+		}
+		else if constexpr (out_channels == 6)
+		{
+			transpose4(mixed[0], mixed[1], mixed[2], mixed[3]);
+			const v128 rear01 = gv_unpacklo32(mixed[4], mixed[5]);
+			const v128 rear23 = gv_unpackhi32(mixed[4], mixed[5]);
+
+			output[0] = mixed[0];
+			output[1] = gv_shufflefs<0, 1, 0, 1>(rear01, mixed[1]);
+			output[2] = gv_shufflefs<2, 3, 2, 3>(mixed[1], rear01);
+			output[3] = mixed[2];
+			output[4] = gv_shufflefs<0, 1, 0, 1>(rear23, mixed[3]);
+			output[5] = gv_shufflefs<2, 3, 2, 3>(mixed[3], rear23);
+		}
+		else
+		{
+			transpose4(mixed[0], mixed[1], mixed[2], mixed[3]);
+			transpose4(mixed[4], mixed[5], mixed[6], mixed[7]);
+
+			for (u32 i = 0; i < 4; i++)
+			{
+				output[i * 2 + 0] = mixed[i];
+				output[i * 2 + 1] = mixed[i + 4];
+			}
+		}
+
+		for (u32 i = 0; i < out_channels; i++)
+		{
+			v128::storeu(gv_addfs(v128::loadu(out, i), output[i]), out, i);
+		}
+	}
+}
+
+// part of cellAudioSetPortLevel functionality
+// spread port volume changes over 13ms
+static void step_port_volume(audio_port& port, f32 master_volume, f32* volumes)
+{
+	const audio_port::level_set_t param = port.level_set.load();
+
+	if (param.inc == 0.0f)
+	{
+		const v128 volume = gv_bcstfs(port.level * master_volume);
+
+		for (u32 frame = 0; frame < AUDIO_BUFFER_SAMPLES; frame += 4)
+		{
+			v128::storeu(volume, volumes + frame);
+		}
+
+		return;
+	}
+
+	// Level of each frame is a step of the slope, clamped by the target value
+	const bool dec = param.inc < 0.0f;
+	const v128 level = gv_bcstfs(port.level);
+	const v128 target = gv_bcstfs(param.value);
+	const v128 slope = gv_bcstfs(param.inc);
+	v128 steps = v128::normal_array_t<f32>{1.0f, 2.0f, 3.0f, 4.0f};
+
+	for (u32 frame = 0; frame < AUDIO_BUFFER_SAMPLES; frame += 4)
+	{
+		v128 volume = gv_addfs(level, gv_mulfs(slope, steps));
+		volume = dec ? gv_maxfs(volume, target) : gv_minfs(volume, target);
+		v128::storeu(gv_mulfs(volume, master_volume), volumes + frame);
+		steps = gv_addfs(steps, gv_bcstfs(4.0f));
+	}
+
+	port.level += param.inc * AUDIO_BUFFER_SAMPLES;
+
+	if ((!dec && param.value - port.level <= 0.0f) || (dec && param.value - port.level >= 0.0f))
+	{
+		port.level = param.value;
+		port.level_set.compare_and_swap(param, {param.value, 0.0f});
+	}
+}
+
 template <AudioChannelCnt channels, AudioChannelCnt downmix>
 void cell_audio_thread::mix(float* out_buffer, s32 offset)
 {
 	AUDIT(out_buffer != nullptr);
 
+	perf_meter<"AUDIOMIX"_u64> perf0;
+
 	constexpr u32 out_channels = static_cast<u32>(channels);
 	constexpr u32 out_buffer_sz = out_channels * AUDIO_BUFFER_SAMPLES;
 
@@ -1054,120 +1266,26 @@ void cell_audio_thread::mix(float* out_buffer, s32 offset)
 	// Reset out_buffer
 	std::memset(out_buffer, 0, out_buffer_sz * sizeof(float));
 
+	// Volume of each frame of the current port
+	alignas(16) f32 volumes[AUDIO_BUFFER_SAMPLES];
+
 	// mixing
 	for (audio_port& port : ports)
 	{
 		if (port.state != audio_port_state::started)
 			continue;
 
-		auto buf = port.get_vm_ptr(offset);
-
-		static constexpr float minus_3db = 0.707f; // value taken from https://www.dolby.com/us/en/technologies/a-guide-to-dolby-metadata.pdf
-		float m = master_volume;
-
-		// part of cellAudioSetPortLevel functionality
-		// spread port volume changes over 13ms
-		auto step_volume = [master_volume, &m](audio_port& port)
-		{
-			const audio_port::level_set_t param = port.level_set.load();
+		const auto buf = port.get_vm_ptr(offset);
 
-			if (param.inc != 0.0f)
-			{
-				port.level += param.inc;
-				const bool dec = param.inc < 0.0f;
-
-				if ((!dec && param.value - port.level <= 0.0f) || (dec && param.value - port.level >= 0.0f))
-				{
-					port.level = param.value;
-					port.level_set.compare_and_swap(param, {param.value, 0.0f});
-				}
-			}
-
-			m = port.level * master_volume;
-		};
+		step_port_volume(port, master_volume, volumes);
 
 		if (port.num_channels == 2)
 		{
-			for (u32 out = 0, in = 0; out < out_buffer_sz; out += out_channels, in += 2)
-			{
-				step_volume(port);
-
-				const float left = buf[in + 0] * m;
-				const float right = buf[in + 1] * m;
-
-				out_buffer[out + 0] += left;
-				out_buffer[out + 1] += right;
-			}
+			mix_port<2, out_channels, downmix>(buf, out_buffer, volumes);
 		}
 		else if (port.num_channels == 8)
 		{
-			for (u32 out = 0, in = 0; out < out_buffer_sz; out += out_channels, in += 8)
-			{
-				step_volume(port);
-
-				const float left = buf[in + 0] * m;
-				const float right = buf[in + 1] * m;
-				const float center = buf[in + 2] * m;
-				const float low_freq = buf[in + 3] * m;
-				const float side_left = buf[in + 4] * m;
-				const float side_right = buf[in + 5] * m;
-				const float rear_left = buf[in + 6] * m;
-				const float rear_right = buf[in + 7] * m;
-
-				if constexpr (downmix == AudioChannelCnt::STEREO)
-				{
-					// Don't mix in the lfe as per dolby specification and based on documentation
-					const float mid = center * 0.5f;
-					out_buffer[out + 0] += left * minus_3db + mid + side_left * 0.5f + rear_left * 0.5f;
-					out_buffer[out + 1] += right * minus_3db + mid + side_right * 0.5f + rear_right * 0.5f;
-				}
-				else if constexpr (downmix == AudioChannelCnt::SURROUND_5_1)
-				{
-					out_buffer[out + 0] += left;
-					out_buffer[out + 1] += right;
-
-					if constexpr (out_channels >= 6) // Only mix the surround channels into the output if surround output is configured
-					{
-						out_buffer[out + 2] += center;
-						out_buffer[out + 3] += low_freq;
-
-						if constexpr (out_channels == 6)
-						{
-							out_buffer[out + 4] += side_left + rear_left;
-							out_buffer[out + 5] += side_right + rear_right;
-						}
-						else // When using 7.1 ouput, out_buffer[out + 4] and out_buffer[out + 5] are the rear channels, so the side channels need to be mixed into [out + 6] and [out + 7]
-						{
-							out_buffer[out + 6] += side_left + rear_left;
-							out_buffer[out + 7] += side_right + rear_right;
-						}
-					}
-				}
-				else
-				{
-					out_buffer[out + 0] += left;
-					out_buffer[out + 1] += right;
-
-					if constexpr (out_channels >= 6) // Only mix the surround channels into the output if surround output is configured
-					{
-						out_buffer[out + 2] += center;
-						out_buffer[out + 3] += low_freq;
-
-						if constexpr (out_channels == 6)
-						{
-							out_buffer[out + 4] += side_left;
-							out_buffer[out + 5] += side_right;
-						}
-						else
-						{
-							out_buffer[out + 4] += rear_left;
-							out_buffer[out + 5] += rear_right;
-							out_buffer[out + 6] += side_left;
-							out_buffer[out + 7] += side_right;
-						}
-					}
-				}
-			}
+			mix_port<8, out_channels, downmix>(buf, out_buffer, volumes);
 		}
 		else
 		{
@@ -1,11 +1,15 @@
 #include "stdafx.h"
 #include "Emu/VFS.h"
+#include "Emu/system_config.h"
 #include "Emu/Cell/PPUModule.h"
 
 #include <stb_truetype.h>
 
 #include "cellFont.h"
 
+#include <list>
+#include <unordered_map>
+
 LOG_CHANNEL(cellFont);
 
 template <>
@@ -46,6 +50,163 @@ void fmt_class_string<CellFontError>::format(std::string& out, u64 arg)
 		});
 }
 
+// Rasterized glyph bitmaps of opened fonts, keyed by font, pixel height and code.
+// Least recently used glyphs are evicted when the configured budget is exceeded.
+struct font_glyph_cache
+{
+	struct glyph
+	{
+		s32 width;
+		s32 height;
+		s32 xoff;
+		s32 yoff;
+		s32 baseline_y;
+		std::vector<u8> bitmap;
+	};
+
+	struct glyph_key
+	{
+		const stbtt_fontinfo* font;
+		u32 scale_bits;
+		u32 code;
+
+		bool operator==(const glyph_key&) const = default;
+	};
+
+	struct glyph_key_hash
+	{
+		usz operator()(const glyph_key& key) const noexcept
+		{
+			const u64 value = reinterpret_cast<uptr>(key.font) ^ (u64{key.scale_bits} << 32 | key.code);
+			return value * 0x9e3779b97f4a7c15 >> 16;
+		}
+	};
+
+	using entry = std::pair<glyph_key, std::shared_ptr<const glyph>>;
+
+	shared_mutex mtx;
+	std::list<entry> lru; // Most recently used first
+	std::unordered_map<glyph_key, std::list<entry>::iterator, glyph_key_hash> glyphs;
+	usz used_bytes = 0;
+
+	atomic_t<u64> hits = 0;
+	atomic_t<u64> misses = 0;
+	atomic_t<u64> evictions = 0;
+
+	font_glyph_cache() = default;
+
+	~font_glyph_cache()
+	{
+		const u64 hit_count = hits.load();
+		const u64 lookups = hit_count + misses.load();
+
+		if (lookups)
+		{
+			cellFont.notice("Glyph cache: %llu hits, %llu misses (%llu%% hit rate), %llu evictions", hit_count, misses.load(), hit_count * 100 / lookups, evictions.load());
+		}
+	}
+
+	std::shared_ptr<const glyph> get(const stbtt_fontinfo* font, f32 pixel_height, u32 code)
+	{
+		const glyph_key key{font, std::bit_cast<u32>(pixel_height), code};
+
+		{
+			std::lock_guard lock(mtx);
+
+			if (auto found = glyphs.find(key); found != glyphs.end())
+			{
+				lru.splice(lru.begin(), lru, found->second);
+				hits++;
+				return found->second->second;
+			}
+		}
+
+		misses++;
+
+		auto result = render(font, pixel_height, code);
+		const usz budget = g_cfg.core.font_glyph_cache_size.get() * 1024ull;
+		const usz size = sizeof(glyph) + result->bitmap.size();
+
+		if (size > budget)
+		{
+			return result;
+		}
+
+		std::lock_guard lock(mtx);
+
+		const auto [found, inserted] = glyphs.emplace(key, lru.end());
+
+		if (!inserted)
+		{
+			// Rendered by another thread meanwhile
+			return found->second->second;
+		}
+
+		lru.emplace_front(key, result);
+		found->second = lru.begin();
+		used_bytes += size;
+
+		while (used_bytes > budget)
+		{
+			remove(std::prev(lru.end()));
+			evictions++;
+		}
+
+		return result;
+	}
+
+	// Drops all glyphs of the font, its data may be reused by the next opened font
+	void invalidate(const stbtt_fontinfo* font)
+	{
+		std::lock_guard lock(mtx);
+
+		for (auto it = lru.begin(); it != lru.end();)
+		{
+			if (it->first.font == font)
+			{
+				it = remove(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+private:
+	std::list<entry>::iterator remove(std::list<entry>::iterator it)
+	{
+		used_bytes -= sizeof(glyph) + it->second->bitmap.size();
+		glyphs.erase(it->first);
+		return lru.erase(it);
+	}
+
+	static std::shared_ptr<const glyph> render(const stbtt_fontinfo* font, f32 pixel_height, u32 code)
+	{
+		auto result = std::make_shared<glyph>();
+
+		const f32 scale = stbtt_ScaleForPixelHeight(font, pixel_height);
+		unsigned char* box = stbtt_GetCodepointBitmap(font, scale, scale, code, &result->width, &result->height, &result->xoff, &result->yoff);
+
+		if (box)
+		{
+			result->bitmap.assign(box, box + usz{static_cast<u32>(result->width)} * static_cast<u32>(result->height));
+			stbtt_FreeBitmap(box, nullptr);
+		}
+		else
+		{
+			result->width = 0;
+			result->height = 0;
+		}
+
+		s32 ascent, descent, lineGap;
+		stbtt_GetFontVMetrics(font, &ascent, &descent, &lineGap);
+		result->baseline_y = static_cast<int>(ascent * scale); // ???
+
+		return result;
+	}
+};
+
 // Functions
 error_code cellFontInitializeWithRevision(u64 revisionFlags, vm::ptr<CellFontConfig> config)
 {
@@ -137,6 +298,9 @@ error_code cellFontOpenFontMemory(vm::ptr<CellFontLibrary> library, u32 fontAddr
 
 	font->stbfont = vm::_ptr<stbtt_fontinfo>(font.addr() + font.size()); // hack: use next bytes of the struct
 
+	// The font struct may be reused for another font
+	g_fxo->get<font_glyph_cache>().invalidate(font->stbfont);
+
 	if (!stbtt_InitFont(font->stbfont, vm::_ptr<unsigned char>(fontAddr), 0))
 	{
 		return CELL_FONT_ERROR_FONT_OPEN_FAILED;
@@ -708,37 +872,32 @@ error_code cellFontRenderCharGlyphImage(vm::ptr<CellFont> font, u32 code, vm::pt
 	}
 
 	// Render the character
-	s32 width, height, xoff, yoff;
-	const f32 scale = stbtt_ScaleForPixelHeight(font->stbfont, font->scale_y);
-	unsigned char* box = stbtt_GetCodepointBitmap(font->stbfont, scale, scale, code, &width, &height, &xoff, &yoff);
+	const auto glyph = g_fxo->get<font_glyph_cache>().get(font->stbfont, font->scale_y, code);
 
-	if (!box)
+	if (glyph->bitmap.empty())
 	{
 		return CELL_OK;
 	}
 
-	// Get the baseLineY value
-	s32 ascent, descent, lineGap;
-	stbtt_GetFontVMetrics(font->stbfont, &ascent, &descent, &lineGap);
-	const s32 baseLineY = static_cast<int>(ascent * scale); // ???
+	const s32 width = glyph->width;
+	const s32 height = glyph->height;
+	const s32 yoff = glyph->yoff;
+	const s32 baseLineY = glyph->baseline_y;
+
+	const u32 surface_width = surface->width;
+	const u32 surface_height = surface->height;
+	const u32 row_width = static_cast<u32>(x) < surface_width ? std::min<u32>(width, surface_width - static_cast<u32>(x)) : 0;
 
 	// Move the rendered character to the surface
 	unsigned char* buffer = vm::_ptr<unsigned char>(surface->buffer.addr());
 	for (u32 ypos = 0; ypos < static_cast<u32>(height); ypos++)
 	{
-		if (static_cast<u32>(y) + ypos + yoff + baseLineY >= static_cast<u32>(surface->height))
+		if (static_cast<u32>(y) + ypos + yoff + baseLineY >= surface_height)
 			break;
 
-		for (u32 xpos = 0; xpos < static_cast<u32>(width); xpos++)
-		{
-			if (static_cast<u32>(x) + xpos >= static_cast<u32>(surface->width))
-				break;
-
-			// TODO: There are some oddities in the position of the character in the final buffer
-			buffer[(static_cast<s32>(y) + ypos + yoff + baseLineY) * surface->width + static_cast<s32>(x) + xpos] = box[ypos * width + xpos];
-		}
+		// TODO: There are some oddities in the position of the character in the final buffer
+		std::memcpy(&buffer[(static_cast<s32>(y) + ypos + yoff + baseLineY) * surface_width + static_cast<s32>(x)], &glyph->bitmap[ypos * width], row_width);
 	}
-	stbtt_FreeBitmap(box, nullptr);
 	return CELL_OK;
 }
 
@@ -860,6 +1019,7 @@ error_code cellFontCloseFont(vm::ptr<CellFont> font)
 		font->origin == CELL_FONT_OPEN_MEMORY)
 	{
 		vm::dealloc(font->fontdata_addr, vm::main);
+		g_fxo->get<font_glyph_cache>().invalidate(font->stbfont);
 	}
 
 	return CELL_OK;
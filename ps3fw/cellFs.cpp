@@ -918,12 +918,7 @@ struct fs_aio_thread : ppu_thread
 			}
 			else if (std::lock_guard lock(file->mp->mutex); file->file)
 			{
-				const auto old_pos = file->file.pos();
-				file->file.seek(aio->offset);
-
-				result = type == 2 ? file->op_write(aio->buf, aio->size) : file->op_read(aio->buf, aio->size);
-
-				file->file.seek(old_pos);
+				result = type == 2 ? lv2_file::op_write_async(file->file, aio->buf, aio->size, aio->offset) : lv2_file::op_read_async(file->file, aio->buf, aio->size, aio->offset);
 				error = CELL_OK;
 			}
 
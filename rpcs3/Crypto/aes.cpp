@@ -888,6 +888,44 @@ int aes_crypt_ctr(aes_context* ctx,
 	return (0);
 }
 
+/*
+ * AES-CTR encryption/decryption of whole blocks
+ */
+int aes_crypt_ctr_blocks(aes_context* ctx,
+	size_t blocks,
+	unsigned char nonce_counter[16],
+	const unsigned char* input,
+	unsigned char* output)
+{
+	int i;
+	unsigned char stream_block[16];
+
+#if defined(__SSE2__) || defined(_M_X64)
+	if (aesni_supports(POLARSSL_AESNI_AES))
+	{
+		aesni_crypt_ctr_blocks(ctx, blocks, nonce_counter, input, output);
+		return (0);
+	}
+#endif
+
+	while (blocks--)
+	{
+		aes_crypt_ecb(ctx, AES_ENCRYPT, nonce_counter, stream_block);
+
+		for (i = 16; i > 0; i--)
+			if (++nonce_counter[i - 1] != 0)
+				break;
+
+		for (i = 0; i < 16; i++)
+			output[i] = static_cast<unsigned char>(input[i] ^ stream_block[i]);
+
+		input += 16;
+		output += 16;
+	}
+
+	return (0);
+}
+
 /* AES-CMAC */
 
 unsigned char const_Rb[16] = {
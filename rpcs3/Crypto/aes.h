@@ -172,6 +172,25 @@ extern "C"
 		const unsigned char* input,
 		unsigned char* output);
 
+	/**
+	 * \brief               AES-CTR encryption/decryption of whole blocks
+	 *
+	 * Same as aes_crypt_ctr() started at a block boundary, but processes
+	 * several counter blocks at once when AES-NI is available.
+	 *
+	 * \param blocks        The number of 16-byte blocks
+	 * \param nonce_counter The 128-bit nonce and counter, advanced by blocks.
+	 * \param input         The input data stream
+	 * \param output        The output data stream, may be equal to input
+	 *
+	 * \return         0 if successful
+	 */
+	int aes_crypt_ctr_blocks(aes_context* ctx,
+		size_t blocks,
+		unsigned char nonce_counter[16],
+		const unsigned char* input,
+		unsigned char* output);
+
 	void aes_cmac(aes_context* ctx, size_t length, unsigned char* input, unsigned char* output);
 
 #ifdef __cplusplus
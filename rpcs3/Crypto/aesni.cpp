@@ -32,9 +32,15 @@
 
 #include "aesni.h"
 
+#include <string.h>
+
 #if defined(_MSC_VER) && defined(_M_X64)
 #define POLARSSL_HAVE_MSVC_X64_INTRINSICS
 #include <intrin.h>
+#define AESNI_TARGET
+#else
+#include <immintrin.h>
+#define AESNI_TARGET __attribute__((target("aes")))
 #endif
 
 /*
@@ -131,6 +137,111 @@ int aesni_crypt_ecb(aes_context* ctx,
 	return (0);
 }
 
+static inline unsigned long long ctr_bswap64(unsigned long long x)
+{
+#if defined(POLARSSL_HAVE_MSVC_X64_INTRINSICS)
+	return _byteswap_uint64(x);
+#else
+	return __builtin_bswap64(x);
+#endif
+}
+
+/*
+ * AES-NI AES-CTR encryption of whole blocks
+ *
+ * The counter is kept in registers and eight independent counter blocks
+ * are kept in flight, so the latency of aesenc is hidden behind the other
+ * blocks of the same round
+ */
+AESNI_TARGET void aesni_crypt_ctr_blocks(aes_context* ctx,
+	size_t blocks,
+	unsigned char nonce_counter[16],
+	const unsigned char* input,
+	unsigned char* output)
+{
+	const __m128i* rk = (const __m128i*)ctx->rk;
+	const int nr = ctx->nr;
+	const __m128i rk0 = _mm_loadu_si128(rk);
+	const __m128i rkn = _mm_loadu_si128(rk + nr);
+	unsigned long long hi, lo;
+	__m128i b0, b1, b2, b3, b4, b5, b6, b7, k;
+	int r;
+
+	memcpy(&hi, nonce_counter, 8);
+	memcpy(&lo, nonce_counter + 8, 8);
+	hi = ctr_bswap64(hi);
+	lo = ctr_bswap64(lo);
+
+#define AESNI_CTR_NEXT(b)                                                  \
+	b = _mm_set_epi64x((long long)ctr_bswap64(lo), (long long)ctr_bswap64(hi)); \
+	b = _mm_xor_si128(b, rk0);                                             \
+	if (++lo == 0)                                                         \
+		++hi;
+
+#define AESNI_CTR_ROUND(op, k) \
+	b0 = op(b0, k);            \
+	b1 = op(b1, k);            \
+	b2 = op(b2, k);            \
+	b3 = op(b3, k);            \
+	b4 = op(b4, k);            \
+	b5 = op(b5, k);            \
+	b6 = op(b6, k);            \
+	b7 = op(b7, k);
+
+#define AESNI_CTR_STORE(b, i)                                    \
+	b = _mm_xor_si128(b, _mm_loadu_si128((const __m128i*)input + i)); \
+	_mm_storeu_si128((__m128i*)output + i, b);
+
+	for (; blocks >= 8; blocks -= 8, input += 128, output += 128)
+	{
+		AESNI_CTR_NEXT(b0)
+		AESNI_CTR_NEXT(b1)
+		AESNI_CTR_NEXT(b2)
+		AESNI_CTR_NEXT(b3)
+		AESNI_CTR_NEXT(b4)
+		AESNI_CTR_NEXT(b5)
+		AESNI_CTR_NEXT(b6)
+		AESNI_CTR_NEXT(b7)
+
+		for (r = 1; r < nr; r++)
+		{
+			k = _mm_loadu_si128(rk + r);
+			AESNI_CTR_ROUND(_mm_aesenc_si128, k)
+		}
+
+		AESNI_CTR_ROUND(_mm_aesenclast_si128, rkn)
+
+		AESNI_CTR_STORE(b0, 0)
+		AESNI_CTR_STORE(b1, 1)
+		AESNI_CTR_STORE(b2, 2)
+		AESNI_CTR_STORE(b3, 3)
+		AESNI_CTR_STORE(b4, 4)
+		AESNI_CTR_STORE(b5, 5)
+		AESNI_CTR_STORE(b6, 6)
+		AESNI_CTR_STORE(b7, 7)
+	}
+
+	for (; blocks; blocks--, input += 16, output += 16)
+	{
+		AESNI_CTR_NEXT(b0)
+
+		for (r = 1; r < nr; r++)
+			b0 = _mm_aesenc_si128(b0, _mm_loadu_si128(rk + r));
+
+		b0 = _mm_aesenclast_si128(b0, rkn);
+		AESNI_CTR_STORE(b0, 0)
+	}
+
+#undef AESNI_CTR_STORE
+#undef AESNI_CTR_ROUND
+#undef AESNI_CTR_NEXT
+
+	hi = ctr_bswap64(hi);
+	lo = ctr_bswap64(lo);
+	memcpy(nonce_counter, &hi, 8);
+	memcpy(nonce_counter + 8, &lo, 8);
+}
+
 #if defined(POLARSSL_HAVE_MSVC_X64_INTRINSICS)
 static inline void clmul256(__m128i a, __m128i b, __m128i* r0, __m128i* r1)
 {
@@ -62,6 +62,22 @@ extern "C"
 		const unsigned char input[16],
 		unsigned char output[16]);
 
+	/**
+	 * \brief          AES-NI AES-CTR encryption of whole blocks, eight
+	 *                 counter blocks are encrypted per iteration
+	 *
+	 * \param ctx      AES context
+	 * \param blocks   Number of 16-byte blocks
+	 * \param nonce_counter Big-endian 128-bit counter, advanced by blocks
+	 * \param input    Input data
+	 * \param output   Output data, may be equal to input
+	 */
+	void aesni_crypt_ctr_blocks(aes_context* ctx,
+		size_t blocks,
+		unsigned char nonce_counter[16],
+		const unsigned char* input,
+		unsigned char* output);
+
 	/**
 	 * \brief          GCM multiplication: c = a * b in GF(2^128)
 	 *
@@ -384,6 +384,7 @@ private:
 	bool fill_data(std::map<std::string, install_entry*>& all_install_entries);
 	std::span<const char> archive_read_block(u64 offset, void* data_ptr, u64 num_bytes);
 	usz decrypt(u64 offset, u64 size, const uchar* key, void* local_buf);
+	void decrypt_blocks(u64 first_block, u64 blocks, const uchar* key, u8* data) const;
 	void extract_worker();
 
 	std::deque<install_entry> m_install_entries;
@@ -392,10 +393,13 @@ private:
 	atomic_t<usz> m_num_failures = 0;
 	atomic_t<usz> m_entry_indexer = 0;
 	atomic_t<usz> m_written_bytes = 0;
+	atomic_t<u64> m_decrypted_bytes = 0;
+	atomic_t<u64> m_decrypt_time_us = 0;
 	bool m_was_null = false;
 
 	static constexpr usz BUF_SIZE = 8192 * 1024; // 8 MB
 	static constexpr usz BUF_PADDING = 32;
+	static constexpr u64 DECRYPT_CHUNK_BLOCKS = 65536; // 1 MB
 
 	bool m_is_valid = false;
 	result m_result = result::not_started;
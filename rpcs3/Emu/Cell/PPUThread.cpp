@@ -68,6 +68,7 @@
 #include "util/v128.hpp"
 #include "util/simd.hpp"
 #include "util/sysinfo.hpp"
+#include "util/task_executor.hpp"
 
 #include "util/sema.h"
 
@@ -2299,6 +2300,9 @@ void ppu_thread::cpu_task()
 
 			spu_cache::initialize();
 
+			// Boot is done, log the executor usage of PPU/SPU compilation and shader loading
+			utils::task_executor::get().report("boot");
+
 #ifdef __APPLE__
 			pthread_jit_write_protect_np(true);
 #endif
@@ -4269,8 +4273,6 @@ extern void ppu_precompile(std::vector<std::string>& dir_queue, std::vector<ppu_
 
 	*progress_dialog = get_localized_string(localized_string_id::PROGRESS_DIALOG_COMPILING_PPU_MODULES);
 
-	atomic_t<usz> fnext = 0;
-
 	lf_queue<file_info> possible_exec_file_paths;
 
 	concurent_memory_limit memory_limit(utils::get_total_memory() / 3);
@@ -4324,163 +4326,167 @@ extern void ppu_precompile(std::vector<std::string>& dir_queue, std::vector<ppu_
 		}
 	}
 
-	named_thread_group workers("SPRX Worker ", std::min<u32>(software_thread_limit, cpu_thread_limit), [&]
+	// Returns false if the file is left to the executable pass
+	const auto precompile_file = [&](usz func_i) -> bool
+	{
+		if (Emu.IsStopped())
 		{
-#ifdef __APPLE__
-			pthread_jit_write_protect_np(false);
-#endif
-			// Set low priority
-			thread_ctrl::scoped_priority low_prio(-1);
-			u32 inc_fdone = 1;
+			return true;
+		}
 
-			for (usz func_i = fnext++; func_i < file_queue.size(); func_i = fnext++, g_progr_fdone += std::exchange(inc_fdone, 1))
-			{
-				if (Emu.IsStopped())
-				{
-					continue;
-				}
+		auto& [path, offset, file_size] = file_queue[func_i];
 
-				auto& [path, offset, file_size] = file_queue[func_i];
+		ppu_log.notice("Trying to load: %s", path);
 
-				ppu_log.notice("Trying to load: %s", path);
+		auto file_allocation = memory_limit.acquire(file_size * 2);
 
-				auto file_allocation = memory_limit.acquire(file_size * 2);
+		// Load MSELF, SPRX or SELF
+		fs::file src{path};
 
-				// Load MSELF, SPRX or SELF
-				fs::file src{path};
+		if (!src)
+		{
+			ppu_log.error("Failed to open '%s' (%s)", path, fs::g_tls_error);
+			return true;
+		}
 
-				if (!src)
-				{
-					ppu_log.error("Failed to open '%s' (%s)", path, fs::g_tls_error);
-					continue;
-				}
+		if (u64 off = offset)
+		{
+			// Adjust offset for MSELF
+			src = make_file_view(std::move(src), offset, file_size);
 
-				if (u64 off = offset)
-				{
-					// Adjust offset for MSELF
-					src = make_file_view(std::move(src), offset, file_size);
+			// Adjust path for MSELF too
+			fmt::append(path, "_x%x", off);
+		}
 
-					// Adjust path for MSELF too
-					fmt::append(path, "_x%x", off);
-				}
+		for (usz i = 0;; i++)
+		{
+			if (i > decrypt_klics.size())
+			{
+				src.close();
+				break;
+			}
 
-				for (usz i = 0;; i++)
-				{
-					if (i > decrypt_klics.size())
-					{
-						src.close();
-						break;
-					}
+			// Some files may fail to decrypt due to the lack of klic
+			u128 key = i == decrypt_klics.size() ? u128{} : decrypt_klics[i];
 
-					// Some files may fail to decrypt due to the lack of klic
-					u128 key = i == decrypt_klics.size() ? u128{} : decrypt_klics[i];
+			if (auto result = decrypt_self(src, i == decrypt_klics.size() ? nullptr : reinterpret_cast<const u8*>(&key)))
+			{
+				src = std::move(result);
+				break;
+			}
+		}
 
-					if (auto result = decrypt_self(src, i == decrypt_klics.size() ? nullptr : reinterpret_cast<const u8*>(&key)))
-					{
-						src = std::move(result);
-						break;
-					}
-				}
+		if (!src && !Emu.klic.empty() && src.open(path))
+		{
+			src = decrypt_self(src, reinterpret_cast<u8*>(&Emu.klic[0]));
 
-				if (!src && !Emu.klic.empty() && src.open(path))
+			if (src)
+			{
+				ppu_log.error("Possible missed KLIC for precompilation of '%s', please report to developers.", path);
+
+				// Ignore executables larger than 500KB to prevent a long pause on exitspawn
+				if (src.size() >= 500000)
 				{
-					src = decrypt_self(src, reinterpret_cast<u8*>(&Emu.klic[0]));
+					g_progr_ftotal_bits -= file_size;
 
-					if (src)
-					{
-						ppu_log.error("Possible missed KLIC for precompilation of '%s', please report to developers.", path);
+					return true;
+				}
+			}
+		}
 
-						// Ignore executables larger than 500KB to prevent a long pause on exitspawn
-						if (src.size() >= 500000)
-						{
-							g_progr_ftotal_bits -= file_size;
+		if (!src)
+		{
+			ppu_log.notice("Failed to decrypt '%s'", path);
 
-							continue;
-						}
-					}
-				}
+			g_progr_ftotal_bits -= file_size;
 
-				if (!src)
-				{
-					ppu_log.notice("Failed to decrypt '%s'", path);
+			return true;
+		}
 
-					g_progr_ftotal_bits -= file_size;
+		elf_error prx_err{}, ovl_err{};
 
-					continue;
+		if (ppu_prx_object obj = src; (prx_err = obj, obj == elf_error::ok))
+		{
+			if (auto prx = ppu_load_prx(obj, true, path, offset))
+			{
+				obj.clear(), src.close(); // Clear decrypted file and elf object memory
+				file_allocation = {};     // release used file memory
+				ppu_initialize(*prx, false, file_size, memory_limit);
+				ppu_finalize(*prx, true);
+				return true;
+			}
+
+			// Log error
+			prx_err = elf_error::header_type;
+		}
+
+		if (ppu_exec_object obj = src; (ovl_err = obj, obj == elf_error::ok))
+		{
+			while (ovl_err == elf_error::ok)
+			{
+				if (Emu.IsStopped())
+				{
+					break;
 				}
 
-				elf_error prx_err{}, ovl_err{};
+				const auto [ovlm, error] = ppu_load_overlay(obj, true, path, offset);
 
-				if (ppu_prx_object obj = src; (prx_err = obj, obj == elf_error::ok))
+				if (error)
 				{
-					if (auto prx = ppu_load_prx(obj, true, path, offset))
+					if (error == CELL_CANCEL + 0u)
 					{
-						obj.clear(), src.close(); // Clear decrypted file and elf object memory
-						file_allocation = {};     // release used file memory
-						ppu_initialize(*prx, false, file_size, memory_limit);
-						ppu_finalize(*prx, true);
-						continue;
+						// Emulation stopped
+						break;
 					}
 
-					// Log error
-					prx_err = elf_error::header_type;
+					// Abort
+					ovl_err = elf_error::header_type;
+					break;
 				}
 
-				if (ppu_exec_object obj = src; (ovl_err = obj, obj == elf_error::ok))
-				{
-					while (ovl_err == elf_error::ok)
-					{
-						if (Emu.IsStopped())
-						{
-							break;
-						}
-
-						const auto [ovlm, error] = ppu_load_overlay(obj, true, path, offset);
+				obj.clear(), src.close(); // Clear decrypted file and elf object memory
+				file_allocation = {};     // release used file memory
 
-						if (error)
+				// Participate in thread execution limitation (takes a long time)
+				if (std::lock_guard lock(g_fxo->get<jit_core_allocator>().sem); !ovlm->analyse(0, ovlm->entry, ovlm->seg0_code_end, ovlm->applied_patches, std::vector<u32>{}, []()
 						{
-							if (error == CELL_CANCEL + 0u)
-							{
-								// Emulation stopped
-								break;
-							}
-
-							// Abort
-							ovl_err = elf_error::header_type;
-							break;
-						}
+							return Emu.IsStopped();
+						}))
+				{
+					// Emulation stopped
+					break;
+				}
 
-						obj.clear(), src.close(); // Clear decrypted file and elf object memory
-						file_allocation = {};     // release used file memory
+				ppu_initialize(*ovlm, false, file_size, memory_limit);
+				ppu_finalize(*ovlm, true);
+				break;
+			}
 
-						// Participate in thread execution limitation (takes a long time)
-						if (std::lock_guard lock(g_fxo->get<jit_core_allocator>().sem); !ovlm->analyse(0, ovlm->entry, ovlm->seg0_code_end, ovlm->applied_patches, std::vector<u32>{}, []()
-								{
-									return Emu.IsStopped();
-								}))
-						{
-							// Emulation stopped
-							break;
-						}
+			if (ovl_err == elf_error::ok)
+			{
+				return true;
+			}
+		}
 
-						ppu_initialize(*ovlm, false, file_size, memory_limit);
-						ppu_finalize(*ovlm, true);
-						break;
-					}
+		ppu_log.notice("Failed to precompile '%s' (prx: %s, ovl: %s): Attempting compilation as executable file", path, prx_err, ovl_err);
+		possible_exec_file_paths.push(path, offset, file_size);
+		return false;
+	};
 
-					if (ovl_err == elf_error::ok)
-					{
-						continue;
-					}
-				}
+	utils::task_group workers("PPU precompilation");
 
-				ppu_log.notice("Failed to precompile '%s' (prx: %s, ovl: %s): Attempting compilation as executable file", path, prx_err, ovl_err);
-				possible_exec_file_paths.push(path, offset, file_size);
-				inc_fdone = 0;
+	// Every task loads and compiles one file
+	workers.run_range(file_queue.size(), std::min<u32>(software_thread_limit, cpu_thread_limit), [&](u32, usz func_i)
+		{
+#ifdef __APPLE__
+			pthread_jit_write_protect_np(false);
+#endif
+			if (precompile_file(func_i))
+			{
+				g_progr_fdone++;
 			}
 		});
 
-	// Join every thread
 	workers.join();
 
 	named_thread exec_worker("PPU Exec Worker", [&]
@@ -4904,9 +4910,6 @@ bool ppu_initialize(const ppu_module<lv2_obj>& info, bool check_only, u64 file_s
 	// Info to load to main JIT instance (true - compiled)
 	std::vector<std::pair<std::string, bool>> link_workload;
 
-	// Sync variable to acquire workloads
-	atomic_t<u32> work_cv = 0;
-
 	bool compiled_new = false;
 
 	bool has_mfvscr = false;
@@ -5506,7 +5509,7 @@ bool ppu_initialize(const ppu_module<lv2_obj>& info, bool check_only, u64 file_s
 		g_progr_fknown_bits += file_size;
 	}
 
-	// Create worker threads for compilation
+	// Compile the workload on the task executor
 	if (!workload.empty())
 	{
 		// Update progress dialog
@@ -5516,110 +5519,52 @@ bool ppu_initialize(const ppu_module<lv2_obj>& info, bool check_only, u64 file_s
 
 		const u32 thread_count = std::min(::size32(workload), rpcs3::utils::get_max_threads());
 
-		struct thread_index_allocator
-		{
-			atomic_t<u64> index = 0;
-		};
-
-		struct thread_op
-		{
-			concurent_memory_limit& memory_limit;
-			atomic_t<u32>& work_cv;
-			std::vector<std::pair<std::string, ppu_module<lv2_obj>>>& workload;
-			const ppu_module<lv2_obj>& main_module;
-			const std::string& cache_path;
-			const cpu_thread* cpu;
-
-			std::unique_lock<decltype(jit_core_allocator::sem)> core_lock;
-
-			thread_op(concurent_memory_limit& memory_limit, atomic_t<u32>& work_cv, std::vector<std::pair<std::string, ppu_module<lv2_obj>>>& workload, const cpu_thread* cpu, const ppu_module<lv2_obj>& main_module, const std::string& cache_path, decltype(jit_core_allocator::sem)& sem) noexcept
-
-				: memory_limit(memory_limit), work_cv(work_cv), workload(workload), main_module(main_module), cache_path(cache_path), cpu(cpu)
-			{
-				// Save mutex
-				core_lock = std::unique_lock{sem, std::defer_lock};
-			}
-
-			thread_op(const thread_op& other) noexcept
-				: memory_limit(other.memory_limit), work_cv(other.work_cv), workload(other.workload), main_module(other.main_module), cache_path(other.cache_path), cpu(other.cpu)
-			{
-				if (auto mtx = other.core_lock.mutex())
-				{
-					// Save mutex
-					core_lock = std::unique_lock{*mtx, std::defer_lock};
-				}
-			}
+		// Prevent watchdog thread from terminating
+		g_watchdog_hold_ctr++;
 
-			thread_op(thread_op&& other) noexcept = default;
+		utils::task_group workers("PPU compilation");
 
-			void operator()()
+		// Every task compiles one part of the module (parts are split on function boundaries)
+		workers.run_range(workload.size(), thread_count, [&](u32, usz i)
 			{
-				// Set low priority
-				thread_ctrl::scoped_priority low_prio(-1);
-
 #ifdef __APPLE__
 				pthread_jit_write_protect_np(false);
 #endif
-				for (u32 i = work_cv++; i < workload.size(); i = work_cv++, g_progr_pdone++)
+				if (cpu ? cpu->state.all_of(cpu_flag::exit) : Emu.IsStopped())
 				{
-					if (cpu ? cpu->state.all_of(cpu_flag::exit) : Emu.IsStopped())
-					{
-						continue;
-					}
-
-					// Keep allocating workload
-					const auto& [obj_name, part] = std::as_const(workload)[i];
+					g_progr_pdone++;
+					return;
+				}
 
-					std::size_t total_fn_size = 0;
-					for (auto& fn : part.get_funcs())
-					{
-						total_fn_size += fn.size;
-					}
+				// Allocate "core"
+				std::lock_guard core_lock(g_fxo->get<jit_core_allocator>().sem);
 
-					ppu_log.warning("LLVM: reporting used memory %u (free/total: %u/%u) by %s%s", total_fn_size * 1024 * 16, memory_limit.free_memory(), memory_limit.total_memory(), cache_path, obj_name);
-					auto used_memory = memory_limit.acquire(total_fn_size * 1024 * 16);
+				const auto& [obj_name, part] = std::as_const(workload)[i];
 
-					std::shared_lock rlock(g_fxo->get<jit_core_allocator>().shared_mtx, std::defer_lock);
-					std::unique_lock lock(g_fxo->get<jit_core_allocator>().shared_mtx, std::defer_lock);
+				std::size_t total_fn_size = 0;
+				for (auto& fn : part.get_funcs())
+				{
+					total_fn_size += fn.size;
+				}
 
-					if (false && part.jit_bounds && part.parent->funcs.size() >= 0x8000)
-					{
-						// Make a large symbol-resolving function compile alone because it has massive memory requirements
-						lock.lock();
-					}
-					else
-					{
-						rlock.lock();
-					}
+				ppu_log.warning("LLVM: reporting used memory %u (free/total: %u/%u) by %s%s", total_fn_size * 1024 * 16, memory_limit.free_memory(), memory_limit.total_memory(), cache_path, obj_name);
+				auto used_memory = memory_limit.acquire(total_fn_size * 1024 * 16);
 
-					ppu_log.warning("LLVM: Compiling module %s%s", cache_path, obj_name);
+				std::shared_lock rlock(g_fxo->get<jit_core_allocator>().shared_mtx);
 
-					{
-						// Use another JIT instance
-						jit_compiler jit2({}, g_cfg.core.llvm_cpu, 0x1);
-						ppu_initialize2(jit2, part, cache_path, obj_name);
-					}
+				ppu_log.warning("LLVM: Compiling module %s%s", cache_path, obj_name);
 
-					ppu_log.success("LLVM: Compiled module %s", obj_name);
+				{
+					// Use another JIT instance
+					jit_compiler jit2({}, g_cfg.core.llvm_cpu, 0x1);
+					ppu_initialize2(jit2, part, cache_path, obj_name);
 				}
 
-				core_lock.unlock();
-			}
-		};
-
-		// Prevent watchdog thread from terminating
-		g_watchdog_hold_ctr++;
-
-		named_thread_group threads(fmt::format("PPUW.%u.", ++g_fxo->get<thread_index_allocator>().index), thread_count, thread_op(memory_limit, work_cv, workload, cpu, info, cache_path, g_fxo->get<jit_core_allocator>().sem), [&](u32 /*thread_index*/, thread_op& op)
-			{
-				// Allocate "core"
-				op.core_lock.lock();
-
-				// Second check before creating another thread
-				return work_cv < workload.size() && (cpu ? !cpu->state.all_of(cpu_flag::exit) : !Emu.IsStopped());
+				ppu_log.success("LLVM: Compiled module %s", obj_name);
+				g_progr_pdone++;
 			});
 
-		threads.join();
+		workers.join();
 
 		g_watchdog_hold_ctr--;
 	}
@@ -13,6 +13,7 @@
 #include "util/JIT.h"
 #include "util/init_mutex.hpp"
 #include "util/shared_ptr.hpp"
+#include "util/task_executor.hpp"
 
 #include "rpcsx/fw/ps3/cellSync.h"
 
@@ -716,6 +717,211 @@ void spu_cache::add(const spu_program& func)
 	m_file.write_gather(gather, 3);
 }
 
+namespace
+{
+	// SPU object archive format, all records are appended to the end of file
+	struct spu_object_archive_header
+	{
+		u64 magic;
+		u32 version;
+		u32 reserved;
+		u8 fingerprint[20];
+		u32 reserved2;
+	};
+
+	struct spu_object_record_header
+	{
+		u32 name_size;
+		u32 symbol_count;
+		u32 symbols_size;
+		u32 object_size;
+	};
+
+	struct spu_object_symbol_header
+	{
+		s64 value;
+		u8 kind;
+		u8 reserved;
+		u16 name_size;
+		u32 reserved2;
+	};
+
+	constexpr u64 c_spu_object_archive_magic = "SPUOBJAR"_u64;
+	constexpr u32 c_spu_object_archive_version = 1;
+} // namespace
+
+bool spu_llvm_object_cache::open(const std::string& path, std::string_view fingerprint)
+{
+	std::lock_guard lock(m_mutex);
+
+	if (m_file || m_open_failed)
+	{
+		return !m_open_failed;
+	}
+
+	fs::file file(path, fs::read + fs::write + fs::create);
+
+	if (!file)
+	{
+		m_open_failed = true;
+		spu_log.error("Failed to open SPU object cache at: %s (%s)", path, fs::g_tls_error);
+		return false;
+	}
+
+	spu_object_archive_header header{};
+	u8 hash[20]{};
+	sha1(reinterpret_cast<const u8*>(fingerprint.data()), fingerprint.size(), hash);
+
+	if (!file.read(header) || header.magic != c_spu_object_archive_magic || header.version != c_spu_object_archive_version || std::memcmp(header.fingerprint, hash, sizeof(hash)) != 0)
+	{
+		if (file.size())
+		{
+			spu_log.notice("SPU object cache is outdated, discarded: %s", path);
+		}
+
+		header = {};
+		header.magic = c_spu_object_archive_magic;
+		header.version = c_spu_object_archive_version;
+		std::memcpy(header.fingerprint, hash, sizeof(hash));
+
+		file.trunc(0);
+		file.seek(0);
+		file.write(header);
+	}
+
+	// Build index, object data is only read on lookup
+	const u64 file_size = file.size();
+	u64 pos = sizeof(header);
+
+	while (pos < file_size)
+	{
+		spu_object_record_header rec{};
+
+		if (file.read_at(pos, &rec, sizeof(rec)) != sizeof(rec) || !rec.name_size)
+		{
+			break;
+		}
+
+		const u64 end = pos + sizeof(rec) + rec.name_size + u64{rec.symbols_size} + rec.object_size;
+
+		if (end > file_size)
+		{
+			break;
+		}
+
+		std::string name(rec.name_size, '\0');
+		file.read_at(pos + sizeof(rec), name.data(), name.size());
+		m_index.insert_or_assign(std::move(name), pos);
+		pos = end;
+	}
+
+	if (pos < file_size)
+	{
+		// Probably the emulator was terminated while writing
+		spu_log.warning("SPU object cache: dropped damaged tail at 0x%x (%s)", pos, path);
+		file.trunc(pos);
+	}
+
+	m_file = std::move(file);
+	spu_log.notice("SPU object cache: %u objects found in %s", m_index.size(), path);
+	return true;
+}
+
+bool spu_llvm_object_cache::load(const std::string& name, object& out)
+{
+	reader_lock lock(m_mutex);
+
+	const auto found = m_index.find(name);
+
+	if (found == m_index.end())
+	{
+		return false;
+	}
+
+	u64 pos = found->second;
+	spu_object_record_header rec{};
+	m_file.read_at(pos, &rec, sizeof(rec));
+	pos += sizeof(rec) + rec.name_size;
+
+	std::vector<u8> symbols(rec.symbols_size);
+	out.symbols.clear();
+	out.data.resize(rec.object_size);
+
+	if (m_file.read_at(pos, symbols.data(), symbols.size()) != symbols.size() ||
+		m_file.read_at(pos + symbols.size(), out.data.data(), out.data.size()) != out.data.size())
+	{
+		spu_log.error("SPU object cache: failed to read %s", name);
+		return false;
+	}
+
+	usz offset = 0;
+
+	for (u32 i = 0; i < rec.symbol_count; i++)
+	{
+		spu_object_symbol_header sym{};
+
+		if (symbols.size() - offset < sizeof(sym))
+		{
+			spu_log.error("SPU object cache: damaged object %s", name);
+			return false;
+		}
+
+		std::memcpy(&sym, symbols.data() + offset, sizeof(sym));
+		offset += sizeof(sym);
+
+		if (symbols.size() - offset < sym.name_size || sym.kind > static_cast<u8>(symbol_kind::patchpoint))
+		{
+			spu_log.error("SPU object cache: damaged object %s", name);
+			return false;
+		}
+
+		out.symbols.push_back({static_cast<symbol_kind>(sym.kind), sym.value, std::string(reinterpret_cast<const char*>(symbols.data() + offset), sym.name_size)});
+		offset += sym.name_size;
+	}
+
+	return true;
+}
+
+void spu_llvm_object_cache::store(const std::string& name, const object& obj)
+{
+	std::vector<u8> symbols;
+
+	for (const auto& sym : obj.symbols)
+	{
+		spu_object_symbol_header header{};
+		header.value = sym.value;
+		header.kind = static_cast<u8>(sym.kind);
+		header.name_size = static_cast<u16>(sym.name.size());
+
+		const auto ptr = reinterpret_cast<const u8*>(&header);
+		symbols.insert(symbols.end(), ptr, ptr + sizeof(header));
+		symbols.insert(symbols.end(), sym.name.begin(), sym.name.end());
+	}
+
+	spu_object_record_header rec{};
+	rec.name_size = ::size32(name);
+	rec.symbol_count = ::size32(obj.symbols);
+	rec.symbols_size = ::size32(symbols);
+	rec.object_size = ::size32(obj.data);
+
+	const fs::iovec_clone gather[4]{
+		{&rec, sizeof(rec)},
+		{name.data(), name.size()},
+		{symbols.data(), symbols.size()},
+		{obj.data.data(), obj.data.size()}};
+
+	std::lock_guard lock(m_mutex);
+
+	if (!m_file || m_index.contains(name))
+	{
+		return;
+	}
+
+	const u64 pos = m_file.seek(0, fs::seek_end);
+	m_file.write_gather(gather, 4);
+	m_index.emplace(name, pos);
+}
+
 void spu_cache::initialize(bool build_existing_cache)
 {
 	spu_runtime::g_interpreter = spu_runtime::g_gateway;
@@ -746,9 +952,14 @@ void spu_cache::initialize(bool build_existing_cache)
 		return;
 	}
 
+	if (!g_cfg.core.spu_debug && (g_cfg.core.spu_decoder == spu_decoder_type::llvm || g_cfg.core.spu_decoder == spu_decoder_type::dynamic))
+	{
+		// Native objects of SPU LLVM recompiler, opened by the recompiler
+		g_fxo->need<spu_llvm_object_cache>();
+	}
+
 	// Read cache
 	auto func_list = cache.get();
-	atomic_t<usz> fnext{};
 	atomic_t<u8> fail_flag{0};
 
 	auto data_list = g_fxo->get<spu_cache>().precompile_funcs.pop_all();
@@ -778,8 +989,6 @@ void spu_cache::initialize(bool build_existing_cache)
 		data_list = {};
 	}
 
-	atomic_t<usz> data_indexer = 0;
-
 	if (g_cfg.core.spu_decoder == spu_decoder_type::dynamic || g_cfg.core.spu_decoder == spu_decoder_type::llvm)
 	{
 		if (auto compiler = spu_recompiler_base::make_llvm_recompiler(11))
@@ -830,295 +1039,286 @@ void spu_cache::initialize(bool build_existing_cache)
 		progress_dialog.emplace(get_localized_string(localized_string_id::PROGRESS_DIALOG_BUILDING_SPU_CACHE));
 	}
 
-	named_thread_group workers("SPU Worker ", worker_count, [&]() -> uint
-		{
-#ifdef __APPLE__
-			pthread_jit_write_protect_np(false);
-#endif
-			// Set low priority
-			thread_ctrl::scoped_priority low_prio(-1);
+	// Compiler instance and fake LS of a worker slot
+	struct worker_context
+	{
+		std::unique_ptr<spu_recompiler_base> compiler;
 
-			// Initialize compiler instances for parallel compilation
-			std::unique_ptr<spu_recompiler_base> compiler;
+		// Counter for error reporting
+		u32 logged_error = 0;
 
-			if (g_cfg.core.spu_decoder == spu_decoder_type::asmjit)
-			{
-				compiler = spu_recompiler_base::make_asmjit_recompiler();
-			}
-			else if (g_cfg.core.spu_decoder == spu_decoder_type::llvm)
-			{
-				compiler = spu_recompiler_base::make_llvm_recompiler();
-			}
+		// How much the slot compiled
+		uint result = 0;
 
-			compiler->init();
+		// Fake LS
+		std::vector<be_t<u32>> ls;
 
-			// Counter for error reporting
-			u32 logged_error = 0;
+		u32 last_sec_idx = umax;
+	};
 
-			// How much every thread compiled
-			uint result = 0;
+	std::vector<worker_context> contexts(worker_count);
 
-			// Fake LS
-			std::vector<be_t<u32>> ls(0x10000);
+	const auto build_func = [&](worker_context& worker, usz func_i)
+	{
+		const spu_program& func = std::as_const(func_list)[func_i];
 
-			usz func_i = fnext++;
+		// Get data start
+		const u32 start = func.lower_bound;
+		const u32 size0 = ::size32(func.data);
 
-			// Ensure some actions are performed on a single thread
-			const bool is_first_thread = func_i == 0;
+		be_t<u64> hash_start;
+		{
+			sha1_context ctx;
+			u8 output[20];
 
-			// Build functions
-			for (; func_i < func_list.size(); func_i = fnext++, (showing_progress ? g_progr_pdone : pending_progress) += build_existing_cache ? 1 : 0)
-			{
-				const spu_program& func = std::as_const(func_list)[func_i];
+			sha1_starts(&ctx);
+			sha1_update(&ctx, reinterpret_cast<const u8*>(func.data.data()), func.data.size() * 4);
+			sha1_finish(&ctx, output);
+			std::memcpy(&hash_start, output, sizeof(hash_start));
+		}
 
-				if (Emu.IsStopped() || fail_flag)
-				{
-					continue;
-				}
+		// Check hash against allowed bounds
+		const bool inverse_bounds = g_cfg.core.spu_llvm_lower_bound > g_cfg.core.spu_llvm_upper_bound;
 
-				// Get data start
-				const u32 start = func.lower_bound;
-				const u32 size0 = ::size32(func.data);
+		if ((!inverse_bounds && (hash_start < g_cfg.core.spu_llvm_lower_bound || hash_start > g_cfg.core.spu_llvm_upper_bound)) ||
+			(inverse_bounds && (hash_start < g_cfg.core.spu_llvm_lower_bound && hash_start > g_cfg.core.spu_llvm_upper_bound)))
+		{
+			spu_log.error("[Debug] Skipped function %s", fmt::base57(hash_start));
+			worker.result++;
+			return;
+		}
 
-				be_t<u64> hash_start;
-				{
-					sha1_context ctx;
-					u8 output[20];
+		// Initialize LS with function data only
+		for (u32 i = 0, pos = start; i < size0; i++, pos += 4)
+		{
+			worker.ls[pos / 4] = std::bit_cast<be_t<u32>>(func.data[i]);
+		}
 
-					sha1_starts(&ctx);
-					sha1_update(&ctx, reinterpret_cast<const u8*>(func.data.data()), func.data.size() * 4);
-					sha1_finish(&ctx, output);
-					std::memcpy(&hash_start, output, sizeof(hash_start));
-				}
+		// Call analyser
+		spu_program func2 = worker.compiler->analyse(worker.ls.data(), func.entry_point);
 
-				// Check hash against allowed bounds
-				const bool inverse_bounds = g_cfg.core.spu_llvm_lower_bound > g_cfg.core.spu_llvm_upper_bound;
+		if (func2 != func)
+		{
+			spu_log.error("[0x%05x] SPU Analyser failed, %u vs %u", func2.entry_point, func2.data.size(), size0);
 
-				if ((!inverse_bounds && (hash_start < g_cfg.core.spu_llvm_lower_bound || hash_start > g_cfg.core.spu_llvm_upper_bound)) ||
-					(inverse_bounds && (hash_start < g_cfg.core.spu_llvm_lower_bound && hash_start > g_cfg.core.spu_llvm_upper_bound)))
-				{
-					spu_log.error("[Debug] Skipped function %s", fmt::base57(hash_start));
-					result++;
-					continue;
-				}
+			if (worker.logged_error < 2)
+			{
+				std::string log;
+				worker.compiler->dump(func, log);
+				spu_log.notice("[0x%05x] Function: %s", func.entry_point, log);
+				worker.logged_error++;
+			}
+		}
+		else if (!worker.compiler->compile(std::move(func2)))
+		{
+			// Likely, out of JIT memory. Signal to prevent further building.
+			fail_flag |= 1;
+			return;
+		}
 
-				// Initialize LS with function data only
-				for (u32 i = 0, pos = start; i < size0; i++, pos += 4)
-				{
-					ls[pos / 4] = std::bit_cast<be_t<u32>>(func.data[i]);
-				}
+		// Clear fake LS
+		std::memset(worker.ls.data() + start / 4, 0, 4 * (size0 - 1));
 
-				// Call analyser
-				spu_program func2 = compiler->analyse(ls.data(), func.entry_point);
+		worker.result++;
+	};
 
-				if (func2 != func)
-				{
-					spu_log.error("[0x%05x] SPU Analyser failed, %u vs %u", func2.entry_point, func2.data.size(), size0);
+	const auto build_section_func = [&](worker_context& worker, usz func_i)
+	{
+		usz passed_count = 0;
+		u32 func_addr = 0;
+		u32 next_func = 0;
+		u32 sec_addr = umax;
+		u32 sec_idx = 0;
+		std::span<const u32> inst_data;
 
-					if (logged_error < 2)
-					{
-						std::string log;
-						compiler->dump(func, log);
-						spu_log.notice("[0x%05x] Function: %s", func.entry_point, log);
-						logged_error++;
-					}
-				}
-				else if (!compiler->compile(std::move(func2)))
-				{
-					// Likely, out of JIT memory. Signal to prevent further building.
-					fail_flag |= 1;
-					continue;
-				}
+		// Try to get the data this index points to
+		for (auto& sec : data_list)
+		{
+			if (func_i < passed_count + sec.funcs.size())
+			{
+				const usz func_idx = func_i - passed_count;
+				sec_addr = sec.vaddr;
+				func_addr = ::at32(sec.funcs, func_idx);
+				inst_data = {sec.inst_data.data(), sec.inst_data.size()};
+				next_func = sec.funcs.size() >= func_idx ? ::narrow<u32>(sec_addr + inst_data.size() * 4) : sec.funcs[func_idx];
+				break;
+			}
 
-				// Clear fake LS
-				std::memset(ls.data() + start / 4, 0, 4 * (size0 - 1));
+			passed_count += sec.funcs.size();
+			sec_idx++;
+		}
 
-				result++;
+		if (sec_addr == umax)
+		{
+			return;
+		}
 
-				if (is_first_thread && !showing_progress)
-				{
-					if (!g_progr_text && !g_progr_ptotal && !g_progr_ftotal)
-					{
-						showing_progress = true;
-						g_progr_pdone += pending_progress.exchange(0);
-						g_progr_ptotal += total_funcs;
-						progress_dialog.emplace(get_localized_string(localized_string_id::PROGRESS_DIALOG_BUILDING_SPU_CACHE));
-					}
-				}
-				else if (showing_progress && pending_progress)
-				{
-					// Cover missing progress due to a race
-					g_progr_pdone += pending_progress.exchange(0);
-				}
+		if (worker.last_sec_idx != sec_idx)
+		{
+			if (worker.last_sec_idx != umax)
+			{
+				// Clear fake LS of previous section
+				auto& sec = data_list[worker.last_sec_idx];
+				std::memset(worker.ls.data() + sec.vaddr / 4, 0, sec.inst_data.size() * 4);
 			}
 
-			u32 last_sec_idx = umax;
-
-			for (func_i = data_indexer++;; func_i = data_indexer++, (showing_progress ? g_progr_pdone : pending_progress) += build_existing_cache ? 1 : 0)
+			// Initialize LS with the entire section data
+			for (u32 i = 0, pos = sec_addr; i < inst_data.size(); i++, pos += 4)
 			{
-				usz passed_count = 0;
-				u32 func_addr = 0;
-				u32 next_func = 0;
-				u32 sec_addr = umax;
-				u32 sec_idx = 0;
-				std::span<const u32> inst_data;
-
-				// Try to get the data this index points to
-				for (auto& sec : data_list)
-				{
-					if (func_i < passed_count + sec.funcs.size())
-					{
-						const usz func_idx = func_i - passed_count;
-						sec_addr = sec.vaddr;
-						func_addr = ::at32(sec.funcs, func_idx);
-						inst_data = {sec.inst_data.data(), sec.inst_data.size()};
-						next_func = sec.funcs.size() >= func_idx ? ::narrow<u32>(sec_addr + inst_data.size() * 4) : sec.funcs[func_idx];
-						break;
-					}
+				worker.ls[pos / 4] = std::bit_cast<be_t<u32>>(inst_data[i]);
+			}
 
-					passed_count += sec.funcs.size();
-					sec_idx++;
-				}
+			worker.last_sec_idx = sec_idx;
+		}
 
-				if (sec_addr == umax)
-				{
-					// End of compilation for thread
-					break;
-				}
+		u32 block_addr = func_addr;
 
-				if (Emu.IsStopped() || fail_flag)
-				{
-					continue;
-				}
+		std::map<u32, std::vector<u32>> targets;
 
-				if (last_sec_idx != sec_idx)
-				{
-					if (last_sec_idx != umax)
-					{
-						// Clear fake LS of previous section
-						auto& sec = data_list[last_sec_idx];
-						std::memset(ls.data() + sec.vaddr / 4, 0, sec.inst_data.size() * 4);
-					}
+		// Call analyser
+		spu_program func2 = worker.compiler->analyse(worker.ls.data(), block_addr, &targets);
 
-					// Initialize LS with the entire section data
-					for (u32 i = 0, pos = sec_addr; i < inst_data.size(); i++, pos += 4)
-					{
-						ls[pos / 4] = std::bit_cast<be_t<u32>>(inst_data[i]);
-					}
+		while (!func2.data.empty())
+		{
+			const u32 last_inst = std::bit_cast<be_t<u32>>(func2.data.back());
+			const u32 prog_size = ::size32(func2.data);
 
-					last_sec_idx = sec_idx;
-				}
+			if (!worker.compiler->compile(std::move(func2)))
+			{
+				// Likely, out of JIT memory. Signal to prevent further building.
+				fail_flag |= 1;
+				break;
+			}
 
-				u32 block_addr = func_addr;
+			worker.result++;
 
-				std::map<u32, std::vector<u32>> targets;
+			const u32 start_new = block_addr + prog_size * 4;
 
-				// Call analyser
-				spu_program func2 = compiler->analyse(ls.data(), block_addr, &targets);
+			if (start_new >= next_func || (start_new == next_func - 4 && worker.ls[start_new / 4] == 0x200000u))
+			{
+				// Completed
+				break;
+			}
 
-				while (!func2.data.empty())
+			if (auto type = g_spu_itype.decode(last_inst);
+				type == spu_itype::BRSL || type == spu_itype::BRASL || type == spu_itype::BISL || type == spu_itype::SYNC)
+			{
+				if (worker.ls[start_new / 4] && g_spu_itype.decode(worker.ls[start_new / 4]) != spu_itype::UNK)
 				{
-					const u32 last_inst = std::bit_cast<be_t<u32>>(func2.data.back());
-					const u32 prog_size = ::size32(func2.data);
+					spu_log.notice("Precompiling fallthrough to 0x%05x", start_new);
+					func2 = worker.compiler->analyse(worker.ls.data(), start_new, &targets);
+					block_addr = start_new;
+					continue;
+				}
+			}
 
-					if (!compiler->compile(std::move(func2)))
-					{
-						// Likely, out of JIT memory. Signal to prevent further building.
-						fail_flag |= 1;
-						break;
-					}
+			if (targets.empty())
+			{
+				break;
+			}
 
-					result++;
+			const auto upper = targets.upper_bound(func_addr);
 
-					const u32 start_new = block_addr + prog_size * 4;
+			if (upper == targets.begin())
+			{
+				break;
+			}
 
-					if (start_new >= next_func || (start_new == next_func - 4 && ls[start_new / 4] == 0x200000u))
-					{
-						// Completed
-						break;
-					}
+			u32 new_entry = umax;
 
-					if (auto type = g_spu_itype.decode(last_inst);
-						type == spu_itype::BRSL || type == spu_itype::BRASL || type == spu_itype::BISL || type == spu_itype::SYNC)
+			// Find the lowest target in the space in-between
+			for (auto it = std::prev(upper); it != targets.end() && it->first < start_new && new_entry > start_new; it++)
+			{
+				for (u32 target : it->second)
+				{
+					if (target >= start_new && target < next_func)
 					{
-						if (ls[start_new / 4] && g_spu_itype.decode(ls[start_new / 4]) != spu_itype::UNK)
+						if (target < new_entry)
 						{
-							spu_log.notice("Precompiling fallthrough to 0x%05x", start_new);
-							func2 = compiler->analyse(ls.data(), start_new, &targets);
-							block_addr = start_new;
-							continue;
-						}
-					}
+							new_entry = target;
 
-					if (targets.empty())
-					{
-						break;
+							if (new_entry == start_new)
+							{
+								// Cannot go lower
+								break;
+							}
+						}
 					}
+				}
+			}
 
-					const auto upper = targets.upper_bound(func_addr);
+			if (new_entry != umax && !spu_thread::is_exec_code(new_entry, {reinterpret_cast<const u8*>(worker.ls.data()), SPU_LS_SIZE}, 0, true))
+			{
+				new_entry = umax;
+			}
 
-					if (upper == targets.begin())
-					{
-						break;
-					}
+			if (new_entry == umax)
+			{
+				new_entry = start_new;
 
-					u32 new_entry = umax;
+				while (new_entry < next_func && (worker.ls[start_new / 4] < 0x3fffc || !spu_thread::is_exec_code(new_entry, {reinterpret_cast<const u8*>(worker.ls.data()), SPU_LS_SIZE}, 0, true)))
+				{
+					new_entry += 4;
+				}
 
-					// Find the lowest target in the space in-between
-					for (auto it = std::prev(upper); it != targets.end() && it->first < start_new && new_entry > start_new; it++)
-					{
-						for (u32 target : it->second)
-						{
-							if (target >= start_new && target < next_func)
-							{
-								if (target < new_entry)
-								{
-									new_entry = target;
+				if (new_entry >= next_func || (new_entry == next_func - 4 && worker.ls[new_entry / 4] == 0x200000u))
+				{
+					// Completed
+					break;
+				}
+			}
 
-									if (new_entry == start_new)
-									{
-										// Cannot go lower
-										break;
-									}
-								}
-							}
-						}
-					}
+			spu_log.notice("Precompiling filler space at 0x%05x (next=0x%05x)", new_entry, next_func);
+			func2 = worker.compiler->analyse(worker.ls.data(), new_entry, &targets);
+			block_addr = new_entry;
+		}
+	};
 
-					if (new_entry != umax && !spu_thread::is_exec_code(new_entry, {reinterpret_cast<const u8*>(ls.data()), SPU_LS_SIZE}, 0, true))
-					{
-						new_entry = umax;
-					}
+	utils::task_group workers("SPU cache");
 
-					if (new_entry == umax)
-					{
-						new_entry = start_new;
+	// Every task builds one function, each worker slot keeps its compiler instance
+	workers.run_range(func_list.size() + total_precompile, worker_count, [&](u32 slot, usz func_i)
+		{
+#ifdef __APPLE__
+			pthread_jit_write_protect_np(false);
+#endif
+			auto& worker = contexts[slot];
 
-						while (new_entry < next_func && (ls[start_new / 4] < 0x3fffc || !spu_thread::is_exec_code(new_entry, {reinterpret_cast<const u8*>(ls.data()), SPU_LS_SIZE}, 0, true)))
-						{
-							new_entry += 4;
-						}
+			if (!worker.compiler)
+			{
+				// Initialize compiler instances for parallel compilation
+				if (g_cfg.core.spu_decoder == spu_decoder_type::asmjit)
+				{
+					worker.compiler = spu_recompiler_base::make_asmjit_recompiler();
+				}
+				else if (g_cfg.core.spu_decoder == spu_decoder_type::llvm)
+				{
+					worker.compiler = spu_recompiler_base::make_llvm_recompiler();
+				}
 
-						if (new_entry >= next_func || (new_entry == next_func - 4 && ls[new_entry / 4] == 0x200000u))
-						{
-							// Completed
-							break;
-						}
-					}
+				worker.compiler->init();
+				worker.ls.resize(0x10000);
+			}
 
-					spu_log.notice("Precompiling filler space at 0x%05x (next=0x%05x)", new_entry, next_func);
-					func2 = compiler->analyse(ls.data(), new_entry, &targets);
-					block_addr = new_entry;
+			if (!Emu.IsStopped() && !fail_flag)
+			{
+				if (func_i < func_list.size())
+				{
+					build_func(worker, func_i);
+				}
+				else
+				{
+					build_section_func(worker, func_i - func_list.size());
 				}
 
-				if (is_first_thread && !showing_progress)
+				// Ensure some actions are performed on a single slot
+				if (slot == 0 && !showing_progress)
 				{
 					if (!g_progr_text && !g_progr_ptotal && !g_progr_ftotal)
 					{
 						showing_progress = true;
 						g_progr_pdone += pending_progress.exchange(0);
 						g_progr_ptotal += total_funcs;
-
 						progress_dialog.emplace(get_localized_string(localized_string_id::PROGRESS_DIALOG_BUILDING_SPU_CACHE));
 					}
 				}
@@ -1129,26 +1329,33 @@ void spu_cache::initialize(bool build_existing_cache)
 				}
 			}
 
-			if (showing_progress && pending_progress)
-			{
-				// Cover missing progress due to a race
-				g_progr_pdone += pending_progress.exchange(0);
-			}
-
-			return result;
+			(showing_progress ? g_progr_pdone : pending_progress) += build_existing_cache ? 1 : 0;
 		});
 
+	workers.join();
+
+	if (showing_progress && pending_progress)
+	{
+		// Cover missing progress due to a race
+		g_progr_pdone += pending_progress.exchange(0);
+	}
+
 	u32 built_total = 0;
 
-	// Join (implicitly) and print individual results
-	for (u32 i = 0; i < workers.size(); i++)
+	// Print individual results
+	for (u32 i = 0; i < worker_count; i++)
 	{
-		spu_log.notice("SPU Runtime: Worker %u built %u programs.", i + 1, workers[i]);
-		built_total += workers[i];
+		spu_log.notice("SPU Runtime: Worker %u built %u programs.", i + 1, contexts[i].result);
+		built_total += contexts[i].result;
 	}
 
 	spu_log.notice("SPU Runtime: Workers built %u programs.", built_total);
 
+	if (const auto obj_cache = g_fxo->try_get<spu_llvm_object_cache>(); obj_cache && obj_cache->is_open())
+	{
+		spu_log.notice("SPU Runtime: %u programs compiled, %u loaded from object cache.", obj_cache->compiled.load(), obj_cache->loaded.load());
+	}
+
 	if (Emu.IsStopped())
 	{
 		spu_log.error("SPU Runtime: Cache building aborted.");
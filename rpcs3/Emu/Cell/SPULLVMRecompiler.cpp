@@ -1435,6 +1435,185 @@ class spu_llvm_recompiler : public spu_recompiler_base, public cpu_translator
 		m_ir->CreateStore(m_ir->getInt32(0), spu_ptr<u32>(OFFSET_OF(spu_thread, raddr)));
 	}
 
+	// Everything the generated code depends on besides the program itself
+	static std::string get_object_fingerprint()
+	{
+		std::string result = "v1";
+
+		// Helpers are referenced relative to the image anchor, which is only valid for the same build
+		fs::stat_t exe_info{};
+		fs::get_stat(fs::get_executable_path(), exe_info);
+		fmt::append(result, "|%s|%u|%d", fs::get_executable_path(), exe_info.size, exe_info.mtime);
+		fmt::append(result, "|%s|%s", jit_compiler::triple2(), jit_compiler::cpu(g_cfg.core.llvm_cpu));
+		fmt::append(result, "|%u|%u|%s", utils::get_tsc_freq(), +g_use_rtm, g_cfg.core.spu_decoder.to_string());
+
+		const cfg::_base* const settings[]{
+			&g_cfg.core.spu_block_size,
+			&g_cfg.core.spu_xfloat_accuracy,
+			&g_cfg.core.use_accurate_dfma,
+			&g_cfg.core.spu_verification,
+			&g_cfg.core.precise_spu_verification,
+			&g_cfg.core.spu_prof,
+			&g_cfg.core.spu_accurate_dma,
+			&g_cfg.core.spu_accurate_reservations,
+			&g_cfg.core.spu_loop_detection,
+			&g_cfg.core.mfc_debug,
+			&g_cfg.core.rsx_accurate_res_access,
+			&g_cfg.core.rsx_fifo_accuracy,
+			&g_cfg.core.clocks_scale,
+			&g_cfg.video.strict_rendering_mode,
+			&g_cfg.savestate.compatible_mode,
+		};
+
+		for (const auto setting : settings)
+		{
+			fmt::append(result, "|%s", setting->to_string());
+		}
+
+		return result;
+	}
+
+	// Reference point of the emulator image for symbols of cached objects
+	static u64 get_image_anchor()
+	{
+		return reinterpret_cast<u64>(&spu_llvm_recompiler::get_runtime_symbol);
+	}
+
+	// Code generated by SPU runtime at startup, its location is not fixed relative to the image
+	static u64 get_runtime_symbol(std::string_view name)
+	{
+		if (name == "spu_escape")
+		{
+			return reinterpret_cast<u64>(spu_runtime::g_escape);
+		}
+
+		if (name == "spu_dispatch")
+		{
+			return reinterpret_cast<u64>(spu_runtime::tr_dispatch);
+		}
+
+		if (name == "spu_dispatcher")
+		{
+			return reinterpret_cast<u64>(spu_runtime::tr_all);
+		}
+
+		if (name == "spu_segment_base")
+		{
+			return reinterpret_cast<u64>(jit_runtime::alloc(0, 0));
+		}
+
+		return 0;
+	}
+
+	// Describe external symbols of the module mapped by the recompiler, others are resolved by the memory manager
+	std::vector<spu_llvm_object_cache::symbol> get_object_symbols(const llvm::Module& module) const
+	{
+		std::vector<spu_llvm_object_cache::symbol> result;
+
+		const auto add_symbol = [&](const llvm::GlobalValue& value)
+		{
+			if (!value.isDeclaration())
+			{
+				return;
+			}
+
+			std::string name = value.getName().str();
+			const u64 addr = m_engine->getAddressToGlobalIfAvailable(name);
+
+			if (!addr)
+			{
+				return;
+			}
+
+			spu_llvm_object_cache::symbol sym{};
+
+			if (name.starts_with(m_hash))
+			{
+				// Branch patchpoints (see tail_chunk)
+				const std::string_view suffix = std::string_view(name).substr(m_hash.size());
+
+				sym.kind = spu_llvm_object_cache::symbol_kind::patchpoint;
+
+				if (suffix.starts_with("-chunkpp-0x"))
+				{
+					sym.value = std::stoul(std::string(suffix.substr(11)), nullptr, 16) / 4;
+				}
+			}
+			else if (get_runtime_symbol(name))
+			{
+				sym.kind = spu_llvm_object_cache::symbol_kind::runtime;
+			}
+			else
+			{
+				sym.kind = spu_llvm_object_cache::symbol_kind::image;
+				sym.value = static_cast<s64>(addr - get_image_anchor());
+			}
+
+			sym.name = std::move(name);
+			result.emplace_back(std::move(sym));
+		};
+
+		for (const auto& func : module.functions())
+		{
+			if (!func.isIntrinsic())
+			{
+				add_symbol(func);
+			}
+		}
+
+		for (const auto& var : module.globals())
+		{
+			add_symbol(var);
+		}
+
+		return result;
+	}
+
+	// Link cached object, restoring symbol mappings for the current process
+	spu_function_t link_cached_object(const spu_llvm_object_cache::object& obj)
+	{
+		m_engine->clearAllGlobalMappings();
+
+		for (const auto& sym : obj.symbols)
+		{
+			u64 addr = 0;
+
+			switch (sym.kind)
+			{
+			case spu_llvm_object_cache::symbol_kind::image:
+			{
+				addr = get_image_anchor() + sym.value;
+				break;
+			}
+			case spu_llvm_object_cache::symbol_kind::runtime:
+			{
+				addr = get_runtime_symbol(sym.name);
+				break;
+			}
+			case spu_llvm_object_cache::symbol_kind::patchpoint:
+			{
+				addr = reinterpret_cast<u64>(m_spurt->make_branch_patchpoint(static_cast<u16>(sym.value)));
+				break;
+			}
+			}
+
+			if (!addr)
+			{
+				return nullptr;
+			}
+
+			m_engine->updateGlobalMapping(sym.name, addr);
+		}
+
+		if (!m_jit.add(obj.data, m_hash))
+		{
+			return nullptr;
+		}
+
+		m_jit.fin();
+		return reinterpret_cast<spu_function_t>(m_jit.get(m_hash));
+	}
+
 public:
 	spu_llvm_recompiler(u8 interp_magn = 0)
 		: spu_recompiler_base(), cpu_translator(nullptr, false), m_interp_magn(interp_magn)
@@ -1449,6 +1628,12 @@ public:
 			m_spurt = &g_fxo->get<spu_runtime>();
 			cpu_translator::initialize(m_jit.get_context(), m_jit.get_engine());
 
+			if (auto obj_cache = g_fxo->try_get<spu_llvm_object_cache>())
+			{
+				// Native objects (version + block size type)
+				obj_cache->open(m_spurt->get_cache_path() + "spu-" + fmt::to_lower(g_cfg.core.spu_block_size.to_string()) + "-v1-llvm.dat", get_object_fingerprint());
+			}
+
 			const auto md_name = llvm::MDString::get(m_context, "branch_weights");
 			const auto md_low = llvm::ValueAsMetadata::get(llvm::ConstantInt::get(GetType<u32>(), 1));
 			const auto md_high = llvm::ValueAsMetadata::get(llvm::ConstantInt::get(GetType<u32>(), 999));
@@ -1548,6 +1733,63 @@ public:
 			m_hash_start = hash_start;
 		}
 
+		// Native object cache is bypassed in debug mode, which relies on IR dumps
+		auto obj_cache = g_cfg.core.spu_debug ? nullptr : g_fxo->try_get<spu_llvm_object_cache>();
+
+		if (obj_cache && !obj_cache->is_open())
+		{
+			obj_cache = nullptr;
+		}
+
+		if (spu_llvm_object_cache::object obj; obj_cache && obj_cache->load(m_hash, obj))
+		{
+#if defined(__APPLE__)
+			pthread_jit_write_protect_np(false);
+#endif
+
+			const spu_function_t fn = link_cached_object(obj);
+
+			if (fn)
+			{
+				add_loc->compiled = fn;
+
+				if (!m_spurt->rebuild_ubertrampoline(func.data[0]))
+				{
+					if (add_to_file)
+					{
+						g_fxo->get<spu_cache>().add(func);
+					}
+
+					return nullptr;
+				}
+
+				add_loc->compiled.notify_all();
+			}
+
+#if defined(__APPLE__)
+			pthread_jit_write_protect_np(true);
+#endif
+#if defined(ARCH_ARM64)
+			// Flush all cache lines after potentially writing executable code
+			asm("ISB");
+			asm("DSB ISH");
+#endif
+
+			if (fn)
+			{
+				if (add_to_file)
+				{
+					g_fxo->get<spu_cache>().add(func);
+				}
+
+				obj_cache->loaded++;
+				spu_log.trace("Loaded function 0x%x from object cache (%s)", func.entry_point, m_hash);
+				return fn;
+			}
+
+			spu_log.error("Failed to link cached function 0x%x (%s), recompiling", func.entry_point, m_hash);
+		}
+
 		spu_log.notice("Building function 0x%x... (size %u, %s)", func.entry_point, func.data.size(), m_hash);
 
 		m_pos = func.lower_bound;
@@ -2785,11 +3027,18 @@ public:
 		pthread_jit_write_protect_np(false);
 #endif
 
+		spu_llvm_object_cache::object compiled_obj;
+
 		if (g_cfg.core.spu_debug)
 		{
 			// Testing only
 			m_jit.add(std::move(_module), m_spurt->get_cache_path() + "llvm/");
 		}
+		else if (obj_cache)
+		{
+			compiled_obj.symbols = get_object_symbols(*_module);
+			m_jit.add(std::move(_module), compiled_obj.data);
+		}
 		else
 		{
 			m_jit.add(std::move(_module));
@@ -2800,6 +3049,12 @@ public:
 		// Register function pointer
 		const spu_function_t fn = reinterpret_cast<spu_function_t>(m_jit.get_engine().getPointerToFunction(main_func));
 
+		if (fn && !compiled_obj.data.empty())
+		{
+			obj_cache->store(m_hash, compiled_obj);
+			obj_cache->compiled++;
+		}
+
 		// Install unconditionally, possibly replacing existing one from spu_fast
 		add_loc->compiled = fn;
 
@@ -3518,7 +3773,7 @@ public:
 #if defined(ARCH_X64)
 			if (utils::get_tsc_freq() && !(g_cfg.core.spu_loop_detection) && (g_cfg.core.clocks_scale == 100))
 			{
-				const auto timebase_offs = m_ir->CreateLoad(get_type<u64>(), m_ir->CreateIntToPtr(m_ir->getInt64(reinterpret_cast<u64>(&g_timebase_offs)), get_type<u64*>()));
+				const auto timebase_offs = get_timebase_offs();
 				const auto timestamp = m_ir->CreateLoad(get_type<u64>(), spu_ptr<u64>(OFFSET_OF(spu_thread, ch_dec_start_timestamp)));
 				const auto dec_value = m_ir->CreateLoad(get_type<u32>(), spu_ptr<u32>(OFFSET_OF(spu_thread, ch_dec_value)));
 				const auto tsc = m_ir->CreateCall(get_intrinsic(llvm::Intrinsic::x86_rdtsc));
@@ -4340,7 +4595,7 @@ public:
 #if defined(ARCH_X64)
 			if (utils::get_tsc_freq() && !(g_cfg.core.spu_loop_detection) && (g_cfg.core.clocks_scale == 100))
 			{
-				const auto timebase_offs = m_ir->CreateLoad(get_type<u64>(), m_ir->CreateIntToPtr(m_ir->getInt64(reinterpret_cast<u64>(&g_timebase_offs)), get_type<u64*>()));
+				const auto timebase_offs = get_timebase_offs();
 				const auto tsc = m_ir->CreateCall(get_intrinsic(llvm::Intrinsic::x86_rdtsc));
 				const auto tscx = m_ir->CreateMul(m_ir->CreateUDiv(tsc, m_ir->getInt64(utils::get_tsc_freq())), m_ir->getInt64(80000000));
 				const auto tscm = m_ir->CreateUDiv(m_ir->CreateMul(m_ir->CreateURem(tsc, m_ir->getInt64(utils::get_tsc_freq())), m_ir->getInt64(80000000)), m_ir->getInt64(utils::get_tsc_freq()));
@@ -8525,6 +8780,14 @@ public:
 		return m_ir->CreatePtrToInt(func, get_type<u64>());
 	}
 
+	// Linked by name, so the code doesn't depend on the variable address (see spu_llvm_object_cache)
+	llvm::Value* get_timebase_offs()
+	{
+		const auto var = m_module->getOrInsertGlobal("spu_timebase_offs", get_type<u64>());
+		m_engine->updateGlobalMapping("spu_timebase_offs", reinterpret_cast<u64>(&g_timebase_offs));
+		return m_ir->CreateLoad(get_type<u64>(), var);
+	}
+
 	static decltype(&spu_llvm_recompiler::UNK) decode(u32 op);
 };
 
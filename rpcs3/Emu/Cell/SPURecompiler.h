@@ -9,6 +9,7 @@
 #include <memory>
 #include <string>
 #include <deque>
+#include <unordered_map>
 
 // Helper class
 class spu_cache
@@ -49,6 +50,56 @@ public:
 	lf_queue<precompile_data_t> precompile_funcs;
 };
 
+// Archive of native objects produced by SPU LLVM recompiler, indexed by program hash
+class spu_llvm_object_cache
+{
+	shared_mutex m_mutex;
+
+	fs::file m_file;
+
+	// Record offsets by program hash
+	std::unordered_map<std::string, u64> m_index;
+
+	bool m_open_failed = false;
+
+public:
+	enum class symbol_kind : u8
+	{
+		image,      // Function or variable of the emulator, value is relative to the image anchor
+		runtime,    // Code generated by SPU runtime, resolved by name
+		patchpoint, // Branch patchpoint, value is its data
+	};
+
+	struct symbol
+	{
+		symbol_kind kind;
+		s64 value;
+		std::string name;
+	};
+
+	struct object
+	{
+		std::vector<symbol> symbols;
+		std::vector<u8> data;
+	};
+
+	// Statistics
+	atomic_t<u32> compiled = 0;
+	atomic_t<u32> loaded = 0;
+
+	// Open archive, it's discarded if fingerprint (codegen settings, CPU, emulator build) doesn't match
+	bool open(const std::string& path, std::string_view fingerprint);
+
+	bool is_open() const
+	{
+		return m_file.operator bool();
+	}
+
+	bool load(const std::string& name, object& out);
+
+	void store(const std::string& name, const object& obj);
+};
+
 struct spu_program
 {
 	// Address of the entry point in LS
@@ -0,0 +1,442 @@
+#include "stdafx.h"
+#include "pipeline_archive.h"
+
+#include "util/vm.hpp"
+#include "rx/align.hpp"
+
+#include <unordered_set>
+
+namespace rsx
+{
+	namespace
+	{
+		// Pipeline archive format, all records are appended to the end of file
+		struct archive_header
+		{
+			u64 magic;
+			u32 version;
+			u32 reserved;
+		};
+
+		struct record_header
+		{
+			u32 type;
+			u32 size;
+			u64 key;
+			u64 vertex_program; // Pipeline only
+			u64 fragment_program; // Pipeline only
+		};
+
+		constexpr u64 c_archive_magic = "RSXPIPEA"_u64;
+		constexpr u32 c_archive_version = 1;
+
+		// Payloads are padded to keep the headers aligned in the view
+		constexpr u32 c_record_alignment = 8;
+	} // namespace
+
+	pipeline_archive::~pipeline_archive()
+	{
+		close_unlocked();
+	}
+
+	bool pipeline_archive::open(const std::string& path, usz pipeline_size)
+	{
+		std::lock_guard lock(m_mutex);
+		return open_unlocked(path, pipeline_size);
+	}
+
+	bool pipeline_archive::open_unlocked(const std::string& path, usz pipeline_size)
+	{
+		if (m_file)
+		{
+			return true;
+		}
+
+		fs::file file(path, fs::read + fs::write + fs::create);
+
+		if (!file)
+		{
+			rsx_log.error("Failed to open pipeline archive at: %s (%s)", path, fs::g_tls_error);
+			return false;
+		}
+
+		archive_header header{};
+
+		if (!file.read(header) || header.magic != c_archive_magic || header.version != c_archive_version)
+		{
+			if (file.size())
+			{
+				rsx_log.notice("Pipeline archive is outdated, discarded: %s", path);
+			}
+
+			header = {};
+			header.magic = c_archive_magic;
+			header.version = c_archive_version;
+
+			file.trunc(0);
+			file.seek(0);
+			file.write(header);
+		}
+
+		const u64 file_size = file.size();
+
+		if (file_size > sizeof(header))
+		{
+			// Mapping is not implemented on all platforms, read the contents as a fallback
+			if (const auto ptr = utils::memory_map_fd(file.get_handle(), file_size, utils::protection::ro))
+			{
+				m_view = static_cast<const u8*>(ptr);
+				m_view_mapped = true;
+			}
+			else
+			{
+				m_view_data.resize(file_size);
+
+				if (file.read_at(0, m_view_data.data(), file_size) != file_size)
+				{
+					rsx_log.error("Failed to read pipeline archive: %s", path);
+					m_view_data.clear();
+				}
+				else
+				{
+					m_view = m_view_data.data();
+				}
+			}
+
+			m_view_size = m_view ? file_size : 0;
+		}
+
+		u64 pos = sizeof(header);
+
+		while (pos < m_view_size)
+		{
+			record_header rec{};
+
+			if (m_view_size - pos < sizeof(rec))
+			{
+				break;
+			}
+
+			std::memcpy(&rec, m_view + pos, sizeof(rec));
+
+			const u64 end = pos + sizeof(rec) + rx::alignUp<u64>(rec.size, c_record_alignment);
+
+			if (!rec.type || end > m_view_size)
+			{
+				break;
+			}
+
+			const record_ref ref{pos + sizeof(rec), rec.size, rec.vertex_program, rec.fragment_program};
+			const u64 record_size = end - pos;
+			pos = end;
+
+			if (rec.type > static_cast<u32>(record_type::pipeline))
+			{
+				m_wasted += record_size;
+				continue;
+			}
+
+			const auto type = static_cast<record_type>(rec.type);
+
+			if (type == record_type::pipeline)
+			{
+				// Programs are always appended before the pipeline, its absence means a damaged entry
+				if (rec.size != pipeline_size || !index(record_type::vertex_program).contains(rec.vertex_program) ||
+					!index(record_type::fragment_program).contains(rec.fragment_program))
+				{
+					m_wasted += record_size;
+					continue;
+				}
+			}
+
+			if (!index(type).emplace(rec.key, ref).second)
+			{
+				m_wasted += record_size;
+				continue;
+			}
+
+			if (type == record_type::pipeline)
+			{
+				m_pipelines.push_back({rec.key, rec.vertex_program, rec.fragment_program, {m_view + ref.offset, rec.size}});
+			}
+		}
+
+		if (m_view && pos < file_size)
+		{
+			// Probably the emulator was terminated while writing
+			rsx_log.warning("Pipeline archive: dropped damaged tail at 0x%x (%s)", pos, path);
+			file.trunc(pos);
+		}
+
+		m_view_end = m_view ? pos : 0;
+
+		// Count programs no longer used by any pipeline
+		std::unordered_set<u64> used_vp, used_fp;
+
+		for (const auto& entry : m_pipelines)
+		{
+			used_vp.insert(entry.vertex_program);
+			used_fp.insert(entry.fragment_program);
+		}
+
+		for (const auto& [key, ref] : index(record_type::vertex_program))
+		{
+			if (!used_vp.contains(key))
+			{
+				m_wasted += sizeof(record_header) + rx::alignUp<u64>(ref.size, c_record_alignment);
+			}
+		}
+
+		for (const auto& [key, ref] : index(record_type::fragment_program))
+		{
+			if (!used_fp.contains(key))
+			{
+				m_wasted += sizeof(record_header) + rx::alignUp<u64>(ref.size, c_record_alignment);
+			}
+		}
+
+		m_file = std::move(file);
+		m_path = path;
+		m_pipeline_size = pipeline_size;
+
+		rsx_log.notice("Pipeline archive: %u pipelines, %u vertex programs, %u fragment programs found in %s (%u KiB reclaimable)",
+			m_pipelines.size(), index(record_type::vertex_program).size(), index(record_type::fragment_program).size(), path, m_wasted / 1024);
+		return true;
+	}
+
+	bool pipeline_archive::is_open() const
+	{
+		reader_lock lock(m_mutex);
+		return !!m_file;
+	}
+
+	void pipeline_archive::close()
+	{
+		std::lock_guard lock(m_mutex);
+		close_unlocked();
+	}
+
+	void pipeline_archive::close_unlocked()
+	{
+		release_view_unlocked();
+
+		m_file.close();
+
+		for (auto& index : m_index)
+		{
+			index.clear();
+		}
+
+		m_wasted = 0;
+		m_appended = false;
+	}
+
+	void pipeline_archive::release_view()
+	{
+		std::lock_guard lock(m_mutex);
+		release_view_unlocked();
+	}
+
+	void pipeline_archive::release_view_unlocked()
+	{
+		if (m_view_mapped)
+		{
+			utils::memory_release(const_cast<u8*>(m_view), m_view_size);
+		}
+
+		m_view = nullptr;
+		m_view_size = 0;
+		m_view_end = 0;
+		m_view_mapped = false;
+		m_view_data = {};
+		m_pipelines = {};
+	}
+
+	std::span<const u8> pipeline_archive::find(record_type type, u64 key) const
+	{
+		reader_lock lock(m_mutex);
+
+		const auto& records = index(type);
+		const auto found = records.find(key);
+
+		if (found == records.end() || found->second.offset + found->second.size > m_view_end)
+		{
+			return {};
+		}
+
+		return {m_view + found->second.offset, found->second.size};
+	}
+
+	bool pipeline_archive::contains(record_type type, u64 key) const
+	{
+		reader_lock lock(m_mutex);
+		return index(type).contains(key);
+	}
+
+	bool pipeline_archive::append(record_type type, u64 key, const void* data, u32 size)
+	{
+		ensure(type != record_type::pipeline);
+
+		std::lock_guard lock(m_mutex);
+
+		if (!m_file || index(type).contains(key))
+		{
+			return false;
+		}
+
+		record_header rec{};
+		rec.type = static_cast<u32>(type);
+		rec.size = size;
+		rec.key = key;
+
+		static constexpr u8 s_padding[c_record_alignment]{};
+
+		const fs::iovec_clone gather[3]{
+			{&rec, sizeof(rec)},
+			{data, size},
+			{s_padding, rx::alignUp<u32>(size, c_record_alignment) - size}};
+
+		const u64 pos = m_file.seek(0, fs::seek_end);
+		m_file.write_gather(gather, 3);
+
+		index(type).emplace(key, record_ref{pos + sizeof(rec), size, 0, 0});
+		m_appended = true;
+		return true;
+	}
+
+	bool pipeline_archive::append_pipeline(u64 key, u64 vertex_program, u64 fragment_program, const void* data, u32 size)
+	{
+		std::lock_guard lock(m_mutex);
+
+		if (!m_file || index(record_type::pipeline).contains(key))
+		{
+			return false;
+		}
+
+		if (!index(record_type::vertex_program).contains(vertex_program) || !index(record_type::fragment_program).contains(fragment_program))
+		{
+			rsx_log.error("Pipeline archive: programs of pipeline 0x%llx are missing", key);
+			return false;
+		}
+
+		record_header rec{};
+		rec.type = static_cast<u32>(record_type::pipeline);
+		rec.size = size;
+		rec.key = key;
+		rec.vertex_program = vertex_program;
+		rec.fragment_program = fragment_program;
+
+		static constexpr u8 s_padding[c_record_alignment]{};
+
+		const fs::iovec_clone gather[3]{
+			{&rec, sizeof(rec)},
+			{data, size},
+			{s_padding, rx::alignUp<u32>(size, c_record_alignment) - size}};
+
+		const u64 pos = m_file.seek(0, fs::seek_end);
+		m_file.write_gather(gather, 3);
+
+		index(record_type::pipeline).emplace(key, record_ref{pos + sizeof(rec), size, vertex_program, fragment_program});
+		m_appended = true;
+		return true;
+	}
+
+	u64 pipeline_archive::wasted() const
+	{
+		reader_lock lock(m_mutex);
+		return m_wasted;
+	}
+
+	bool pipeline_archive::compact()
+	{
+		std::lock_guard lock(m_mutex);
+
+		if (!m_file)
+		{
+			return false;
+		}
+
+		const std::string path = m_path;
+		const usz pipeline_size = m_pipeline_size;
+
+		if (m_appended)
+		{
+			// Records appended after opening are not part of the view
+			close_unlocked();
+
+			if (!open_unlocked(path, pipeline_size))
+			{
+				return false;
+			}
+		}
+
+		fs::pending_file temp(path);
+
+		if (!temp.file)
+		{
+			rsx_log.error("Pipeline archive: failed to create temporary file for %s (%s)", path, fs::g_tls_error);
+			return false;
+		}
+
+		archive_header header{};
+		header.magic = c_archive_magic;
+		header.version = c_archive_version;
+		temp.file.write(header);
+
+		const u64 old_size = m_view_end;
+
+		static constexpr u8 s_padding[c_record_alignment]{};
+
+		// Place programs next to the first pipeline using them
+		std::unordered_set<u64> written_vp, written_fp;
+
+		const auto write_record = [&](record_type type, u64 key)
+		{
+			const auto& ref = index(type).at(key);
+
+			record_header rec{};
+			rec.type = static_cast<u32>(type);
+			rec.size = ref.size;
+			rec.key = key;
+			rec.vertex_program = ref.vertex_program;
+			rec.fragment_program = ref.fragment_program;
+
+			const fs::iovec_clone gather[3]{
+				{&rec, sizeof(rec)},
+				{m_view + ref.offset, ref.size},
+				{s_padding, rx::alignUp<u32>(ref.size, c_record_alignment) - ref.size}};
+
+			temp.file.write_gather(gather, 3);
+		};
+
+		for (const auto& entry : m_pipelines)
+		{
+			if (written_vp.insert(entry.vertex_program).second)
+			{
+				write_record(record_type::vertex_program, entry.vertex_program);
+			}
+
+			if (written_fp.insert(entry.fragment_program).second)
+			{
+				write_record(record_type::fragment_program, entry.fragment_program);
+			}
+
+			write_record(record_type::pipeline, entry.key);
+		}
+
+		const u64 new_size = temp.file.size();
+
+		// The file must be closed before it's replaced
+		close_unlocked();
+
+		if (!temp.commit())
+		{
+			rsx_log.error("Pipeline archive: failed to replace %s (%s)", path, fs::g_tls_error);
+			open_unlocked(path, pipeline_size);
+			return false;
+		}
+
+		rsx_log.notice("Pipeline archive: compacted %s (%u KiB -> %u KiB)", path, old_size / 1024, new_size / 1024);
+		return open_unlocked(path, pipeline_size);
+	}
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "util/types.hpp"
+#include "util/File.h"
+#include "util/mutex.h"
+#include "unordered_map.hpp"
+
+#include <span>
+#include <string>
+#include <vector>
+
+namespace rsx
+{
+	// Append-only single file storage of the pipeline cache.
+	// Vertex and fragment program ucode is stored once and shared by all pipelines using it.
+	class pipeline_archive
+	{
+	public:
+		enum class record_type : u32
+		{
+			vertex_program = 1,
+			fragment_program = 2,
+			pipeline = 3,
+		};
+
+		struct pipeline_entry
+		{
+			u64 key;
+			u64 vertex_program;
+			u64 fragment_program;
+			std::span<const u8> data;
+		};
+
+	private:
+		struct record_ref
+		{
+			u64 offset; // Payload offset in the file
+			u32 size;
+			u64 vertex_program; // Pipeline only
+			u64 fragment_program; // Pipeline only
+		};
+
+		mutable shared_mutex m_mutex;
+
+		std::string m_path;
+		fs::file m_file;
+		usz m_pipeline_size = 0;
+
+		// Contents of the archive at the time it was opened (mapped if possible)
+		const u8* m_view = nullptr;
+		usz m_view_size = 0;
+		usz m_view_end = 0; // End of valid records
+		bool m_view_mapped = false;
+		std::vector<u8> m_view_data;
+
+		// Hashed index of all records, including ones appended after opening
+		rsx::unordered_map<u64, record_ref> m_index[3];
+
+		// Loadable pipelines of the view in storage order
+		std::vector<pipeline_entry> m_pipelines;
+
+		// Bytes occupied by duplicate, damaged or unreferenced records
+		u64 m_wasted = 0;
+
+		// Records were appended after opening
+		bool m_appended = false;
+
+		rsx::unordered_map<u64, record_ref>& index(record_type type)
+		{
+			return m_index[static_cast<u32>(type) - 1];
+		}
+
+		const rsx::unordered_map<u64, record_ref>& index(record_type type) const
+		{
+			return m_index[static_cast<u32>(type) - 1];
+		}
+
+		bool open_unlocked(const std::string& path, usz pipeline_size);
+		void close_unlocked();
+		void release_view_unlocked();
+
+	public:
+		pipeline_archive() = default;
+
+		pipeline_archive(const pipeline_archive&) = delete;
+
+		pipeline_archive& operator=(const pipeline_archive&) = delete;
+
+		~pipeline_archive();
+
+		// Open or create the archive and index its contents. Pipelines of another size than pipeline_size are ignored.
+		bool open(const std::string& path, usz pipeline_size);
+
+		bool is_open() const;
+
+		void close();
+
+		// Drop the view of the archive contents when the loading is done, the index is preserved
+		void release_view();
+
+		// Loadable pipelines of the view
+		const std::vector<pipeline_entry>& pipelines() const
+		{
+			return m_pipelines;
+		}
+
+		// Find vertex or fragment program ucode in the view
+		std::span<const u8> find(record_type type, u64 key) const;
+
+		bool contains(record_type type, u64 key) const;
+
+		// Append vertex or fragment program ucode unless it's already stored
+		bool append(record_type type, u64 key, const void* data, u32 size);
+
+		// Append the pipeline unless it's already stored, the programs should be appended first
+		bool append_pipeline(u64 key, u64 vertex_program, u64 fragment_program, const void* data, u32 size);
+
+		// Amount of space which can be reclaimed by compaction
+		u64 wasted() const;
+
+		// Rewrite the archive without duplicate, damaged and unreferenced records, then open it again.
+		// Must not run concurrently with the use of the view.
+		bool compact();
+	};
+}
@@ -3,7 +3,9 @@
 #include "util/File.h"
 #include "util/lockless.h"
 #include "util/Thread.h"
+#include "util/task_executor.hpp"
 #include "Common/bitfield.hpp"
+#include "Common/pipeline_archive.h"
 #include "Common/unordered_map.hpp"
 #include "Emu/System.h"
 #include "Emu/cache_utils.hpp"
@@ -78,6 +80,8 @@ namespace rsx
 
 		backend_storage& m_storage;
 
+		pipeline_archive m_archive;
+
 		std::atomic<bool> m_shader_storage_exit{false};
 		std::condition_variable m_shader_storage_cv;
 		std::mutex m_shader_storage_mtx;
@@ -101,52 +105,132 @@ namespace rsx
 						m_shader_storage_worker_queue.pop_back();
 					}
 
+					if (!m_archive.is_open())
+					{
+						// Failed to open
+						continue;
+					}
+
 					pipeline_data data = pack(item.props, item.vp, item.fp);
 
-					std::string fp_name = root_path + "/raw/" + fmt::format("%llX.fp", data.fragment_program_hash);
-					std::string vp_name = root_path + "/raw/" + fmt::format("%llX.vp", data.vertex_program_hash);
+					// Program ucode is shared by many pipelines and only stored once
+					m_archive.append(pipeline_archive::record_type::vertex_program, data.vertex_program_hash, item.vp.data.data(), ::size32(item.vp.data) * sizeof(u32));
+					m_archive.append(pipeline_archive::record_type::fragment_program, data.fragment_program_hash, item.fp.get_data(), item.fp.ucode_length);
+					m_archive.append_pipeline(get_pipeline_key(data), data.vertex_program_hash, data.fragment_program_hash, &data, sizeof(data));
+				}
+			});
 
-					if (fs::stat_t s{}; !fs::get_stat(fp_name, s) || s.size != item.fp.ucode_length)
-					{
-						fs::write_pending_file(fp_name, item.fp.get_data(), item.fp.ucode_length);
-					}
+		static u64 get_pipeline_key(const pipeline_data& data)
+		{
+			const u32 state_params[] =
+				{
+					data.vp_ctrl0,
+					data.vp_ctrl1,
+					data.fp_ctrl,
+					data.vp_texture_dimensions,
+					data.fp_texture_dimensions,
+					data.fp_texcoord_control,
+					data.fp_height,
+					data.fp_pixel_layout,
+					data.fp_lighting_flags,
+					data.fp_shadow_textures,
+					data.fp_redirected_textures,
+					data.vp_multisampled_textures,
+					data.fp_multisampled_textures,
+					data.fp_mrt_count,
+			};
+
+			const u64 key_params[] =
+				{
+					data.vertex_program_hash,
+					data.fragment_program_hash,
+					data.pipeline_storage_hash,
+					rpcs3::hash_array(state_params),
+			};
+
+			return rpcs3::hash_array(key_params);
+		}
+
+		std::string get_archive_path() const
+		{
+			return root_path + "pipelines/" + pipeline_class_name + "/" + version_prefix + ".pack";
+		}
+
+		// Import pipelines stored as separate files by older versions
+		u32 import_legacy_cache(const std::string& directory_path)
+		{
+			u32 count = 0;
+
+			for (auto&& entry : fs::dir(directory_path))
+			{
+				if (entry.is_directory || !entry.name.ends_with(".bin"))
+				{
+					continue;
+				}
+
+				pipeline_data pdata{};
+
+				if (fs::file f(directory_path + "/" + entry.name); !f || f.size() != sizeof(pipeline_data) || !f.read(pdata))
+				{
+					continue;
+				}
+
+				const fs::file vp(fmt::format("%s/raw/%llX.vp", root_path, pdata.vertex_program_hash));
+				const fs::file fp(fmt::format("%s/raw/%llX.fp", root_path, pdata.fragment_program_hash));
+
+				if (!vp || !fp)
+				{
+					continue;
+				}
+
+				const auto vp_data = vp.to_vector<u8>();
+				const auto fp_data = fp.to_vector<u8>();
+
+				m_archive.append(pipeline_archive::record_type::vertex_program, pdata.vertex_program_hash, vp_data.data(), ::size32(vp_data));
+				m_archive.append(pipeline_archive::record_type::fragment_program, pdata.fragment_program_hash, fp_data.data(), ::size32(fp_data));
+
+				if (m_archive.append_pipeline(get_pipeline_key(pdata), pdata.vertex_program_hash, pdata.fragment_program_hash, &pdata, sizeof(pdata)))
+				{
+					count++;
+				}
+			}
+
+			rsx_log.notice("shaders_cache: imported %u pipelines from %s", count, directory_path);
+			fs::remove_all(directory_path);
+
+			// Raw programs are shared by the legacy caches of all renderers
+			bool legacy_found = false;
 
-					if (fs::stat_t s{}; !fs::get_stat(vp_name, s) || s.size != item.vp.data.size() * sizeof(u32))
+			for (auto&& class_entry : fs::dir(root_path + "pipelines"))
+			{
+				if (!class_entry.is_directory || class_entry.name == "." || class_entry.name == "..")
+				{
+					continue;
+				}
+
+				for (auto&& entry : fs::dir(root_path + "pipelines/" + class_entry.name))
+				{
+					if (entry.is_directory && entry.name != "." && entry.name != "..")
 					{
-						fs::write_pending_file(vp_name, item.vp.data);
+						legacy_found = true;
 					}
-
-					const u32 state_params[] =
-						{
-							data.vp_ctrl0,
-							data.vp_ctrl1,
-							data.fp_ctrl,
-							data.vp_texture_dimensions,
-							data.fp_texture_dimensions,
-							data.fp_texcoord_control,
-							data.fp_height,
-							data.fp_pixel_layout,
-							data.fp_lighting_flags,
-							data.fp_shadow_textures,
-							data.fp_redirected_textures,
-							data.vp_multisampled_textures,
-							data.fp_multisampled_textures,
-							data.fp_mrt_count,
-					};
-					const usz state_hash = rpcs3::hash_array(state_params);
-
-					const std::string pipeline_file_name = fmt::format("%llX+%llX+%llX+%llX.bin", data.vertex_program_hash, data.fragment_program_hash, data.pipeline_storage_hash, state_hash);
-					const std::string pipeline_path = root_path + "/pipelines/" + pipeline_class_name + "/" + version_prefix + "/" + pipeline_file_name;
-					fs::write_pending_file(pipeline_path, &data, sizeof(data));
 				}
-			});
+			}
+
+			if (!legacy_found)
+			{
+				fs::remove_all(root_path + "raw");
+			}
+
+			return count;
+		}
 
 		static std::string get_message(u32 index, u32 processed, u32 entry_count)
 		{
 			return fmt::format("%s pipeline object %u of %u", index == 0 ? "Loading" : "Compiling", processed, entry_count);
 		}
 
-		void load_shaders(uint nb_workers, unpacked_type& unpacked, std::string& directory_path, std::vector<fs::dir_entry>& entries, u32 entry_count,
+		void load_shaders(uint nb_workers, unpacked_type& unpacked, const std::vector<pipeline_archive::pipeline_entry>& entries, u32 entry_count,
 			shader_loading_dialog* dlg)
 		{
 			atomic_t<u32> processed(0);
@@ -168,27 +252,11 @@ namespace rsx
 
 				for (u32 pos = start_at; pos < stop_at; ++pos)
 				{
-					const fs::dir_entry& tmp = entries[pos];
 					thread_processed++;
 
-					const auto filename = directory_path + "/" + tmp.name;
-					fs::file f(filename);
-
-					if (!f)
-					{
-						fs::remove_file(filename);
-						continue;
-					}
-
-					if (f.size() != sizeof(pipeline_data))
-					{
-						rsx_log.error("Removing cached pipeline object %s since it's not binary compatible with the current shader cache", tmp.name.c_str());
-						fs::remove_file(filename);
-						continue;
-					}
-
+					// The size is validated by the archive
 					pipeline_data pdata{};
-					f.read(&pdata, f.size());
+					std::memcpy(&pdata, entries[pos].data.data(), sizeof(pdata));
 
 					auto entry = unpack(pdata);
 
@@ -285,19 +353,18 @@ namespace rsx
 			}
 			else
 			{
-				named_thread_group workers("RSX Worker ", nb_workers, [&](u32 thread_index)
-					{
-						if (nb_workers == entry_count)
-						{
-							worker(thread_index, thread_index + 1);
-							return;
-						}
+				utils::task_group workers("RSX shader cache", utils::task_lane::high);
 
-						auto per_thread_entries = entry_count / nb_workers;
-						auto start_at = per_thread_entries * thread_index;
-						auto stop_at = thread_index == nb_workers - 1 ? entry_count : start_at + per_thread_entries;
-						worker(start_at, stop_at);
-					});
+				// Entries are submitted in short batches, so the executor workers stay available to other subsystems
+				const u32 batch_size = std::clamp<u32>(entry_count / (nb_workers * 16), 1, 64);
+
+				for (u32 start_at = 0; start_at < entry_count; start_at += batch_size)
+				{
+					workers.run([&worker, start_at, stop_at = std::min(start_at + batch_size, entry_count)]()
+						{
+							worker(start_at, stop_at);
+						});
+				}
 
 				u32 current_progress = 0;
 				u32 last_update_progress = 0;
@@ -317,6 +384,11 @@ namespace rsx
 						dlg->set_value(step, current_progress);
 					}
 				}
+
+				if (Emu.IsStopped())
+				{
+					workers.cancel();
+				}
 			}
 
 			if (!Emu.IsStopped())
@@ -357,36 +429,35 @@ namespace rsx
 				return;
 			}
 
-			std::string directory_path = root_path + "/pipelines/" + pipeline_class_name + "/" + version_prefix;
+			fs::create_path(root_path + "pipelines/" + pipeline_class_name);
 
-			fs::dir root = fs::dir(directory_path);
-
-			if (!root)
+			if (!m_archive.open(get_archive_path(), sizeof(pipeline_data)))
 			{
-				fs::create_path(directory_path);
-				fs::create_path(root_path + "/raw");
 				return;
 			}
 
-			std::vector<fs::dir_entry> entries;
+			bool needs_compaction = m_archive.wasted() != 0;
 
-			for (auto&& entry : root)
+			if (const std::string legacy_path = root_path + "pipelines/" + pipeline_class_name + "/" + version_prefix; fs::is_dir(legacy_path))
 			{
-				if (entry.is_directory)
-					continue;
+				needs_compaction |= import_legacy_cache(legacy_path) != 0;
+			}
 
-				if (entry.name.ends_with(".bin"))
-				{
-					entries.push_back(std::move(entry));
-				}
+			if (needs_compaction)
+			{
+				// Done before loading, the view must not be in use
+				m_archive.compact();
 			}
 
+			const auto& entries = m_archive.pipelines();
+
 			u32 entry_count = ::size32(entries);
 
 			if (!entry_count)
+			{
+				m_archive.release_view();
 				return;
-
-			root.rewind();
+			}
 
 			// Progress dialog
 			std::unique_ptr<shader_loading_dialog> fallback_dlg;
@@ -406,13 +477,16 @@ namespace rsx
 			unpacked_type unpacked;
 			uint nb_workers = g_cfg.video.renderer == video_renderer::vulkan ? utils::get_thread_count() * 2 : 1;
 
-			load_shaders(nb_workers, unpacked, directory_path, entries, entry_count, dlg);
+			load_shaders(nb_workers, unpacked, entries, entry_count, dlg);
 
 			// Account for any invalid entries
 			entry_count = unpacked.size();
 
 			compile_shaders(nb_workers, unpacked, entry_count, dlg, std::forward<Args>(args)...);
 
+			// Program ucode was copied during unpacking
+			m_archive.release_view();
+
 			dlg->refresh();
 			dlg->close();
 		}
@@ -457,20 +531,20 @@ namespace rsx
 		{
 			RSXVertexProgram vp = {};
 
-			fs::file f(fmt::format("%s/raw/%llX.vp", root_path, program_hash));
-			if (f)
-				f.read(vp.data, f.size() / sizeof(u32));
+			const auto data = m_archive.find(pipeline_archive::record_type::vertex_program, program_hash);
+			vp.data.resize(data.size() / sizeof(u32));
+			std::memcpy(vp.data.data(), data.data(), vp.data.size() * sizeof(u32));
 
 			return vp;
 		}
 
 		RSXFragmentProgram load_fp_raw(u64 program_hash)
 		{
-			fs::file f(fmt::format("%s/raw/%llX.fp", root_path, program_hash));
+			const auto data = m_archive.find(pipeline_archive::record_type::fragment_program, program_hash);
 
 			RSXFragmentProgram fp = {};
 
-			const u32 size = fp.ucode_length = f ? ::size32(f) : 0;
+			const u32 size = fp.ucode_length = ::size32(data);
 
 			if (!size)
 			{
@@ -479,7 +553,7 @@ namespace rsx
 
 			auto buf = std::make_unique<u8[]>(size);
 			fp.data = buf.get();
-			f.read(buf.get(), size);
+			std::memcpy(buf.get(), data.data(), size);
 			fragment_program_data[fragment_program_data.push_begin()] = std::move(buf);
 			return fp;
 		}
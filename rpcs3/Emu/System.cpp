@@ -1015,7 +1015,7 @@ game_boot_result Emulator::BootGame(std::string path, const std::string& title_i
 		fs::file file(path);
 		if (getFileType(file) == FileType::Iso)
 		{
-			shared_ptr<fs::device_base> iso_device = stx::make_shared<iso_dev>(*ensure(iso_dev::open(std::make_unique<file_block_dev>(std::move(file)))));
+			shared_ptr<fs::device_base> iso_device = stx::make_shared<iso_dev>(*ensure(iso_dev::open(std::make_unique<cached_block_dev>(std::make_unique<file_block_dev>(std::move(file))))));
 
 			auto mount_path = iso_device->fs_prefix + "/";
 			sys_log.notice("Mounting iso: '%s' -> '%s'", path, mount_path);
@@ -6,9 +6,11 @@
 #include "rx/tsc.hpp"
 #include "util/Thread.h"
 #include "util/mutex.h"
+#include "util/File.h"
 
 #include <map>
 #include <mutex>
+#include <set>
 
 void perf_stat_base::push(u64 ns[66]) noexcept
 {
@@ -92,14 +94,164 @@ perf_stat_base::push(u64 data[66], u64 start_time, const char* name) noexcept
 	data[0] += ns != 0;
 	data[64 - std::countl_zero(ns)]++;
 	data[65] += ns;
+
+	if (g_cfg.core.perf_trace != perf_trace_format::disabled) [[unlikely]]
+	{
+		trace(name, start_time, end_time);
+	}
 }
 
+namespace
+{
+	// Most recent events of a thread, only written by the owner
+	struct perf_trace_ring
+	{
+		static constexpr u64 capacity = 8192;
+
+		std::unique_ptr<perf_trace_event[]> events = std::make_unique<perf_trace_event[]>(capacity);
+
+		// Number of recorded events
+		atomic_t<u64> head = 0;
+
+		// Number of collected or lost events (protected by s_perf_mutex)
+		u64 tail = 0;
+
+		u32 thread_id = 0;
+
+		const std::string thread_name = thread_ctrl::get_name();
+
+		perf_trace_ring() noexcept;
+
+		~perf_trace_ring();
+	};
+
+	// Trace events collected from a thread
+	struct perf_trace_thread
+	{
+		std::string name;
+		std::vector<perf_trace_event> events;
+		u64 lost = 0;
+	};
+
+	// Binary trace format: header, stats, then threads with their events
+	struct perf_trace_header
+	{
+		u64 magic;
+		u32 version;
+		u32 thread_count;
+		u64 tsc_freq;
+		u32 stat_count;
+		u32 reserved;
+	};
+
+	struct perf_trace_stat
+	{
+		char name[8];
+		u64 events;
+		u64 total_ns;
+		u64 histogram[64];
+	};
+
+	struct perf_trace_thread_header
+	{
+		u32 thread_id;
+		u32 name_size;
+		u64 event_count;
+		u64 lost;
+	};
+
+	struct perf_trace_record
+	{
+		char name[8];
+		u64 start;
+		u64 end;
+	};
+
+	constexpr u64 c_perf_trace_magic = "RPCSPERF"_u64;
+	constexpr u32 c_perf_trace_version = 1;
+} // namespace
+
 static shared_mutex s_perf_mutex;
 
 static std::map<std::string, perf_stat_base> s_perf_acc;
 
 static std::multimap<std::string, u64*> s_perf_sources;
 
+static std::set<perf_trace_ring*> s_perf_rings;
+
+static std::map<u32, perf_trace_thread> s_perf_trace;
+
+static u32 s_perf_trace_threads = 0;
+
+static thread_local std::unique_ptr<perf_trace_ring> g_tls_perf_trace;
+
+// Move new events of the ring to s_perf_trace (s_perf_mutex must be locked)
+static void collect_trace(perf_trace_ring& ring)
+{
+	const u64 head = ring.head.load();
+	const u64 begin = std::max(ring.tail, head > ring.capacity ? head - ring.capacity : 0);
+
+	auto& out = s_perf_trace[ring.thread_id];
+	out.name = ring.thread_name;
+
+	const usz old_size = out.events.size();
+
+	for (u64 i = begin; i < head; i++)
+	{
+		out.events.push_back(ring.events[i % ring.capacity]);
+	}
+
+	atomic_fence_acquire();
+
+	// Discard events which could be overwritten while copying
+	const u64 new_head = ring.head.load();
+	const u64 valid = std::min(head, new_head >= ring.capacity ? new_head - ring.capacity + 1 : 0);
+
+	if (valid > begin)
+	{
+		out.events.erase(out.events.begin() + old_size, out.events.begin() + old_size + (valid - begin));
+	}
+
+	out.lost += std::max(begin, valid) - ring.tail;
+	ring.tail = head;
+}
+
+perf_trace_ring::perf_trace_ring() noexcept
+{
+	std::lock_guard lock(s_perf_mutex);
+
+	thread_id = ++s_perf_trace_threads;
+	s_perf_rings.emplace(this);
+}
+
+perf_trace_ring::~perf_trace_ring()
+{
+	std::lock_guard lock(s_perf_mutex);
+
+	collect_trace(*this);
+	s_perf_rings.erase(this);
+}
+
+void perf_stat_base::trace(const char* name, u64 start_time, u64 end_time) noexcept
+{
+	if (!g_tls_perf_trace) [[unlikely]]
+	{
+		// Don't attempt to register some foreign/unnamed threads
+		if (!thread_ctrl::get_current())
+		{
+			return;
+		}
+
+		g_tls_perf_trace = std::make_unique<perf_trace_ring>();
+	}
+
+	auto& ring = *g_tls_perf_trace;
+
+	const u64 pos = ring.head.observe();
+	ring.events[pos % ring.capacity] = {name, start_time, end_time};
+	ring.head.release(pos + 1);
+}
+
 void perf_stat_base::add(u64 ns[66], const char* name) noexcept
 {
 	// Don't attempt to register some foreign/unnamed threads
@@ -156,3 +308,199 @@ void perf_stat_base::report() noexcept
 
 	perf_log.notice("Performance report end.");
 }
+
+std::vector<perf_stat_snapshot> perf_stat_base::snapshot(bool reset)
+{
+	std::lock_guard lock(s_perf_mutex);
+
+	for (auto& [name, ns] : s_perf_sources)
+	{
+		s_perf_acc[name].push(ns);
+	}
+
+	std::vector<perf_stat_snapshot> result;
+
+	for (auto& [name, data] : s_perf_acc)
+	{
+		if (!data.m_log[0])
+		{
+			continue;
+		}
+
+		auto& stat = result.emplace_back();
+		stat.name = name;
+		stat.events = data.m_log[0];
+		stat.total_ns = data.m_log[65];
+
+		for (u32 i = 0; i < 64; i++)
+		{
+			stat.histogram[i] = data.m_log[i + 1];
+		}
+	}
+
+	if (reset)
+	{
+		s_perf_acc.clear();
+	}
+
+	return result;
+}
+
+static void append_json_string(std::string& out, std::string_view str)
+{
+	out += '"';
+
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (static_cast<u8>(c) < 0x20)
+		{
+			fmt::append(out, "\\u%04x", static_cast<u8>(c));
+		}
+		else
+		{
+			out += c;
+		}
+	}
+
+	out += '"';
+}
+
+bool perf_stat_base::export_trace(const std::string& path, perf_trace_format format)
+{
+	std::map<u32, perf_trace_thread> threads;
+
+	{
+		std::lock_guard lock(s_perf_mutex);
+
+		for (perf_trace_ring* ring : s_perf_rings)
+		{
+			collect_trace(*ring);
+		}
+
+		threads = std::move(s_perf_trace);
+		s_perf_trace.clear();
+	}
+
+	const auto stats = snapshot(false);
+	const u64 tsc_freq = utils::get_tsc_freq();
+
+	u64 event_count = 0;
+	u64 base_time = umax;
+
+	for (const auto& [id, thread] : threads)
+	{
+		event_count += thread.events.size();
+
+		for (const auto& event : thread.events)
+		{
+			base_time = std::min(base_time, event.start);
+		}
+	}
+
+	bool result = false;
+
+	if (format == perf_trace_format::chrome_json)
+	{
+		// Timestamps are in microseconds since the first event
+		const auto to_us = [&](u64 tsc)
+		{
+			return static_cast<f64>(tsc) * 1000'000. / tsc_freq;
+		};
+
+		std::string json = "{\"traceEvents\":[";
+		bool first = true;
+
+		for (const auto& [id, thread] : threads)
+		{
+			fmt::append(json, "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", first ? "" : ",", id);
+			append_json_string(json, thread.name);
+			fmt::append(json, ",\"lost_events\":%u}}", thread.lost);
+			first = false;
+
+			for (const auto& event : thread.events)
+			{
+				fmt::append(json, ",\n{\"name\":");
+				append_json_string(json, event.name);
+				fmt::append(json, ",\"cat\":\"perf\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", id, to_us(event.start - base_time), to_us(event.end - event.start));
+			}
+		}
+
+		json += "\n],\"otherData\":{";
+		first = true;
+
+		for (const auto& stat : stats)
+		{
+			json += first ? "" : ",";
+			append_json_string(json, stat.name);
+			fmt::append(json, ":\"%u events, total %.4fs\"", stat.events, stat.total_ns / 1000'000'000.);
+			first = false;
+		}
+
+		json += "}}\n";
+
+		result = fs::write_pending_file(path, json);
+	}
+	else if (format == perf_trace_format::binary)
+	{
+		std::vector<u8> data;
+
+		const auto append = [&](const void* ptr, usz size)
+		{
+			data.insert(data.end(), static_cast<const u8*>(ptr), static_cast<const u8*>(ptr) + size);
+		};
+
+		perf_trace_header header{};
+		header.magic = c_perf_trace_magic;
+		header.version = c_perf_trace_version;
+		header.thread_count = ::size32(threads);
+		header.tsc_freq = tsc_freq;
+		header.stat_count = ::size32(stats);
+		append(&header, sizeof(header));
+
+		for (const auto& stat : stats)
+		{
+			perf_trace_stat rec{};
+			std::memcpy(rec.name, stat.name.data(), std::min(stat.name.size(), sizeof(rec.name)));
+			rec.events = stat.events;
+			rec.total_ns = stat.total_ns;
+			std::memcpy(rec.histogram, stat.histogram, sizeof(rec.histogram));
+			append(&rec, sizeof(rec));
+		}
+
+		for (const auto& [id, thread] : threads)
+		{
+			perf_trace_thread_header rec{};
+			rec.thread_id = id;
+			rec.name_size = ::size32(thread.name);
+			rec.event_count = thread.events.size();
+			rec.lost = thread.lost;
+			append(&rec, sizeof(rec));
+			append(thread.name.data(), thread.name.size());
+
+			for (const auto& event : thread.events)
+			{
+				perf_trace_record record{};
+				std::memcpy(record.name, event.name, std::min(std::strlen(event.name), sizeof(record.name)));
+				record.start = event.start;
+				record.end = event.end;
+				append(&record, sizeof(record));
+			}
+		}
+
+		result = fs::write_pending_file(path, data);
+	}
+
+	if (!result)
+	{
+		perf_log.error("Failed to export performance trace to %s (%s)", path, fs::g_tls_error);
+		return false;
+	}
+
+	perf_log.notice("Performance trace: %u events of %u threads exported to %s", event_count, threads.size(), path);
+	return true;
+}
@@ -6,6 +6,8 @@
 #include "system_config.h"
 #include <array>
 #include <cmath>
+#include <string>
+#include <vector>
 
 LOG_CHANNEL(perf_log, "PERF");
 
@@ -19,6 +21,23 @@ inline const auto perf_name = []
 	return result;
 }();
 
+// Accumulated stats of an event
+struct perf_stat_snapshot
+{
+	std::string name;
+	u64 events;
+	u64 total_ns;
+	u64 histogram[64]; // Event count by the bit length of its duration in ns
+};
+
+// perf_meter scope recorded by the trace
+struct perf_trace_event
+{
+	const char* name;
+	u64 start; // TSC
+	u64 end;   // TSC
+};
+
 class perf_stat_base
 {
 	atomic_t<u64> m_log[66]{};
@@ -39,6 +58,9 @@ protected:
 	// Unregister TLS storage and drain its data
 	static void remove(u64 ns[66], const char* name) noexcept;
 
+	// Record the event in the trace ring of the current thread
+	static void trace(const char* name, u64 start_time, u64 end_time) noexcept;
+
 public:
 	perf_stat_base() noexcept = default;
 
@@ -50,6 +72,12 @@ public:
 
 	// Collect all data, report it, and clean
 	static void report() noexcept;
+
+	// Collect all data without reporting, optionally clean
+	static std::vector<perf_stat_snapshot> snapshot(bool reset);
+
+	// Write the recorded trace events (which are then discarded) and the current stats
+	static bool export_trace(const std::string& path, perf_trace_format format);
 };
 
 // Object that prints event length stats at the end
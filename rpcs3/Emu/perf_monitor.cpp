@@ -3,10 +3,10 @@
 
 #include "Emu/System.h"
 #include "Emu/Cell/timers.hpp"
+#include "Emu/perf_meter.hpp"
 #include "util/cpu_stats.hpp"
 #include "util/Thread.h"
-
-LOG_CHANNEL(perf_log, "PERF");
+#include "util/date_time.h"
 
 void perf_monitor::operator()()
 {
@@ -23,6 +23,22 @@ void perf_monitor::operator()()
 	std::vector<double> per_core_usage;
 	std::string msg;
 
+	u64 report_elapsed_us = 0;
+	bool trace_exported = false;
+
+	const auto export_trace = []()
+	{
+		const perf_trace_format format = g_cfg.core.perf_trace;
+		const std::string dir = fs::get_log_dir() + "perf_traces/";
+
+		if (format == perf_trace_format::disabled || !fs::create_path(dir))
+		{
+			return;
+		}
+
+		perf_stat_base::export_trace(dir + Emu.GetTitleID() + "_" + date_time::current_time_narrow() + (format == perf_trace_format::chrome_json ? ".json" : ".bin"), format);
+	};
+
 	for (u64 sleep_until = get_system_time(); thread_ctrl::state() != thread_state::aborting;)
 	{
 		thread_ctrl::wait_until(&sleep_until, update_interval_us);
@@ -33,6 +49,30 @@ void perf_monitor::operator()()
 			break;
 		}
 
+		if (g_cfg.core.perf_report)
+		{
+			report_elapsed_us += update_interval_us;
+
+			// Periodic snapshot of perf_meter stats
+			if (const u64 interval = g_cfg.core.perf_report_interval; interval && report_elapsed_us >= interval * 1000000)
+			{
+				report_elapsed_us = 0;
+				export_trace();
+				perf_stat_base::report();
+			}
+
+			// Export the recent events when paused (e.g. after a hitch)
+			if (!Emu.IsPaused())
+			{
+				trace_exported = false;
+			}
+			else if (!trace_exported)
+			{
+				trace_exported = true;
+				export_trace();
+			}
+		}
+
 		double total_usage = 0.0;
 
 		stats.get_per_core_usage(per_core_usage, total_usage);
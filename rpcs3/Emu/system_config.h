@@ -119,8 +119,12 @@ struct cfg_root : cfg::node
 #endif
 		cfg::_int<-1000, 1500> usleep_addend{this, "Usleep Time Addend", 0, true};
 
+		cfg::uint<0, 65536> font_glyph_cache_size{this, "Font Glyph Cache Size (KB)", 4096, true}; // Memory budget of rasterized cellFont glyphs, 0 = disabled
+
 		cfg::uint64 perf_report_threshold{this, "Performance Report Threshold", 500, true}; // In µs, 0.5ms = default, 0 = everything
 		cfg::_bool perf_report{this, "Enable Performance Report", false, true};             // Show certain perf-related logs
+		cfg::uint<0, 3600> perf_report_interval{this, "Performance Report Interval", 0, true}; // In seconds, 0 = report on resume and stop only
+		cfg::_enum<perf_trace_format> perf_trace{this, "Performance Trace", perf_trace_format::disabled, true}; // Record perf_meter scopes, exported on pause and with periodic reports
 		cfg::_bool external_debugger{this, "Assume External Debugger"};
 	} core{this};
 
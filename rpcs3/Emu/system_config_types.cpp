@@ -717,3 +717,19 @@ void fmt_class_string<xfloat_accuracy>::format(std::string& out, u64 arg)
 			return unknown;
 		});
 }
+
+template <>
+void fmt_class_string<perf_trace_format>::format(std::string& out, u64 arg)
+{
+	format_enum(out, arg, [](perf_trace_format value)
+		{
+			switch (value)
+			{
+			case perf_trace_format::disabled: return "Disabled";
+			case perf_trace_format::chrome_json: return "Chrome Trace JSON";
+			case perf_trace_format::binary: return "Binary";
+			}
+
+			return unknown;
+		});
+}
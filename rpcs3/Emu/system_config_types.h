@@ -355,3 +355,10 @@ enum class xfloat_accuracy
 	relaxed, // Approximate accuracy for only the "FCGT", "FNMS", "FREST" AND "FRSQEST" instructions
 	inaccurate
 };
+
+enum class perf_trace_format
+{
+	disabled,
+	chrome_json,
+	binary,
+};
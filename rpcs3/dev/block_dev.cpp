@@ -0,0 +1,165 @@
+#include "block_dev.hpp"
+#include "util/logs.hpp"
+#include <algorithm>
+#include <cstring>
+
+LOG_CHANNEL(block_dev_log, "BlockDev");
+
+cached_block_dev::cached_block_dev(std::unique_ptr<block_dev> device, std::size_t cache_size, std::size_t readahead_size)
+	: m_dev(std::move(device))
+{
+	set_block_info(m_dev->block_size(), m_dev->block_count());
+
+	m_cluster_blocks = std::max<std::size_t>(cluster_size / block_size(), 1);
+	m_clusters_per_shard = std::max<std::size_t>(cache_size / (m_cluster_blocks * block_size()) / shard_count, 1);
+	m_readahead_clusters = readahead_size / (m_cluster_blocks * block_size());
+	m_uncached_blocks = m_clusters_per_shard * shard_count * m_cluster_blocks / 4;
+	m_shards = std::make_unique<shard[]>(shard_count);
+}
+
+cached_block_dev::~cached_block_dev()
+{
+	const auto stats = get_stats();
+
+	if (const u64 lookups = stats.hits + stats.misses)
+	{
+		block_dev_log.notice("Block cache: %u hits, %u misses (%u%% hit rate), %u device reads, %u KiB read", stats.hits, stats.misses, stats.hits * 100 / lookups, stats.device_reads, stats.device_bytes / 1024);
+	}
+}
+
+cached_block_dev::stats_t cached_block_dev::get_stats() const
+{
+	return {
+		.hits = m_hits,
+		.misses = m_misses,
+		.device_reads = m_device_reads,
+		.device_bytes = m_device_bytes,
+	};
+}
+
+bool cached_block_dev::read_cached(std::size_t clusterIndex, std::size_t firstBlock, std::size_t blockCount, std::byte* data)
+{
+	auto& shard = m_shards[clusterIndex % shard_count];
+	std::lock_guard lock(shard.mutex);
+
+	const auto found = shard.clusters.find(clusterIndex);
+
+	if (found == shard.clusters.end() || found->second->block_count < firstBlock + blockCount)
+	{
+		return false;
+	}
+
+	shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+	std::memcpy(data, found->second->data.get() + firstBlock * block_size(), blockCount * block_size());
+	return true;
+}
+
+void cached_block_dev::insert(std::size_t clusterIndex, const std::byte* data, std::size_t blockCount)
+{
+	auto& shard = m_shards[clusterIndex % shard_count];
+	std::lock_guard lock(shard.mutex);
+
+	if (auto found = shard.clusters.find(clusterIndex); found != shard.clusters.end())
+	{
+		// Loaded by another thread meanwhile
+		shard.lru.splice(shard.lru.begin(), shard.lru, found->second);
+		return;
+	}
+
+	std::unique_ptr<std::byte[]> buffer;
+
+	if (shard.clusters.size() >= m_clusters_per_shard)
+	{
+		// Reuse the memory of the evicted cluster
+		buffer = std::move(shard.lru.back().data);
+		shard.clusters.erase(shard.lru.back().index);
+		shard.lru.pop_back();
+	}
+	else
+	{
+		buffer = std::make_unique<std::byte[]>(m_cluster_blocks * block_size());
+	}
+
+	std::memcpy(buffer.get(), data, blockCount * block_size());
+	shard.lru.push_front({clusterIndex, blockCount, std::move(buffer)});
+	shard.clusters.emplace(clusterIndex, shard.lru.begin());
+}
+
+std::size_t cached_block_dev::read(std::size_t blockIndex, void* data, std::size_t blockCount)
+{
+	if (blockIndex >= block_count())
+	{
+		return 0;
+	}
+
+	blockCount = std::min(blockCount, block_count() - blockIndex);
+
+	if (blockCount > m_uncached_blocks)
+	{
+		// Would evict most of the cache
+		m_next_block = blockIndex + blockCount;
+		m_device_reads++;
+
+		const std::size_t result = m_dev->read(blockIndex, data, blockCount);
+		m_device_bytes += result * block_size();
+		return result;
+	}
+
+	const bool is_sequential = m_next_block.exchange(blockIndex + blockCount) == blockIndex;
+	const auto output = static_cast<std::byte*>(data);
+
+	std::vector<std::byte> buffer;
+	std::size_t result = 0;
+
+	while (result < blockCount)
+	{
+		const std::size_t block = blockIndex + result;
+		const std::size_t cluster_index = block / m_cluster_blocks;
+		const std::size_t cluster_offset = block % m_cluster_blocks;
+		const std::size_t count = std::min(m_cluster_blocks - cluster_offset, blockCount - result);
+
+		if (read_cached(cluster_index, cluster_offset, count, output + result * block_size()))
+		{
+			m_hits++;
+			result += count;
+			continue;
+		}
+
+		m_misses++;
+
+		// Load the rest of the request at once, extended by readahead when the
+		// device is read sequentially
+		const std::size_t request_end = blockIndex + blockCount;
+		std::size_t load_end = (request_end + m_cluster_blocks - 1) / m_cluster_blocks;
+
+		if (is_sequential)
+		{
+			load_end += m_readahead_clusters;
+		}
+
+		const std::size_t load_first = cluster_index * m_cluster_blocks;
+		const std::size_t load_blocks = std::min(load_end * m_cluster_blocks, block_count()) - load_first;
+
+		buffer.resize(load_blocks * block_size());
+		const std::size_t loaded = m_dev->read(load_first, buffer.data(), load_blocks);
+
+		m_device_reads++;
+		m_device_bytes += loaded * block_size();
+
+		for (std::size_t offset = 0; offset < loaded; offset += m_cluster_blocks)
+		{
+			insert(cluster_index + offset / m_cluster_blocks, buffer.data() + offset * block_size(), std::min(m_cluster_blocks, loaded - offset));
+		}
+
+		const std::size_t available = loaded > cluster_offset ? std::min(loaded - cluster_offset, blockCount - result) : 0;
+		std::memcpy(output + result * block_size(), buffer.data() + cluster_offset * block_size(), available * block_size());
+		result += available;
+
+		if (loaded < load_blocks)
+		{
+			break;
+		}
+	}
+
+	return result;
+}
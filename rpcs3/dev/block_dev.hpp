@@ -1,8 +1,14 @@
 #pragma once
 
 #include "util/File.h"
+#include "util/atomic.hpp"
+#include "util/mutex.h"
 #include <cstddef>
+#include <list>
+#include <memory>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 class block_dev
 {
@@ -104,3 +110,70 @@ public:
 		return result / block_size();
 	}
 };
+
+// Read-only cache of the underlying device. Blocks are cached in clusters,
+// spread over independently locked LRU shards. Sequential reads fetch the
+// following clusters in the same request to the underlying device.
+class cached_block_dev final : public block_dev
+{
+public:
+	static constexpr std::size_t shard_count = 16;
+	static constexpr std::size_t cluster_size = 64 * 1024;
+
+	struct stats_t
+	{
+		u64 hits;
+		u64 misses;
+		u64 device_reads;
+		u64 device_bytes;
+	};
+
+	explicit cached_block_dev(std::unique_ptr<block_dev> device,
+		std::size_t cache_size = 64 * 1024 * 1024,
+		std::size_t readahead_size = 1024 * 1024);
+
+	~cached_block_dev() override;
+
+	std::size_t read(std::size_t blockIndex, void* data,
+		std::size_t blockCount) override;
+
+	std::size_t write(std::size_t, const void*, std::size_t) override
+	{
+		return 0;
+	}
+
+	stats_t get_stats() const;
+
+private:
+	struct cluster
+	{
+		std::size_t index;
+		std::size_t block_count;
+		std::unique_ptr<std::byte[]> data;
+	};
+
+	struct shard
+	{
+		shared_mutex mutex;
+		std::list<cluster> lru; // Most recently used first
+		std::unordered_map<std::size_t, std::list<cluster>::iterator> clusters;
+	};
+
+	bool read_cached(std::size_t clusterIndex, std::size_t firstBlock,
+		std::size_t blockCount, std::byte* data);
+	void insert(std::size_t clusterIndex, const std::byte* data,
+		std::size_t blockCount);
+
+	std::unique_ptr<block_dev> m_dev;
+	std::size_t m_cluster_blocks;
+	std::size_t m_clusters_per_shard;
+	std::size_t m_readahead_clusters;
+	std::size_t m_uncached_blocks;
+	std::unique_ptr<shard[]> m_shards;
+
+	atomic_t<std::size_t> m_next_block = 0;
+	atomic_t<u64> m_hits = 0;
+	atomic_t<u64> m_misses = 0;
+	atomic_t<u64> m_device_reads = 0;
+	atomic_t<u64> m_device_bytes = 0;
+};
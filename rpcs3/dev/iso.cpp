@@ -8,6 +8,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <memory>
 #include <string>
@@ -58,6 +59,120 @@ static std::string decodeString(std::string_view data,
 	return std::string(data);
 }
 
+namespace
+{
+	// Reads the file extent from the device on demand
+	class iso_file final : public fs::file_base
+	{
+		std::shared_ptr<block_dev> m_dev;
+		fs::stat_t m_stat;
+		u64 m_first_block;
+		u64 m_pos = 0;
+
+	public:
+		iso_file(std::shared_ptr<block_dev> dev, const iso::DirEntry& entry)
+			: m_dev(std::move(dev)), m_stat(entry.to_fs_stat()), m_first_block(entry.lba.value())
+		{
+		}
+
+		fs::stat_t get_stat() override
+		{
+			return m_stat;
+		}
+
+		bool trunc(u64) override
+		{
+			fs::g_tls_error = fs::error::acces;
+			return false;
+		}
+
+		u64 read(void* buffer, u64 size) override
+		{
+			const u64 result = read_at(m_pos, buffer, size);
+			m_pos += result;
+			return result;
+		}
+
+		u64 read_at(u64 offset, void* buffer, u64 size) override
+		{
+			if (offset >= m_stat.size)
+			{
+				return 0;
+			}
+
+			size = std::min<u64>(size, m_stat.size - offset);
+
+			const u64 block_size = m_dev->block_size();
+			const auto output = static_cast<u8*>(buffer);
+			std::vector<u8> temp;
+			u64 result = 0;
+
+			while (result < size)
+			{
+				const u64 block = m_first_block + (offset + result) / block_size;
+				const u64 block_offset = (offset + result) % block_size;
+
+				if (block_offset == 0 && size - result >= block_size)
+				{
+					// Whole blocks are read into the destination
+					const u64 count = (size - result) / block_size;
+					const u64 read_count = m_dev->read(block, output + result, count);
+					result += read_count * block_size;
+
+					if (read_count < count)
+					{
+						break;
+					}
+
+					continue;
+				}
+
+				temp.resize(block_size);
+
+				if (m_dev->read(block, temp.data(), 1) != 1)
+				{
+					break;
+				}
+
+				const u64 count = std::min(block_size - block_offset, size - result);
+				std::memcpy(output + result, temp.data() + block_offset, count);
+				result += count;
+			}
+
+			return result;
+		}
+
+		u64 write(const void*, u64) override
+		{
+			fs::g_tls_error = fs::error::acces;
+			return 0;
+		}
+
+		u64 seek(s64 offset, fs::seek_mode whence) override
+		{
+			const s64 new_pos =
+				whence == fs::seek_set ? offset :
+				whence == fs::seek_cur ? offset + m_pos :
+				whence == fs::seek_end ? offset + m_stat.size :
+										 -1;
+
+			if (new_pos < 0)
+			{
+				fs::g_tls_error = fs::error::inval;
+				return -1;
+			}
+
+			m_pos = new_pos;
+			return m_pos;
+		}
+
+		u64 size() override
+		{
+			return m_stat.size;
+		}
+	};
+} // namespace
+
 bool iso_dev::initialize()
 {
 	constexpr std::size_t primaryVolumeDescOffset = 16;
@@ -167,7 +282,7 @@ std::unique_ptr<fs::file_base> iso_dev::open(const std::string& path, rx::EnumBi
 		return {};
 	}
 
-	return read_file(*optEntry).release();
+	return read_file(*optEntry);
 }
 
 std::unique_ptr<fs::dir_base> iso_dev::open_dir(const std::string& path)
@@ -365,7 +480,7 @@ iso_dev::read_dir(const iso::DirEntry& entry)
 	return {std::move(isoEntries), std::move(names)};
 }
 
-fs::file iso_dev::read_file(const iso::DirEntry& entry)
+std::unique_ptr<fs::file_base> iso_dev::read_file(const iso::DirEntry& entry)
 {
 	if ((entry.flags & iso::DirEntryFlags::Directory) ==
 		iso::DirEntryFlags::Directory)
@@ -373,21 +488,5 @@ fs::file iso_dev::read_file(const iso::DirEntry& entry)
 		return {};
 	}
 
-	if (entry.length.value() == 0)
-	{
-		return fs::make_stream<std::vector<std::uint8_t>>();
-	}
-
-	auto block_size = m_dev->block_size();
-	auto block_count = (entry.length.value() + block_size - 1) / block_size;
-
-	std::vector<std::uint8_t> data;
-	data.resize(block_count * block_size);
-	if (!m_dev->read(entry.lba.value(), data.data(), block_count))
-	{
-		return {};
-	}
-
-	data.resize(entry.length.value());
-	return fs::make_stream(std::move(data), entry.to_fs_stat());
+	return std::make_unique<iso_file>(m_dev, entry);
 }
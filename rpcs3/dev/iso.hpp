@@ -5,6 +5,7 @@
 #include "util/endian.hpp"
 #include "util/types.hpp"
 #include <bit>
+#include <memory>
 #include <optional>
 #include <string_view>
 
@@ -208,7 +209,7 @@ namespace iso
 
 class iso_dev final : public fs::device_base
 {
-	std::unique_ptr<block_dev> m_dev;
+	std::shared_ptr<block_dev> m_dev;
 	iso::DirEntry m_root_dir;
 	iso::StringEncoding m_encoding = iso::StringEncoding::ascii;
 
@@ -238,5 +239,5 @@ private:
 
 	std::optional<iso::DirEntry> open_entry(std::string_view path);
 	std::pair<std::vector<iso::DirEntry>, std::vector<std::string>> read_dir(const iso::DirEntry& entry);
-	fs::file read_file(const iso::DirEntry& entry);
+	std::unique_ptr<fs::file_base> read_file(const iso::DirEntry& entry);
 };
@@ -542,9 +542,15 @@ public:
 	// Add module (not cached)
 	void add(std::unique_ptr<llvm::Module> _module);
 
+	// Add module (compiled object is copied to the output)
+	void add(std::unique_ptr<llvm::Module> _module, std::vector<u8>& object);
+
 	// Add object (path to obj file)
 	bool add(const std::string& path);
 
+	// Add object (object file in memory)
+	bool add(const std::vector<u8>& object, const std::string& name);
+
 	// Update global mapping for a single value
 	void update_global_mapping(const std::string& name, u64 addr);
 
@@ -511,6 +511,31 @@ public:
 	}
 };
 
+// Helper class, copies the compiled object for external caching
+class ObjectSink final : public llvm::ObjectCache
+{
+	std::vector<u8>& m_object;
+
+public:
+	ObjectSink(std::vector<u8>& object)
+		: m_object(object)
+	{
+	}
+
+	~ObjectSink() override = default;
+
+	void notifyObjectCompiled(const llvm::Module*, llvm::MemoryBufferRef obj) override
+	{
+		const auto data = reinterpret_cast<const u8*>(obj.getBufferStart());
+		m_object.assign(data, data + obj.getBufferSize());
+	}
+
+	std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module*) override
+	{
+		return nullptr;
+	}
+};
+
 std::string jit_compiler::cpu(const std::string& _cpu)
 {
 	std::string m_cpu = _cpu;
@@ -771,6 +796,23 @@ void jit_compiler::add(std::unique_ptr<llvm::Module> _module, const std::string&
 	}
 }
 
+void jit_compiler::add(std::unique_ptr<llvm::Module> _module, std::vector<u8>& object)
+{
+	ObjectSink sink{object};
+	m_engine->setObjectCache(&sink);
+
+	const auto ptr = _module.get();
+	m_engine->addModule(std::move(_module));
+	m_engine->generateCodeForModule(ptr);
+	m_engine->setObjectCache(nullptr);
+
+	for (auto& func : ptr->functions())
+	{
+		// Delete IR to lower memory consumption
+		func.deleteBody();
+	}
+}
+
 void jit_compiler::add(std::unique_ptr<llvm::Module> _module)
 {
 	const auto ptr = _module.get();
@@ -807,6 +849,25 @@ bool jit_compiler::add(const std::string& path)
 	}
 }
 
+bool jit_compiler::add(const std::vector<u8>& object, const std::string& name)
+{
+	auto buf = llvm::WritableMemoryBuffer::getNewUninitMemBuffer(object.size(), name);
+	std::memcpy(buf->getBufferStart(), object.data(), object.size());
+
+	if (auto object_file = llvm::object::ObjectFile::createObjectFile(*buf))
+	{
+		m_engine->addObjectFile(llvm::object::OwningBinary<llvm::object::ObjectFile>(std::move(*object_file), std::move(buf)));
+		jit_log.trace("ObjectCache: Successfully added %s", name);
+		return true;
+	}
+	else
+	{
+		llvm::consumeError(object_file.takeError());
+		jit_log.error("ObjectCache: Adding failed: %s", name);
+		return false;
+	}
+}
+
 bool jit_compiler::check(const std::string& path)
 {
 	if (auto cache = ObjectCache::load(path))
@@ -0,0 +1,341 @@
+#include "util/task_executor.hpp"
+#include "util/Thread.h"
+#include "util/mutex.h"
+#include "util/sysinfo.hpp"
+#include "util/logs.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+LOG_CHANNEL(sys_log, "SYS");
+
+namespace utils
+{
+	// Index of the current worker (umax if the current thread is not a worker)
+	static thread_local u32 g_tls_task_worker = umax;
+
+	static u64 get_time_ns()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	// Accumulated until the next report
+	struct task_subsystem_stats
+	{
+		atomic_t<u64> tasks = 0;
+		atomic_t<u64> wait_ns = 0;
+		atomic_t<u64> exec_ns = 0;
+	};
+
+	struct task_executor::task
+	{
+		std::function<void()> func;
+		task_group* group = nullptr;
+		u64 submit_time = 0;
+		task_lane lane = task_lane::normal;
+	};
+
+	struct task_executor::worker
+	{
+		task_executor* executor;
+
+		void operator()();
+	};
+
+	struct task_executor::state
+	{
+		struct queue
+		{
+			shared_mutex mutex;
+			std::deque<task> lanes[static_cast<usz>(task_lane::count_)];
+		};
+
+		std::unique_ptr<queue[]> queues;
+		u32 queue_count = 0;
+
+		// Number of queued tasks
+		atomic_t<u32> pending = 0;
+
+		// Round-robin placement of tasks submitted by other threads
+		atomic_t<u32> next_queue = 0;
+		atomic_t<u32> next_worker = 0;
+
+		shared_mutex stats_mutex;
+		std::map<std::string, task_subsystem_stats, std::less<>> stats;
+
+		// Must be the last member, it is joined before the rest is destroyed
+		std::unique_ptr<named_thread_group<worker>> workers;
+	};
+
+	void task_executor::worker::operator()()
+	{
+		auto& st = *executor->m_state;
+		g_tls_task_worker = st.next_worker++;
+
+		// Set low priority, only the high lane is latency sensitive
+		thread_ctrl::scoped_priority low_prio(-1);
+
+		while (thread_ctrl::state() != thread_state::aborting)
+		{
+			if (task t; executor->take(t, nullptr))
+			{
+				if (t.lane == task_lane::high)
+				{
+					thread_ctrl::set_native_priority(0);
+					executor->execute(t);
+					thread_ctrl::set_native_priority(-1);
+					continue;
+				}
+
+				executor->execute(t);
+				continue;
+			}
+
+			thread_ctrl::wait_on(st.pending, 0);
+		}
+	}
+
+	task_executor::task_executor()
+		: m_state(std::make_unique<state>())
+	{
+		m_state->queue_count = std::max<u32>(utils::get_thread_count(), 1);
+		m_state->queues = std::make_unique<state::queue[]>(m_state->queue_count);
+		m_state->workers = std::make_unique<named_thread_group<worker>>("Task Worker ", m_state->queue_count, worker{this});
+	}
+
+	task_executor::~task_executor()
+	{
+		// Join workers
+		m_state->workers.reset();
+	}
+
+	task_executor& task_executor::get()
+	{
+		static task_executor s_executor;
+		return s_executor;
+	}
+
+	u32 task_executor::size() const
+	{
+		return m_state->queue_count;
+	}
+
+	void task_executor::push(task&& t, task_lane lane)
+	{
+		auto& st = *m_state;
+
+		// Workers keep their subtasks local, which are then stolen by idle workers if necessary
+		const u32 index = g_tls_task_worker != umax ? g_tls_task_worker : st.next_queue++ % st.queue_count;
+		auto& queue = st.queues[index];
+
+		{
+			std::lock_guard lock(queue.mutex);
+			queue.lanes[static_cast<usz>(lane)].emplace_back(std::move(t));
+		}
+
+		st.pending++;
+		st.pending.notify_one();
+	}
+
+	bool task_executor::take(task& out, const task_group* group)
+	{
+		auto& st = *m_state;
+
+		if (!st.pending)
+		{
+			return false;
+		}
+
+		const u32 self = g_tls_task_worker;
+		const u32 start = self != umax ? self : st.next_queue.observe() % st.queue_count;
+
+		for (usz lane = 0; lane < static_cast<usz>(task_lane::count_); lane++)
+		{
+			for (u32 i = 0; i < st.queue_count; i++)
+			{
+				auto& queue = st.queues[(start + i) % st.queue_count];
+				auto& tasks = queue.lanes[lane];
+
+				std::lock_guard lock(queue.mutex);
+
+				if (tasks.empty())
+				{
+					continue;
+				}
+
+				if (group)
+				{
+					const auto found = std::find_if(tasks.begin(), tasks.end(), [&](const task& t)
+						{
+							return t.group == group;
+						});
+
+					if (found == tasks.end())
+					{
+						continue;
+					}
+
+					out = std::move(*found);
+					tasks.erase(found);
+				}
+				else if (i == 0 && self != umax)
+				{
+					// Own queue: newest first
+					out = std::move(tasks.back());
+					tasks.pop_back();
+				}
+				else
+				{
+					// Steal the oldest task
+					out = std::move(tasks.front());
+					tasks.pop_front();
+				}
+
+				st.pending--;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	void task_executor::execute(task& t)
+	{
+		const auto group = t.group;
+		auto& stats = *group->m_stats;
+
+		const u64 start = get_time_ns();
+		stats.wait_ns += start - t.submit_time;
+
+		if (!group->cancelled())
+		{
+			t.func();
+		}
+
+		// Destroy the context before signaling completion
+		t.func = nullptr;
+
+		stats.exec_ns += get_time_ns() - start;
+		stats.tasks++;
+
+		if (!--group->m_pending)
+		{
+			group->m_pending.notify_all();
+		}
+	}
+
+	task_subsystem_stats& task_executor::get_stats(std::string_view subsystem)
+	{
+		auto& st = *m_state;
+
+		std::lock_guard lock(st.stats_mutex);
+
+		if (auto found = st.stats.find(subsystem); found != st.stats.end())
+		{
+			return found->second;
+		}
+
+		return st.stats[std::string(subsystem)];
+	}
+
+	void task_executor::report(std::string_view stage)
+	{
+		auto& st = *m_state;
+
+		std::lock_guard lock(st.stats_mutex);
+
+		for (auto& [name, stats] : st.stats)
+		{
+			const u64 tasks = stats.tasks.exchange(0);
+			const u64 wait_ns = stats.wait_ns.exchange(0);
+			const u64 exec_ns = stats.exec_ns.exchange(0);
+
+			if (!tasks)
+			{
+				continue;
+			}
+
+			sys_log.notice("Task executor (%s): %s: %u tasks, queue wait %.3f s, execution %.3f s (%u workers)", stage, name, tasks, wait_ns / 1e9, exec_ns / 1e9, st.queue_count);
+		}
+	}
+
+	task_group::task_group(std::string_view subsystem, task_lane lane)
+		: m_stats(&task_executor::get().get_stats(subsystem)), m_lane(lane)
+	{
+	}
+
+	task_group::~task_group()
+	{
+		join();
+	}
+
+	void task_group::run(std::function<void()> func)
+	{
+		m_pending++;
+		task_executor::get().push({std::move(func), this, get_time_ns(), m_lane}, m_lane);
+	}
+
+	struct task_range
+	{
+		std::function<void(u32, usz)> func;
+		usz count = 0;
+		atomic_t<usz> next = 0;
+	};
+
+	static void run_range_item(task_group& group, std::shared_ptr<task_range> range, u32 slot)
+	{
+		const usz index = range->next++;
+
+		if (index >= range->count)
+		{
+			return;
+		}
+
+		group.run([&group, range = std::move(range), slot, index]() mutable
+			{
+				range->func(slot, index);
+				run_range_item(group, std::move(range), slot);
+			});
+	}
+
+	void task_group::run_range(usz count, u32 max_tasks, std::function<void(u32, usz)> func)
+	{
+		auto range = std::make_shared<task_range>();
+		range->func = std::move(func);
+		range->count = count;
+
+		for (u32 slot = 0; slot < std::min<usz>(max_tasks, count); slot++)
+		{
+			run_range_item(*this, range, slot);
+		}
+	}
+
+	bool task_group::join()
+	{
+		auto& executor = task_executor::get();
+
+		while (const u32 pending = m_pending)
+		{
+			if (!cancelled() && thread_ctrl::get_current() && thread_ctrl::state() == thread_state::aborting)
+			{
+				cancel();
+			}
+
+			// Execute own tasks instead of blocking, it also makes nested groups on workers safe
+			if (task_executor::task t; executor.take(t, this))
+			{
+				executor.execute(t);
+				continue;
+			}
+
+			// Wait for tasks taken by workers (timeout to observe thread state)
+			m_pending.wait(pending, atomic_wait_timeout{1'000'000});
+		}
+
+		return !cancelled();
+	}
+} // namespace utils
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "util/types.hpp"
+#include "util/atomic.hpp"
+
+#include <functional>
+#include <memory>
+#include <string_view>
+
+namespace utils
+{
+	// Workers take tasks from the highest non-empty lane first
+	enum class task_lane : u8
+	{
+		high,   // Blocks progress visible to the user (shader cache loading)
+		normal, // Boot-time compilation, installation
+		low,    // Background work
+
+		count_
+	};
+
+	struct task_subsystem_stats;
+
+	class task_group;
+
+	// Process-wide pool of workers shared by compilation and installation workloads.
+	// Every worker owns a deque per lane: it pops its own tasks from the back and steals
+	// the oldest tasks of other workers when idle, so overlapping subsystems don't oversubscribe cores.
+	// Tasks must be short: lanes are only prioritized when a worker picks the next task, and task
+	// bodies run on pool threads (thread_ctrl::state() is the state of the worker, not of the submitter).
+	class task_executor
+	{
+		friend class task_group;
+
+		struct task;
+		struct state;
+		struct worker;
+
+		std::unique_ptr<state> m_state;
+
+		task_executor();
+
+		void push(task&& t, task_lane lane);
+
+		// Take a pending task (only of the specified group if not null)
+		bool take(task& out, const task_group* group);
+
+		void execute(task& t);
+
+		task_subsystem_stats& get_stats(std::string_view subsystem);
+
+	public:
+		task_executor(const task_executor&) = delete;
+
+		task_executor& operator=(const task_executor&) = delete;
+
+		~task_executor();
+
+		static task_executor& get();
+
+		// Number of worker threads
+		u32 size() const;
+
+		// Log queue wait and execution time per subsystem accumulated since the previous report
+		void report(std::string_view stage);
+	};
+
+	// Tasks of one subsystem joined together, also serves as their cancellation token.
+	// Pending tasks of a cancelled group are skipped, running tasks are not interrupted.
+	class task_group
+	{
+		friend class task_executor;
+
+		task_subsystem_stats* m_stats;
+		task_lane m_lane;
+		atomic_t<u32> m_pending = 0;
+		atomic_t<bool> m_cancelled = false;
+
+	public:
+		task_group(std::string_view subsystem, task_lane lane = task_lane::normal);
+
+		task_group(const task_group&) = delete;
+
+		task_group& operator=(const task_group&) = delete;
+
+		// Joins (the group must outlive its tasks)
+		~task_group();
+
+		void run(std::function<void()> func);
+
+		// Run func(slot, index) for every index below count, one index per task and at most max_tasks tasks at a time.
+		// A finished task queues the next index for its slot, so every slot runs sequentially (and may own state
+		// such as a compiler instance) while lanes are still prioritized between items.
+		void run_range(usz count, u32 max_tasks, std::function<void(u32, usz)> func);
+
+		// Wait for all tasks of the group, executing them on the current thread when possible.
+		// The group is cancelled if the current thread is aborting. Returns false if cancelled.
+		bool join();
+
+		void cancel()
+		{
+			m_cancelled.release(true);
+		}
+
+		bool cancelled() const
+		{
+			return m_cancelled.observe();
+		}
+	};
+} // namespace utils
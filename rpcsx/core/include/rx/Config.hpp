@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string>
+
 namespace rx {
 // FIXME: serialization
 struct Config {
@@ -7,6 +9,13 @@ struct Config {
   bool validateGpu = false;
   bool disableGpuCache = false;
   bool debugGpu = false;
+  std::string shaderCachePath;
+  unsigned shaderCompilerThreads = 0;
+  bool skipDrawsWhileCompiling = false;
+  bool optimizeShaders = true;
+  std::string gpuCapturePath;
+  unsigned gpuCaptureFrames = 1;
+  bool headlessGpu = false;
 };
 
 extern Config g_config;
@@ -1,5 +1,6 @@
 #include "Cache.hpp"
 #include "Device.hpp"
+#include "ShaderCompiler.hpp"
 #include "amdgpu/tiler.hpp"
 #include "gnm/vulkan.hpp"
 #include "rx/Config.hpp"
@@ -31,18 +32,8 @@ static bool testHostInvalidations(Device *device, int vmId,
   auto firstPage = address / rx::mem::pageSize;
   auto lastPage = (address + size + rx::mem::pageSize - 1) / rx::mem::pageSize;
 
-  for (auto page = firstPage; page < lastPage; ++page) {
-    auto prevValue =
-        device->cachePages[vmId][page].load(std::memory_order::relaxed);
-
-    if (~prevValue & kPageInvalidated) {
-      continue;
-    }
-
-    return true;
-  }
-
-  return false;
+  return testPageFlags(device->cachePages[vmId], firstPage, lastPage,
+                       kPageInvalidated);
 }
 
 static bool handleHostInvalidations(Device *device, int vmId,
@@ -50,24 +41,8 @@ static bool handleHostInvalidations(Device *device, int vmId,
   auto firstPage = address / rx::mem::pageSize;
   auto lastPage = (address + size + rx::mem::pageSize - 1) / rx::mem::pageSize;
 
-  bool hasInvalidations = false;
-
-  for (auto page = firstPage; page < lastPage; ++page) {
-    auto prevValue =
-        device->cachePages[vmId][page].load(std::memory_order::relaxed);
-
-    if (~prevValue & kPageInvalidated) {
-      continue;
-    }
-
-    while (!device->cachePages[vmId][page].compare_exchange_weak(
-        prevValue, prevValue & ~kPageInvalidated, std::memory_order::relaxed)) {
-    }
-
-    hasInvalidations = true;
-  }
-
-  return hasInvalidations;
+  return modifyPageFlags(device->cachePages[vmId], firstPage, lastPage, 0,
+                         kPageInvalidated);
 }
 
 static void markHostInvalidated(Device *device, int vmId, std::uint64_t address,
@@ -75,13 +50,8 @@ static void markHostInvalidated(Device *device, int vmId, std::uint64_t address,
   auto firstPage = address / rx::mem::pageSize;
   auto lastPage = (address + size + rx::mem::pageSize - 1) / rx::mem::pageSize;
 
-  for (auto page = firstPage; page < lastPage; ++page) {
-    std::uint8_t prevValue = 0;
-
-    while (!device->cachePages[vmId][page].compare_exchange_weak(
-        prevValue, prevValue | kPageInvalidated, std::memory_order::relaxed)) {
-    }
-  }
+  modifyPageFlags(device->cachePages[vmId], firstPage, lastPage,
+                  kPageInvalidated, 0);
 }
 
 static bool isPrimRequiresConversion(gnm::PrimitiveType primType) {
@@ -1320,88 +1290,78 @@ Cache::Shader Cache::Tag::getShader(const ShaderKey &key,
     };
   }
 
-  auto vmId = mParent->mVmId;
+  auto &compiler = getDevice()->shaderCompiler;
 
-  std::optional<gcn::ConvertedShader> converted;
+  auto job = std::make_shared<ShaderCompileJob>();
+  job->vmId = mParent->mVmId;
+  job->address = key.address;
+  job->stage = key.stage;
+  job->env = key.env;
+  job->userSgprs.assign(key.env.userSgprs.begin(), key.env.userSgprs.end());
+  job->env.userSgprs = job->userSgprs;
+  job->vkStage = stage;
 
-  {
-    auto env = key.env;
-    env.supportsBarycentric = vk::context->supportsBarycentric;
-    env.supportsInt8 = vk::context->supportsInt8;
-    env.supportsInt64Atomics = vk::context->supportsInt64Atomics;
-    env.supportsNonSemanticInfo = vk::context->supportsNonSemanticInfo;
-
-    gcn::Context context;
-    auto deserialized = gcn::deserialize(
-        context, env, mParent->mDevice->gcnSemantic, key.address,
-        [vmId](std::uint64_t address) -> std::uint32_t {
-          return *RemoteMemory{vmId}.getPointer<std::uint32_t>(address);
-        });
-
-    // deserialized.print(std::cerr, context.ns);
-
-    converted = gcn::convertToSpv(
-        context, deserialized, mParent->mDevice->gcnSemantic,
-        mParent->mDevice->gcnSemanticModuleInfo, key.stage, env);
-    if (!converted) {
-      return {};
-    }
+  if (stage == VK_SHADER_STAGE_COMPUTE_BIT) {
+    job->setLayouts = std::span(&mParent->mComputeDescriptorSetLayout, 1);
+  } else {
+    job->setLayouts = mParent->mGraphicsDescriptorSetLayouts;
+  }
 
-    converted->info.resources.dump();
-    if (!shader::spv::validate(converted->spv)) {
-      shader::spv::dump(converted->spv, true);
-      return {};
+  if (compiler.isAsync()) {
+    auto submitted = compiler.submit(job);
+
+    if (submitted && !submitted->isDone()) {
+      return {.stage = stage, .pendingJob = std::move(submitted)};
     }
 
-    rx::print(stderr, "{}", shader::glsl::decompile(converted->spv));
-    // if (auto opt = shader::spv::optimize(converted->spv)) {
-    //   converted->spv = std::move(*opt);
-    //   std::fprintf(stderr, "opt: %s",
-    //              shader::glsl::decompile(converted->spv).c_str());
-    // } else {
-    //   std::printf("optimization failed\n");
-    // }
+    if (submitted) {
+      compiler.release(submitted);
+
+      // guest memory could be changed while the shader was compiled in
+      // background, schedule new compilation in this case
+      bool isChanged =
+          std::ranges::any_of(submitted->usedMemory, [this](auto &memory) {
+            return compareMemory(memory.second.data(),
+                                 rx::AddressRange::fromBeginSize(
+                                     memory.first, memory.second.size())) != 0;
+          });
+
+      if (!isChanged) {
+        job = std::move(submitted);
+      } else if (auto resubmitted = compiler.submit(job)) {
+        return {.stage = stage, .pendingJob = std::move(resubmitted)};
+      }
+    }
   }
 
-  VkShaderCreateInfoEXT createInfo{
-      .sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
-      .flags = 0,
-      .stage = stage,
-      .codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT,
-      .codeSize = converted->spv.size() * sizeof(converted->spv[0]),
-      .pCode = converted->spv.data(),
-      .pName = "main",
-      .setLayoutCount = static_cast<uint32_t>(
-          stage == VK_SHADER_STAGE_COMPUTE_BIT ? 1
-                                               : Cache::kGraphicsStages.size()),
-      .pSetLayouts = (stage == VK_SHADER_STAGE_COMPUTE_BIT
-                          ? &mParent->mComputeDescriptorSetLayout
-                          : mParent->mGraphicsDescriptorSetLayouts.data())};
+  if (!job->isDone()) {
+    compiler.compile(*job);
 
-  VkShaderEXT handle;
-  VK_VERIFY(vk::CreateShadersEXT(vk::context->device, 1, &createInfo,
-                                 vk::context->allocator, &handle));
+    readMemory(&job->magic, rx::AddressRange::fromBeginSize(
+                                key.address, sizeof(job->magic)));
+
+    for (auto &[address, data] : job->usedMemory) {
+      readMemory(data.data(),
+                 rx::AddressRange::fromBeginSize(address, data.size()));
+    }
+  }
+
+  if (job->handle == VK_NULL_HANDLE) {
+    return {};
+  }
 
   auto magicRange =
       rx::AddressRange::fromBeginSize(key.address, sizeof(std::uint64_t));
   auto result = std::make_shared<CachedShader>();
   result->addressRange = magicRange;
   result->tagId = getReadId();
-  result->handle = handle;
-  result->info = std::move(converted->info);
-  readMemory(&result->magic, rx::AddressRange::fromBeginSize(
-                                 key.address, sizeof(result->magic)));
-
-  for (auto entry : result->info.memoryMap) {
-    auto entryRange =
-        rx::AddressRange::fromBeginEnd(entry.beginAddress, entry.endAddress);
-    auto &inserted = result->usedMemory.emplace_back();
-    inserted.first = entryRange.beginAddress();
-    inserted.second.resize(entryRange.size());
-    readMemory(inserted.second.data(), entryRange);
-  }
+  result->handle = job->takeHandle();
+  result->magic = job->magic;
+  result->info = std::move(job->converted->info);
+  result->usedMemory = std::move(job->usedMemory);
 
   auto &info = result->info;
+  auto handle = result->handle;
 
   mParent->trackUpdate(EntryType::Shader, result->addressRange, result,
                        getReadId(), true);
@@ -2800,6 +2760,10 @@ void Cache::trackUpdate(EntryType type, rx::AddressRange range,
   if (watchChanges) {
     mDevice->watchWrites(mVmId, range.beginAddress(), range.size());
   }
+
+  if (mDevice->capture.isRecording()) {
+    mDevice->captureMemory(mVmId, range.beginAddress(), range.size());
+  }
 }
 
 void Cache::trackWrite(rx::AddressRange range, TagId tagId, bool lockMemory) {
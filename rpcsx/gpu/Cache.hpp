@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Pipe.hpp"
+#include "ShaderCompiler.hpp"
 #include "amdgpu/tiler.hpp"
 #include "gnm/constants.hpp"
 #include "rx/AddressRange.hpp"
@@ -174,6 +175,11 @@ struct Cache {
     VkShaderEXT handle = VK_NULL_HANDLE;
     shader::gcn::ShaderInfo *info;
     VkShaderStageFlagBits stage;
+
+    // Set while the shader is compiled in background
+    std::shared_ptr<ShaderCompileJob> pendingJob;
+
+    [[nodiscard]] bool isPending() const { return pendingJob != nullptr; }
   };
 
   struct Sampler {
@@ -574,6 +580,25 @@ public:
 
   void trackWrite(rx::AddressRange range, TagId tagId, bool lockMemory);
 
+  // Returns merged guest memory ranges which were accessed by the cache
+  std::vector<rx::AddressRange> getTrackedRanges() {
+    std::lock_guard lock(mResourcesMtx);
+    std::vector<rx::AddressRange> result;
+
+    for (auto it = mSyncTable.begin(); it != mSyncTable.end(); ++it) {
+      auto range = it.range();
+
+      if (!result.empty() &&
+          result.back().endAddress() == range.beginAddress()) {
+        result.back() = result.back().merge(range);
+      } else {
+        result.push_back(range);
+      }
+    }
+
+    return result;
+  }
+
   [[nodiscard]] bool isInSync(rx::AddressRange range, TagId expTagId) {
     auto syncIt = mSyncTable.queryArea(range.beginAddress());
     return syncIt != mSyncTable.end() && syncIt.range().contains(range) &&
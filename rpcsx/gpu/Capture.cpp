@@ -0,0 +1,459 @@
+#include "Capture.hpp"
+#include "rx/align.hpp"
+#include "rx/print.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+using namespace amdgpu;
+
+static constexpr std::uint64_t kCaptureMagic = 0x3450'4d58'5343'5052;
+static constexpr std::uint32_t kCaptureVersion = 2;
+
+// records are padded, so packet payloads are naturally aligned
+static constexpr std::uint64_t kRecordAlignment = 8;
+
+namespace {
+struct FileHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t pad;
+};
+
+struct RecordHeader {
+  CaptureRecordType type;
+  std::uint32_t headerSize;
+  std::uint64_t payloadSize;
+};
+
+struct ProcessHeader {
+  std::uint32_t pid;
+  std::int32_t vmId;
+};
+
+struct MemoryHeader {
+  std::int32_t vmId;
+  std::uint32_t pad;
+  std::uint64_t address;
+  std::uint64_t size;
+  std::uint64_t blob;
+};
+
+struct BlobHeader {
+  std::uint64_t id;
+};
+
+struct RegistersHeader {
+  std::int32_t pipe;
+  std::uint32_t pad;
+  std::uint64_t blobs[kCaptureRegisterBlockCount];
+};
+
+struct PacketHeader {
+  std::int32_t pipe;
+  std::uint32_t pad;
+};
+
+struct ComputePacketHeader {
+  std::int32_t pipe;
+  std::int32_t queue;
+  std::int32_t vmId;
+  std::uint32_t pad;
+  std::uint64_t doorbell;
+};
+
+template <typename T> std::span<const std::byte> asBytes(const T &object) {
+  return std::as_bytes(std::span(&object, 1));
+}
+
+std::uint64_t hashBlob(std::span<const std::byte> data) {
+  return std::hash<std::string_view>{}(std::string_view(
+      reinterpret_cast<const char *>(data.data()), data.size()));
+}
+} // namespace
+
+bool CaptureWriter::open(const std::filesystem::path &path,
+                         std::uint32_t frameCount) {
+  std::lock_guard lock(mMtx);
+
+  mFile.open(path, std::ios::binary | std::ios::trunc);
+  if (!mFile) {
+    rx::println(stderr, "gpu capture: failed to open {}", path.string());
+    return false;
+  }
+
+  FileHeader header{
+      .magic = kCaptureMagic,
+      .version = kCaptureVersion,
+  };
+
+  mFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  mFile.flush();
+
+  // stored blobs are read back to resolve hash collisions
+  mReadback.open(path, std::ios::binary);
+  if (!mReadback) {
+    rx::println(stderr, "gpu capture: failed to open {}", path.string());
+    mFile.close();
+    return false;
+  }
+
+  mNextBlobId = 0;
+  mFrameCount = std::max(frameCount, 1u);
+  mBytesWritten = sizeof(header);
+  return true;
+}
+
+void CaptureWriter::close() {
+  std::lock_guard lock(mMtx);
+  mRecording.store(false, std::memory_order::relaxed);
+  mFile.close();
+  mReadback.close();
+  mBlobs.clear();
+}
+
+bool CaptureWriter::nextFrame() {
+  std::lock_guard lock(mMtx);
+
+  if (!mFile.is_open()) {
+    return false;
+  }
+
+  if (mRecording.load(std::memory_order::relaxed)) {
+    writeRecord(CaptureRecordType::FrameEnd, {});
+
+    if (--mFramesLeft == 0) {
+      mRecording.store(false, std::memory_order::relaxed);
+      mFile.close();
+      mReadback.close();
+      mBlobs.clear();
+
+      rx::println("gpu capture: {} frames, {} KiB written", mFrameCount,
+                  mBytesWritten / 1024);
+    }
+
+    return false;
+  }
+
+  if (!mStartRequested.exchange(false, std::memory_order::relaxed)) {
+    return false;
+  }
+
+  mFramesLeft = mFrameCount;
+  mRecording.store(true, std::memory_order::relaxed);
+  rx::println("gpu capture: started");
+  return true;
+}
+
+void CaptureWriter::recordProcess(std::uint32_t pid, int vmId) {
+  ProcessHeader header{.pid = pid, .vmId = vmId};
+
+  std::lock_guard lock(mMtx);
+  writeRecord(CaptureRecordType::Process, asBytes(header));
+}
+
+void CaptureWriter::recordMapMemory(int vmId, rx::AddressRange range) {
+  MemoryHeader header{
+      .vmId = vmId,
+      .address = range.beginAddress(),
+      .size = range.size(),
+  };
+
+  std::lock_guard lock(mMtx);
+  writeRecord(CaptureRecordType::MapMemory, asBytes(header));
+}
+
+void CaptureWriter::recordMemory(int vmId, rx::AddressRange range,
+                                 std::span<const std::byte> data) {
+  if (data.empty()) {
+    return;
+  }
+
+  std::lock_guard lock(mMtx);
+  if (!mRecording.load(std::memory_order::relaxed)) {
+    return;
+  }
+
+  MemoryHeader header{
+      .vmId = vmId,
+      .address = range.beginAddress(),
+      .size = range.size(),
+      .blob = writeBlob(data),
+  };
+
+  writeRecord(CaptureRecordType::Memory, asBytes(header));
+}
+
+void CaptureWriter::recordRegisters(
+    int pipe,
+    std::span<const std::span<const std::byte>, kCaptureRegisterBlockCount>
+        blocks) {
+  RegistersHeader header{.pipe = pipe};
+
+  std::lock_guard lock(mMtx);
+  for (std::size_t i = 0; i < blocks.size(); ++i) {
+    header.blobs[i] = writeBlob(blocks[i]);
+  }
+
+  writeRecord(CaptureRecordType::Registers, asBytes(header));
+}
+
+void CaptureWriter::recordPacket(int pipe,
+                                 std::span<const std::uint32_t> packet,
+                                 std::span<const std::uint32_t> wrapped) {
+  PacketHeader header{.pipe = pipe};
+
+  std::lock_guard lock(mMtx);
+  if (!mRecording.load(std::memory_order::relaxed)) {
+    return;
+  }
+
+  writeRecord(CaptureRecordType::Packet, asBytes(header),
+              std::as_bytes(packet), std::as_bytes(wrapped));
+}
+
+void CaptureWriter::recordComputePacket(
+    int pipe, int queue, int vmId, std::uint64_t doorbell,
+    std::span<const std::uint32_t> packet,
+    std::span<const std::uint32_t> wrapped) {
+  ComputePacketHeader header{
+      .pipe = pipe,
+      .queue = queue,
+      .vmId = vmId,
+      .doorbell = doorbell,
+  };
+
+  std::lock_guard lock(mMtx);
+  if (!mRecording.load(std::memory_order::relaxed)) {
+    return;
+  }
+
+  writeRecord(CaptureRecordType::ComputePacket, asBytes(header),
+              std::as_bytes(packet), std::as_bytes(wrapped));
+}
+
+std::uint64_t CaptureWriter::writeBlob(std::span<const std::byte> data) {
+  auto &candidates = mBlobs[hashBlob(data)];
+
+  for (auto &blob : candidates) {
+    if (isStoredBlob(blob, data)) {
+      return blob.id;
+    }
+  }
+
+  StoredBlob blob{
+      .id = mNextBlobId++,
+      .offset = mBytesWritten + sizeof(RecordHeader) + sizeof(BlobHeader),
+      .size = data.size(),
+  };
+
+  BlobHeader header{.id = blob.id};
+  writeRecord(CaptureRecordType::Blob, asBytes(header), data);
+  candidates.push_back(blob);
+  return blob.id;
+}
+
+bool CaptureWriter::isStoredBlob(const StoredBlob &blob,
+                                 std::span<const std::byte> data) {
+  if (blob.size != data.size()) {
+    return false;
+  }
+
+  // the hash is not unique, compare with the bytes already written. Recent
+  // blobs are usually still in the page cache
+  mFile.flush();
+  mReadback.clear();
+  mReadback.seekg(blob.offset);
+
+  char buffer[16 * 1024];
+  for (std::size_t offset = 0; offset < data.size(); offset += sizeof(buffer)) {
+    auto size = std::min(sizeof(buffer), data.size() - offset);
+
+    if (!mReadback.read(buffer, size) ||
+        std::memcmp(buffer, data.data() + offset, size) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void CaptureWriter::writeRecord(CaptureRecordType type,
+                                std::span<const std::byte> header,
+                                std::span<const std::byte> payload,
+                                std::span<const std::byte> payloadTail) {
+  auto payloadSize = payload.size() + payloadTail.size();
+
+  RecordHeader record{
+      .type = type,
+      .headerSize = static_cast<std::uint32_t>(header.size()),
+      .payloadSize = payloadSize,
+  };
+
+  mFile.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  mFile.write(reinterpret_cast<const char *>(header.data()), header.size());
+  mFile.write(reinterpret_cast<const char *>(payload.data()), payload.size());
+  mFile.write(reinterpret_cast<const char *>(payloadTail.data()),
+              payloadTail.size());
+
+  static constexpr char kPadding[kRecordAlignment]{};
+  auto padding = rx::alignUp(payloadSize, kRecordAlignment) - payloadSize;
+  mFile.write(kPadding, padding);
+
+  mBytesWritten += sizeof(record) + header.size() + payloadSize + padding;
+}
+
+bool CaptureReader::open(const std::filesystem::path &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    rx::println(stderr, "gpu capture: failed to open {}", path.string());
+    return false;
+  }
+
+  in.seekg(0, std::ios::end);
+  mData.resize(in.tellg());
+  in.seekg(0, std::ios::beg);
+  in.read(reinterpret_cast<char *>(mData.data()), mData.size());
+
+  FileHeader header{};
+  if (!in || mData.size() < sizeof(header)) {
+    rx::println(stderr, "gpu capture: failed to read {}", path.string());
+    return false;
+  }
+
+  std::memcpy(&header, mData.data(), sizeof(header));
+  if (header.magic != kCaptureMagic || header.version != kCaptureVersion) {
+    rx::println(stderr, "gpu capture: {} has unsupported format",
+                path.string());
+    return false;
+  }
+
+  mRecordsOffset = sizeof(header);
+  mOffset = mRecordsOffset;
+  return true;
+}
+
+bool CaptureReader::next(CaptureRecord &record) {
+  while (true) {
+    RecordHeader recordHeader;
+    if (mData.size() - mOffset < sizeof(recordHeader)) {
+      return false;
+    }
+
+    std::memcpy(&recordHeader, mData.data() + mOffset, sizeof(recordHeader));
+    auto bodyOffset = mOffset + sizeof(recordHeader);
+
+    auto payloadSize =
+        rx::alignUp(recordHeader.payloadSize, kRecordAlignment);
+
+    if (mData.size() - bodyOffset < recordHeader.headerSize ||
+        mData.size() - bodyOffset - recordHeader.headerSize < payloadSize) {
+      // truncated tail, probably the emulator was killed during capture
+      rx::println(stderr, "gpu capture: dropping damaged tail");
+      mOffset = mData.size();
+      return false;
+    }
+
+    auto header =
+        std::span(mData).subspan(bodyOffset, recordHeader.headerSize);
+    auto payload = std::span(mData).subspan(
+        bodyOffset + recordHeader.headerSize, recordHeader.payloadSize);
+    mOffset = bodyOffset + recordHeader.headerSize + payloadSize;
+
+    auto readHeader = [&]<typename T>(T &result) {
+      if (header.size() < sizeof(T)) {
+        return false;
+      }
+
+      std::memcpy(&result, header.data(), sizeof(T));
+      return true;
+    };
+
+    record = {.type = recordHeader.type};
+
+    switch (recordHeader.type) {
+    case CaptureRecordType::Process: {
+      ProcessHeader body;
+      if (!readHeader(body)) {
+        continue;
+      }
+
+      record.pid = body.pid;
+      record.vmId = body.vmId;
+      return true;
+    }
+
+    case CaptureRecordType::MapMemory:
+    case CaptureRecordType::Memory: {
+      MemoryHeader body;
+      if (!readHeader(body)) {
+        continue;
+      }
+
+      record.vmId = body.vmId;
+      record.range = rx::AddressRange::fromBeginSize(body.address, body.size);
+      record.blob = body.blob;
+      return true;
+    }
+
+    case CaptureRecordType::Blob: {
+      BlobHeader body;
+      if (readHeader(body)) {
+        mBlobs[body.id] = payload;
+      }
+      continue;
+    }
+
+    case CaptureRecordType::Registers: {
+      RegistersHeader body;
+      if (!readHeader(body)) {
+        continue;
+      }
+
+      record.pipe = body.pipe;
+      std::memcpy(record.registers, body.blobs, sizeof(body.blobs));
+      return true;
+    }
+
+    case CaptureRecordType::Packet: {
+      PacketHeader body;
+      if (!readHeader(body)) {
+        continue;
+      }
+
+      record.pipe = body.pipe;
+      record.packet = {reinterpret_cast<const std::uint32_t *>(payload.data()),
+                       payload.size() / sizeof(std::uint32_t)};
+      return true;
+    }
+
+    case CaptureRecordType::ComputePacket: {
+      ComputePacketHeader body;
+      if (!readHeader(body)) {
+        continue;
+      }
+
+      record.pipe = body.pipe;
+      record.queue = body.queue;
+      record.vmId = body.vmId;
+      record.doorbell = body.doorbell;
+      record.packet = {reinterpret_cast<const std::uint32_t *>(payload.data()),
+                       payload.size() / sizeof(std::uint32_t)};
+      return true;
+    }
+
+    case CaptureRecordType::FrameEnd:
+      return true;
+    }
+
+    // unknown record, skip it
+  }
+}
+
+std::span<const std::byte> CaptureReader::getBlob(std::uint64_t id) const {
+  if (auto it = mBlobs.find(id); it != mBlobs.end()) {
+    return it->second;
+  }
+
+  return {};
+}
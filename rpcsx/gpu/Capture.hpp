@@ -0,0 +1,138 @@
+#pragma once
+
+#include "rx/AddressRange.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace amdgpu {
+enum class CaptureRecordType : std::uint32_t {
+  Process,       // pid, vmId
+  MapMemory,     // vmId, address, size
+  Blob,          // blob id, bytes
+  Memory,        // vmId, address, size, blob id
+  Registers,     // pipe, sh/context/uconfig/constant ram blob ids
+  Packet,        // pipe, packet dwords
+  FrameEnd,
+  ComputePacket, // pipe, queue, vmId, doorbell address, packet dwords
+};
+
+enum CaptureRegisterBlock {
+  kCaptureShRegisters,
+  kCaptureContextRegisters,
+  kCaptureUConfigRegisters,
+  kCaptureConstantMemory,
+  kCaptureRegisterBlockCount
+};
+
+struct CaptureRecord {
+  CaptureRecordType type;
+  std::uint32_t pid = 0;
+  int vmId = -1;
+  int pipe = 0;
+  int queue = 0;
+  rx::AddressRange range;
+  std::uint64_t blob = 0;
+  std::uint64_t registers[kCaptureRegisterBlockCount]{};
+  std::uint64_t doorbell = 0;
+  std::span<const std::uint32_t> packet;
+};
+
+// Records main ring packets of graphics pipes and level 0 packets of compute
+// queues together with guest memory read by the command processor and the
+// cache. Memory records written after a packet hold the memory state observed
+// while processing of that packet. Contents are deduplicated, each distinct
+// blob is stored once.
+class CaptureWriter {
+public:
+  CaptureWriter() = default;
+  CaptureWriter(const CaptureWriter &) = delete;
+  ~CaptureWriter() { close(); }
+
+  bool open(const std::filesystem::path &path, std::uint32_t frameCount);
+  void close();
+
+  // Recording starts at the next frame boundary
+  void requestStart() {
+    mStartRequested.store(true, std::memory_order::relaxed);
+  }
+
+  [[nodiscard]] bool isRecording() const {
+    return mRecording.load(std::memory_order::relaxed);
+  }
+
+  // Called on every frame boundary. Returns true if the new frame is
+  // recorded and the initial state must be written
+  bool nextFrame();
+
+  void recordProcess(std::uint32_t pid, int vmId);
+  void recordMapMemory(int vmId, rx::AddressRange range);
+  void recordMemory(int vmId, rx::AddressRange range,
+                    std::span<const std::byte> data);
+  void recordRegisters(
+      int pipe,
+      std::span<const std::span<const std::byte>, kCaptureRegisterBlockCount>
+          blocks);
+
+  // Packets which wrap around the ring end are passed as two segments, the
+  // second one starts at the ring base
+  void recordPacket(int pipe, std::span<const std::uint32_t> packet,
+                    std::span<const std::uint32_t> wrapped = {});
+  void recordComputePacket(int pipe, int queue, int vmId,
+                           std::uint64_t doorbell,
+                           std::span<const std::uint32_t> packet,
+                           std::span<const std::uint32_t> wrapped = {});
+
+private:
+  struct StoredBlob {
+    std::uint64_t id;
+    std::uint64_t offset; // payload offset in the file
+    std::uint64_t size;
+  };
+
+  std::uint64_t writeBlob(std::span<const std::byte> data);
+  bool isStoredBlob(const StoredBlob &blob, std::span<const std::byte> data);
+  void writeRecord(CaptureRecordType type, std::span<const std::byte> header,
+                   std::span<const std::byte> payload = {},
+                   std::span<const std::byte> payloadTail = {});
+
+  std::mutex mMtx;
+  std::ofstream mFile;
+  std::ifstream mReadback;
+
+  // stored blobs by content hash
+  std::unordered_map<std::uint64_t, std::vector<StoredBlob>> mBlobs;
+  std::uint64_t mNextBlobId = 0;
+  std::uint32_t mFrameCount = 0;
+  std::uint32_t mFramesLeft = 0;
+  std::uint64_t mBytesWritten = 0;
+  std::atomic<bool> mRecording{false};
+  std::atomic<bool> mStartRequested{false};
+};
+
+class CaptureReader {
+public:
+  bool open(const std::filesystem::path &path);
+
+  // Restarts iteration from the first record
+  void rewind() { mOffset = mRecordsOffset; }
+
+  // Returns false at the end of capture. Blob records are consumed
+  // internally and available through getBlob
+  bool next(CaptureRecord &record);
+
+  [[nodiscard]] std::span<const std::byte> getBlob(std::uint64_t id) const;
+
+private:
+  std::vector<std::byte> mData;
+  std::unordered_map<std::uint64_t, std::span<const std::byte>> mBlobs;
+  std::size_t mRecordsOffset = 0;
+  std::size_t mOffset = 0;
+};
+} // namespace amdgpu
@@ -18,13 +18,17 @@
 #include "shader/spv.hpp"
 #include "shaders/rdna-semantic-spirv.hpp"
 #include "vk.hpp"
+#include <algorithm>
+#include <bit>
 #include <chrono>
 #include <cstdio>
 #include <fcntl.h>
+#include <optional>
 #include <stop_token>
 #include <sys/mman.h>
 #include <thread>
 #include <unistd.h>
+#include <vector>
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
@@ -75,38 +79,45 @@ static vk::Context createVkContext(Device *device) {
     }
   }
 
-  auto createWindow = [=] {
-    glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-    device->window = glfwCreateWindow(1920, 1080, "RPCSX", nullptr, nullptr);
-  };
+  // headless device has no window and presents nothing, used for replay
+  bool isHeadless = rx::g_config.headlessGpu;
+  std::vector<const char *> requiredExtensions;
+
+  if (!isHeadless) {
+    auto createWindow = [=] {
+      glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+      device->window = glfwCreateWindow(1920, 1080, "RPCSX", nullptr, nullptr);
+    };
 
 #ifdef GLFW_PLATFORM_WAYLAND
-  if (glfwPlatformSupported(GLFW_PLATFORM_WAYLAND)) {
-    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
-  }
+    if (glfwPlatformSupported(GLFW_PLATFORM_WAYLAND)) {
+      glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_WAYLAND);
+    }
 
-  glfwInit();
-  createWindow();
+    glfwInit();
+    createWindow();
 
-  if (device->window == nullptr) {
-    glfwTerminate();
+    if (device->window == nullptr) {
+      glfwTerminate();
 
-    glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+      glfwInitHint(GLFW_PLATFORM, GLFW_ANY_PLATFORM);
+      glfwInit();
+      createWindow();
+    }
+#else
     glfwInit();
     createWindow();
-  }
-#else
-  glfwInit();
-  createWindow();
 #endif
 
-  glfwHideWindow(device->window);
+    glfwHideWindow(device->window);
+
+    const char **glfwExtensions;
+    uint32_t glfwExtensionCount = 0;
+    glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+    requiredExtensions.assign(glfwExtensions,
+                              glfwExtensions + glfwExtensionCount);
+  }
 
-  const char **glfwExtensions;
-  uint32_t glfwExtensionCount = 0;
-  glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-  std::vector<const char *> requiredExtensions{
-      glfwExtensions, glfwExtensions + glfwExtensionCount};
   if (enableValidation) {
     optionalLayers.push_back("VK_LAYER_KHRONOS_validation");
     requiredExtensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -136,8 +147,10 @@ static vk::Context createVkContext(Device *device) {
         &device->debugMessenger));
   }
 
-  glfwCreateWindowSurface(vk::context->instance, device->window, nullptr,
-                          &device->surface);
+  if (!isHeadless) {
+    glfwCreateWindowSurface(vk::context->instance, device->window, nullptr,
+                            &device->surface);
+  }
 
   result.createDevice(device->surface, rx::g_config.gpuIndex,
                       {
@@ -208,19 +221,33 @@ Device::Device() : vkContext(createVkContext(this)) {
     rx::die("failed to deserialize builtin semantics\n");
   }
 
+  if (!rx::g_config.shaderCachePath.empty()) {
+    shaderDiskCache.open(rx::g_config.shaderCachePath);
+  }
+
+  if (!rx::g_config.gpuCapturePath.empty()) {
+    capture.open(rx::g_config.gpuCapturePath, rx::g_config.gpuCaptureFrames);
+  }
+
+  shaderCompiler.start(rx::g_config.shaderCompilerThreads);
+
   for (auto &pipe : graphicsPipes) {
     pipe.device = this;
   }
 
   for (auto &cachePage : cachePages) {
     cachePage = static_cast<std::atomic<std::uint8_t> *>(
-        orbis::kalloc(kCachePageSize, 1));
+        orbis::kalloc(kCachePageSize, alignof(std::uint64_t)));
     std::memset(cachePage, 0, kCachePageSize);
   }
 
   cacheUpdateThread = std::jthread([this](const std::stop_token &stopToken) {
     auto &sched = graphicsPipes[0].scheduler;
     std::uint32_t prevIdleValue = 0;
+    std::vector<rx::AddressRange> ranges[kMaxProcessCount];
+    std::vector<rx::AddressRange> flushedRanges;
+    std::optional<Cache::Tag> tags[kMaxProcessCount];
+
     while (!stopToken.stop_requested()) {
       if (gpuCacheCommandIdle.wait(prevIdleValue) != std::errc{}) {
         continue;
@@ -228,37 +255,93 @@ Device::Device() : vkContext(createVkContext(this)) {
 
       prevIdleValue = gpuCacheCommandIdle.load(std::memory_order::acquire);
 
+      // collect all pending faults and merge them into contiguous ranges
+      bool hasCommands = false;
       for (int vmId = 0; vmId < kMaxProcessCount; ++vmId) {
-        auto page = gpuCacheCommand[vmId].load(std::memory_order::relaxed);
-        if (page == 0) {
+        auto &vmRanges = ranges[vmId];
+        vmRanges.clear();
+
+        for (auto &command : gpuCacheCommands[vmId]) {
+          auto page = command.exchange(0, std::memory_order::acquire);
+          if (page == 0) {
+            continue;
+          }
+
+          cacheFlushFaults.fetch_add(1, std::memory_order::relaxed);
+          vmRanges.push_back(rx::AddressRange::fromBeginSize(
+              static_cast<std::uint64_t>(page) * rx::mem::pageSize,
+              rx::mem::pageSize));
+        }
+
+        if (vmRanges.empty()) {
           continue;
         }
 
-        gpuCacheCommand[vmId].store(0, std::memory_order::relaxed);
-        auto address = static_cast<std::uint64_t>(page) * rx::mem::pageSize;
+        std::ranges::sort(vmRanges, {}, &rx::AddressRange::beginAddress);
 
-        auto range =
-            rx::AddressRange::fromBeginSize(address, rx::mem::pageSize);
-        auto tag = getCacheTag(vmId, sched);
+        std::size_t count = 0;
+        for (auto range : vmRanges) {
+          if (count > 0 &&
+              vmRanges[count - 1].endAddress() >= range.beginAddress()) {
+            vmRanges[count - 1] = vmRanges[count - 1].merge(range);
+          } else {
+            vmRanges[count++] = range;
+          }
+        }
 
-        auto flushedRange = tag.getCache()->flushImages(tag, range);
-        flushedRange =
-            flushedRange.merge(tag.getCache()->flushImageBuffers(tag, range));
+        vmRanges.resize(count);
+        hasCommands = true;
+      }
 
-        if (flushedRange) {
-          sched.submit();
-          sched.wait();
+      if (!hasCommands) {
+        continue;
+      }
+
+      // record copies of all ranges and wait for them at once
+      bool needsSubmit = false;
+      flushedRanges.clear();
+
+      for (int vmId = 0; vmId < kMaxProcessCount; ++vmId) {
+        if (ranges[vmId].empty()) {
+          continue;
         }
 
-        flushedRange = tag.getCache()->flushBuffers(flushedRange);
+        auto &tag = tags[vmId].emplace(getCacheTag(vmId, sched));
+
+        for (auto range : ranges[vmId]) {
+          auto flushedRange = tag.getCache()->flushImages(tag, range);
+          flushedRange =
+              flushedRange.merge(tag.getCache()->flushImageBuffers(tag, range));
 
-        if (flushedRange) {
-          unlockReadWrite(vmId, flushedRange.beginAddress(),
-                          flushedRange.size());
-        } else {
-          unlockReadWrite(vmId, range.beginAddress(), range.size());
+          needsSubmit |= static_cast<bool>(flushedRange);
+          flushedRanges.push_back(flushedRange);
         }
       }
+
+      if (needsSubmit) {
+        sched.submit();
+        sched.wait();
+        cacheFlushSubmits.fetch_add(1, std::memory_order::relaxed);
+      }
+
+      auto flushedRangeIt = flushedRanges.begin();
+      for (int vmId = 0; vmId < kMaxProcessCount; ++vmId) {
+        for (auto range : ranges[vmId]) {
+          auto flushedRange =
+              tags[vmId]->getCache()->flushBuffers(*flushedRangeIt++);
+
+          if (flushedRange) {
+            cacheFlushBytes.fetch_add(flushedRange.size(),
+                                      std::memory_order::relaxed);
+            unlockReadWrite(vmId, flushedRange.beginAddress(),
+                            flushedRange.size());
+          } else {
+            unlockReadWrite(vmId, range.beginAddress(), range.size());
+          }
+        }
+
+        tags[vmId].reset();
+      }
     }
   });
 
@@ -287,8 +370,66 @@ Device::Device() : vkContext(createVkContext(this)) {
 }
 
 Device::~Device() {
+  shaderCompiler.stop();
   vkDeviceWaitIdle(vk::context->device);
 
+  // deferred tasks hold cache tags, release them while caches are alive
+  for (auto &pipe : computePipes) {
+    pipe.scheduler.wait();
+  }
+
+  for (auto &pipe : graphicsPipes) {
+    pipe.scheduler.wait();
+
+    auto stats = pipe.scheduler.getStats();
+    if (stats.submits != 0) {
+      rx::println("graphics pipe {}: {} submits, max {} in flight, {} stalls "
+                  "({} us), {} us waiting",
+                  &pipe - graphicsPipes, stats.submits, stats.maxInFlight,
+                  stats.stalls,
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      stats.stallTime)
+                      .count(),
+                  std::chrono::duration_cast<std::chrono::microseconds>(
+                      stats.waitTime)
+                      .count());
+    }
+  }
+
+  if (auto stats = shaderCompiler.getStats();
+      stats.queued != 0 || stats.overflows != 0) {
+    rx::println("shader compiler: {} queued, {} compiled, {} failed, {} "
+                "overflows, {} evicted, max queue depth {}, {} skipped "
+                "draws, {} us compiling",
+                stats.queued, stats.compiled, stats.failed, stats.overflows,
+                stats.evicted, stats.maxQueueDepth, stats.skippedDraws,
+                stats.compileTime.count());
+  }
+
+  if (auto stats = shaderCompiler.getStats(); stats.irSlabs != 0) {
+    rx::println("shader ir: {} nodes and {} locations in {} arena slabs ({} "
+                "KiB)",
+                stats.irNodes, stats.irLocations, stats.irSlabs,
+                stats.irBytes / 1024);
+  }
+
+  if (shaderDiskCache.isOpen()) {
+    shaderDiskCache.printStats();
+  }
+
+  if (auto faults = cacheFlushFaults.load(std::memory_order::relaxed)) {
+    auto submits = cacheFlushSubmits.load(std::memory_order::relaxed);
+    auto bytes = cacheFlushBytes.load(std::memory_order::relaxed);
+    auto seconds = std::chrono::duration_cast<std::chrono::seconds>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+    rx::println("cache flush: {} faults ({} per second), {} submits, {} bytes "
+                "per submit",
+                faults, faults / std::max<std::uint64_t>(seconds, 1), submits,
+                submits ? bytes / submits : 0);
+  }
+
   if (debugMessenger != VK_NULL_HANDLE) {
     vk::DestroyDebugUtilsMessengerEXT(vk::context->instance, debugMessenger,
                                       vk::context->allocator);
@@ -529,6 +670,10 @@ void Device::start() {
     kbPadState.timestamp =
         std::chrono::high_resolution_clock::now().time_since_epoch().count();
 
+    if (glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS) {
+      capture.requestStart();
+    }
+
     if (glfwWindowShouldClose(window)) {
       rx::shutdown();
       break;
@@ -696,12 +841,16 @@ bool Device::processPipes() {
     if (!pipe.processAllRings()) {
       allProcessed = false;
     }
+
+    pipe.scheduler.retire();
   }
 
   for (auto &pipe : graphicsPipes) {
     if (!pipe.processAllRings()) {
       allProcessed = false;
     }
+
+    pipe.scheduler.retire();
   }
 
   return allProcessed;
@@ -910,7 +1059,65 @@ bool Device::flip(std::uint32_t pid, int bufferIndex, std::uint64_t arg,
   return true;
 }
 
+void Device::captureFrame() {
+  if (capture.nextFrame()) {
+    for (auto &[pid, process] : processInfo) {
+      if (process.vmId < 0) {
+        continue;
+      }
+
+      capture.recordProcess(pid, process.vmId);
+
+      for (auto slot : process.vmTable) {
+        if ((slot->prot >> 4) != 0) {
+          capture.recordMapMemory(process.vmId,
+                                  rx::AddressRange::fromBeginSize(
+                                      slot.beginAddress(), slot.size()));
+        }
+      }
+
+      // resources which are already cached are not read again during capture
+      for (auto range : caches[process.vmId].getTrackedRanges()) {
+        captureMemory(process.vmId, range.beginAddress(), range.size());
+      }
+    }
+
+    // compute registers set before the capture live in the queue doorbells
+    for (auto &pipe : computePipes) {
+      for (int queueId = 0; queueId < ComputePipe::kQueueCount; ++queueId) {
+        auto lock = pipe.lockQueue(queueId);
+        auto &ring = pipe.queues[1][queueId];
+
+        if (ring.size == 0 || ring.doorbell == nullptr) {
+          continue;
+        }
+
+        auto doorbell = std::bit_cast<std::uint64_t>(ring.doorbell) &
+                        ((std::uint64_t(1) << 40) - 1);
+        captureMemory(ring.vmId, doorbell, sizeof(Registers::ComputeConfig));
+      }
+    }
+  }
+
+  if (!capture.isRecording()) {
+    return;
+  }
+
+  for (auto &pipe : graphicsPipes) {
+    std::span<const std::byte> blocks[]{
+        std::as_bytes(std::span(&pipe.sh, 1)),
+        std::as_bytes(std::span(&pipe.context, 1)),
+        std::as_bytes(std::span(&pipe.uConfig, 1)),
+        std::as_bytes(std::span(pipe.constantMemory)),
+    };
+
+    capture.recordRegisters(&pipe - graphicsPipes, blocks);
+  }
+}
+
 void Device::flip(std::uint32_t pid, int bufferIndex, std::uint64_t arg) {
+  captureFrame();
+
   auto recreateSwapchain = [this] {
     int width;
     int height;
@@ -1017,6 +1224,11 @@ void Device::mapMemory(std::uint32_t pid, std::uint64_t address,
     return;
   }
 
+  if (capture.isRecording()) {
+    capture.recordMapMemory(process.vmId,
+                            rx::AddressRange::fromBeginSize(address, size));
+  }
+
   auto memory = amdgpu::RemoteMemory{process.vmId};
 
   int mapFd = process.vmFd;
@@ -1049,58 +1261,20 @@ void Device::unmapMemory(std::uint32_t pid, std::uint64_t address,
   protectMemory(pid, address, size, 0);
 }
 
-static void notifyPageChanges(Device *device, int vmId, std::uint32_t firstPage,
-                              std::uint32_t pageCount) {
-  std::uint64_t command =
-      (static_cast<std::uint64_t>(pageCount - 1) << 32) | firstPage;
-
-  while (true) {
-    for (std::size_t i = 0; i < std::size(device->cpuCacheCommands); ++i) {
-      std::uint64_t expCommand = 0;
-      if (device->cpuCacheCommands[vmId][i].compare_exchange_strong(
-              expCommand, command, std::memory_order::release,
-              std::memory_order::relaxed)) {
-        device->cpuCacheCommandsIdle[vmId].fetch_add(
-            1, std::memory_order::release);
-        device->cpuCacheCommandsIdle[vmId].notify_one();
-
-        while (device->cpuCacheCommands[vmId][i].load(
-                   std::memory_order::acquire) != 0) {
-        }
-        return;
-      }
-    }
-  }
-}
-
 static void modifyWatchFlags(Device *device, int vmId, std::uint64_t address,
                              std::uint64_t size, std::uint8_t addFlags,
                              std::uint8_t removeFlags) {
   auto firstPage = address / rx::mem::pageSize;
   auto lastPage = (address + size + rx::mem::pageSize - 1) / rx::mem::pageSize;
-  bool hasChanges = false;
-  for (auto page = firstPage; page < lastPage; ++page) {
-    auto prevValue =
-        device->cachePages[vmId][page].load(std::memory_order::relaxed);
-    auto newValue = (prevValue & ~removeFlags) | addFlags;
-
-    if (newValue == prevValue) {
-      continue;
-    }
 
-    while (!device->cachePages[vmId][page].compare_exchange_weak(
-        prevValue, newValue, std::memory_order::relaxed)) {
-      newValue = (prevValue & ~removeFlags) | addFlags;
-    }
-
-    if (newValue != prevValue) {
-      hasChanges = true;
-    }
+  if (!modifyPageFlags(device->cachePages[vmId], firstPage, lastPage, addFlags,
+                       removeFlags)) {
+    return;
   }
 
-  if (hasChanges) {
-    notifyPageChanges(device, vmId, firstPage, lastPage - firstPage);
-  }
+  std::uint64_t command =
+      (static_cast<std::uint64_t>(lastPage - firstPage - 1) << 32) | firstPage;
+  device->cpuCacheCommands[vmId].push(command);
 }
 
 void Device::watchWrites(int vmId, std::uint64_t address, std::uint64_t size) {
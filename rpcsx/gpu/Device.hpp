@@ -1,8 +1,11 @@
 #pragma once
 #include "Cache.hpp"
+#include "Capture.hpp"
 #include "DeviceContext.hpp"
 #include "FlipPipeline.hpp"
 #include "Pipe.hpp"
+#include "ShaderCache.hpp"
+#include "ShaderCompiler.hpp"
 #include "amdgpu/tiler_vulkan.hpp"
 #include "orbis/KernelAllocator.hpp"
 #include "rx/MemoryTable.hpp"
@@ -12,6 +15,8 @@
 #include "shader/SpvConverter.hpp"
 #include "shader/gcn.hpp"
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <thread>
 #include <vulkan/vulkan_core.h>
 
@@ -70,6 +75,9 @@ struct Device : rx::RcBase, DeviceContext {
   shader::SemanticInfo gcnSemantic;
   shader::spv::Context shaderSemanticContext;
   shader::gcn::SemanticModuleInfo gcnSemanticModuleInfo;
+  ShaderDiskCache shaderDiskCache;
+  ShaderCompiler shaderCompiler{this};
+  CaptureWriter capture;
   Registers::Config config;
   GLFWwindow *window = nullptr;
   VkSurfaceKHR surface = VK_NULL_HANDLE;
@@ -87,6 +95,11 @@ struct Device : rx::RcBase, DeviceContext {
   bool isImageAcquired = false;
 
   std::jthread cacheUpdateThread;
+  std::chrono::steady_clock::time_point startTime =
+      std::chrono::steady_clock::now();
+  std::atomic<std::uint64_t> cacheFlushFaults{0};
+  std::atomic<std::uint64_t> cacheFlushSubmits{0};
+  std::atomic<std::uint64_t> cacheFlushBytes{0};
 
   int dmemFd[3] = {-1, -1, -1};
   orbis::kmap<std::int32_t, ProcessInfo> processInfo;
@@ -115,6 +128,16 @@ struct Device : rx::RcBase, DeviceContext {
     return caches[vmId].createComputeTag(scheduler);
   }
 
+  void captureMemory(int vmId, std::uint64_t address, std::uint64_t size) {
+    capture.recordMemory(
+        vmId, rx::AddressRange::fromBeginSize(address, size),
+        {RemoteMemory{vmId}.getPointer<const std::byte>(address), size});
+  }
+
+  // Handles frame boundary of the capture, records initial memory state on
+  // the first frame and register state on every frame
+  void captureFrame();
+
   void submitCommand(Ring &ring, std::span<const std::uint32_t> command);
   void submitGfxCommand(int gfxPipe, std::span<const std::uint32_t> command);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "rx/SharedAtomic.hpp"
+#include <algorithm>
 #include <atomic>
 #include <cstdint>
 
@@ -31,6 +32,158 @@ enum {
   kPageLazyLock = 1 << 3
 };
 
+// Page flags are stored one byte per page and updated 8 pages per atomic
+// operation. The page flags array must be aligned to a word boundary
+static constexpr std::uint64_t kPagesInFlagsWord = sizeof(std::uint64_t);
+
+namespace detail {
+inline std::atomic<std::uint64_t> *
+getPageFlagsWords(std::atomic<std::uint8_t> *pages) {
+  return reinterpret_cast<std::atomic<std::uint64_t> *>(pages);
+}
+
+inline std::uint64_t getPageFlagsLaneMask(std::uint64_t firstLane,
+                                          std::uint64_t lastLane) {
+  return (~static_cast<std::uint64_t>(0) >> (64 - (lastLane - firstLane) * 8))
+         << (firstLane * 8);
+}
+
+inline constexpr std::uint64_t kPageFlagsBroadcast = 0x0101'0101'0101'0101;
+} // namespace detail
+
+// Applies flags change to pages [firstPage, lastPage). Returns true if flags
+// of any page were changed
+inline bool modifyPageFlags(std::atomic<std::uint8_t> *pages,
+                            std::uint64_t firstPage, std::uint64_t lastPage,
+                            std::uint8_t addFlags, std::uint8_t removeFlags) {
+  auto words = detail::getPageFlagsWords(pages);
+  bool hasChanges = false;
+
+  for (auto page = firstPage; page < lastPage;) {
+    auto wordIndex = page / kPagesInFlagsWord;
+    auto wordPage = wordIndex * kPagesInFlagsWord;
+    auto laneMask = detail::getPageFlagsLaneMask(
+        page - wordPage, std::min(kPagesInFlagsWord, lastPage - wordPage));
+    auto addMask = addFlags * detail::kPageFlagsBroadcast & laneMask;
+    auto removeMask = removeFlags * detail::kPageFlagsBroadcast & laneMask;
+
+    auto &word = words[wordIndex];
+    auto prevValue = word.load(std::memory_order::relaxed);
+    auto newValue = (prevValue & ~removeMask) | addMask;
+
+    while (newValue != prevValue &&
+           !word.compare_exchange_weak(prevValue, newValue,
+                                       std::memory_order::relaxed)) {
+      newValue = (prevValue & ~removeMask) | addMask;
+    }
+
+    hasChanges |= newValue != prevValue;
+    page = wordPage + kPagesInFlagsWord;
+  }
+
+  return hasChanges;
+}
+
+// Returns true if any page in [firstPage, lastPage) has any of flags set
+inline bool testPageFlags(std::atomic<std::uint8_t> *pages,
+                          std::uint64_t firstPage, std::uint64_t lastPage,
+                          std::uint8_t flags) {
+  auto words = detail::getPageFlagsWords(pages);
+
+  for (auto page = firstPage; page < lastPage;) {
+    auto wordIndex = page / kPagesInFlagsWord;
+    auto wordPage = wordIndex * kPagesInFlagsWord;
+    auto laneMask = detail::getPageFlagsLaneMask(
+        page - wordPage, std::min(kPagesInFlagsWord, lastPage - wordPage));
+
+    if (words[wordIndex].load(std::memory_order::relaxed) &
+        (flags * detail::kPageFlagsBroadcast & laneMask)) {
+      return true;
+    }
+
+    page = wordPage + kPagesInFlagsWord;
+  }
+
+  return false;
+}
+
+// Multiple producers single consumer queue of page range protection updates.
+// Producers reserve a slot by advancing tail and wait until head passes it,
+// consumer processes all published commands as a batch before advancing head
+struct CacheCommandRing {
+  static constexpr std::uint32_t kSize = 64;
+
+  std::atomic<std::uint64_t> commands[kSize]{};
+  std::atomic<std::uint32_t> tail{};
+  rx::shared_atomic32 head{};
+  rx::shared_atomic32 pushCount{};
+
+  void push(std::uint64_t command) {
+    auto index = tail.load(std::memory_order::relaxed);
+
+    while (true) {
+      auto headIndex = head.load(std::memory_order::acquire);
+
+      if (index - headIndex >= kSize) {
+        // ring is full, wait for the consumer
+        (void)head.wait(headIndex);
+        index = tail.load(std::memory_order::relaxed);
+        continue;
+      }
+
+      if (tail.compare_exchange_weak(index, index + 1,
+                                     std::memory_order::relaxed)) {
+        break;
+      }
+    }
+
+    commands[index % kSize].store(command, std::memory_order::release);
+    pushCount.fetch_add(1, std::memory_order::release);
+    pushCount.notify_one();
+
+    while (true) {
+      auto headIndex = head.load(std::memory_order::acquire);
+      if (static_cast<std::int32_t>(headIndex - index) > 0) {
+        break;
+      }
+
+      (void)head.wait(headIndex);
+    }
+  }
+
+  // Consumer side: waits for new commands, passes all published commands to
+  // the handler and acknowledges them at once
+  template <typename HandlerT>
+  void processCommands(std::uint32_t &prevPushCount, HandlerT &&handler) {
+    if (pushCount.wait(prevPushCount) != std::errc{}) {
+      return;
+    }
+
+    prevPushCount = pushCount.load(std::memory_order::acquire);
+
+    auto headIndex = head.load(std::memory_order::relaxed);
+    auto end = headIndex;
+
+    while (end - headIndex < kSize) {
+      auto command =
+          commands[end % kSize].exchange(0, std::memory_order::acquire);
+
+      if (command == 0) {
+        // not published yet, producer will wake us up again
+        break;
+      }
+
+      handler(command);
+      ++end;
+    }
+
+    if (end != headIndex) {
+      head.store(end, std::memory_order::release);
+      head.notify_all();
+    }
+  }
+};
+
 struct PadState {
   std::uint64_t timestamp;
   std::uint32_t unk;
@@ -66,11 +219,12 @@ enum {
 
 struct DeviceContext {
   static constexpr auto kMaxProcessCount = 6;
+  static constexpr auto kGpuCacheCommandSlots = 16;
 
   PadState kbPadState{};
-  std::atomic<std::uint64_t> cpuCacheCommands[kMaxProcessCount][4]{};
-  rx::shared_atomic32 cpuCacheCommandsIdle[kMaxProcessCount]{};
-  rx::shared_atomic32 gpuCacheCommand[kMaxProcessCount]{};
+  CacheCommandRing cpuCacheCommands[kMaxProcessCount];
+  std::atomic<std::uint32_t>
+      gpuCacheCommands[kMaxProcessCount][kGpuCacheCommandSlots]{};
   rx::shared_atomic32 gpuCacheCommandIdle{};
   std::atomic<std::uint8_t> *cachePages[kMaxProcessCount]{};
 
@@ -78,5 +232,22 @@ struct DeviceContext {
   volatile std::uint64_t flipArg[kMaxProcessCount];
   volatile std::uint64_t flipCount[kMaxProcessCount];
   volatile std::uint64_t bufferInUseAddress[kMaxProcessCount];
+
+  // Requests flush of GPU caches of the page to the guest memory. Returns
+  // false if all slots of the process are busy
+  bool pushGpuCacheCommand(int vmId, std::uint32_t page) {
+    for (auto &command : gpuCacheCommands[vmId]) {
+      std::uint32_t expected = 0;
+      if (command.compare_exchange_strong(expected, page,
+                                          std::memory_order::release,
+                                          std::memory_order::relaxed)) {
+        gpuCacheCommandIdle.fetch_add(1, std::memory_order::release);
+        gpuCacheCommandIdle.notify_all();
+        return true;
+      }
+    }
+
+    return false;
+  }
 };
 } // namespace amdgpu
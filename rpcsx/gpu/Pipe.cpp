@@ -156,8 +156,36 @@ bool ComputePipe::processRing(Ring &ring) {
           rx::die("unimplemented COND_EXEC");
         }
 
+        // level 0 packets are recorded once, indirect buffers are recorded
+        // as memory. Not ready packets are retried with the same rptr
+        auto rptr = const_cast<const std::uint32_t *>(ring.rptr);
+        if (device->capture.isRecording() && ring.indirectLevel == 0 &&
+            rptr != capturedRptr[currentQueueId]) {
+          capturedRptr[currentQueueId] = rptr;
+
+          // doorbell holds compute registers of the queue in guest memory
+          auto doorbell = std::bit_cast<std::uint64_t>(ring.doorbell) &
+                          ((std::uint64_t(1) << 40) - 1);
+          // packet may wrap around the ring end
+          auto tail = std::min<std::size_t>(
+              ring.size - (ring.rptr - ring.base), len);
+          device->capture.recordComputePacket(
+              index, currentQueueId, ring.vmId, doorbell, {rptr, tail},
+              {ring.base, len - tail});
+        }
+
         auto handler = commandHandlers[op];
-        if (!(this->*handler)(ring)) {
+        auto startTime = packetStats != nullptr
+                             ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+        bool isDone = (this->*handler)(ring);
+
+        if (packetStats != nullptr) {
+          packetStats->time[op] += std::chrono::steady_clock::now() - startTime;
+          packetStats->count[op] += isDone ? 1 : 0;
+        }
+
+        if (!isDone) {
           if (ring.rptrReportLocation != nullptr) {
             *ring.rptrReportLocation = ring.rptr - ring.base;
           }
@@ -239,6 +267,13 @@ void ComputePipe::submit(int queueId, std::uint32_t offset) {
   ring.wptr = ring.base + offset;
 }
 
+void ComputePipe::captureMemory(int vmId, std::uint64_t address,
+                                std::uint64_t size) {
+  if (device->capture.isRecording()) {
+    device->captureMemory(vmId, address, size);
+  }
+}
+
 bool ComputePipe::setShReg(Ring &ring) {
   auto len = rx::getBits(ring.rptr[0], 29, 16);
   auto offset = ring.rptr[1] & 0xffff;
@@ -294,6 +329,8 @@ bool ComputePipe::dispatchIndirect(Ring &ring) {
   config->computeDispatchInitiator = dispatchInitiator;
   auto buffer = RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(
       drawIndexIndirPatchBase + offset);
+  captureMemory(ring.vmId, drawIndexIndirPatchBase + offset,
+                sizeof(std::uint32_t) * 3);
 
   auto dimX = buffer[0];
   auto dimY = buffer[1];
@@ -370,16 +407,26 @@ bool ComputePipe::waitRegMem(Ring &ring) {
   auto pollInterval = ring.rptr[6];
 
   std::uint32_t pollData;
+  std::uint64_t pollAddress = 0;
 
   if (memSpace == 0) {
     pollData = *getMmRegister(ring, pollAddressLo & ((1 << 16) - 1));
   } else {
-    auto pollAddress = (pollAddressLo & ~3) |
-                       (static_cast<std::uint64_t>(pollAddressHi) << 32);
+    pollAddress = (pollAddressLo & ~3) |
+                  (static_cast<std::uint64_t>(pollAddressHi) << 32);
     pollData = *RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(pollAddress);
   }
 
-  return compare(function, pollData, mask, reference);
+  if (!compare(function, pollData, mask, reference)) {
+    return false;
+  }
+
+  if (memSpace != 0) {
+    // only the satisfied value is recorded, replay must not block on it
+    captureMemory(ring.vmId, pollAddress, sizeof(std::uint32_t));
+  }
+
+  return true;
 }
 
 bool ComputePipe::writeData(Ring &ring) {
@@ -438,6 +485,7 @@ bool ComputePipe::indirectBuffer(Ring &ring) {
   vmId = ring.vmId;
 
   auto rptr = RemoteMemory{vmId}.getPointer<std::uint32_t>(address);
+  captureMemory(vmId, address, ibSize * sizeof(std::uint32_t));
   auto indirectRing = Ring::createFromRange(vmId, rptr, ibSize);
   indirectRing.doorbell = ring.doorbell;
   setIndirectRing(currentQueueId, ring.indirectLevel + 1, indirectRing);
@@ -533,6 +581,7 @@ bool ComputePipe::dmaData(Ring &ring) {
       src = amdgpu::RemoteMemory{ring.vmId}.getPointer(srcAddress);
       device->caches[ring.vmId].flush(
           scheduler, rx::AddressRange::fromBeginSize(srcAddress, size));
+      captureMemory(ring.vmId, srcAddress, size);
     } else {
       src = getMmRegister(ring, srcAddressLo / sizeof(std::uint32_t));
     }
@@ -843,8 +892,32 @@ void GraphicsPipe::processRing(Ring &ring) {
       if (op == gnm::IT_COND_EXEC) {
         std::println("unimplemented COND_EXEC");
       } else {
+        // packets of the main ring are recorded once, before the memory
+        // accessed by them. Not ready packets are retried with the same rptr
+        auto rptr = const_cast<const std::uint32_t *>(ring.rptr);
+        if (device->capture.isRecording() && rptr != capturedRptr &&
+            ring.indirectLevel == 0 &&
+            ring.base == device->mainGfxRings[getIndex()]) {
+          capturedRptr = rptr;
+          // packet may wrap around the ring end
+          auto tail = std::min<std::size_t>(
+              ring.size - (ring.rptr - ring.base), len);
+          device->capture.recordPacket(getIndex(), {rptr, tail},
+                                       {ring.base, len - tail});
+        }
+
         auto handler = commandHandlers[cp][op];
-        if (!(this->*handler)(ring)) {
+        auto startTime = packetStats != nullptr
+                             ? std::chrono::steady_clock::now()
+                             : std::chrono::steady_clock::time_point{};
+        bool isDone = (this->*handler)(ring);
+
+        if (packetStats != nullptr) {
+          packetStats->time[op] += std::chrono::steady_clock::now() - startTime;
+          packetStats->count[op] += isDone ? 1 : 0;
+        }
+
+        if (!isDone) {
           return;
         }
       }
@@ -871,6 +944,15 @@ void GraphicsPipe::processRing(Ring &ring) {
   }
 }
 
+int GraphicsPipe::getIndex() const { return this - device->graphicsPipes; }
+
+void GraphicsPipe::captureMemory(int vmId, std::uint64_t address,
+                                 std::uint64_t size) {
+  if (device->capture.isRecording()) {
+    device->captureMemory(vmId, address, size);
+  }
+}
+
 bool GraphicsPipe::handleNop(Ring &ring) { return true; }
 
 bool GraphicsPipe::setBase(Ring &ring) {
@@ -1014,6 +1096,8 @@ bool GraphicsPipe::dispatchIndirect(Ring &ring) {
   sh.compute.computeDispatchInitiator = dispatchInitiator;
   auto buffer = RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(
       drawIndexIndirPatchBase + offset);
+  captureMemory(ring.vmId, drawIndexIndirPatchBase + offset,
+                sizeof(std::uint32_t) * 3);
 
   auto dimX = buffer[0];
   auto dimY = buffer[1];
@@ -1055,6 +1139,8 @@ bool GraphicsPipe::drawIndirect(Ring &ring) {
 
   auto buffer = RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(
       drawIndexIndirPatchBase + dataOffset);
+  captureMemory(ring.vmId, drawIndexIndirPatchBase + dataOffset,
+                sizeof(std::uint32_t) * 4);
 
   std::uint32_t vertexCountPerInstance = buffer[0];
   std::uint32_t instanceCount = buffer[1];
@@ -1072,6 +1158,8 @@ bool GraphicsPipe::drawIndexIndirect(Ring &ring) {
 
   auto buffer = RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(
       drawIndexIndirPatchBase + dataOffset);
+  captureMemory(ring.vmId, drawIndexIndirPatchBase + dataOffset,
+                sizeof(std::uint32_t) * 5);
 
   context.vgtDrawInitiator = drawInitiator;
 
@@ -1214,16 +1302,26 @@ bool GraphicsPipe::waitRegMem(Ring &ring) {
   auto pollInterval = ring.rptr[6];
 
   std::uint32_t pollData;
+  std::uint64_t pollAddress = 0;
 
   if (memSpace == 0) {
     pollData = *getMmRegister(pollAddressLo & ((1 << 16) - 1));
   } else {
-    auto pollAddress = (pollAddressLo & ~3) |
-                       (static_cast<std::uint64_t>(pollAddressHi) << 32);
+    pollAddress = (pollAddressLo & ~3) |
+                  (static_cast<std::uint64_t>(pollAddressHi) << 32);
     pollData = *RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(pollAddress);
   }
 
-  return compare(function, pollData, mask, reference);
+  if (!compare(function, pollData, mask, reference)) {
+    return false;
+  }
+
+  if (memSpace != 0) {
+    // only the satisfied value is recorded, replay must not block on it
+    captureMemory(ring.vmId, pollAddress, sizeof(std::uint32_t));
+  }
+
+  return true;
 }
 
 bool GraphicsPipe::indirectBufferConst(Ring &ring) {
@@ -1240,6 +1338,7 @@ bool GraphicsPipe::indirectBufferConst(Ring &ring) {
   }
 
   auto rptr = RemoteMemory{vmId}.getPointer<std::uint32_t>(address);
+  captureMemory(vmId, address, ibSize * sizeof(std::uint32_t));
   setCeQueue(Ring::createFromRange(vmId, rptr, ibSize));
   return true;
 }
@@ -1256,6 +1355,7 @@ bool GraphicsPipe::indirectBuffer(Ring &ring) {
     vmId = ring.vmId;
   }
   auto rptr = RemoteMemory{vmId}.getPointer<std::uint32_t>(address);
+  captureMemory(vmId, address, ibSize * sizeof(std::uint32_t));
   setDeQueue(Ring::createFromRange(vmId, rptr, ibSize), ring.indirectLevel + 1);
   return true;
 }
@@ -1611,6 +1711,15 @@ bool GraphicsPipe::loadUConfigReg(Ring &ring) {
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
 
+  if (device->capture.isRecording()) {
+    std::uint64_t size = 0;
+    for (auto range : std::span{ranges, len / 2}) {
+      size += range.count * sizeof(std::uint32_t);
+    }
+
+    captureMemory(ring.vmId, address, size);
+  }
+
   for (auto range : std::span{ranges, len / 2}) {
     // std::println(stderr, "loadUConfigReg: address={} regOffset={}
     // numWords={}",
@@ -1642,6 +1751,15 @@ bool GraphicsPipe::loadShReg(Ring &ring) {
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
 
+  if (device->capture.isRecording()) {
+    std::uint64_t size = 0;
+    for (auto range : std::span{ranges, len / 2}) {
+      size += range.count * sizeof(std::uint32_t);
+    }
+
+    captureMemory(ring.vmId, address, size);
+  }
+
   for (auto range : std::span{ranges, len / 2}) {
     // std::println(stderr, "loadShReg: address={} regOffset={} numWords={}",
     // data,
@@ -1673,6 +1791,15 @@ bool GraphicsPipe::loadConfigReg(Ring &ring) {
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
 
+  if (device->capture.isRecording()) {
+    std::uint64_t size = 0;
+    for (auto range : std::span{ranges, len / 2}) {
+      size += range.count * sizeof(std::uint32_t);
+    }
+
+    captureMemory(ring.vmId, address, size);
+  }
+
   for (auto range : std::span{ranges, len / 2}) {
     // std::println(stderr, "loadConfigReg: address={} regOffset={}
     // numWords={}",
@@ -1704,6 +1831,15 @@ bool GraphicsPipe::loadContextReg(Ring &ring) {
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
 
+  if (device->capture.isRecording()) {
+    std::uint64_t size = 0;
+    for (auto range : std::span{ranges, len / 2}) {
+      size += range.count * sizeof(std::uint32_t);
+    }
+
+    captureMemory(ring.vmId, address, size);
+  }
+
   for (auto range : std::span{ranges, len / 2}) {
     // std::println(stderr, "loadContextReg: address={} regOffset={}
     // numWords={}",
@@ -1900,6 +2036,7 @@ bool GraphicsPipe::loadConstRam(Ring &ring) {
   std::uint32_t offset =
       (ring.rptr[4] & ((1 << 16) - 1)) / sizeof(std::uint32_t);
   auto address = addressLo | (static_cast<std::uint64_t>(addressHi) << 32);
+  captureMemory(ring.vmId, address, numDw * sizeof(std::uint32_t));
   std::memcpy(constantMemory + offset,
               RemoteMemory{ring.vmId}.getPointer(address),
               numDw * sizeof(std::uint32_t));
@@ -1979,6 +2116,8 @@ bool GraphicsPipe::loadContextRegIndex(Ring &ring) {
       addressLo | (static_cast<std::uint64_t>(addressHiOffset) << 32);
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
+  captureMemory(ring.vmId, address,
+                sizeof(std::uint32_t) * numWords * (dataFormat == 0 ? 1 : 2));
 
   constexpr auto mmioOffset = Registers::Context::kMmioOffset;
 
@@ -2045,6 +2184,8 @@ bool GraphicsPipe::loadShRegIndex(Ring &ring) {
       addressLo | (static_cast<std::uint64_t>(addressHiOffset) << 32);
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
+  captureMemory(ring.vmId, address,
+                sizeof(std::uint32_t) * numWords * (dataFormat == 0 ? 1 : 2));
 
   constexpr auto mmioOffset = Registers::ShaderConfig::kMmioOffset;
 
@@ -2106,6 +2247,8 @@ bool GraphicsPipe::loadUConfigRegIndex(Ring &ring) {
       addressLo | (static_cast<std::uint64_t>(addressHiOffset) << 32);
   auto data =
       amdgpu::RemoteMemory{ring.vmId}.getPointer<std::uint32_t>(address);
+  captureMemory(ring.vmId, address,
+                sizeof(std::uint32_t) * numWords * (dataFormat == 0 ? 1 : 2));
 
   constexpr auto mmioOffset = Registers::UConfig::kMmioOffset;
 
@@ -3,6 +3,7 @@
 #include "Scheduler.hpp"
 #include "rx/SharedMutex.hpp"
 
+#include <chrono>
 #include <cstdint>
 #include <vulkan/vulkan_core.h>
 
@@ -34,6 +35,13 @@ struct Ring {
   }
 };
 
+// CPU time spent in command handlers per PM4 opcode. Handlers which are not
+// ready yet are retried, their time is accounted but not counted
+struct PacketStats {
+  std::uint64_t count[256]{};
+  std::chrono::nanoseconds time[256]{};
+};
+
 struct ComputePipe {
   static constexpr auto kRingsPerQueue = 2;
   static constexpr auto kQueueCount = 8;
@@ -47,6 +55,8 @@ struct ComputePipe {
   int currentQueueId;
   Ring queues[kRingsPerQueue][kQueueCount];
   std::uint64_t drawIndexIndirPatchBase = 0;
+  PacketStats *packetStats = nullptr;
+  const std::uint32_t *capturedRptr[kQueueCount]{};
 
   ComputePipe(int index);
 
@@ -75,6 +85,7 @@ struct ComputePipe {
   bool handleNop(Ring &ring);
 
   std::uint32_t *getMmRegister(Ring &ring, std::uint32_t dwAddress);
+  void captureMemory(int vmId, std::uint64_t address, std::uint64_t size);
 };
 
 struct EopFlipRequest {
@@ -116,6 +127,9 @@ struct GraphicsPipe {
   using CommandHandler = bool (GraphicsPipe::*)(Ring &);
   CommandHandler commandHandlers[4][255];
 
+  PacketStats *packetStats = nullptr;
+  const std::uint32_t *capturedRptr = nullptr;
+
   GraphicsPipe(int index);
 
   void setCeQueue(Ring ring);
@@ -185,6 +199,8 @@ struct GraphicsPipe {
   bool switchBuffer(Ring &ring);
 
   std::uint32_t *getMmRegister(std::uint32_t dwAddress);
+  int getIndex() const;
+  void captureMemory(int vmId, std::uint64_t address, std::uint64_t size);
 };
 
 struct CommandPipe {
@@ -1,6 +1,7 @@
 #include "Renderer.hpp"
 #include "Device.hpp"
 #include "gnm/gnm.hpp"
+#include "rx/Config.hpp"
 #include "rx/print.hpp"
 
 #include <amdgpu/tiler.hpp>
@@ -451,8 +452,13 @@ void amdgpu::draw(GraphicsPipe &pipe, int vmId, std::uint32_t firstVertex,
   auto pipelineLayout = cacheTag.getGraphicsPipelineLayout();
   auto descriptorSets = cacheTag.getDescriptorSets();
   Cache::Shader vertexShader;
+  Cache::Shader pixelShader;
+
+  auto getVertexShader = [&] {
+    if (pipe.context.vgtShaderStagesEn.vsEn != amdgpu::VsStage::VsReal) {
+      return;
+    }
 
-  if (pipe.context.vgtShaderStagesEn.vsEn == amdgpu::VsStage::VsReal) {
     gnm::PrimitiveType vsPrimType = {};
     if (indexBuffer.handle == VK_NULL_HANDLE &&
         pipe.uConfig.vgtPrimitiveType != indexBuffer.primType) {
@@ -465,15 +471,45 @@ void amdgpu::draw(GraphicsPipe &pipe, int vmId, std::uint32_t firstVertex,
     vertexShader = cacheTag.getVertexShader(
         gcn::Stage::VsVs, pipe.sh.spiShaderPgmVs, pipe.context, indexOffset,
         vsPrimType, viewPorts);
+  };
+
+  auto getPixelShader = [&] {
+    if (pipe.sh.spiShaderPgmPs.address == 0) {
+      return;
+    }
+
+    pixelShader = cacheTag.getPixelShader(pipe.sh.spiShaderPgmPs,
+                                          pipe.context, viewPorts);
+  };
+
+  getVertexShader();
+  getPixelShader();
+
+  // both stages are requested before waiting, so they are compiled in
+  // parallel by background compiler
+  while (vertexShader.isPending() || pixelShader.isPending()) {
+    if (rx::g_config.skipDrawsWhileCompiling) {
+      pipe.device->shaderCompiler.onDrawSkipped();
+      pipe.scheduler.submit();
+      pipe.scheduler.wait();
+      return;
+    }
+
+    if (vertexShader.isPending()) {
+      vertexShader.pendingJob->wait();
+      getVertexShader();
+    }
+
+    if (pixelShader.isPending()) {
+      pixelShader.pendingJob->wait();
+      getPixelShader();
+    }
   }
 
   shaders[Cache::getStageIndex(VK_SHADER_STAGE_VERTEX_BIT)] =
       vertexShader.handle;
 
   if (pipe.sh.spiShaderPgmPs.address != 0) {
-    auto pixelShader = cacheTag.getPixelShader(pipe.sh.spiShaderPgmPs,
-                                               pipe.context, viewPorts);
-
     shaders[Cache::getStageIndex(VK_SHADER_STAGE_FRAGMENT_BIT)] =
         pixelShader.handle != nullptr
             ? pixelShader.handle
@@ -605,6 +641,11 @@ void amdgpu::dispatch(Cache &cache, Scheduler &sched,
   auto tag = cache.createComputeTag(sched);
   auto descriptorSet = tag.getDescriptorSet();
   auto shader = tag.getShader(pgm);
+  while (shader.isPending()) {
+    shader.pendingJob->wait();
+    shader = tag.getShader(pgm);
+  }
+
   auto pipelineLayout = tag.getComputePipelineLayout();
   tag.buildDescriptors(descriptorSet);
 
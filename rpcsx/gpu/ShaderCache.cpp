@@ -0,0 +1,271 @@
+#include "ShaderCache.hpp"
+#include "rx/Serializer.hpp"
+#include "rx/print.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace amdgpu;
+
+static constexpr std::uint64_t kShaderCacheMagic = 0x4843'4148'5358'5852;
+
+// Must be bumped on every change of the GCN converter output or of the
+// serialized layout
+static constexpr std::uint32_t kShaderCacheVersion = 2;
+
+namespace {
+struct BufferSerializer : rx::Serializer {
+  std::vector<std::byte> data;
+
+  void write(std::span<const std::byte> bytes) override {
+    data.insert(data.end(), bytes.begin(), bytes.end());
+  }
+};
+
+struct BufferDeserializer : rx::Deserializer {
+  std::span<const std::byte> data;
+
+  BufferDeserializer(std::span<const std::byte> data) : data(data) {}
+
+  void read(std::span<std::byte> bytes) override {
+    if (bytes.size() > data.size()) {
+      setFailure();
+      std::memset(bytes.data(), 0, bytes.size());
+      data = {};
+      return;
+    }
+
+    std::memcpy(bytes.data(), data.data(), bytes.size());
+    data = data.subspan(bytes.size());
+  }
+};
+
+struct FileHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t pad;
+};
+} // namespace
+
+ShaderCacheKey ShaderCacheKey::createFrom(std::uint64_t address,
+                                          std::uint64_t magic,
+                                          shader::gcn::Stage stage,
+                                          const shader::gcn::Environment &env) {
+  std::uint8_t features = 0;
+  features |= env.supportsBarycentric ? 1 << 0 : 0;
+  features |= env.supportsInt8 ? 1 << 1 : 0;
+  features |= env.supportsInt64Atomics ? 1 << 2 : 0;
+  features |= env.supportsNonSemanticInfo ? 1 << 3 : 0;
+  features |= env.optimize ? 1 << 4 : 0;
+
+  return {
+      .address = address,
+      .magic = magic,
+      .stage = stage,
+      .vgprCount = env.vgprCount,
+      .sgprCount = env.sgprCount,
+      .numThreadX = env.numThreadX,
+      .numThreadY = env.numThreadY,
+      .numThreadZ = env.numThreadZ,
+      .features = features,
+  };
+}
+
+void ShaderDiskCache::open(const std::filesystem::path &directory) {
+  std::lock_guard lock(mMtx);
+
+  std::error_code ec;
+  std::filesystem::create_directories(directory, ec);
+  auto path = directory / "shaders.bin";
+
+  bool isValid = false;
+  {
+    std::ifstream in(path, std::ios::binary);
+    std::vector<std::byte> data;
+
+    if (in) {
+      in.seekg(0, std::ios::end);
+      data.resize(in.tellg());
+      in.seekg(0, std::ios::beg);
+      in.read(reinterpret_cast<char *>(data.data()), data.size());
+    }
+
+    FileHeader header{};
+    if (data.size() >= sizeof(header)) {
+      std::memcpy(&header, data.data(), sizeof(header));
+      isValid = header.magic == kShaderCacheMagic &&
+                header.version == kShaderCacheVersion;
+    }
+
+    if (isValid) {
+      auto records = std::span(data).subspan(sizeof(header));
+
+      while (records.size() >= sizeof(std::uint32_t)) {
+        std::uint32_t recordSize;
+        std::memcpy(&recordSize, records.data(), sizeof(recordSize));
+        records = records.subspan(sizeof(recordSize));
+
+        if (recordSize > records.size() ||
+            !loadRecord(records.subspan(0, recordSize))) {
+          // truncated tail, probably the emulator was killed during write
+          rx::println(stderr, "shader cache: dropping damaged tail of {}",
+                      path.string());
+          break;
+        }
+
+        records = records.subspan(recordSize);
+      }
+    }
+  }
+
+  if (isValid) {
+    mFile.open(path, std::ios::binary | std::ios::app);
+  } else {
+    mRecords.clear();
+    mFile.open(path, std::ios::binary | std::ios::trunc);
+
+    FileHeader header{
+        .magic = kShaderCacheMagic,
+        .version = kShaderCacheVersion,
+    };
+
+    mFile.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    mFile.flush();
+  }
+
+  if (!mFile) {
+    rx::println(stderr, "shader cache: failed to open {}", path.string());
+    mFile.close();
+    return;
+  }
+
+  rx::println("shader cache: loaded {} shaders from {}",
+              mLoaded.load(std::memory_order::relaxed), path.string());
+}
+
+void ShaderDiskCache::close() {
+  std::lock_guard lock(mMtx);
+  mFile.close();
+  mRecords.clear();
+}
+
+bool ShaderDiskCache::loadRecord(std::span<const std::byte> data) {
+  BufferDeserializer s(data);
+
+  auto key = s.deserialize<ShaderCacheKey>();
+
+  Record record;
+  s.deserialize(record.requiredSgprs);
+  s.deserialize(record.usedMemory);
+
+  if (s.failure()) {
+    return false;
+  }
+
+  record.payload.assign(s.data.begin(), s.data.end());
+  mRecords.emplace(key, std::move(record));
+  mLoaded.fetch_add(1, std::memory_order::relaxed);
+  return true;
+}
+
+std::optional<shader::gcn::ConvertedShader>
+ShaderDiskCache::find(const ShaderCacheKey &key,
+                      std::span<const std::uint32_t> userSgprs,
+                      MemoryMatcher matchMemory) {
+  std::lock_guard lock(mMtx);
+
+  auto [beginIt, endIt] = mRecords.equal_range(key);
+
+  for (auto it = beginIt; it != endIt; ++it) {
+    auto &record = it->second;
+
+    bool matches = std::ranges::all_of(
+        record.requiredSgprs, [&](std::pair<int, std::uint32_t> sgpr) {
+          return static_cast<std::size_t>(sgpr.first) < userSgprs.size() &&
+                 userSgprs[sgpr.first] == sgpr.second;
+        });
+
+    matches = matches && std::ranges::all_of(record.usedMemory, [&](auto &mem) {
+                return matchMemory(mem.first, mem.second);
+              });
+
+    if (!matches) {
+      continue;
+    }
+
+    BufferDeserializer s(record.payload);
+    shader::gcn::ConvertedShader result;
+    s.deserialize(result.spv);
+    result.info.deserialize(s);
+
+    if (s.failure()) {
+      mRejected.fetch_add(1, std::memory_order::relaxed);
+      mRecords.erase(it);
+      break;
+    }
+
+    mHits.fetch_add(1, std::memory_order::relaxed);
+    return result;
+  }
+
+  mMisses.fetch_add(1, std::memory_order::relaxed);
+  return {};
+}
+
+void ShaderDiskCache::store(
+    const ShaderCacheKey &key, const shader::gcn::ConvertedShader &shader,
+    std::span<const std::pair<std::uint64_t, std::vector<std::byte>>>
+        usedMemory) {
+  if (!shader.info.isSerializable()) {
+    mRejected.fetch_add(1, std::memory_order::relaxed);
+    return;
+  }
+
+  Record record;
+  record.requiredSgprs = shader.info.requiredSgprs;
+  record.usedMemory.assign(usedMemory.begin(), usedMemory.end());
+
+  BufferSerializer payload;
+  payload.serialize(shader.spv);
+  shader.info.serialize(payload);
+  record.payload = std::move(payload.data);
+
+  BufferSerializer s;
+  s.serialize(key);
+  s.serialize(record.requiredSgprs);
+  s.serialize(record.usedMemory);
+  s.write(record.payload);
+
+  std::lock_guard lock(mMtx);
+  if (!mFile.is_open()) {
+    return;
+  }
+
+  auto recordSize = static_cast<std::uint32_t>(s.data.size());
+  mFile.write(reinterpret_cast<const char *>(&recordSize), sizeof(recordSize));
+  mFile.write(reinterpret_cast<const char *>(s.data.data()), s.data.size());
+  mFile.flush();
+
+  mRecords.emplace(key, std::move(record));
+  mStored.fetch_add(1, std::memory_order::relaxed);
+}
+
+ShaderDiskCache::Stats ShaderDiskCache::getStats() const {
+  return {
+      .loaded = mLoaded.load(std::memory_order::relaxed),
+      .hits = mHits.load(std::memory_order::relaxed),
+      .misses = mMisses.load(std::memory_order::relaxed),
+      .stored = mStored.load(std::memory_order::relaxed),
+      .rejected = mRejected.load(std::memory_order::relaxed),
+  };
+}
+
+void ShaderDiskCache::printStats() const {
+  auto stats = getStats();
+  auto lookups = stats.hits + stats.misses;
+
+  rx::println("shader cache: {} loaded, {} hits, {} misses ({}% hit rate), "
+              "{} stored, {} rejected",
+              stats.loaded, stats.hits, stats.misses,
+              lookups ? stats.hits * 100 / lookups : 0, stats.stored,
+              stats.rejected);
+}
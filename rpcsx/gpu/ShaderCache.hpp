@@ -0,0 +1,91 @@
+#pragma once
+
+#include "rx/FunctionRef.hpp"
+#include "shader/GcnConverter.hpp"
+#include "shader/gcn.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <vector>
+
+namespace amdgpu {
+struct ShaderCacheKey {
+  std::uint64_t address;
+  std::uint64_t magic;
+  shader::gcn::Stage stage;
+  std::uint8_t vgprCount;
+  std::uint8_t sgprCount;
+  std::uint8_t numThreadX;
+  std::uint8_t numThreadY;
+  std::uint8_t numThreadZ;
+  std::uint8_t features;
+
+  static ShaderCacheKey createFrom(std::uint64_t address, std::uint64_t magic,
+                                   shader::gcn::Stage stage,
+                                   const shader::gcn::Environment &env);
+
+  auto operator<=>(const ShaderCacheKey &) const = default;
+};
+
+// Persistent storage of converted shaders. Entries are looked up by shader
+// address, code magic and environment, then validated against the user SGPRs
+// and guest memory snapshot captured at conversion time.
+class ShaderDiskCache {
+public:
+  using MemoryMatcher =
+      rx::FunctionRef<bool(std::uint64_t, std::span<const std::byte>)>;
+
+  struct Stats {
+    std::uint64_t loaded;
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t stored;
+    std::uint64_t rejected;
+  };
+
+  ShaderDiskCache() = default;
+  ShaderDiskCache(const ShaderDiskCache &) = delete;
+
+  void open(const std::filesystem::path &directory);
+  void close();
+
+  [[nodiscard]] bool isOpen() const { return mFile.is_open(); }
+
+  std::optional<shader::gcn::ConvertedShader>
+  find(const ShaderCacheKey &key, std::span<const std::uint32_t> userSgprs,
+       MemoryMatcher matchMemory);
+
+  void store(const ShaderCacheKey &key,
+             const shader::gcn::ConvertedShader &shader,
+             std::span<const std::pair<std::uint64_t, std::vector<std::byte>>>
+                 usedMemory);
+
+  [[nodiscard]] Stats getStats() const;
+  void printStats() const;
+
+private:
+  struct Record {
+    std::vector<std::pair<int, std::uint32_t>> requiredSgprs;
+    std::vector<std::pair<std::uint64_t, std::vector<std::byte>>> usedMemory;
+    std::vector<std::byte> payload;
+  };
+
+  bool loadRecord(std::span<const std::byte> data);
+
+  std::mutex mMtx;
+  std::ofstream mFile;
+  std::multimap<ShaderCacheKey, Record> mRecords;
+
+  std::atomic<std::uint64_t> mLoaded{0};
+  std::atomic<std::uint64_t> mHits{0};
+  std::atomic<std::uint64_t> mMisses{0};
+  std::atomic<std::uint64_t> mStored{0};
+  std::atomic<std::uint64_t> mRejected{0};
+};
+} // namespace amdgpu
@@ -0,0 +1,263 @@
+#include "ShaderCompiler.hpp"
+#include "Device.hpp"
+#include "ShaderCache.hpp"
+#include "rx/Config.hpp"
+#include "rx/print.hpp"
+#include "shader/glsl.hpp"
+#include "shader/spv.hpp"
+#include "vk.hpp"
+#include <cstring>
+
+using namespace amdgpu;
+using namespace shader;
+
+ShaderCompileJob::~ShaderCompileJob() {
+  if (handle != VK_NULL_HANDLE) {
+    vk::DestroyShaderEXT(vk::context->device, handle, vk::context->allocator);
+  }
+}
+
+ShaderCompiler::JobKey
+ShaderCompiler::JobKey::createFrom(const ShaderCompileJob &job) {
+  return {
+      .vmId = job.vmId,
+      .address = job.address,
+      .stage = job.stage,
+      .vgprCount = job.env.vgprCount,
+      .sgprCount = job.env.sgprCount,
+      .numThreadX = job.env.numThreadX,
+      .numThreadY = job.env.numThreadY,
+      .numThreadZ = job.env.numThreadZ,
+      .userSgprs = job.userSgprs,
+  };
+}
+
+void ShaderCompiler::start(unsigned workerCount) {
+  for (unsigned i = 0; i < workerCount; ++i) {
+    mWorkers.emplace_back(
+        [this](const std::stop_token &stopToken) { workerEntry(stopToken); });
+  }
+}
+
+void ShaderCompiler::stop() {
+  for (auto &worker : mWorkers) {
+    worker.request_stop();
+  }
+
+  mCv.notify_all();
+  mWorkers.clear();
+
+  std::lock_guard lock(mMtx);
+  for (auto &queue : mQueues) {
+    queue.clear();
+  }
+  mJobs.clear();
+  mCompletedJobs.clear();
+}
+
+std::shared_ptr<ShaderCompileJob>
+ShaderCompiler::submit(std::shared_ptr<ShaderCompileJob> job) {
+  std::lock_guard lock(mMtx);
+
+  auto [it, inserted] = mJobs.try_emplace(JobKey::createFrom(*job));
+  if (!inserted) {
+    return it->second;
+  }
+
+  auto lane = job->stage == gcn::Stage::Ps ? kLowPriorityLane
+                                           : kHighPriorityLane;
+
+  if (mQueues[lane].size() >= kMaxQueuedJobs) {
+    mJobs.erase(it);
+    mOverflows.fetch_add(1, std::memory_order::relaxed);
+    return {};
+  }
+
+  it->second = job;
+  mQueues[lane].push_back(std::move(job));
+  mQueued.fetch_add(1, std::memory_order::relaxed);
+
+  std::uint64_t queueDepth =
+      mQueues[kHighPriorityLane].size() + mQueues[kLowPriorityLane].size();
+  if (queueDepth > mMaxQueueDepth.load(std::memory_order::relaxed)) {
+    mMaxQueueDepth.store(queueDepth, std::memory_order::relaxed);
+  }
+  mCv.notify_one();
+  return it->second;
+}
+
+void ShaderCompiler::release(const std::shared_ptr<ShaderCompileJob> &job) {
+  std::lock_guard lock(mMtx);
+
+  if (auto it = mJobs.find(JobKey::createFrom(*job));
+      it != mJobs.end() && it->second == job) {
+    mJobs.erase(it);
+  }
+}
+
+void ShaderCompiler::compile(ShaderCompileJob &job) {
+  RemoteMemory memory{job.vmId};
+
+  job.env.userSgprs = job.userSgprs;
+  job.env.supportsBarycentric = vk::context->supportsBarycentric;
+  job.env.supportsInt8 = vk::context->supportsInt8;
+  job.env.supportsInt64Atomics = vk::context->supportsInt64Atomics;
+  job.env.supportsNonSemanticInfo = vk::context->supportsNonSemanticInfo;
+  job.env.optimize = rx::g_config.optimizeShaders;
+
+  std::memcpy(&job.magic, memory.getPointer(job.address), sizeof(job.magic));
+
+  auto &diskCache = mDevice->shaderDiskCache;
+  auto diskCacheKey =
+      ShaderCacheKey::createFrom(job.address, job.magic, job.stage, job.env);
+  bool isLoadedFromDisk = false;
+
+  if (diskCache.isOpen()) {
+    job.converted = diskCache.find(
+        diskCacheKey, job.userSgprs,
+        [&](std::uint64_t address, std::span<const std::byte> data) {
+          return std::memcmp(memory.getPointer(address), data.data(),
+                             data.size()) == 0;
+        });
+
+    isLoadedFromDisk = job.converted.has_value();
+  }
+
+  auto complete = [&] {
+    job.mDone.store(true, std::memory_order::release);
+    job.mDone.notify_all();
+  };
+
+  if (!job.converted) {
+    gcn::Context context;
+    auto deserialized = gcn::deserialize(
+        context, job.env, mDevice->gcnSemantic, job.address,
+        [&](std::uint64_t address) -> std::uint32_t {
+          return *memory.getPointer<std::uint32_t>(address);
+        });
+
+    // deserialized.print(std::cerr, context.ns);
+
+    job.converted =
+        gcn::convertToSpv(context, deserialized, mDevice->gcnSemantic,
+                          mDevice->gcnSemanticModuleInfo, job.stage, job.env);
+
+    auto irStats = context.getStats();
+    mIrNodes.fetch_add(irStats.nodeCount, std::memory_order::relaxed);
+    mIrLocations.fetch_add(irStats.locationCount, std::memory_order::relaxed);
+    mIrSlabs.fetch_add(irStats.slabCount, std::memory_order::relaxed);
+    mIrBytes.fetch_add(irStats.allocatedBytes, std::memory_order::relaxed);
+    if (!job.converted) {
+      mFailed.fetch_add(1, std::memory_order::relaxed);
+      complete();
+      return;
+    }
+
+    job.converted->info.resources.dump();
+    if (!shader::spv::validate(job.converted->spv)) {
+      shader::spv::dump(job.converted->spv, true);
+      job.converted.reset();
+      mFailed.fetch_add(1, std::memory_order::relaxed);
+      complete();
+      return;
+    }
+
+    rx::print(stderr, "{}", shader::glsl::decompile(job.converted->spv));
+  }
+
+  for (auto entry : job.converted->info.memoryMap) {
+    auto &inserted = job.usedMemory.emplace_back();
+    inserted.first = entry.beginAddress;
+    inserted.second.resize(entry.endAddress - entry.beginAddress);
+    std::memcpy(inserted.second.data(), memory.getPointer(entry.beginAddress),
+                inserted.second.size());
+  }
+
+  if (diskCache.isOpen() && !isLoadedFromDisk) {
+    diskCache.store(diskCacheKey, *job.converted, job.usedMemory);
+  }
+
+  VkShaderCreateInfoEXT createInfo{
+      .sType = VK_STRUCTURE_TYPE_SHADER_CREATE_INFO_EXT,
+      .flags = 0,
+      .stage = job.vkStage,
+      .codeType = VK_SHADER_CODE_TYPE_SPIRV_EXT,
+      .codeSize = job.converted->spv.size() * sizeof(job.converted->spv[0]),
+      .pCode = job.converted->spv.data(),
+      .pName = "main",
+      .setLayoutCount = static_cast<uint32_t>(job.setLayouts.size()),
+      .pSetLayouts = job.setLayouts.data()};
+
+  VK_VERIFY(vk::CreateShadersEXT(vk::context->device, 1, &createInfo,
+                                 vk::context->allocator, &job.handle));
+
+  mCompiled.fetch_add(1, std::memory_order::relaxed);
+  complete();
+}
+
+void ShaderCompiler::workerEntry(const std::stop_token &stopToken) {
+  while (true) {
+    std::shared_ptr<ShaderCompileJob> job;
+
+    {
+      std::unique_lock lock(mMtx);
+      if (!mCv.wait(lock, stopToken, [this] {
+            return !mQueues[kHighPriorityLane].empty() ||
+                   !mQueues[kLowPriorityLane].empty();
+          })) {
+        return;
+      }
+
+      auto &queue = mQueues[kHighPriorityLane].empty()
+                        ? mQueues[kLowPriorityLane]
+                        : mQueues[kHighPriorityLane];
+      job = std::move(queue.front());
+      queue.pop_front();
+    }
+
+    auto startTime = std::chrono::steady_clock::now();
+    compile(*job);
+    mCompileTimeUs.fetch_add(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - startTime)
+            .count(),
+        std::memory_order::relaxed);
+
+    std::lock_guard lock(mMtx);
+    mCompletedJobs.push_back(job);
+
+    while (mCompletedJobs.size() > kMaxCompletedJobs) {
+      auto completed = mCompletedJobs.front().lock();
+      mCompletedJobs.pop_front();
+
+      if (completed == nullptr) {
+        continue;
+      }
+
+      // nobody took the job since it was finished, drop it from the table
+      if (auto it = mJobs.find(JobKey::createFrom(*completed));
+          it != mJobs.end() && it->second == completed) {
+        mJobs.erase(it);
+        mEvicted.fetch_add(1, std::memory_order::relaxed);
+      }
+    }
+  }
+}
+
+ShaderCompiler::Stats ShaderCompiler::getStats() const {
+  return {
+      .queued = mQueued.load(std::memory_order::relaxed),
+      .compiled = mCompiled.load(std::memory_order::relaxed),
+      .failed = mFailed.load(std::memory_order::relaxed),
+      .overflows = mOverflows.load(std::memory_order::relaxed),
+      .evicted = mEvicted.load(std::memory_order::relaxed),
+      .skippedDraws = mSkippedDraws.load(std::memory_order::relaxed),
+      .maxQueueDepth = mMaxQueueDepth.load(std::memory_order::relaxed),
+      .compileTime = std::chrono::microseconds(
+          mCompileTimeUs.load(std::memory_order::relaxed)),
+      .irNodes = mIrNodes.load(std::memory_order::relaxed),
+      .irLocations = mIrLocations.load(std::memory_order::relaxed),
+      .irSlabs = mIrSlabs.load(std::memory_order::relaxed),
+      .irBytes = mIrBytes.load(std::memory_order::relaxed),
+  };
+}
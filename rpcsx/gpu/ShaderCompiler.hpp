@@ -0,0 +1,149 @@
+#pragma once
+
+#include "shader/GcnConverter.hpp"
+#include "shader/gcn.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <vulkan/vulkan_core.h>
+
+namespace amdgpu {
+struct Device;
+
+struct ShaderCompileJob {
+  int vmId;
+  std::uint64_t address;
+  shader::gcn::Stage stage;
+  shader::gcn::Environment env;
+  std::vector<std::uint32_t> userSgprs;
+  VkShaderStageFlagBits vkStage;
+  std::span<const VkDescriptorSetLayout> setLayouts;
+
+  std::uint64_t magic = 0;
+  VkShaderEXT handle = VK_NULL_HANDLE;
+  std::optional<shader::gcn::ConvertedShader> converted;
+  std::vector<std::pair<std::uint64_t, std::vector<std::byte>>> usedMemory;
+
+  ShaderCompileJob() = default;
+  ShaderCompileJob(const ShaderCompileJob &) = delete;
+  ~ShaderCompileJob();
+
+  [[nodiscard]] bool isDone() const {
+    return mDone.load(std::memory_order::acquire);
+  }
+
+  void wait() const { mDone.wait(false, std::memory_order::acquire); }
+
+  // Transfers ownership of the created shader handle to the caller
+  VkShaderEXT takeHandle() { return std::exchange(handle, VK_NULL_HANDLE); }
+
+private:
+  friend class ShaderCompiler;
+  std::atomic<bool> mDone{false};
+};
+
+// Translates GCN shaders to SPIR-V and creates Vulkan shader objects. With
+// worker threads configured, jobs are processed in background so command
+// processors can continue while shaders are compiled. Vertex and compute
+// shaders are processed before pixel shaders.
+class ShaderCompiler {
+public:
+  static constexpr std::size_t kMaxQueuedJobs = 256;
+
+  // Finished jobs kept for callers which did not take them yet, the oldest
+  // ones are evicted with their shader handle
+  static constexpr std::size_t kMaxCompletedJobs = 256;
+
+  struct Stats {
+    std::uint64_t queued;
+    std::uint64_t compiled;
+    std::uint64_t failed;
+    std::uint64_t overflows;
+    std::uint64_t evicted;
+    std::uint64_t skippedDraws;
+    std::uint64_t maxQueueDepth;
+    std::chrono::microseconds compileTime; // spent by workers
+    std::uint64_t irNodes;
+    std::uint64_t irLocations;
+    std::uint64_t irSlabs; // arena allocations replacing per node ones
+    std::uint64_t irBytes;
+  };
+
+  explicit ShaderCompiler(Device *device) : mDevice(device) {}
+  ShaderCompiler(const ShaderCompiler &) = delete;
+  ~ShaderCompiler() { stop(); }
+
+  void start(unsigned workerCount);
+  void stop();
+
+  [[nodiscard]] bool isAsync() const { return !mWorkers.empty(); }
+
+  // Returns already submitted job with the same inputs or queues the new one.
+  // Returns nullptr if queue is full, the caller should compile it inline.
+  std::shared_ptr<ShaderCompileJob>
+  submit(std::shared_ptr<ShaderCompileJob> job);
+
+  // Removes finished job from the in-flight table
+  void release(const std::shared_ptr<ShaderCompileJob> &job);
+
+  void compile(ShaderCompileJob &job);
+
+  void onDrawSkipped() {
+    mSkippedDraws.fetch_add(1, std::memory_order::relaxed);
+  }
+
+  [[nodiscard]] Stats getStats() const;
+
+private:
+  struct JobKey {
+    int vmId;
+    std::uint64_t address;
+    shader::gcn::Stage stage;
+    std::uint8_t vgprCount;
+    std::uint8_t sgprCount;
+    std::uint8_t numThreadX;
+    std::uint8_t numThreadY;
+    std::uint8_t numThreadZ;
+    std::vector<std::uint32_t> userSgprs;
+
+    static JobKey createFrom(const ShaderCompileJob &job);
+    auto operator<=>(const JobKey &) const = default;
+  };
+
+  enum Lane { kHighPriorityLane, kLowPriorityLane, kLaneCount };
+
+  void workerEntry(const std::stop_token &stopToken);
+
+  Device *mDevice;
+  std::mutex mMtx;
+  std::condition_variable_any mCv;
+  std::deque<std::shared_ptr<ShaderCompileJob>> mQueues[kLaneCount];
+  std::map<JobKey, std::shared_ptr<ShaderCompileJob>> mJobs;
+  std::deque<std::weak_ptr<ShaderCompileJob>> mCompletedJobs;
+  std::vector<std::jthread> mWorkers;
+
+  std::atomic<std::uint64_t> mQueued{0};
+  std::atomic<std::uint64_t> mCompiled{0};
+  std::atomic<std::uint64_t> mFailed{0};
+  std::atomic<std::uint64_t> mOverflows{0};
+  std::atomic<std::uint64_t> mEvicted{0};
+  std::atomic<std::uint64_t> mSkippedDraws{0};
+  std::atomic<std::uint64_t> mMaxQueueDepth{0};
+  std::atomic<std::uint64_t> mCompileTimeUs{0};
+  std::atomic<std::uint64_t> mIrNodes{0};
+  std::atomic<std::uint64_t> mIrLocations{0};
+  std::atomic<std::uint64_t> mIrSlabs{0};
+  std::atomic<std::uint64_t> mIrBytes{0};
+};
+} // namespace amdgpu
@@ -2,7 +2,9 @@
 
 #include "gnm/constants.hpp"
 #include "tiler.hpp"
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace amdgpu {
 std::uint64_t getTiledOffset(gnm::TextureType texType, bool isPow2Padded,
@@ -11,4 +13,108 @@ std::uint64_t getTiledOffset(gnm::TextureType texType, bool isPow2Padded,
                              amdgpu::MacroTileMode macroTileMode, int mipLevel,
                              int arraySlice, int width, int height, int depth,
                              int pitch, int x, int y, int z, int fragmentIndex);
+
+// Converts single sampled subresource between tiled layout and tightly packed
+// linear layout. Block compressed surfaces are converted by blocks.
+//
+// Subresource is converted by tile rows: element rows of linear surfaces,
+// rows of 8x8 micro tiles of 1D tiled surfaces and rows of macro tiles of
+// 2D/3D tiled surfaces. Pipe and bank swizzles of micro tile columns and rows
+// are computed on construction, so tile rows can be converted independently
+class CpuTiler {
+public:
+  CpuTiler(gnm::TextureType texType, bool isPow2Padded, gnm::DataFormat dfmt,
+           TileMode tileMode, MacroTileMode macroTileMode, int mipLevel,
+           int arraySlice, int width, int height, int depth, int pitch);
+
+  std::uint32_t getTileRowHeight() const { return mTileRowHeight; }
+  std::uint32_t getTileRowCount() const {
+    return mTileRowsPerSlice * mElemDepth;
+  }
+  std::uint64_t getLinearSize() const {
+    return mLinearRowPitch * mElemHeight * mElemDepth;
+  }
+
+  void detileRows(void *dst, const void *src, std::uint32_t firstRow,
+                  std::uint32_t rowCount) const;
+  void tileRows(void *dst, const void *src, std::uint32_t firstRow,
+                std::uint32_t rowCount) const;
+
+private:
+  // Offset of micro tile column or row within slice, with pipe and bank bits
+  // of its coordinate. Pipe and bank equations xor x and y terms, so swizzle
+  // of micro tile is xor of swizzles of its column and row
+  struct Swizzle {
+    std::uint64_t offset;
+    std::uint32_t pipeBank;
+  };
+
+  template <bool IsTile>
+  void copyRows(std::byte *dst, const std::byte *src, std::uint32_t firstRow,
+                std::uint32_t rowCount) const;
+
+  template <std::uint32_t ElementSize, bool IsTile>
+  void copyMicroTileRow(std::byte *dst, const std::byte *src, std::uint32_t z,
+                        std::uint32_t row) const;
+
+  template <std::uint32_t ElementSize, bool IsTile>
+  void copyMacroTileRow(std::byte *dst, const std::byte *src, std::uint32_t z,
+                        std::uint32_t row) const;
+
+  gnm::TextureType mTexType;
+  bool mIsPow2Padded;
+  gnm::DataFormat mDfmt;
+  TileMode mTileMode;
+  MacroTileMode mMacroTileMode;
+  int mMipLevel;
+  int mArraySlice;
+  int mWidth;
+  int mHeight;
+  int mDepth;
+  int mPitch;
+
+  std::uint32_t mElementSize = 0;
+  std::uint32_t mElemWidth = 0;
+  std::uint32_t mElemHeight = 0;
+  std::uint32_t mElemDepth = 0;
+  std::uint64_t mLinearRowPitch = 0;
+  std::uint32_t mTileRowHeight = 1;
+  std::uint32_t mTileRowsPerSlice = 0;
+
+  // linear surfaces
+  std::uint64_t mTiledRowPitch = 0;
+  std::uint64_t mTiledSlicePitch = 0;
+
+  // micro tiled surfaces
+  std::uint32_t mThickness = 1;
+  std::uint32_t mTileBytes = 0;
+  std::uint16_t mElementOffsets[8][kMicroTileWidth * kMicroTileHeight]{};
+
+  // macro tiled surfaces
+  std::uint32_t mNumPipes = 0;
+  std::uint32_t mNumBanks = 0;
+  std::uint32_t mPipeBits = 0;
+  std::uint32_t mOffsetShift = 0;
+  std::uint32_t mSplitBytes = 0;
+  std::uint32_t mSlicesPerTile = 1;
+  std::uint64_t mSliceBytes = 0;
+  std::vector<Swizzle> mColumnSwizzles;
+  std::vector<Swizzle> mRowSwizzles;
+};
+
+// Converts single sampled subresource from tiled layout of src to tightly
+// packed linear layout of dst. Block compressed surfaces are copied by blocks
+void detileSurface(void *dst, const void *src, gnm::TextureType texType,
+                   bool isPow2Padded, gnm::DataFormat dfmt,
+                   amdgpu::TileMode tileMode,
+                   amdgpu::MacroTileMode macroTileMode, int mipLevel,
+                   int arraySlice, int width, int height, int depth, int pitch);
+
+// Converts single sampled subresource from tightly packed linear layout of
+// src to tiled layout of dst
+void tileSurface(void *dst, const void *src, gnm::TextureType texType,
+                 bool isPow2Padded, gnm::DataFormat dfmt,
+                 amdgpu::TileMode tileMode, amdgpu::MacroTileMode macroTileMode,
+                 int mipLevel, int arraySlice, int width, int height, int depth,
+                 int pitch);
 }
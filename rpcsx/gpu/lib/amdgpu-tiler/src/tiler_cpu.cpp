@@ -1,6 +1,12 @@
 #include "amdgpu/tiler_cpu.hpp"
 #include "amdgpu/tiler.hpp"
 #include "gnm/gnm.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <tuple>
+#include <utility>
 
 constexpr std::uint64_t
 getTiledOffset1D(gnm::TextureType texType, bool isPow2Padded,
@@ -439,3 +445,422 @@ std::uint64_t amdgpu::getTiledOffset(gnm::TextureType texType,
 
   std::abort();
 }
+
+// Tiled offsets of bytes within aligned chunk of micro tile are contiguous:
+// chunk never crosses pipe interleave, tile split or micro tile boundary
+static constexpr std::uint32_t kTiledChunkBytes = 64;
+
+template <std::uint32_t ElementSize, bool IsTile>
+static void copyElement(std::byte *dst, const std::byte *src,
+                        std::uint64_t tiledOffset, std::uint64_t linearOffset) {
+  if constexpr (IsTile) {
+    std::memcpy(dst + tiledOffset, src + linearOffset, ElementSize);
+  } else {
+    std::memcpy(dst + linearOffset, src + tiledOffset, ElementSize);
+  }
+}
+
+amdgpu::CpuTiler::CpuTiler(gnm::TextureType texType, bool isPow2Padded,
+                           gnm::DataFormat dfmt, TileMode tileMode,
+                           MacroTileMode macroTileMode, int mipLevel,
+                           int arraySlice, int width, int height, int depth,
+                           int pitch)
+    : mTexType(texType), mIsPow2Padded(isPow2Padded), mDfmt(dfmt),
+      mTileMode(tileMode), mMacroTileMode(macroTileMode), mMipLevel(mipLevel),
+      mArraySlice(arraySlice), mWidth(width), mHeight(height), mDepth(depth),
+      mPitch(pitch) {
+  bool isVolume = texType == gnm::TextureType::Dim3D;
+  auto bitsPerFragment = getBitsPerElement(dfmt);
+  auto isBlockCompressed = getTexelsPerElement(dfmt) > 1;
+
+  // converts texels to elements, block compressed surfaces are copied by
+  // blocks
+  auto getElementExtent = [&](std::uint32_t width, std::uint32_t height) {
+    if (isBlockCompressed) {
+      switch (bitsPerFragment) {
+      case 1:
+        return std::pair{std::max((width + 7) / 8, 1u), height};
+      case 4:
+      case 8:
+        return std::pair{std::max((width + 3) / 4, 1u),
+                         std::max((height + 3) / 4, 1u)};
+      default:
+        std::abort();
+      }
+    }
+
+    return std::pair{width, height};
+  };
+
+  auto bitsPerElement = bitsPerFragment;
+  if (isBlockCompressed) {
+    bitsPerElement *= bitsPerFragment == 1 ? 8 : 16;
+  }
+
+  mElementSize = bitsPerElement / 8;
+  std::tie(mElemWidth, mElemHeight) =
+      getElementExtent(std::max(width >> mipLevel, 1),
+                       std::max(height >> mipLevel, 1));
+  mElemDepth = isVolume ? std::max(depth >> mipLevel, 1) : 1;
+  mLinearRowPitch = std::uint64_t(mElemWidth) * mElementSize;
+
+  auto arrayMode = tileMode.arrayMode();
+
+  switch (arrayMode) {
+  case kArrayModeLinearGeneral:
+  case kArrayModeLinearAligned: {
+    auto [tiledWidth, tiledHeight] = getElementExtent(pitch, height);
+    mTiledRowPitch = std::uint64_t(tiledWidth) * mElementSize;
+    mTiledSlicePitch = mTiledRowPitch * tiledHeight;
+    mTileRowHeight = 1;
+    mTileRowsPerSlice = mElemHeight;
+    return;
+  }
+
+  default:
+    break;
+  }
+
+  auto microTileMode = tileMode.microTileMode();
+  mThickness = getMicroTileThickness(arrayMode);
+  mTileBytes = kMicroTileWidth * kMicroTileHeight * mThickness * mElementSize;
+  mTileRowHeight = kMicroTileHeight;
+
+  // offsets of elements inside of micro tile, same for every tile of surface
+  for (std::uint32_t z = 0; z < mThickness; ++z) {
+    for (std::uint32_t y = 0; y < kMicroTileHeight; ++y) {
+      for (std::uint32_t x = 0; x < kMicroTileWidth; ++x) {
+        mElementOffsets[z][y * kMicroTileWidth + x] =
+            getElementIndex(x, y, z, bitsPerElement, microTileMode,
+                            arrayMode) *
+            mElementSize;
+      }
+    }
+  }
+
+  std::uint32_t tileColumnCount =
+      (mElemWidth + kMicroTileWidth - 1) / kMicroTileWidth;
+  std::uint32_t tileRowCount =
+      (mElemHeight + kMicroTileHeight - 1) / kMicroTileHeight;
+
+  if (!isMacroTiled(arrayMode)) {
+    mTileRowsPerSlice = tileRowCount;
+    return;
+  }
+
+  auto bankWidth = 1u << macroTileMode.bankWidth();
+  auto bankHeight = 1u << macroTileMode.bankHeight();
+  auto macroTileAspect = 1u << macroTileMode.macroTileAspect();
+  mNumBanks = 2u << macroTileMode.numBanks();
+  mNumPipes = getPipeCount(tileMode.pipeConfig());
+  mPipeBits = std::countr_zero(mNumPipes);
+  mOffsetShift = std::countr_zero(kPipeInterleaveBytes) + mPipeBits +
+                 std::countr_zero(mNumBanks);
+
+  auto macroTileWidth =
+      (kMicroTileWidth * bankWidth * mNumPipes) * macroTileAspect;
+  auto macroTileHeight =
+      (kMicroTileHeight * bankHeight * mNumBanks) / macroTileAspect;
+
+  std::uint32_t sampleSplit = 1 << tileMode.sampleSplit();
+  std::uint32_t tileSplitC =
+      microTileMode == kMicroTileModeDepth
+          ? (64 << tileMode.tileSplit())
+          : std::max(256U, mTileBytes * sampleSplit);
+  auto tileSplitBytes = std::min(kDramRowSize, tileSplitC);
+
+  mSplitBytes = mTileBytes;
+  if (mTileBytes > tileSplitBytes && mThickness == 1) {
+    mSlicesPerTile = mTileBytes / tileSplitBytes;
+    mSplitBytes = tileSplitBytes;
+  }
+
+  std::uint64_t macroTileBytes = (macroTileWidth / kMicroTileWidth) *
+                                 (macroTileHeight / kMicroTileHeight) *
+                                 mSplitBytes / (mNumPipes * mNumBanks);
+  auto [paddedWidth, paddedHeight] = getElementExtent(pitch, height);
+  std::uint64_t macroTilesPerRow = paddedWidth / macroTileWidth;
+  mSliceBytes =
+      macroTilesPerRow * (paddedHeight / macroTileHeight) * macroTileBytes;
+
+  bool isPrtSwizzle = arrayMode == kArrayModeTiledThinPrt ||
+                      arrayMode == kArrayModeTiledThickPrt;
+
+  auto getPipeBank = [&](std::uint32_t x, std::uint32_t y) {
+    if (isPrtSwizzle) {
+      x %= macroTileWidth;
+      y %= macroTileHeight;
+    }
+
+    return getPipeIndex(x, y, tileMode.pipeConfig()) |
+           getBankIndex(x, y, bankWidth, bankHeight, mNumBanks, mNumPipes)
+               << mPipeBits;
+  };
+
+  mColumnSwizzles.resize(tileColumnCount);
+  for (std::uint32_t tileX = 0; tileX < tileColumnCount; ++tileX) {
+    auto x = tileX * kMicroTileWidth;
+    mColumnSwizzles[tileX] = {
+        .offset = (x / macroTileWidth) * macroTileBytes +
+                  ((tileX / mNumPipes) % bankWidth) * mSplitBytes,
+        .pipeBank = getPipeBank(x, 0),
+    };
+  }
+
+  mRowSwizzles.resize(tileRowCount);
+  for (std::uint32_t tileY = 0; tileY < tileRowCount; ++tileY) {
+    auto y = tileY * kMicroTileHeight;
+    mRowSwizzles[tileY] = {
+        .offset = (y / macroTileHeight) * macroTilesPerRow * macroTileBytes +
+                  (tileY % bankHeight) * bankWidth * mSplitBytes,
+        .pipeBank = getPipeBank(0, y),
+    };
+  }
+
+  mTileRowHeight = macroTileHeight;
+  mTileRowsPerSlice = (mElemHeight + macroTileHeight - 1) / macroTileHeight;
+}
+
+template <std::uint32_t ElementSize, bool IsTile>
+void amdgpu::CpuTiler::copyMicroTileRow(std::byte *dst, const std::byte *src,
+                                        std::uint32_t z,
+                                        std::uint32_t row) const {
+  auto &elementOffsets = mElementOffsets[z % mThickness];
+  auto tileY = row * kMicroTileHeight;
+  auto tileHeight = std::min(kMicroTileHeight, mElemHeight - tileY);
+
+  // micro tiles of row are stored one after another
+  std::uint64_t rowOffset =
+      getTiledOffset(mTexType, mIsPow2Padded, 0, mDfmt, mTileMode,
+                     mMacroTileMode, mMipLevel, mArraySlice, mWidth, mHeight,
+                     mDepth, mPitch, 0, tileY, z, 0) /
+          8 -
+      elementOffsets[0];
+  std::uint64_t linearRow =
+      (std::uint64_t(z) * mElemHeight + tileY) * mLinearRowPitch;
+
+  for (std::uint32_t tileX = 0; tileX < mElemWidth;
+       tileX += kMicroTileWidth) {
+    auto tileWidth = std::min(kMicroTileWidth, mElemWidth - tileX);
+    auto tileOffset = rowOffset + (tileX / kMicroTileWidth) * mTileBytes;
+
+    for (std::uint32_t y = 0; y < tileHeight; ++y) {
+      auto linearOffset =
+          linearRow + y * mLinearRowPitch + tileX * ElementSize;
+
+      for (std::uint32_t x = 0; x < tileWidth; ++x) {
+        copyElement<ElementSize, IsTile>(
+            dst, src, tileOffset + elementOffsets[y * kMicroTileWidth + x],
+            linearOffset + x * ElementSize);
+      }
+    }
+  }
+}
+
+template <std::uint32_t ElementSize, bool IsTile>
+void amdgpu::CpuTiler::copyMacroTileRow(std::byte *dst, const std::byte *src,
+                                        std::uint32_t z,
+                                        std::uint32_t row) const {
+  constexpr auto kMaxTileSplits = 16;
+  constexpr auto kMaxChunks = 8 * kMicroTileWidth * kMicroTileHeight *
+                              ElementSize / kTiledChunkBytes;
+  constexpr auto kPipeInterleaveBits = std::countr_zero(kPipeInterleaveBytes);
+  constexpr std::uint64_t kPipeInterleaveMask = kPipeInterleaveBytes - 1;
+
+  auto arrayMode = mTileMode.arrayMode();
+  std::uint32_t slice = mArraySlice != 0 ? mArraySlice : z;
+  std::uint32_t thickSlice = slice / mThickness;
+
+  std::uint32_t pipeRotation = 0;
+  std::uint32_t bankRotation = 0;
+  std::uint32_t tileSplitRotation = 0;
+
+  switch (arrayMode) {
+  case kArrayMode2dTiledThin:
+  case kArrayMode2dTiledThick:
+  case kArrayMode2dTiledXThick:
+    bankRotation = ((mNumBanks / 2) - 1) * thickSlice;
+    break;
+  case kArrayMode3dTiledThin:
+  case kArrayMode3dTiledThick:
+  case kArrayMode3dTiledXThick:
+    pipeRotation = std::max(1u, (mNumPipes / 2) - 1) * thickSlice;
+    bankRotation = pipeRotation / mNumPipes;
+    break;
+  default:
+    break;
+  }
+
+  switch (arrayMode) {
+  case kArrayMode2dTiledThin:
+  case kArrayMode3dTiledThin:
+  case kArrayMode2dTiledThinPrt:
+  case kArrayMode3dTiledThinPrt:
+    tileSplitRotation = (mNumBanks / 2) + 1;
+    break;
+  default:
+    break;
+  }
+
+  // slice offset and swizzle of every tile split of micro tile
+  std::uint64_t splitOffsets[kMaxTileSplits];
+  std::uint32_t splitSwizzles[kMaxTileSplits];
+  for (std::uint32_t split = 0; split < mSlicesPerTile; ++split) {
+    splitOffsets[split] =
+        (split + mSlicesPerTile * z / mThickness) * mSliceBytes;
+    splitSwizzles[split] =
+        (pipeRotation & (mNumPipes - 1)) |
+        (((bankRotation ^ (tileSplitRotation * split)) & (mNumBanks - 1))
+         << mPipeBits);
+  }
+
+  auto splitShift = std::countr_zero(mSplitBytes);
+  auto chunkCount = mTileBytes / kTiledChunkBytes;
+  std::uint64_t chunkOffsets[kMaxChunks];
+  auto &elementOffsets = mElementOffsets[z % mThickness];
+  auto firstTileRow = row * (mTileRowHeight / kMicroTileHeight);
+  auto lastTileRow =
+      std::min<std::size_t>(firstTileRow + mTileRowHeight / kMicroTileHeight,
+                            mRowSwizzles.size());
+
+  for (auto tileRow = firstTileRow; tileRow < lastTileRow; ++tileRow) {
+    auto &rowSwizzle = mRowSwizzles[tileRow];
+    auto tileY = tileRow * kMicroTileHeight;
+    auto tileHeight = std::min(kMicroTileHeight, mElemHeight - tileY);
+    std::uint64_t linearRow =
+        (std::uint64_t(z) * mElemHeight + tileY) * mLinearRowPitch;
+
+    for (std::uint32_t tileColumn = 0; tileColumn < mColumnSwizzles.size();
+         ++tileColumn) {
+      auto &columnSwizzle = mColumnSwizzles[tileColumn];
+      auto tileX = tileColumn * kMicroTileWidth;
+      auto tileWidth = std::min(kMicroTileWidth, mElemWidth - tileX);
+      auto tileOffset = rowSwizzle.offset + columnSwizzle.offset;
+      auto pipeBank = rowSwizzle.pipeBank ^ columnSwizzle.pipeBank;
+
+      for (std::uint32_t chunk = 0; chunk < chunkCount; ++chunk) {
+        auto elementOffset = chunk * kTiledChunkBytes;
+        auto split = elementOffset >> splitShift;
+        auto offset = splitOffsets[split] + tileOffset +
+                      (elementOffset & (mSplitBytes - 1));
+
+        // pipe and bank bits are inserted above pipe interleave
+        chunkOffsets[chunk] =
+            (offset & kPipeInterleaveMask) |
+            (std::uint64_t(pipeBank ^ splitSwizzles[split])
+             << kPipeInterleaveBits) |
+            ((offset >> kPipeInterleaveBits) << mOffsetShift);
+      }
+
+      for (std::uint32_t y = 0; y < tileHeight; ++y) {
+        auto linearOffset =
+            linearRow + y * mLinearRowPitch + tileX * ElementSize;
+
+        for (std::uint32_t x = 0; x < tileWidth; ++x) {
+          std::uint32_t elementOffset = elementOffsets[y * kMicroTileWidth + x];
+
+          copyElement<ElementSize, IsTile>(
+              dst, src,
+              chunkOffsets[elementOffset / kTiledChunkBytes] +
+                  elementOffset % kTiledChunkBytes,
+              linearOffset + x * ElementSize);
+        }
+      }
+    }
+  }
+}
+
+template <bool IsTile>
+void amdgpu::CpuTiler::copyRows(std::byte *dst, const std::byte *src,
+                                std::uint32_t firstRow,
+                                std::uint32_t rowCount) const {
+  auto arrayMode = mTileMode.arrayMode();
+
+  if (arrayMode == kArrayModeLinearGeneral ||
+      arrayMode == kArrayModeLinearAligned) {
+    for (auto row = firstRow; row < firstRow + rowCount; ++row) {
+      auto z = row / mTileRowsPerSlice;
+      auto y = row % mTileRowsPerSlice;
+
+      auto tiledOffset = z * mTiledSlicePitch + y * mTiledRowPitch;
+      auto linearOffset = std::uint64_t(row) * mLinearRowPitch;
+
+      if constexpr (IsTile) {
+        std::memcpy(dst + tiledOffset, src + linearOffset, mLinearRowPitch);
+      } else {
+        std::memcpy(dst + linearOffset, src + tiledOffset, mLinearRowPitch);
+      }
+    }
+    return;
+  }
+
+  auto copyRow = [&]<std::uint32_t ElementSize>(std::uint32_t z,
+                                                std::uint32_t row) {
+    if (isMacroTiled(arrayMode)) {
+      copyMacroTileRow<ElementSize, IsTile>(dst, src, z, row);
+    } else {
+      copyMicroTileRow<ElementSize, IsTile>(dst, src, z, row);
+    }
+  };
+
+  for (auto row = firstRow; row < firstRow + rowCount; ++row) {
+    auto z = row / mTileRowsPerSlice;
+    auto sliceRow = row % mTileRowsPerSlice;
+
+    switch (mElementSize) {
+    case 1:
+      copyRow.template operator()<1>(z, sliceRow);
+      break;
+    case 2:
+      copyRow.template operator()<2>(z, sliceRow);
+      break;
+    case 4:
+      copyRow.template operator()<4>(z, sliceRow);
+      break;
+    case 8:
+      copyRow.template operator()<8>(z, sliceRow);
+      break;
+    case 16:
+      copyRow.template operator()<16>(z, sliceRow);
+      break;
+    default:
+      std::abort();
+    }
+  }
+}
+
+void amdgpu::CpuTiler::detileRows(void *dst, const void *src,
+                                  std::uint32_t firstRow,
+                                  std::uint32_t rowCount) const {
+  copyRows<false>(static_cast<std::byte *>(dst),
+                  static_cast<const std::byte *>(src), firstRow, rowCount);
+}
+
+void amdgpu::CpuTiler::tileRows(void *dst, const void *src,
+                                std::uint32_t firstRow,
+                                std::uint32_t rowCount) const {
+  copyRows<true>(static_cast<std::byte *>(dst),
+                 static_cast<const std::byte *>(src), firstRow, rowCount);
+}
+
+void amdgpu::detileSurface(void *dst, const void *src,
+                           gnm::TextureType texType, bool isPow2Padded,
+                           gnm::DataFormat dfmt, amdgpu::TileMode tileMode,
+                           amdgpu::MacroTileMode macroTileMode, int mipLevel,
+                           int arraySlice, int width, int height, int depth,
+                           int pitch) {
+  CpuTiler tiler(texType, isPow2Padded, dfmt, tileMode, macroTileMode,
+                 mipLevel, arraySlice, width, height, depth, pitch);
+  tiler.detileRows(dst, src, 0, tiler.getTileRowCount());
+}
+
+void amdgpu::tileSurface(void *dst, const void *src, gnm::TextureType texType,
+                         bool isPow2Padded, gnm::DataFormat dfmt,
+                         amdgpu::TileMode tileMode,
+                         amdgpu::MacroTileMode macroTileMode, int mipLevel,
+                         int arraySlice, int width, int height, int depth,
+                         int pitch) {
+  CpuTiler tiler(texType, isPow2Padded, dfmt, tileMode, macroTileMode,
+                 mipLevel, arraySlice, width, height, depth, pitch);
+  tiler.tileRows(dst, src, 0, tiler.getTileRowCount());
+}
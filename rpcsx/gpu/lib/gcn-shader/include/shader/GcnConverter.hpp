@@ -2,6 +2,7 @@
 
 #include "gcn.hpp"
 #include "rx/MemoryTable.hpp"
+#include "rx/Serializer.hpp"
 #include <cstdint>
 #include <optional>
 #include <vector>
@@ -178,6 +179,13 @@ struct Resources {
 
   void print(std::ostream &os, ir::NameStorage &ns) const;
   void dump();
+
+  // Resource expressions are persisted as a flat value graph. Graphs that
+  // reference memory SSA scopes or nested blocks cannot be restored and are
+  // rejected by isSerializable().
+  [[nodiscard]] bool isSerializable() const;
+  void serialize(rx::Serializer &s) const;
+  void deserialize(rx::Deserializer &s);
 };
 
 struct ShaderInfo {
@@ -202,6 +210,13 @@ struct ShaderInfo {
 
     return configSlots.size() - 1;
   }
+
+  [[nodiscard]] bool isSerializable() const {
+    return resources.isSerializable();
+  }
+
+  void serialize(rx::Serializer &s) const;
+  void deserialize(rx::Deserializer &s);
 };
 
 struct ConvertedShader {
@@ -107,6 +107,7 @@ struct Environment {
   bool supportsInt8 = false;
   bool supportsInt64Atomics = false;
   bool supportsNonSemanticInfo = false;
+  bool optimize = false; // run shader::optimize on the converted body
   std::span<const std::uint32_t> userSgprs;
 };
 
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace shader::ir {
+// Bump allocator for objects which live as long as the owning context.
+// Memory is released by slabs, destructors are invoked in reverse order of
+// creation. Objects must be destroyed through Base's virtual destructor
+template <typename Base> class Arena {
+  static constexpr std::size_t kSlabSize = 64 * 1024;
+
+  struct SlabDeleter {
+    void operator()(std::byte *slab) const {
+      ::operator delete(slab, std::align_val_t{alignof(std::max_align_t)});
+    }
+  };
+
+  std::vector<std::unique_ptr<std::byte, SlabDeleter>> mSlabs;
+  std::vector<Base *> mObjects;
+  std::byte *mCursor = nullptr;
+  std::byte *mEnd = nullptr;
+  std::size_t mAllocatedBytes = 0;
+
+public:
+  Arena() = default;
+  Arena(const Arena &) = delete;
+  Arena(Arena &&other) noexcept { swap(other); }
+  Arena &operator=(Arena &&other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~Arena() {
+    for (auto it = mObjects.rbegin(); it != mObjects.rend(); ++it) {
+      (*it)->~Base();
+    }
+  }
+
+  void swap(Arena &other) noexcept {
+    std::swap(mSlabs, other.mSlabs);
+    std::swap(mObjects, other.mObjects);
+    std::swap(mCursor, other.mCursor);
+    std::swap(mEnd, other.mEnd);
+    std::swap(mAllocatedBytes, other.mAllocatedBytes);
+  }
+
+  template <typename T, typename... ArgsT> T *create(ArgsT &&...args) {
+    static_assert(std::is_base_of_v<Base, T>);
+    static_assert(alignof(T) <= alignof(std::max_align_t));
+
+    auto result =
+        new (allocate(sizeof(T), alignof(T))) T(std::forward<ArgsT>(args)...);
+    mObjects.push_back(result);
+    return result;
+  }
+
+  [[nodiscard]] std::size_t getObjectCount() const { return mObjects.size(); }
+  [[nodiscard]] std::size_t getSlabCount() const { return mSlabs.size(); }
+  [[nodiscard]] std::size_t getAllocatedBytes() const {
+    return mAllocatedBytes;
+  }
+
+private:
+  void *allocate(std::size_t size, std::size_t alignment) {
+    auto offset = (alignment - reinterpret_cast<std::uintptr_t>(mCursor) %
+                                   alignment) %
+                  alignment;
+
+    if (mCursor == nullptr ||
+        static_cast<std::size_t>(mEnd - mCursor) < offset + size) {
+      auto slabSize = std::max(kSlabSize, size);
+      mSlabs.emplace_back(static_cast<std::byte *>(::operator new(
+          slabSize, std::align_val_t{alignof(std::max_align_t)})));
+      mCursor = mSlabs.back().get();
+      mEnd = mCursor + slabSize;
+      mAllocatedBytes += slabSize;
+      offset = 0;
+    }
+
+    auto result = mCursor + offset;
+    mCursor = result + size;
+    return result;
+  }
+};
+} // namespace shader::ir
@@ -1,30 +1,46 @@
 #pragma once
 
+#include "Arena.hpp"
 #include "Location.hpp"
 #include "NodeImpl.hpp"
 #include "Operand.hpp"
 
-#include <forward_list>
-#include <memory>
 #include <set>
 #include <type_traits>
+#include <typeindex>
 #include <utility>
 
 namespace shader::ir {
-struct UniqPtrCompare {
-  static bool operator()(const auto &lhs, const auto &rhs)
-    requires requires { *lhs <=> *rhs; }
-  {
+// Orders locations by type first, then by value
+struct LocationCompare {
+  static bool operator()(const LocationImpl *lhs, const LocationImpl *rhs) {
+    std::type_index lhsType = typeid(*lhs);
+    std::type_index rhsType = typeid(*rhs);
+
+    if (lhsType != rhsType) {
+      return lhsType < rhsType;
+    }
+
     return (*lhs <=> *rhs) == std::strong_ordering::less;
   }
 };
 
 class Context {
-  std::forward_list<std::unique_ptr<NodeImpl>> mNodes;
-  std::set<std::unique_ptr<LocationImpl>, UniqPtrCompare> mLocations;
-  std::unique_ptr<UnknownLocationImpl> mUnknownLocation;
+  Arena<NodeImpl> mNodes;
+  Arena<LocationImpl> mLocationStorage;
+  std::set<LocationImpl *, LocationCompare> mLocations;
+  UnknownLocationImpl *mUnknownLocation = nullptr;
+  std::size_t mLocationLookups = 0;
 
 public:
+  struct Stats {
+    std::size_t nodeCount;
+    std::size_t locationCount;
+    std::size_t locationLookups; // interned location requests
+    std::size_t slabCount;       // heap allocations made by the arenas
+    std::size_t allocatedBytes;
+  };
+
   Context() = default;
   Context(const Context &) = delete;
   Context(Context &&) = default;
@@ -37,9 +53,8 @@ public:
       requires std::is_base_of_v<NodeImpl, typename T::underlying_type>;
     }
   T create(ArgsT &&...args) {
-    auto result = new typename T::underlying_type(std::forward<ArgsT>(args)...);
-    mNodes.emplace_front(std::unique_ptr<NodeImpl>{result});
-    return T(result);
+    return T(mNodes.template create<typename T::underlying_type>(
+        std::forward<ArgsT>(args)...));
   }
 
   template <typename T, typename... ArgsT>
@@ -49,10 +64,17 @@ public:
       requires std::is_base_of_v<LocationImpl, typename T::underlying_type>;
     }
   T getLocation(ArgsT &&...args) {
-    auto result = std::make_unique<typename T::underlying_type>(
-        std::forward<ArgsT>(args)...);
-    auto ptr = mLocations.insert(std::move(result)).first->get();
-    return T(static_cast<typename T::underlying_type *>(ptr));
+    using ImplT = typename T::underlying_type;
+
+    ImplT location(std::forward<ArgsT>(args)...);
+    mLocationLookups++;
+    if (auto it = mLocations.find(&location); it != mLocations.end()) {
+      return T(static_cast<ImplT *>(*it));
+    }
+
+    auto result = mLocationStorage.template create<ImplT>(std::move(location));
+    mLocations.insert(result);
+    return T(result);
   }
 
   PathLocation getPathLocation(std::string path) {
@@ -76,9 +98,20 @@ public:
   }
   UnknownLocation getUnknownLocation() {
     if (mUnknownLocation == nullptr) {
-      mUnknownLocation = std::make_unique<UnknownLocationImpl>();
+      mUnknownLocation = mLocationStorage.create<UnknownLocationImpl>();
     }
-    return mUnknownLocation.get();
+    return mUnknownLocation;
+  }
+
+  [[nodiscard]] Stats getStats() const {
+    return {
+        .nodeCount = mNodes.getObjectCount(),
+        .locationCount = mLocationStorage.getObjectCount(),
+        .locationLookups = mLocationLookups,
+        .slabCount = mNodes.getSlabCount() + mLocationStorage.getSlabCount(),
+        .allocatedBytes = mNodes.getAllocatedBytes() +
+                          mLocationStorage.getAllocatedBytes(),
+    };
   }
 };
 } // namespace shader::ir
@@ -1,7 +1,10 @@
 #pragma once
-#include "ir/Context.hpp"
+#include "SpvConverter.hpp"
 #include "ir/Region.hpp"
 
 namespace shader {
-bool optimize(ir::Context &context, ir::Region region);
+// Removes redundant pure instructions of the region: copies are propagated,
+// instructions with constant integer operands are folded, equal expressions
+// are numbered over the dominator tree and unused values are removed
+bool optimize(spv::Context &context, ir::Region region);
 }
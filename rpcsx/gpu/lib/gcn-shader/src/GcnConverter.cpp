@@ -6,10 +6,13 @@
 #include "dialect.hpp"
 #include "gcn.hpp"
 #include "ir.hpp"
+#include "opt.hpp"
 #include "rx/die.hpp"
 #include "rx/print.hpp"
 #include <iostream>
 #include <limits>
+#include <map>
+#include <variant>
 
 using namespace shader;
 
@@ -720,6 +723,380 @@ void gcn::Resources::print(std::ostream &os, ir::NameStorage &ns) const {
 
 void gcn::Resources::dump() { print(std::cerr, context.ns); }
 
+namespace {
+inline constexpr std::uint32_t kNullResourceNode = ~0u;
+inline constexpr std::uint8_t kValueOperandIndex = 1;
+static_assert(std::is_same_v<std::variant_alternative_t<
+                                 kValueOperandIndex, ir::Operand::UnderlyingT>,
+                             ir::ValueImpl *>);
+
+struct ResourceNodeTable {
+  std::vector<ir::Value> nodes;
+  std::map<ir::Value, std::uint32_t> ids;
+
+  bool add(ir::Value root) {
+    if (root == nullptr || ids.contains(root)) {
+      return true;
+    }
+
+    std::vector<ir::Value> workList;
+    ids.emplace(root, nodes.size());
+    nodes.push_back(root);
+    workList.push_back(root);
+
+    while (!workList.empty()) {
+      auto value = workList.back();
+      workList.pop_back();
+
+      if (value.getKind() == ir::Kind::MemSSA || value.isa<ir::Block>()) {
+        return false;
+      }
+
+      for (auto &operand : value.getOperands()) {
+        auto operandValue = operand.getAsValue();
+        if (operandValue == nullptr) {
+          continue;
+        }
+
+        if (ids.emplace(operandValue, nodes.size()).second) {
+          nodes.push_back(operandValue);
+          workList.push_back(operandValue);
+        }
+      }
+    }
+
+    return true;
+  }
+
+  bool build(const gcn::Resources &resources) {
+    for (auto &pointer : resources.pointers) {
+      if (!add(pointer.base) || !add(pointer.offset)) {
+        return false;
+      }
+    }
+
+    auto addWords = [this](std::span<const ir::Value> words) {
+      for (auto word : words) {
+        if (!add(word)) {
+          return false;
+        }
+      }
+
+      return true;
+    };
+
+    for (auto &texture : resources.textures) {
+      if (!addWords(texture.words)) {
+        return false;
+      }
+    }
+
+    for (auto &buffer : resources.buffers) {
+      if (!addWords(buffer.words)) {
+        return false;
+      }
+    }
+
+    for (auto &imageBuffer : resources.imageBuffers) {
+      if (!addWords(imageBuffer.words)) {
+        return false;
+      }
+    }
+
+    for (auto &sampler : resources.samplers) {
+      if (!addWords(sampler.words)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  std::uint32_t getId(ir::Value value) const {
+    if (value == nullptr) {
+      return kNullResourceNode;
+    }
+
+    return ids.at(value);
+  }
+};
+
+void serializeOperand(rx::Serializer &s, const ResourceNodeTable &table,
+                      const ir::Operand &operand) {
+  s.serialize(static_cast<std::uint8_t>(operand.value.index()));
+
+  std::visit(
+      [&](auto &&value) {
+        using type = std::remove_cvref_t<decltype(value)>;
+        if constexpr (std::is_same_v<type, std::nullptr_t>) {
+          return;
+        } else if constexpr (std::is_same_v<type, ir::ValueImpl *>) {
+          s.serialize(table.getId(ir::Value(value)));
+        } else {
+          s.serialize(value);
+        }
+      },
+      operand.value);
+}
+
+template <std::size_t I = 0>
+ir::Operand deserializeOperand(rx::Deserializer &s, std::uint8_t index) {
+  if constexpr (I == std::variant_size_v<ir::Operand::UnderlyingT>) {
+    s.setFailure();
+    return {};
+  } else {
+    if (index != I) {
+      return deserializeOperand<I + 1>(s, index);
+    }
+
+    using type = std::variant_alternative_t<I, ir::Operand::UnderlyingT>;
+
+    if constexpr (std::is_same_v<type, std::nullptr_t>) {
+      return nullptr;
+    } else if constexpr (std::is_same_v<type, ir::ValueImpl *>) {
+      // value references are resolved by the caller
+      s.setFailure();
+      return {};
+    } else {
+      ir::Operand result;
+      result.value = s.deserialize<type>();
+      return result;
+    }
+  }
+}
+} // namespace
+
+bool gcn::Resources::isSerializable() const {
+  ResourceNodeTable table;
+  return table.build(*this);
+}
+
+void gcn::Resources::serialize(rx::Serializer &s) const {
+  ResourceNodeTable table;
+  if (!table.build(*this)) {
+    s.serialize(kNullResourceNode);
+    return;
+  }
+
+  s.serialize(static_cast<std::uint32_t>(table.nodes.size()));
+
+  for (auto node : table.nodes) {
+    s.serialize(static_cast<std::uint32_t>(node.getKind()));
+    s.serialize(static_cast<std::uint32_t>(node.getOp()));
+    s.serialize(static_cast<std::uint32_t>(node.getOperandCount()));
+
+    for (auto &operand : node.getOperands()) {
+      serializeOperand(s, table, operand);
+    }
+  }
+
+  s.serialize(hasUnknown);
+  s.serialize(slots);
+
+  s.serialize(static_cast<std::uint32_t>(pointers.size()));
+  for (auto &pointer : pointers) {
+    s.serialize(pointer.resourceSlot);
+    s.serialize(pointer.size);
+    s.serialize(table.getId(pointer.base));
+    s.serialize(table.getId(pointer.offset));
+  }
+
+  auto serializeWords = [&](std::span<const ir::Value> words) {
+    for (auto word : words) {
+      s.serialize(table.getId(word));
+    }
+  };
+
+  s.serialize(static_cast<std::uint32_t>(buffers.size()));
+  for (auto &buffer : buffers) {
+    s.serialize(buffer.resourceSlot);
+    s.serialize(buffer.access);
+    serializeWords(buffer.words);
+  }
+
+  s.serialize(static_cast<std::uint32_t>(textures.size()));
+  for (auto &texture : textures) {
+    s.serialize(texture.resourceSlot);
+    s.serialize(texture.access);
+    serializeWords(texture.words);
+  }
+
+  s.serialize(static_cast<std::uint32_t>(imageBuffers.size()));
+  for (auto &imageBuffer : imageBuffers) {
+    s.serialize(imageBuffer.resourceSlot);
+    s.serialize(imageBuffer.access);
+    serializeWords(imageBuffer.words);
+  }
+
+  s.serialize(static_cast<std::uint32_t>(samplers.size()));
+  for (auto &sampler : samplers) {
+    s.serialize(sampler.resourceSlot);
+    s.serialize(sampler.unorm);
+    serializeWords(sampler.words);
+  }
+}
+
+void gcn::Resources::deserialize(rx::Deserializer &s) {
+  auto nodeCount = s.deserialize<std::uint32_t>();
+  if (s.failure() || nodeCount == kNullResourceNode) {
+    s.setFailure();
+    return;
+  }
+
+  // operands can reference nodes that come later in the stream, create all
+  // nodes first and fill operands on second pass
+  std::vector<ir::Value> nodes;
+  nodes.reserve(nodeCount);
+
+  auto loc = context.getUnknownLocation();
+  std::vector<std::vector<ir::Operand>> operands(nodeCount);
+  std::vector<std::vector<std::pair<std::size_t, std::uint32_t>>> valueRefs(
+      nodeCount);
+
+  for (std::uint32_t i = 0; i < nodeCount; ++i) {
+    auto kind = s.deserialize<std::uint32_t>();
+    auto op = s.deserialize<std::uint32_t>();
+    auto operandCount = s.deserialize<std::uint32_t>();
+
+    if (s.failure() || kind >= static_cast<std::uint32_t>(ir::Kind::Count)) {
+      s.setFailure();
+      return;
+    }
+
+    nodes.push_back(
+        context.create<ir::Value>(loc, static_cast<ir::Kind>(kind), op));
+
+    for (std::uint32_t j = 0; j < operandCount; ++j) {
+      auto index = s.deserialize<std::uint8_t>();
+
+      if (index == kValueOperandIndex) {
+        auto id = s.deserialize<std::uint32_t>();
+        if (id >= nodeCount) {
+          s.setFailure();
+        }
+
+        valueRefs[i].emplace_back(operands[i].size(), id);
+        operands[i].emplace_back(nullptr);
+      } else {
+        operands[i].push_back(deserializeOperand(s, index));
+      }
+
+      if (s.failure()) {
+        return;
+      }
+    }
+  }
+
+  for (std::uint32_t i = 0; i < nodeCount; ++i) {
+    for (auto [operandIndex, id] : valueRefs[i]) {
+      operands[i][operandIndex] = nodes[id];
+    }
+
+    for (auto &operand : operands[i]) {
+      nodes[i].addOperand(std::move(operand));
+    }
+  }
+
+  auto getNode = [&](std::uint32_t id) -> ir::Value {
+    if (id == kNullResourceNode) {
+      return nullptr;
+    }
+
+    if (id >= nodes.size()) {
+      s.setFailure();
+      return nullptr;
+    }
+
+    return nodes[id];
+  };
+
+  auto deserializeWords = [&](std::span<ir::Value> words) {
+    for (auto &word : words) {
+      word = getNode(s.deserialize<std::uint32_t>());
+    }
+  };
+
+  hasUnknown = s.deserialize<bool>();
+  slots = s.deserialize<std::uint32_t>();
+
+  pointers.resize(s.deserialize<std::uint32_t>());
+  for (auto &pointer : pointers) {
+    pointer.resourceSlot = s.deserialize<std::uint32_t>();
+    pointer.size = s.deserialize<std::uint32_t>();
+    pointer.base = getNode(s.deserialize<std::uint32_t>());
+    pointer.offset = getNode(s.deserialize<std::uint32_t>());
+  }
+
+  buffers.resize(s.deserialize<std::uint32_t>());
+  for (auto &buffer : buffers) {
+    buffer.resourceSlot = s.deserialize<std::uint32_t>();
+    buffer.access = s.deserialize<Access>();
+    deserializeWords(buffer.words);
+  }
+
+  textures.resize(s.deserialize<std::uint32_t>());
+  for (auto &texture : textures) {
+    texture.resourceSlot = s.deserialize<std::uint32_t>();
+    texture.access = s.deserialize<Access>();
+    deserializeWords(texture.words);
+  }
+
+  imageBuffers.resize(s.deserialize<std::uint32_t>());
+  for (auto &imageBuffer : imageBuffers) {
+    imageBuffer.resourceSlot = s.deserialize<std::uint32_t>();
+    imageBuffer.access = s.deserialize<Access>();
+    deserializeWords(imageBuffer.words);
+  }
+
+  samplers.resize(s.deserialize<std::uint32_t>());
+  for (auto &sampler : samplers) {
+    sampler.resourceSlot = s.deserialize<std::uint32_t>();
+    sampler.unorm = s.deserialize<bool>();
+    deserializeWords(sampler.words);
+  }
+}
+
+void gcn::ShaderInfo::serialize(rx::Serializer &s) const {
+  s.serialize(configSlots);
+
+  std::uint32_t areaCount = 0;
+  for ([[maybe_unused]] auto area : memoryMap) {
+    ++areaCount;
+  }
+
+  s.serialize(areaCount);
+  for (auto area : memoryMap) {
+    s.serialize(area.beginAddress);
+    s.serialize(area.endAddress);
+  }
+
+  s.serialize(requiredSgprs);
+  resources.serialize(s);
+}
+
+void gcn::ShaderInfo::deserialize(rx::Deserializer &s) {
+  configSlots = s.deserialize<std::vector<ConfigSlot>>();
+
+  auto areaCount = s.deserialize<std::uint32_t>();
+  for (std::uint32_t i = 0; i < areaCount && !s.failure(); ++i) {
+    auto beginAddress = s.deserialize<std::uint64_t>();
+    auto endAddress = s.deserialize<std::uint64_t>();
+
+    if (beginAddress >= endAddress) {
+      s.setFailure();
+      return;
+    }
+
+    memoryMap.map(beginAddress, endAddress);
+  }
+
+  requiredSgprs = s.deserialize<std::vector<std::pair<int, std::uint32_t>>>();
+
+  if (!s.failure()) {
+    resources.deserialize(s);
+  }
+}
+
 ir::Value GcnConverter::getGlPosition(gcn::Builder &builder) {
   auto float4OutPtrT = gcnContext.getTypePointer(
       ir::spv::StorageClass::Output,
@@ -1742,6 +2119,10 @@ static void createEntryPoint(gcn::Context &context, const gcn::Environment &env,
   auto functions = context.layout.getOrCreateFunctions(context);
   functions.appendRegion(prologueBlock.getParent());
 
+  if (env.optimize) {
+    optimize(context, body);
+  }
+
   for (auto cfg = buildCFG(body.getFirst()); auto bb : cfg.getPreorderNodes()) {
     for (auto child : bb->range()) {
       child.erase();
@@ -1,73 +1,308 @@
 #include "opt.hpp"
+#include "Evaluator.hpp"
 #include "analyze.hpp"
+#include "dialect.hpp"
 #include "ir.hpp"
+#include <bit>
+#include <functional>
+#include <span>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 using namespace shader;
 
 namespace {
-bool isEqOperands(ir::Instruction a, ir::Instruction b) {
-  auto opCount = a.getOperandCount();
-  if (opCount != b.getOperandCount()) {
-    return false;
+struct ValueNumberKey {
+  ir::InstructionId instId;
+  std::span<const ir::Operand> operands;
+
+  bool operator==(const ValueNumberKey &other) const {
+    return instId == other.instId &&
+           std::ranges::equal(operands, other.operands);
+  }
+};
+
+struct ValueNumberKeyHash {
+  static std::size_t hashOperand(const ir::Operand &operand) {
+    auto hash = std::visit(
+        [](auto &&value) -> std::size_t {
+          using type = std::remove_cvref_t<decltype(value)>;
+          if constexpr (std::is_same_v<type, std::nullptr_t>) {
+            return 0;
+          } else if constexpr (std::is_same_v<type, float>) {
+            return std::bit_cast<std::uint32_t>(value);
+          } else if constexpr (std::is_same_v<type, double>) {
+            return std::hash<std::uint64_t>{}(
+                std::bit_cast<std::uint64_t>(value));
+          } else {
+            return std::hash<type>{}(value);
+          }
+        },
+        operand.value);
+
+    return hash ^ operand.value.index();
+  }
+
+  std::size_t operator()(const ValueNumberKey &key) const {
+    std::size_t result = static_cast<std::size_t>(key.instId);
+
+    for (auto &operand : key.operands) {
+      result = result * 0x9e37'79b9'7f4a'7c15 + hashOperand(operand);
+    }
+
+    return result;
+  }
+};
+
+// Scoped table of available expressions, entries inserted by a block are
+// visible only in the blocks it dominates
+class ValueNumberTable {
+  std::unordered_map<ValueNumberKey, ir::Value, ValueNumberKeyHash> mValues;
+  std::vector<ValueNumberKey> mInserted;
+
+public:
+  std::size_t enterScope() const { return mInserted.size(); }
+
+  void exitScope(std::size_t scope) {
+    while (mInserted.size() > scope) {
+      mValues.erase(mInserted.back());
+      mInserted.pop_back();
+    }
   }
 
-  for (std::size_t i = 0; i < opCount; ++i) {
-    if (a.getOperand(i) != b.getOperand(i)) {
-      return false;
+  ir::Value findOrInsert(ir::Value value) {
+    ValueNumberKey key{value.getInstId(), value.getOperands()};
+    auto [it, inserted] = mValues.try_emplace(key, value);
+
+    if (inserted) {
+      mInserted.push_back(key);
+      return nullptr;
     }
+
+    return it->second;
   }
+};
 
-  return true;
+bool isIntConstant(const ir::Operand &operand) {
+  auto value = operand.getAsValue();
+  return value != nullptr && value == ir::spv::OpConstant &&
+         value.getOperand(0).getAsValue() == ir::spv::OpTypeInt;
 }
-} // namespace
 
-static bool combineInstructions(CFG &cfg, ir::Region region) {
+bool isDivision(ir::InstructionId instId) {
+  return instId == ir::spv::OpSDiv || instId == ir::spv::OpUDiv ||
+         instId == ir::spv::OpSMod || instId == ir::spv::OpUMod ||
+         instId == ir::spv::OpSRem;
+}
+
+bool isShift(ir::InstructionId instId) {
+  return instId == ir::spv::OpShiftLeftLogical ||
+         instId == ir::spv::OpShiftRightLogical ||
+         instId == ir::spv::OpShiftRightArithmetic;
+}
+
+// Folds pure instruction with integer constant operands, float constants are
+// not evaluated precisely by the evaluator and are kept as is
+ir::Value foldConstant(spv::Context &context, ir::Value inst) {
+  auto operands = inst.getOperands();
+  if (operands.size() < 2 || inst == ir::spv::OpPhi) {
+    return nullptr;
+  }
+
+  auto type = operands[0].getAsValue();
+  if (type == nullptr) {
+    return nullptr;
+  }
+
+  for (auto &operand : operands.subspan(1)) {
+    if (!isIntConstant(operand)) {
+      return nullptr;
+    }
+  }
+
+  eval::Evaluator evaluator;
+
+  if (isDivision(inst.getInstId())) {
+    auto divisor = evaluator.eval(operands.back()).zExtScalar();
+    if (!divisor || *divisor == 0) {
+      return nullptr;
+    }
+  }
+
+  if (isShift(inst.getInstId())) {
+    auto shift = evaluator.eval(operands.back()).zExtScalar();
+    auto width = type == ir::spv::OpTypeInt
+                     ? type.getOperand(0).getAsInt32()
+                     : nullptr;
+    if (!shift || width == nullptr ||
+        *shift >= static_cast<std::uint64_t>(*width)) {
+      return nullptr;
+    }
+  }
+
+  auto result = evaluator.eval(inst.getInstId(), operands);
+  if (result.empty()) {
+    return nullptr;
+  }
+
+  if (type == ir::spv::OpTypeBool) {
+    if (auto value = result.as<bool>()) {
+      return context.getBool(*value);
+    }
+
+    return nullptr;
+  }
+
+  if (type != ir::spv::OpTypeInt) {
+    return nullptr;
+  }
+
+  auto width = *type.getOperand(0).getAsInt32();
+  bool isSigned = *type.getOperand(1).getAsInt32() != 0;
+
+  if (width == 32 && isSigned) {
+    if (auto value = result.as<std::int32_t>()) {
+      return context.getOrCreateConstant(type, *value);
+    }
+  } else if (width == 32) {
+    if (auto value = result.as<std::uint32_t>()) {
+      return context.getOrCreateConstant(type, *value);
+    }
+  } else if (width == 64 && isSigned) {
+    if (auto value = result.as<std::int64_t>()) {
+      return context.getOrCreateConstant(type, *value);
+    }
+  } else if (width == 64) {
+    if (auto value = result.as<std::uint64_t>()) {
+      return context.getOrCreateConstant(type, *value);
+    }
+  }
+
+  return nullptr;
+}
+
+// Walks dominator tree in preorder, so every available expression was
+// already visited in the dominating block
+bool numberValues(spv::Context &context, CFG &cfg) {
   auto domTree = buildDomTree(cfg);
+  ValueNumberTable table;
+  std::size_t changes = 0;
 
-  std::unordered_map<ir::InstructionId, std::vector<ir::Instruction>>
-      instructions;
-  auto findPrevInst = [&](ir::Instruction inst) -> ir::Instruction {
-    for (auto prevInst : instructions[inst.getInstId()]) {
-      if (!isEqOperands(inst, prevInst)) {
+  using DomNode = graph::DomTree<ir::Value>::Node;
+  std::vector<std::pair<DomNode *, std::size_t>> workStack;
+  workStack.push_back({domTree.getRootNode(), table.enterScope()});
+
+  while (!workStack.empty()) {
+    auto [domNode, scope] = workStack.back();
+
+    if (domNode == nullptr) {
+      // all children processed
+      workStack.pop_back();
+      table.exitScope(scope);
+      continue;
+    }
+
+    workStack.back().first = nullptr;
+
+    auto bb = cfg.getNode(domNode->block);
+    for (auto inst : bb->rangeWithoutLabelAndTerminator()) {
+      auto value = inst.cast<ir::Value>();
+      if (value == nullptr) {
         continue;
       }
 
-      if (!dominates(prevInst, inst, false, domTree)) {
+      // copies are not in the side effect free set, they are never numbered
+      if (value == ir::spv::OpCopyObject) {
+        value.replaceAllUsesWith(value.getOperand(1).getAsValue());
+        value.remove();
+        changes++;
+        continue;
+      }
+
+      if (!isWithoutSideEffects(inst.getInstId())) {
+        continue;
+      }
+
+      if (auto folded = foldConstant(context, value)) {
+        value.replaceAllUsesWith(folded);
+        value.remove();
+        changes++;
+        continue;
+      }
+
+      if (value == ir::spv::OpPhi) {
         continue;
       }
 
-      return prevInst;
+      if (auto prev = table.findOrInsert(value)) {
+        value.replaceAllUsesWith(prev);
+        value.remove();
+        changes++;
+      }
+    }
+
+    for (auto child : domNode->children) {
+      workStack.push_back({child, table.enterScope()});
     }
+  }
 
-    return nullptr;
-  };
+  return changes != 0;
+}
 
-  std::size_t changes = 0;
+bool removeDeadValues(CFG &cfg) {
+  std::unordered_set<ir::Value> candidates;
+  std::vector<ir::Value> workList;
 
   for (auto bb : cfg.getPreorderNodes()) {
     for (auto inst : bb->rangeWithoutLabelAndTerminator()) {
-      if (!shader::isWithoutSideEffects(inst.getInstId())) {
+      if (!isWithoutSideEffects(inst.getInstId())) {
         continue;
       }
 
-      if (auto prev = findPrevInst(inst)) {
-        if (auto value = inst.cast<ir::Value>()) {
-          value.replaceAllUsesWith(prev.staticCast<ir::Value>());
-        }
-        inst.remove();
-        changes++;
-      } else {
-        instructions[inst.getInstId()].push_back(inst);
+      if (auto value = inst.cast<ir::Value>()) {
+        candidates.insert(value);
+        workList.push_back(value);
+      }
+    }
+  }
+
+  std::size_t changes = 0;
+
+  while (!workList.empty()) {
+    auto value = workList.back();
+    workList.pop_back();
+
+    if (!value.isUnused() || !candidates.contains(value)) {
+      continue;
+    }
+
+    candidates.erase(value);
+
+    std::vector<ir::Value> operands;
+    for (auto &operand : value.getOperands()) {
+      if (auto operandValue = operand.getAsValue()) {
+        operands.push_back(operandValue);
+      }
+    }
+
+    value.remove();
+    changes++;
+
+    for (auto operand : operands) {
+      if (candidates.contains(operand)) {
+        workList.push_back(operand);
       }
     }
   }
 
-  // std::cerr << "combined instructions: " << changes << "\n";
   return changes != 0;
 }
+} // namespace
 
-bool shader::optimize(ir::Context &context, ir::Region region) {
+bool shader::optimize(spv::Context &context, ir::Region region) {
   auto cfg = buildCFG(region.getFirst());
-  return combineInstructions(cfg, region);
-}
\ No newline at end of file
+  bool changed = numberValues(context, cfg);
+  changed |= removeDeadValues(cfg);
+  return changed;
+}
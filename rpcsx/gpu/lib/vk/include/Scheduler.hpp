@@ -1,49 +1,117 @@
 #pragma once
 
 #include "vk.hpp"
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <map>
 #include <mutex>
 #include <stop_token>
 #include <thread>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+// Records commands into a ring of command buffers. Submissions are ordered on
+// the GPU by the timeline semaphore, the CPU only waits when it wraps around
+// to a command buffer which is still executing.
+//
+// afterSubmit tasks are deferred until the submission completes and are
+// executed on the submitting thread, by retire(), wait() or a later submit().
+// onComplete tasks are executed on the completion thread and must not use the
+// scheduler.
 class Scheduler {
+public:
+  static constexpr std::size_t kMaxInFlight = 4;
+
+  struct Stats {
+    std::uint64_t submits;
+    std::uint64_t maxInFlight;
+    std::uint64_t stalls;
+    std::chrono::nanoseconds stallTime;
+    std::chrono::nanoseconds waitTime;
+  };
+
+private:
+  using TaskList = std::vector<std::move_only_function<void()>>;
+
+  struct Slot {
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    std::uint64_t signalValue = 0;
+  };
+
   vk::Semaphore mSemaphore = vk::Semaphore::Create();
   VkQueue mQueue;
   unsigned mQueueFamily;
   vk::CommandPool mCommandPool;
-  vk::CommandBuffer mCommandBuffer;
+  Slot mSlots[kMaxInFlight];
+  std::size_t mCurrentSlot = 0;
   bool mIsEmpty = false;
+  bool mIsRetiring = false;
 
   std::uint64_t mNextSignal = 1;
+  TaskList mAfterSubmitTasks;
+  std::map<std::uint64_t, TaskList> mRetireTasks;
+
+  std::uint64_t mSubmits = 0;
+  std::uint64_t mMaxInFlight = 0;
+  std::uint64_t mStalls = 0;
+  std::chrono::nanoseconds mStallTime{};
+  std::chrono::nanoseconds mWaitTime{};
+
   std::mutex mTaskMutex;
-  std::condition_variable mTaskCv;
-  std::map<std::uint64_t, std::vector<std::move_only_function<void()>>> mTasks;
-  std::vector<std::move_only_function<void()>> mAfterSubmitTasks;
+  std::condition_variable_any mTaskCv;
+  std::map<std::uint64_t, TaskList> mTasks;
 
-  // std::jthread mThread = std::jthread{
-  //     [this](std::stop_token stopToken) { schedulerEntry(stopToken); }};
+  // must be the last member, it is joined before the rest is destroyed
+  std::jthread mCompletionThread;
 
 public:
   Scheduler(VkQueue queue, unsigned queueFamilyIndex)
       : mQueue(queue), mQueueFamily(queueFamilyIndex) {
-    mCommandPool = vk::CommandPool::Create(queueFamilyIndex);
-    mCommandBuffer = mCommandPool.createOneTimeSubmitBuffer();
+    mCommandPool = vk::CommandPool::Create(
+        queueFamilyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+
+    VkCommandBuffer commandBuffers[kMaxInFlight];
+    VkCommandBufferAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = mCommandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = kMaxInFlight,
+    };
+
+    VK_VERIFY(vkAllocateCommandBuffers(vk::context->device, &allocInfo,
+                                       commandBuffers));
+
+    for (std::size_t i = 0; i < kMaxInFlight; ++i) {
+      mSlots[i].commandBuffer = commandBuffers[i];
+    }
+
+    beginSlot(mSlots[mCurrentSlot]);
   }
 
+  Scheduler(const Scheduler &) = delete;
+
   ~Scheduler() {
-    // mThread.request_stop();
-    // mTaskCv.notify_one();
+    // command buffers cannot be destroyed while in use, external submits are
+    // not tracked here
+    std::uint64_t lastSignal = 0;
+    for (auto &slot : mSlots) {
+      lastSignal = std::max(lastSignal, slot.signalValue);
+    }
+
+    if (lastSignal != 0) {
+      mSemaphore.wait(lastSignal, UINT64_MAX);
+    }
   }
 
   unsigned getQueueFamily() const { return mQueueFamily; }
   VkQueue getQueue() const { return mQueue; }
   VkCommandBuffer getCommandBuffer() {
     mIsEmpty = false;
-    return mCommandBuffer;
+    return mSlots[mCurrentSlot].commandBuffer;
   }
 
   Scheduler &submit() {
@@ -52,7 +120,8 @@ public:
     }
     mIsEmpty = true;
 
-    mCommandBuffer.end();
+    auto &slot = mSlots[mCurrentSlot];
+    VK_VERIFY(vkEndCommandBuffer(slot.commandBuffer));
 
     VkSemaphoreSubmitInfo waitSemSubmitInfo = {
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
@@ -70,7 +139,7 @@ public:
 
     VkCommandBufferSubmitInfo cmdBufferSubmitInfo{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
-        .commandBuffer = mCommandBuffer,
+        .commandBuffer = slot.commandBuffer,
     };
 
     VkSubmitInfo2 submitInfo{
@@ -83,52 +152,27 @@ public:
         .pSignalSemaphoreInfos = &signalSemSubmitInfo,
     };
 
-    mCommandBuffer = mCommandPool.createOneTimeSubmitBuffer();
-
-    wait();
-
     VK_VERIFY(vkQueueSubmit2(mQueue, 1, &submitInfo, VK_NULL_HANDLE));
 
-    ++mNextSignal;
-
-    // then([afterSubmit = std::move(mAfterSubmitTasks)] mutable {
-    //   for (auto &&fn : afterSubmit) {
-    //     std::move(fn)();
-    //   }
-    // });
-
-    // mAfterSubmitTasks.clear();
-
-    auto endIt = mTasks.upper_bound(mNextSignal - 1);
-
-    if (mAfterSubmitTasks.empty() && endIt == mTasks.end()) {
-      return *this;
-    }
-
-    auto afterSubmit = std::move(mAfterSubmitTasks);
-    mAfterSubmitTasks.clear();
-
-    wait();
+    slot.signalValue = mNextSignal;
 
-    while (!afterSubmit.empty()) {
-      auto task = std::move(afterSubmit.back());
-      afterSubmit.pop_back();
-      std::move(task)();
-    }
-
-    std::vector<std::move_only_function<void()>> taskList;
-
-    for (auto it = mTasks.begin(); it != mTasks.end(); it = mTasks.erase(it)) {
-      taskList.reserve(taskList.size() + it->second.size());
-      for (auto &&fn : it->second) {
-        taskList.push_back(std::move(fn));
+    if (!mAfterSubmitTasks.empty()) {
+      auto &tasks = mRetireTasks[mNextSignal];
+      for (auto &&fn : mAfterSubmitTasks) {
+        tasks.push_back(std::move(fn));
       }
+      mAfterSubmitTasks.clear();
     }
 
-    for (auto &&task : taskList) {
-      std::move(task)();
-    }
+    ++mNextSignal;
+    ++mSubmits;
 
+    auto completed = mSemaphore.getCounterValue();
+    mMaxInFlight = std::max(mMaxInFlight, mNextSignal - 1 - completed);
+
+    mCurrentSlot = (mCurrentSlot + 1) % kMaxInFlight;
+    beginSlot(mSlots[mCurrentSlot]);
+    retire();
     return *this;
   }
 
@@ -138,47 +182,134 @@ public:
   }
 
   Scheduler &then(std::move_only_function<void()> fn) {
-    // auto signalValue = mNextSignal++;
-    // onComplete([this, signalValue, fn = std::move(fn)] mutable {
-    //   mSemaphore.wait(signalValue - 1, UINT64_MAX);
-    //   std::move(fn)();
-    //   mSemaphore.signal(signalValue);
-    // });
     wait();
     fn();
     return *this;
   }
 
-  // Scheduler &onComplete(std::move_only_function<void()> fn) {
-  //   std::unique_lock lock(mTaskMutex);
-  //   mTasks[mNextSignal - 1].push_back(std::move(fn));
-  //   mTaskCv.notify_one();
-  //   return *this;
-  // }
+  // Executes fn on the completion thread after all submitted work is done
+  Scheduler &onComplete(std::move_only_function<void()> fn) {
+    std::lock_guard lock(mTaskMutex);
+    if (!mCompletionThread.joinable()) {
+      mCompletionThread = std::jthread{
+          [this](std::stop_token stopToken) { schedulerEntry(stopToken); }};
+    }
+
+    mTasks[mNextSignal - 1].push_back(std::move(fn));
+    mTaskCv.notify_one();
+    return *this;
+  }
 
   std::uint64_t createExternalSubmit() { return mNextSignal++; }
-  void wait() const { mSemaphore.wait(mNextSignal - 1, UINT64_MAX); }
+
+  // Waits for all submitted work and executes completed afterSubmit tasks
+  void wait() {
+    auto value = mNextSignal - 1;
+
+    if (mSemaphore.getCounterValue() < value) {
+      auto startTime = std::chrono::steady_clock::now();
+      mSemaphore.wait(value, UINT64_MAX);
+      mWaitTime += std::chrono::steady_clock::now() - startTime;
+    }
+
+    runRetireTasks(value);
+  }
+
+  // Executes afterSubmit tasks of completed submissions without blocking
+  void retire() {
+    if (!mRetireTasks.empty()) {
+      runRetireTasks(mSemaphore.getCounterValue());
+    }
+  }
+
+  [[nodiscard]] std::uint64_t getInFlightDepth() const {
+    return mNextSignal - 1 - mSemaphore.getCounterValue();
+  }
+
+  [[nodiscard]] Stats getStats() const {
+    return {
+        .submits = mSubmits,
+        .maxInFlight = mMaxInFlight,
+        .stalls = mStalls,
+        .stallTime = mStallTime,
+        .waitTime = mWaitTime,
+    };
+  }
 
   VkSemaphore getSemaphoreHandle() const { return mSemaphore.getHandle(); }
 
 private:
+  void beginSlot(Slot &slot) {
+    if (slot.signalValue != 0 &&
+        mSemaphore.getCounterValue() < slot.signalValue) {
+      auto startTime = std::chrono::steady_clock::now();
+      mSemaphore.wait(slot.signalValue, UINT64_MAX);
+      mStallTime += std::chrono::steady_clock::now() - startTime;
+      ++mStalls;
+    }
+
+    VK_VERIFY(vkResetCommandBuffer(slot.commandBuffer, 0));
+
+    VkCommandBufferBeginInfo beginInfo{
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+
+    VK_VERIFY(vkBeginCommandBuffer(slot.commandBuffer, &beginInfo));
+  }
+
+  void runRetireTasks(std::uint64_t completedValue) {
+    // tasks are allowed to submit and wait, nested calls leave the rest of
+    // the queue to the outer one
+    if (mIsRetiring) {
+      return;
+    }
+
+    mIsRetiring = true;
+
+    while (!mRetireTasks.empty() &&
+           mRetireTasks.begin()->first <= completedValue) {
+      auto tasks = std::move(mRetireTasks.begin()->second);
+      mRetireTasks.erase(mRetireTasks.begin());
+
+      while (!tasks.empty()) {
+        auto task = std::move(tasks.back());
+        tasks.pop_back();
+        std::move(task)();
+      }
+    }
+
+    mIsRetiring = false;
+  }
+
   void schedulerEntry(std::stop_token stopToken) {
-    std::vector<std::move_only_function<void()>> taskList;
-    while (!stopToken.stop_requested()) {
-      std::this_thread::sleep_for(std::chrono::microseconds(10));
+    TaskList taskList;
+
+    while (true) {
+      std::uint64_t value;
 
       {
         std::unique_lock lock(mTaskMutex);
-        while (mTasks.empty()) {
-          mTaskCv.wait(lock);
+        auto hasTasks = [this] { return !mTasks.empty(); };
+        if (!mTaskCv.wait(lock, stopToken, hasTasks)) {
+          return;
+        }
 
-          if (stopToken.stop_requested()) {
-            return;
-          }
+        value = mTasks.begin()->first;
+      }
+
+      // wake up periodically to observe stop requests
+      if (mSemaphore.wait(value, 1'000'000) != VK_SUCCESS) {
+        if (stopToken.stop_requested()) {
+          return;
         }
 
-        auto value = mSemaphore.getCounterValue();
-        auto endIt = mTasks.upper_bound(value);
+        continue;
+      }
+
+      {
+        std::lock_guard lock(mTaskMutex);
+        auto endIt = mTasks.upper_bound(mSemaphore.getCounterValue());
 
         for (auto it = mTasks.begin(); it != endIt; it = mTasks.erase(it)) {
           taskList.reserve(taskList.size() + it->second.size());
@@ -10,13 +10,17 @@
 #include "vfs.hpp"
 #include "vm.hpp"
 #include <cerrno>
+#include <chrono>
+#include <ctime>
 #include <dirent.h>
 #include <fcntl.h>
 #include <filesystem>
+#include <mutex>
 #include <netinet/in.h>
 #include <optional>
 #include <rx/align.hpp>
 #include <rx/mem.hpp>
+#include <shared_mutex>
 #include <span>
 #include <string>
 #include <sys/mman.h>
@@ -734,38 +738,185 @@ orbis::ErrorCode createSocket(rx::Ref<orbis::File> *file, orbis::kstring name,
   return {};
 }
 
-static std::optional<std::string>
-findFileInDir(const std::filesystem::path &dir, const char *name) {
-  for (auto entry : std::filesystem::directory_iterator(dir)) {
-    auto entryName = entry.path().filename();
-    if (strcasecmp(entryName.c_str(), name) == 0) {
-      return entryName;
+static std::string foldCase(std::string_view name) {
+  std::string result(name);
+  for (auto &c : result) {
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
     }
   }
-  return {};
+  return result;
+}
+
+static std::int64_t getMTime(const struct stat &st) {
+  return st.st_mtim.tv_sec * 1'000'000'000ll + st.st_mtim.tv_nsec;
+}
+
+HostFsDevice::~HostFsDevice() {
+  auto stats = getLookupStats();
+
+  if (stats.lookups != 0) {
+    std::string_view path = hostPath;
+    auto averageLookupNs = stats.lookupTimeNs / stats.lookups;
+    ORBIS_LOG_NOTICE("host fs: path lookup stats", path, stats.lookups,
+                     stats.misses, stats.dirScans, averageLookupNs);
+  }
 }
 
-static std::optional<std::filesystem::path>
-toRealPath(const std::filesystem::path &inp) {
-  if (inp.empty()) {
+HostFsDevice::LookupStats HostFsDevice::getLookupStats() const {
+  return {
+      .lookups = mLookups.load(std::memory_order::relaxed),
+      .misses = mMisses.load(std::memory_order::relaxed),
+      .dirScans = mDirScans.load(std::memory_order::relaxed),
+      .lookupTimeNs = mLookupTimeNs.load(std::memory_order::relaxed),
+  };
+}
+
+std::optional<orbis::kstring> HostFsDevice::findEntry(const std::string &dir,
+                                                      std::string_view name) {
+  auto foldedName = foldCase(name);
+
+  // Directory modification time tells whether the cached list is still valid,
+  // the directory may be changed by the host
+  struct stat st;
+  if (::stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) {
     return {};
   }
 
-  std::filesystem::path result;
-  for (auto elem : inp) {
-    if (result.empty() || std::filesystem::exists(result / elem)) {
-      result /= elem;
+  auto mtime = getMTime(st);
+
+  {
+    std::shared_lock lock(mDirCacheMtx);
+
+    if (auto it = mDirCache.find(std::string_view(dir));
+        it != mDirCache.end() && it->second.mtime == mtime) {
+      if (auto nameIt = it->second.names.find(std::string_view(foldedName));
+          nameIt != it->second.names.end()) {
+        return nameIt->second;
+      }
+
+      return {};
+    }
+  }
+
+  auto hostDir = ::opendir(dir.c_str());
+  if (hostDir == nullptr) {
+    return {};
+  }
+
+  mDirScans.fetch_add(1, std::memory_order::relaxed);
+
+  DirCache dirCache;
+  while (auto entry = ::readdir(hostDir)) {
+    std::string_view entryName = entry->d_name;
+    if (entryName == "." || entryName == "..") {
       continue;
     }
 
-    auto icaseElem = findFileInDir(result, elem.c_str());
-    if (!icaseElem) {
-      return {};
+    dirCache.names.emplace(foldCase(entryName), entryName);
+  }
+
+  ::closedir(hostDir);
+
+  // Timestamps have coarse granularity on some file systems, a directory
+  // modified recently may change again without updating its mtime
+  struct timespec now;
+  ::clock_gettime(CLOCK_REALTIME, &now);
+  auto isStable =
+      now.tv_sec * 1'000'000'000ll + now.tv_nsec - mtime > 1'000'000'000ll;
+
+  std::optional<orbis::kstring> result;
+  if (auto it = dirCache.names.find(std::string_view(foldedName));
+      it != dirCache.names.end()) {
+    result = it->second;
+  }
+
+  std::lock_guard lock(mDirCacheMtx);
+  if (isStable) {
+    dirCache.mtime = mtime;
+    mDirCache.insert_or_assign(orbis::kstring(dir), std::move(dirCache));
+  } else if (auto it = mDirCache.find(std::string_view(dir));
+             it != mDirCache.end()) {
+    mDirCache.erase(it);
+  }
+
+  return result;
+}
+
+void HostFsDevice::invalidateParentDir(const std::string &hostFilePath) {
+  auto parentDir = hostFilePath.substr(0, hostFilePath.rfind('/'));
+
+  std::lock_guard lock(mDirCacheMtx);
+  if (auto it = mDirCache.find(std::string_view(parentDir));
+      it != mDirCache.end()) {
+    mDirCache.erase(it);
+  }
+}
+
+void HostFsDevice::invalidateDirTree(const std::string &hostDirPath) {
+  std::string_view dir = hostDirPath;
+
+  std::lock_guard lock(mDirCacheMtx);
+  for (auto it = mDirCache.lower_bound(dir);
+       it != mDirCache.end() && std::string_view(it->first).starts_with(dir);) {
+    // keep siblings which only share the name prefix
+    if (it->first.size() == dir.size() || it->first[dir.size()] == '/') {
+      it = mDirCache.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+std::optional<std::string> HostFsDevice::resolvePath(std::string_view path,
+                                                     bool allowMissing) {
+  auto startTime = std::chrono::steady_clock::now();
+  mLookups.fetch_add(1, std::memory_order::relaxed);
+
+  std::optional<std::string> result = std::string(hostPath);
+  bool isMissing = false;
+
+  while (!path.empty()) {
+    auto separator = path.find('/');
+    auto elem = path.substr(0, separator);
+    path.remove_prefix(separator == std::string_view::npos ? path.size()
+                                                           : separator + 1);
+
+    if (elem.empty() || elem == ".") {
+      continue;
+    }
+
+    // nothing exists under a missing component, no need to look it up
+    auto realName = elem == ".." || isMissing ? std::nullopt
+                                              : findEntry(*result, elem);
+
+    if (realName) {
+      *result += '/';
+      *result += *realName;
+      continue;
+    }
+
+    if (elem == "..") {
+      *result += '/';
+      *result += elem;
+      continue;
+    }
+
+    if (allowMissing) {
+      isMissing = true;
+      *result += '/';
+      *result += elem;
+      continue;
     }
 
-    result /= *icaseElem;
+    mMisses.fetch_add(1, std::memory_order::relaxed);
+    result.reset();
+    break;
   }
 
+  auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - startTime);
+  mLookupTimeNs.fetch_add(elapsed.count(), std::memory_order::relaxed);
   return result;
 }
 
@@ -827,7 +978,7 @@ orbis::ErrorCode HostFsDevice::open(rx::Ref<orbis::File> *file,
   if (hostFd < 0) {
     error = convertErrno();
 
-    if (auto icaseRealPath = toRealPath(realPath)) {
+    if (auto icaseRealPath = resolvePath(path, (realFlags & O_CREAT) != 0)) {
       ORBIS_LOG_WARNING(__FUNCTION__, path, realPath.c_str(),
                         icaseRealPath->c_str());
       hostFd = ::open(icaseRealPath->c_str(), realFlags, 0777);
@@ -897,14 +1048,17 @@ orbis::ErrorCode HostFsDevice::open(rx::Ref<orbis::File> *file,
 
 orbis::ErrorCode HostFsDevice::unlink(const char *path, bool recursive,
                                       orbis::Thread *thread) {
+  auto realPath = resolvePath(path, true).value();
   std::error_code ec;
 
   if (recursive) {
-    std::filesystem::remove_all(hostPath + "/" + path, ec);
+    std::filesystem::remove_all(realPath, ec);
+    invalidateDirTree(realPath);
   } else {
-    std::filesystem::remove(hostPath + "/" + path, ec);
+    std::filesystem::remove(realPath, ec);
   }
 
+  invalidateParentDir(realPath);
   return convertErrorCode(ec);
 }
 
@@ -913,26 +1067,35 @@ orbis::ErrorCode HostFsDevice::createSymlink(const char *linkPath,
                                              orbis::Thread *thread) {
   std::error_code ec;
   std::filesystem::create_symlink(
-      std::filesystem::absolute(hostPath + "/" + linkPath),
-      hostPath + "/" + target, ec);
+      std::filesystem::absolute(resolvePath(linkPath, true).value()),
+      resolvePath(target, true).value(), ec);
   return convertErrorCode(ec);
 }
 
 orbis::ErrorCode HostFsDevice::mkdir(const char *path, int mode,
                                      orbis::Thread *thread) {
   std::error_code ec;
-  std::filesystem::create_directories(hostPath + "/" + path, ec);
+  std::filesystem::create_directories(resolvePath(path, true).value(), ec);
   return convertErrorCode(ec);
 }
 orbis::ErrorCode HostFsDevice::rmdir(const char *path, orbis::Thread *thread) {
+  auto realPath = resolvePath(path, true).value();
   std::error_code ec;
-  std::filesystem::remove_all(hostPath + "/" + path, ec);
+  std::filesystem::remove_all(realPath, ec);
+  invalidateDirTree(realPath);
+  invalidateParentDir(realPath);
   return convertErrorCode(ec);
 }
 orbis::ErrorCode HostFsDevice::rename(const char *from, const char *to,
                                       orbis::Thread *thread) {
+  auto realFrom = resolvePath(from, true).value();
+  auto realTo = resolvePath(to, true).value();
   std::error_code ec;
-  std::filesystem::rename(hostPath + "/" + from, hostPath + "/" + to, ec);
+  std::filesystem::rename(realFrom, realTo, ec);
+  invalidateDirTree(realFrom);
+  invalidateDirTree(realTo);
+  invalidateParentDir(realFrom);
+  invalidateParentDir(realTo);
   return convertErrorCode(ec);
 }
 
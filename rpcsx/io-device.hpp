@@ -4,15 +4,35 @@
 #include "orbis/KernelAllocator.hpp"
 #include "orbis/file.hpp"
 #include "rx/Rc.hpp"
+#include "rx/SharedMutex.hpp"
+#include <atomic>
 #include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <system_error>
 
 struct HostFsDevice : orbis::IoDevice {
+  // Entries of a host directory, real names by case folded names
+  struct DirCache {
+    orbis::kmap<orbis::kstring, orbis::kstring> names;
+    std::int64_t mtime = 0;
+  };
+
+  struct LookupStats {
+    std::uint64_t lookups;
+    std::uint64_t misses;
+    std::uint64_t dirScans;
+    std::uint64_t lookupTimeNs;
+  };
+
   orbis::kstring hostPath;
   orbis::kstring virtualPath;
 
   HostFsDevice(orbis::kstring path, orbis::kstring virtualPath)
       : hostPath(std::move(path)), virtualPath(std::move(virtualPath)) {}
+  ~HostFsDevice();
+
   orbis::ErrorCode open(rx::Ref<orbis::File> *file, const char *path,
                         std::uint32_t flags, std::uint32_t mode,
                         orbis::Thread *thread) override;
@@ -25,6 +45,28 @@ struct HostFsDevice : orbis::IoDevice {
   orbis::ErrorCode rmdir(const char *path, orbis::Thread *thread) override;
   orbis::ErrorCode rename(const char *from, const char *to,
                           orbis::Thread *thread) override;
+
+  // Resolves a guest path to the host path, matching components case
+  // insensitively. If allowMissing is set, the first missing component and
+  // all components after it are kept as is
+  std::optional<std::string> resolvePath(std::string_view path,
+                                         bool allowMissing);
+
+  [[nodiscard]] LookupStats getLookupStats() const;
+
+private:
+  std::optional<orbis::kstring> findEntry(const std::string &dir,
+                                          std::string_view name);
+  void invalidateParentDir(const std::string &hostFilePath);
+  void invalidateDirTree(const std::string &hostDirPath);
+
+  rx::shared_mutex mDirCacheMtx;
+  orbis::kmap<orbis::kstring, DirCache> mDirCache; // by host directory path
+
+  std::atomic<std::uint64_t> mLookups{0};
+  std::atomic<std::uint64_t> mMisses{0};
+  std::atomic<std::uint64_t> mDirScans{0};
+  std::atomic<std::uint64_t> mLookupTimeNs{0};
 };
 
 orbis::ErrorCode convertErrorCode(const std::error_code &code);
@@ -4,12 +4,25 @@
 #include "orbis/IoDevice.hpp"
 #include "orbis/KernelAllocator.hpp"
 #include "orbis/file.hpp"
+#include "orbis/thread/Process.hpp"
 #include "orbis/thread/Thread.hpp"
 #include "orbis/utils/Logs.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
-#include <rx/atScopeExit.hpp>
+#include <immintrin.h>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <rx/SharedCV.hpp>
 #include <rx/hexdump.hpp>
+#include <signal.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
 
 extern "C" {
 #include <libatrac9/decoder.h>
@@ -53,6 +66,27 @@ enum {
   AJM_IOCTL_INSTANCE_SWITCH = 0xc028890b,
 };
 
+static constexpr orbis::uint32_t kAjmWaitInfinite = ~0u;
+static constexpr std::size_t kAjmMaxTrackedBatches = 1024;
+
+// Waits for jobs also look for exited processes with this period. A process
+// which crashed cannot drop its jobs on its own
+static constexpr long kAjmExitPollUs = 100'000;
+
+struct AjmBatch {
+  orbis::uint32_t pendingJobs = 0;
+};
+
+// Workers of one host process. Guest buffers and codec state are process
+// local, so jobs are decoded by the process which submitted them
+struct AjmWorkerGroup {
+  // instances with pending jobs and no owning worker
+  orbis::kdeque<orbis::int32_t> readyInstances;
+  rx::shared_cv cv;
+  orbis::uint32_t workerCount = 0;
+  bool isExiting = false;
+};
+
 struct AjmDevice
     : orbis::IoDeviceWithIoctl<orbis::ioctl::group(AJM_IOCTL_FINALIZE)> {
   rx::shared_mutex mtx;
@@ -61,13 +95,43 @@ struct AjmDevice
   orbis::uint32_t instanceIds[AJM_CODEC_COUNT]{};
   orbis::uint32_t unimplementedInstanceId = 0;
   orbis::kmap<orbis::int32_t, Instance> instanceMap;
+
+  orbis::kmap<orbis::uint32_t, AjmBatch> batches;
+  orbis::kmap<std::uint64_t, AjmWorkerGroup> workerGroups;
+  rx::shared_cv batchCv;
+  bool isStopping = false;
+
+  std::uint64_t batchCount = 0;
+  std::uint64_t jobCount = 0;
+  std::uint64_t jobTimeUs = 0;
+  std::uint64_t maxJobTimeUs = 0;
+
   orbis::ErrorCode open(rx::Ref<orbis::File> *file, const char *path,
                         std::uint32_t flags, std::uint32_t mode,
                         orbis::Thread *thread) override;
 
   AjmDevice();
+  ~AjmDevice() override;
 };
 
+// Worker threads started by this host process. A forked process inherits a
+// copy of the table without the threads, so it is recreated for each pid
+static std::mutex g_ajmThreadsMtx;
+static ::pid_t g_ajmThreadsPid = 0;
+static std::map<AjmDevice *, std::vector<std::thread>> *g_ajmThreads = nullptr;
+
+static void stopAjmWorkers();
+
+static std::map<AjmDevice *, std::vector<std::thread>> &getAjmThreads() {
+  if (g_ajmThreadsPid != ::getpid()) {
+    g_ajmThreadsPid = ::getpid();
+    g_ajmThreads = new std::map<AjmDevice *, std::vector<std::thread>>();
+    std::atexit(stopAjmWorkers);
+  }
+
+  return *g_ajmThreads;
+}
+
 AVSampleFormat ajmToAvFormat(AJMFormat ajmFormat) {
   switch (ajmFormat) {
   case AJM_FORMAT_S16:
@@ -131,6 +195,16 @@ struct AjmIoctlInstanceFinalize {
 static orbis::ErrorCode ajm_ioctl_finalize(orbis::Thread *, AjmDevice *device,
                                            AjmIoctlInstanceFinalize &args) {
   ORBIS_LOG_ERROR(__FUNCTION__, args.instanceId);
+
+  {
+    std::lock_guard lock(device->mtx);
+    if (device->jobCount != 0) {
+      ORBIS_LOG_NOTICE("ajm: decode stats", device->batchCount,
+                       device->jobCount, device->jobTimeUs / device->jobCount,
+                       device->maxJobTimeUs);
+    }
+  }
+
   args.result = 0;
   args.unk0 = 0;
   return {};
@@ -261,8 +335,26 @@ ajm_ioctl_instance_destroy(orbis::Thread *, AjmDevice *device,
                            AjmIoctlInstanceDestroy &args) {
   ORBIS_LOG_ERROR(__FUNCTION__, args.instanceId);
   std::lock_guard lock(device->mtx);
-  if (device->instanceMap.erase(args.instanceId) == 0) {
-    return orbis::ErrorCode::INVAL;
+
+  while (true) {
+    auto it = device->instanceMap.find(args.instanceId);
+    if (it == device->instanceMap.end()) {
+      return orbis::ErrorCode::INVAL;
+    }
+
+    // worker keeps reference to the instance until its queue is drained
+    if (it->second.ownerPid == 0) {
+      device->instanceMap.erase(it);
+      break;
+    }
+
+    orbis::scoped_unblock unblock;
+    if (device->batchCv.wait(device->mtx, kAjmExitPollUs) ==
+        std::errc::interrupted) {
+      return orbis::ErrorCode::INTR;
+    }
+
+    removeExitedWorkerGroups(device);
   }
 
   args.result = 0;
@@ -301,6 +393,610 @@ ajm_ioctl_instance_switch(orbis::Thread *thread, AjmDevice *device,
   return {};
 }
 
+static orbis::ErrorCode executeJob(Instance &instance, AjmJob &job) {
+  auto &runJob = job.run;
+  auto instanceId = job.instanceId;
+
+  if (runJob.control) {
+    auto *ctrl = &job.control;
+    auto *result = reinterpret_cast<AJMSidebandResult *>(ctrl->pSidebandOutput);
+    *result = {};
+
+    ORBIS_LOG_ERROR(__FUNCTION__, "control buffer", ctrl->opcode,
+                    ctrl->commandId, ctrl->flagsHi, ctrl->flagsLo,
+                    ctrl->sidebandInputSize, ctrl->sidebandOutputSize);
+    if (ctrl->getFlags() & CONTROL_RESET) {
+      reset(&instance);
+      if (instance.codec == AJM_CODEC_At9) {
+        resetAt9(&instance);
+      }
+    }
+
+    if (ctrl->getFlags() & CONTROL_INITIALIZE) {
+      if (instance.codec == AJM_CODEC_At9) {
+        struct InitalizeBuffer {
+          orbis::uint32_t configData;
+          orbis::int32_t unk0[2];
+        };
+        auto *initializeBuffer = (InitalizeBuffer *)ctrl->pSidebandInput;
+        instance.at9.configData = initializeBuffer->configData;
+        reset(&instance);
+        resetAt9(&instance);
+
+        orbis::uint32_t maxChannels =
+            instance.maxChannels == AJM_CHANNEL_DEFAULT ? 2
+                                                        : instance.maxChannels;
+        orbis::uint32_t outputChannels =
+            instance.at9.inputChannels > maxChannels
+                ? maxChannels
+                : instance.at9.inputChannels;
+        // TODO: check max channels
+        ORBIS_LOG_TODO("CONTROL_INITIALIZE AT9", instance.at9.inputChannels,
+                       instance.at9.sampleRate, instance.at9.frameSamples,
+                       instance.at9.superFrameSize, maxChannels,
+                       outputChannels, initializeBuffer->configData,
+                       (orbis::uint32_t)instance.outputFormat);
+      } else if (instance.codec == AJM_CODEC_AAC) {
+        struct InitializeBuffer {
+          orbis::uint32_t headerIndex;
+          orbis::uint32_t sampleRateIndex;
+        };
+        auto *initializeBuffer = (InitializeBuffer *)ctrl->pSidebandInput;
+        instance.aac.headerType = AACHeaderType(initializeBuffer->headerIndex);
+        instance.aac.sampleRate = AACFreq[initializeBuffer->sampleRateIndex];
+        if (instance.aac.headerType == AAC_RAW) {
+          avcodec_free_context(&instance.codecCtx);
+
+          AVCodecContext *codecCtx = avcodec_alloc_context3(instance.avCodec);
+          if (!codecCtx) {
+            ORBIS_LOG_FATAL("Failed to allocate codec context for raw aac");
+            std::abort();
+          }
+
+          orbis::uint32_t outputChannels =
+              instance.maxChannels == AJM_CHANNEL_DEFAULT
+                  ? 2
+                  : instance.maxChannels;
+
+          AVChannelLayout chLayout;
+          av_channel_layout_default(&chLayout, outputChannels);
+          codecCtx->ch_layout = chLayout;
+          codecCtx->sample_rate = instance.aac.sampleRate;
+
+          if (int err = avcodec_open2(codecCtx, instance.avCodec, nullptr);
+              err < 0) {
+            ORBIS_LOG_FATAL("Could not open codec for raw aac", err);
+            std::abort();
+          }
+
+          instance.codecCtx = codecCtx;
+        }
+        ORBIS_LOG_TODO("CONTROL_INITIALIZE AAC",
+                       (std::int16_t)instance.aac.headerType,
+                       instance.aac.sampleRate,
+                       (std::int16_t)instance.maxChannels,
+                       (orbis::uint32_t)instance.outputFormat);
+      }
+    }
+    if (ctrl->getFlags() & SIDEBAND_GAPLESS_DECODE) {
+      struct InitializeBuffer {
+        orbis::uint32_t totalSamples;
+        orbis::uint16_t skipSamples;
+        orbis::uint16_t totalSkippedSamples;
+      };
+
+      auto *initializeBuffer = (InitializeBuffer *)ctrl->pSidebandInput;
+      if (initializeBuffer->totalSamples > 0) {
+        instance.gapless.totalSamples = initializeBuffer->totalSamples;
+      }
+      if (initializeBuffer->skipSamples > 0) {
+        instance.gapless.skipSamples = initializeBuffer->skipSamples;
+      }
+      ORBIS_LOG_TODO("SIDEBAND_GAPLESS_DECODE", instance.gapless.skipSamples,
+                     instance.gapless.totalSamples);
+    }
+    return {};
+  }
+
+  std::swap(instance.inputBuffer, job.input);
+
+  if (instanceId >= 0xC000) {
+    auto *result = reinterpret_cast<AJMSidebandResult *>(runJob.pSideband);
+    result->result = 0;
+    result->codecResult = 0;
+    if (runJob.flags & SIDEBAND_STREAM) {
+      auto *stream =
+          reinterpret_cast<AJMSidebandStream *>(runJob.pSideband + 8);
+      stream->inputSize = instance.inputBuffer.size();
+      stream->outputSize = runJob.totalOutputSize;
+    }
+  } else {
+    // orbis::uint32_t maxChannels =
+    //     instance.maxChannels == AJM_CHANNEL_DEFAULT ? 2
+    //                                                 :
+    //                                                 instance.maxChannels;
+    auto *result = reinterpret_cast<AJMSidebandResult *>(runJob.pSideband);
+    *result = {};
+
+    orbis::uint32_t totalDecodedBytes = 0;
+    orbis::uint32_t outputWritten = 0;
+    orbis::uint32_t framesProcessed = 0;
+    orbis::uint32_t samplesCount = 0;
+    if (!instance.inputBuffer.empty() && runJob.totalOutputSize != 0) {
+      instance.inputBuffer.reserve(instance.inputBuffer.size() +
+                                   AV_INPUT_BUFFER_PADDING_SIZE);
+
+      // packet and frame are reused by all jobs of the instance
+      if (instance.packet == nullptr) {
+        instance.packet = av_packet_alloc();
+        instance.frame = av_frame_alloc();
+      }
+
+      AVPacket *pkt = instance.packet;
+      AVFrame *frame = instance.frame;
+      av_frame_unref(frame);
+
+      do {
+        if (instance.codec == AJM_CODEC_At9 &&
+            instance.at9.frameSamples == 0) {
+          break;
+        }
+        if (totalDecodedBytes >= instance.inputBuffer.size()) {
+          break;
+        }
+
+        framesProcessed++;
+
+        std::uint32_t inputFrameSize = 0;
+        std::uint32_t outputBufferSize = 0;
+
+        if (instance.codec == AJM_CODEC_At9) {
+          inputFrameSize = 4;
+          outputBufferSize = av_samples_get_buffer_size(
+              nullptr, instance.at9.inputChannels, instance.at9.frameSamples,
+              ajmToAvFormat(instance.outputFormat), 0);
+        } else if (instance.codec == AJM_CODEC_MP3) {
+          if (instance.inputBuffer.size() - totalDecodedBytes < 4) {
+            result->result = AJM_RESULT_INVALID_DATA;
+            break;
+          }
+
+          inputFrameSize = get_mp3_data_size(
+              (orbis::uint8_t *)(instance.inputBuffer.data() +
+                                 totalDecodedBytes));
+          if (inputFrameSize == 0) {
+            result->result = AJM_RESULT_INVALID_DATA;
+            break;
+          }
+        } else if (instance.codec == AJM_CODEC_AAC) {
+          inputFrameSize = instance.inputBuffer.size() - totalDecodedBytes;
+        }
+
+        if (inputFrameSize >
+            instance.inputBuffer.size() - totalDecodedBytes) {
+          result->result |= AJM_RESULT_PARTIAL_INPUT;
+          break;
+        }
+
+        if (outputBufferSize > runJob.totalOutputSize - outputWritten) {
+          result->result |= AJM_RESULT_NOT_ENOUGH_ROOM;
+          break;
+        }
+
+        pkt->data =
+            (std::uint8_t *)instance.inputBuffer.data() + totalDecodedBytes;
+        pkt->size = inputFrameSize;
+
+        if (instance.codec == AJM_CODEC_At9) {
+          orbis::int32_t bytesUsed = 0;
+          instance.outputBuffer.resize(outputBufferSize);
+          int err =
+              Atrac9Decode(instance.at9.handle,
+                           instance.inputBuffer.data() + totalDecodedBytes,
+                           instance.outputBuffer.data(),
+                           instance.at9.outputFormat, &bytesUsed);
+          if (err != ERR_SUCCESS) {
+            rx::hexdump(
+                std::span(instance.inputBuffer).subspan(totalDecodedBytes));
+            ORBIS_LOG_FATAL("Could not decode AT9 frame", err,
+                            instance.at9.estimatedSizeUsed,
+                            instance.at9.superFrameSize,
+                            instance.at9.frameSamples, instance.at9.handle,
+                            totalDecodedBytes, outputWritten);
+            result->codecResult = err;
+            result->result |= AJM_RESULT_CODEC_ERROR | AJM_RESULT_FATAL;
+            break;
+          }
+
+          instance.at9.estimatedSizeUsed =
+              static_cast<orbis::uint32_t>(bytesUsed);
+          instance.at9.superFrameDataLeft -= bytesUsed;
+          instance.at9.superFrameDataIdx++;
+          if (instance.at9.superFrameDataIdx ==
+              instance.at9.framesInSuperframe) {
+            instance.at9.estimatedSizeUsed += instance.at9.superFrameDataLeft;
+            instance.at9.superFrameDataIdx = 0;
+            instance.at9.superFrameDataLeft = instance.at9.superFrameSize;
+          }
+          samplesCount = instance.at9.frameSamples;
+          inputFrameSize = instance.at9.estimatedSizeUsed;
+          instance.lastDecode.channels =
+              AJMChannels(instance.at9.inputChannels);
+          instance.lastDecode.sampleRate = instance.at9.sampleRate;
+          // ORBIS_LOG_TODO("at9 decode", instance.at9.estimatedSizeUsed,
+          //                instance.at9.superFrameDataLeft,
+          //                instance.at9.superFrameDataIdx,
+          //                instance.at9.framesInSuperframe);
+        } else if (instance.codec == AJM_CODEC_MP3) {
+          int ret = avcodec_send_packet(instance.codecCtx, pkt);
+          if (ret < 0) {
+            ORBIS_LOG_FATAL("Error sending packet for decoding", ret);
+            std::abort();
+          }
+          ret = avcodec_receive_frame(instance.codecCtx, frame);
+          if (ret < 0) {
+            ORBIS_LOG_FATAL("Error during decoding MP3");
+            rx::hexdump(
+                std::span(instance.inputBuffer).subspan(totalDecodedBytes));
+            std::abort();
+          }
+          outputBufferSize = av_samples_get_buffer_size(
+              nullptr, frame->ch_layout.nb_channels, frame->nb_samples,
+              ajmToAvFormat(instance.outputFormat), 0);
+
+          samplesCount = frame->nb_samples;
+          instance.lastDecode.channels =
+              AJMChannels(frame->ch_layout.nb_channels);
+          instance.lastDecode.sampleRate = frame->sample_rate;
+        } else if (instance.codec == AJM_CODEC_AAC) {
+          // HACK: to avoid writing a bunch of useless calls
+          // we simply call this method directly (but it can be very
+          // unstable)
+          int gotFrame;
+          int len = ffcodec(instance.codecCtx->codec)
+                        ->cb.decode(instance.codecCtx, frame, &gotFrame, pkt);
+          if (len < 0) {
+            ORBIS_LOG_FATAL("Error during decoding AAC");
+            rx::hexdump(
+                std::span(instance.inputBuffer).subspan(totalDecodedBytes));
+            std::abort();
+          }
+          outputBufferSize = av_samples_get_buffer_size(
+              nullptr, frame->ch_layout.nb_channels, frame->nb_samples,
+              ajmToAvFormat(instance.outputFormat), 0);
+          samplesCount = frame->nb_samples;
+          inputFrameSize = len;
+          instance.lastDecode.channels =
+              AJMChannels(frame->ch_layout.nb_channels);
+          instance.lastDecode.sampleRate = frame->sample_rate;
+        }
+
+        if (inputFrameSize >
+            instance.inputBuffer.size() - totalDecodedBytes) {
+          result->result |= AJM_RESULT_PARTIAL_INPUT;
+          break;
+        }
+
+        if (outputBufferSize > runJob.totalOutputSize - outputWritten) {
+          result->result |= AJM_RESULT_NOT_ENOUGH_ROOM;
+          break;
+        }
+
+        totalDecodedBytes += inputFrameSize;
+
+        if (instance.isNeedToSkipOutput()) {
+          instance.gapless.totalSkippedSamples += samplesCount;
+          continue;
+        }
+
+        // at least three codecs outputs in float
+        // and mp3 support sample rate resample (TODO), so made resampling
+        // with swr
+        if (instance.codec != AJM_CODEC_At9) {
+          instance.outputBuffer.resize(outputBufferSize);
+
+          if (instance.resampler == nullptr) {
+            instance.resampler = swr_alloc();
+            auto resampler = instance.resampler;
+
+            AVChannelLayout chLayout;
+            av_channel_layout_default(&chLayout,
+                                      frame->ch_layout.nb_channels);
+            av_opt_set_chlayout(resampler, "in_chlayout", &chLayout, 0);
+            av_opt_set_chlayout(resampler, "out_chlayout", &chLayout, 0);
+            av_opt_set_int(resampler, "in_sample_rate", frame->sample_rate,
+                           0);
+            av_opt_set_int(resampler, "out_sample_rate", frame->sample_rate,
+                           0);
+            av_opt_set_sample_fmt(resampler, "in_sample_fmt",
+                                  ajmToAvFormat(AJM_FORMAT_FLOAT), 0);
+            av_opt_set_sample_fmt(resampler, "out_sample_fmt",
+                                  ajmToAvFormat(instance.outputFormat), 0);
+            if (swr_init(resampler) < 0) {
+              ORBIS_LOG_FATAL("Failed to initialize the resampling context");
+              std::abort();
+            }
+          }
+
+          auto *outputBuffer = reinterpret_cast<orbis::uint8_t *>(
+              instance.outputBuffer.data());
+          int nb_samples = swr_convert(
+              instance.resampler, &outputBuffer, frame->nb_samples,
+              frame->extended_data, frame->nb_samples);
+          if (nb_samples != frame->nb_samples) {
+            ORBIS_LOG_FATAL("Error while converting");
+            std::abort();
+          }
+        }
+
+        std::uint32_t bufferOutputWritten = 0;
+        for (std::size_t bufferOffset = 0;
+             auto buffer : runJob.outputBuffers) {
+          if (bufferOffset <= outputWritten &&
+              bufferOffset + buffer.size > outputWritten) {
+            auto byteOffset = outputWritten - bufferOffset;
+            auto size =
+                std::min(buffer.size - byteOffset,
+                         instance.outputBuffer.size() - bufferOutputWritten);
+            ORBIS_RET_ON_ERROR(orbis::uwrite(
+                buffer.pOutput + byteOffset,
+                instance.outputBuffer.data() + bufferOutputWritten, size));
+
+            bufferOutputWritten += size;
+            outputWritten += size;
+
+            if (bufferOutputWritten >= instance.outputBuffer.size()) {
+              break;
+            }
+          }
+
+          bufferOffset += buffer.size;
+        }
+
+        instance.processedSamples += samplesCount;
+      } while ((runJob.flags & RUN_MULTIPLE_FRAMES) != 0);
+    }
+
+    orbis::int64_t currentSize = sizeof(AJMSidebandResult);
+
+    if (runJob.flags & SIDEBAND_STREAM) {
+      // ORBIS_LOG_TODO("SIDEBAND_STREAM", currentSize, outputWritten,
+      //                instance.processedSamples);
+      auto *stream = reinterpret_cast<AJMSidebandStream *>(runJob.pSideband +
+                                                           currentSize);
+      stream->inputSize = totalDecodedBytes;
+      stream->outputSize = outputWritten;
+      stream->decodedSamples = instance.processedSamples;
+      currentSize += sizeof(AJMSidebandStream);
+    }
+
+    if (runJob.flags & SIDEBAND_FORMAT) {
+      // ORBIS_LOG_TODO("SIDEBAND_FORMAT", currentSize,
+      //                (std::uint16_t)instance.lastDecode.channels,
+      //                (std::uint16_t)instance.outputFormat,
+      //                instance.lastDecode.sampleRate);
+      auto *format = reinterpret_cast<AJMSidebandFormat *>(runJob.pSideband +
+                                                           currentSize);
+      format->channels = AJMChannels(instance.lastDecode.channels);
+      format->sampleRate = instance.lastDecode.sampleRate;
+      format->sampleFormat = instance.outputFormat;
+      // TODO: channel mask and bitrate
+      currentSize += sizeof(AJMSidebandFormat);
+    }
+
+    if (runJob.flags & SIDEBAND_GAPLESS_DECODE) {
+      // ORBIS_LOG_TODO("SIDEBAND_GAPLESS_DECODE", currentSize);
+      auto *gapless = reinterpret_cast<AJMSidebandGaplessDecode *>(
+          runJob.pSideband + currentSize);
+      gapless->skipSamples = instance.gapless.skipSamples;
+      gapless->totalSamples = instance.gapless.totalSamples;
+      gapless->totalSkippedSamples = instance.gapless.totalSkippedSamples;
+      currentSize += sizeof(AJMSidebandGaplessDecode);
+    }
+
+    if (runJob.flags & RUN_GET_CODEC_INFO) {
+      // ORBIS_LOG_TODO("RUN_GET_CODEC_INFO");
+      if (instance.codec == AJM_CODEC_At9) {
+        auto *info = reinterpret_cast<AJMAt9CodecInfoSideband *>(
+            runJob.pSideband + currentSize);
+        info->superFrameSize = instance.at9.superFrameSize;
+        info->framesInSuperFrame = instance.at9.framesInSuperframe;
+        info->frameSamples = instance.at9.frameSamples;
+        currentSize += sizeof(AJMAt9CodecInfoSideband);
+      } else if (instance.codec == AJM_CODEC_MP3) {
+        // TODO
+        auto *info = reinterpret_cast<AJMMP3CodecInfoSideband *>(
+            runJob.pSideband + currentSize);
+        currentSize += sizeof(AJMMP3CodecInfoSideband);
+      } else if (instance.codec == AJM_CODEC_AAC) {
+        // TODO
+        auto *info = reinterpret_cast<AJMAACCodecInfoSideband *>(
+            runJob.pSideband + currentSize);
+        info->heaac = instance.codecCtx->profile == FF_PROFILE_AAC_HE ||
+                      instance.codecCtx->profile == FF_PROFILE_AAC_HE_V2;
+        currentSize += sizeof(AJMAACCodecInfoSideband);
+      }
+    }
+
+    if (runJob.flags & RUN_MULTIPLE_FRAMES) {
+      // ORBIS_LOG_TODO("RUN_MULTIPLE_FRAMES", framesProcessed);
+      auto *multipleFrames = reinterpret_cast<AJMSidebandMultipleFrames *>(
+          runJob.pSideband + currentSize);
+      multipleFrames->framesProcessed = framesProcessed;
+      currentSize += sizeof(AJMSidebandMultipleFrames);
+    }
+  }
+
+  return {};
+}
+
+static void finishBatchJob(AjmDevice *device, orbis::uint32_t batchId) {
+  if (auto it = device->batches.find(batchId);
+      it != device->batches.end() && --it->second.pendingJobs == 0) {
+    device->batchCv.notify_all(device->mtx);
+  }
+}
+
+// Passes the instance to workers of the process which submitted its next job
+static void scheduleInstance(AjmDevice *device, orbis::int32_t instanceId,
+                             Instance &instance) {
+  if (instance.pendingJobs.empty()) {
+    instance.ownerPid = 0;
+
+    // instance destruction waits until the instance is idle
+    device->batchCv.notify_all(device->mtx);
+    return;
+  }
+
+  instance.ownerPid = instance.pendingJobs.front().hostPid;
+
+  auto &group = device->workerGroups.at(instance.ownerPid);
+  group.readyInstances.push_back(instanceId);
+  group.cv.notify_one(device->mtx);
+}
+
+static bool isHostProcessAlive(std::uint64_t hostPid) {
+  return ::kill(hostPid, 0) == 0 || errno == EPERM;
+}
+
+// Drops jobs of the exited host process, their guest buffers are gone.
+// Batches of the jobs are completed and instances owned by its workers are
+// passed to other processes
+static void removeWorkerGroup(AjmDevice *device, std::uint64_t hostPid) {
+  for (auto &[instanceId, instance] : device->instanceMap) {
+    auto isExitedJob = [=](const AjmJob &job) { return job.hostPid == hostPid; };
+
+    for (auto &job : instance.pendingJobs) {
+      if (isExitedJob(job)) {
+        finishBatchJob(device, job.batchId);
+      }
+    }
+
+    std::erase_if(instance.pendingJobs, isExitedJob);
+
+    if (instance.ownerPid == hostPid) {
+      scheduleInstance(device, instanceId, instance);
+    }
+  }
+
+  device->workerGroups.erase(hostPid);
+}
+
+static void removeExitedWorkerGroups(AjmDevice *device) {
+  for (auto it = device->workerGroups.begin();
+       it != device->workerGroups.end();) {
+    auto hostPid = it->first;
+    ++it;
+
+    if (!isHostProcessAlive(hostPid)) {
+      removeWorkerGroup(device, hostPid);
+    }
+  }
+}
+
+// Executes queued jobs of the instance in submission order. Only one worker
+// owns the instance at a time, other instances are decoded in parallel
+static void runInstanceJobs(AjmDevice *device, std::uint64_t hostPid,
+                            orbis::int32_t instanceId, Instance &instance,
+                            std::unique_lock<rx::shared_mutex> &lock) {
+  while (!instance.pendingJobs.empty() &&
+         instance.pendingJobs.front().hostPid == hostPid) {
+    auto job = std::move(instance.pendingJobs.front());
+    instance.pendingJobs.pop_front();
+    lock.unlock();
+
+    auto startTime = std::chrono::steady_clock::now();
+    if (auto error = executeJob(instance, job); error != orbis::ErrorCode{}) {
+      ORBIS_LOG_ERROR("ajm: job failed", instanceId, job.batchId, error);
+    }
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                       std::chrono::steady_clock::now() - startTime)
+                       .count();
+
+    lock.lock();
+    device->jobCount++;
+    device->jobTimeUs += elapsed;
+    device->maxJobTimeUs =
+        std::max<std::uint64_t>(device->maxJobTimeUs, elapsed);
+
+    finishBatchJob(device, job.batchId);
+  }
+
+  // next job was submitted by another process, hand the instance over
+  scheduleInstance(device, instanceId, instance);
+}
+
+static void workerEntry(AjmDevice *device, std::uint64_t hostPid,
+                        orbis::Thread *thread) {
+  pthread_setname_np(pthread_self(), "AJM Worker");
+
+  // Decoded samples are written to guest memory. The signal handler resolves
+  // GPU cache write watch faults for the process of the current thread and
+  // restores its fs base on return
+  thread->hostTid = ::gettid();
+  thread->nativeHandle = pthread_self();
+  thread->fsBase = _readfsbase_u64();
+  orbis::g_currentThread = thread;
+
+  std::unique_lock lock(device->mtx);
+  auto &group = device->workerGroups.at(hostPid);
+
+  while (!device->isStopping && !group.isExiting) {
+    if (group.readyInstances.empty()) {
+      group.cv.wait(lock);
+      continue;
+    }
+
+    auto instanceId = group.readyInstances.front();
+    group.readyInstances.pop_front();
+
+    if (auto it = device->instanceMap.find(instanceId);
+        it != device->instanceMap.end()) {
+      runInstanceJobs(device, hostPid, instanceId, it->second, lock);
+    }
+  }
+
+  group.workerCount--;
+  device->batchCv.notify_all(device->mtx);
+}
+
+// Stops workers of this host process when it exits, jobs it leaves behind
+// would block instances shared with other processes
+static void stopAjmWorkers() {
+  const std::uint64_t hostPid = ::getpid();
+  std::map<AjmDevice *, std::vector<std::thread>> threads;
+
+  {
+    std::lock_guard threadsLock(g_ajmThreadsMtx);
+    threads = std::move(getAjmThreads());
+    getAjmThreads().clear();
+  }
+
+  for (auto &[device, deviceThreads] : threads) {
+    {
+      std::lock_guard lock(device->mtx);
+
+      if (auto it = device->workerGroups.find(hostPid);
+          it != device->workerGroups.end()) {
+        auto &group = it->second;
+        group.isExiting = true;
+        group.cv.notify_all(device->mtx);
+
+        while (group.workerCount != 0) {
+          device->batchCv.wait(device->mtx);
+        }
+
+        removeWorkerGroup(device, hostPid);
+      }
+    }
+
+    for (auto &thread : deviceThreads) {
+      thread.join();
+    }
+  }
+}
+
 struct AjmIoctlStartBatchBuffer {
   orbis::uint32_t result;
   orbis::uint32_t unk0;
@@ -311,27 +1007,28 @@ struct AjmIoctlStartBatchBuffer {
   orbis::uint32_t batchId;
 };
 static orbis::ErrorCode
-ajm_ioctl_start_batch_buffer(orbis::Thread *, AjmDevice *device,
+ajm_ioctl_start_batch_buffer(orbis::Thread *thread, AjmDevice *device,
                              AjmIoctlStartBatchBuffer &args) {
-  args.result = 0;
-  args.batchId = device->batchId++;
   // ORBIS_LOG_ERROR(__FUNCTION__, args.result, args.unk0, args.pBatch,
   //                 args.batchSize, args.priority, args.batchError, args.batchId);
   // thread->where();
 
+  // Jobs are parsed and their input is copied here, decoding is done by the
+  // workers. Output and sideband buffers are owned by guest until batch wait
+  orbis::kvector<AjmJob> jobs;
+
   auto ptr = args.pBatch;
   auto endPtr = args.pBatch + args.batchSize;
 
   while (ptr < endPtr) {
     auto header = (InstructionHeader *)ptr;
-    auto instanceId = (header->id >> 6) & 0xfffff;
     auto jobPtr = ptr + sizeof(InstructionHeader);
     auto endJobPtr = ptr + header->len;
-    // TODO: handle unimplemented codecs, so auto create instance for now
-    auto &instance = device->instanceMap[instanceId];
 
-    instance.inputBuffer.clear();
-    RunJob runJob{};
+    auto &batchJob = jobs.emplace_back();
+    batchJob.instanceId = (header->id >> 6) & 0xfffff;
+    auto &runJob = batchJob.run;
+
     while (jobPtr < endJobPtr) {
       auto typed = (OpcodeHeader *)jobPtr;
       switch (typed->getOpcode()) {
@@ -345,108 +1042,7 @@ ajm_ioctl_start_batch_buffer(orbis::Thread *, AjmDevice *device,
       }
       case Opcode::ControlBufferRa: {
         runJob.control = true;
-        auto *ctrl = (BatchJobControlBufferRa *)jobPtr;
-        auto *result =
-            reinterpret_cast<AJMSidebandResult *>(ctrl->pSidebandOutput);
-        *result = {};
-
-        ORBIS_LOG_ERROR(__FUNCTION__, "control buffer", ctrl->opcode,
-                        ctrl->commandId, ctrl->flagsHi, ctrl->flagsLo,
-                        ctrl->sidebandInputSize, ctrl->sidebandOutputSize);
-        if (ctrl->getFlags() & CONTROL_RESET) {
-          reset(&instance);
-          if (instance.codec == AJM_CODEC_At9) {
-            resetAt9(&instance);
-          }
-        }
-
-        if (ctrl->getFlags() & CONTROL_INITIALIZE) {
-          if (instance.codec == AJM_CODEC_At9) {
-            struct InitalizeBuffer {
-              orbis::uint32_t configData;
-              orbis::int32_t unk0[2];
-            };
-            auto *initializeBuffer = (InitalizeBuffer *)ctrl->pSidebandInput;
-            instance.at9.configData = initializeBuffer->configData;
-            reset(&instance);
-            resetAt9(&instance);
-
-            orbis::uint32_t maxChannels =
-                instance.maxChannels == AJM_CHANNEL_DEFAULT
-                    ? 2
-                    : instance.maxChannels;
-            orbis::uint32_t outputChannels =
-                instance.at9.inputChannels > maxChannels
-                    ? maxChannels
-                    : instance.at9.inputChannels;
-            // TODO: check max channels
-            ORBIS_LOG_TODO("CONTROL_INITIALIZE AT9", instance.at9.inputChannels,
-                           instance.at9.sampleRate, instance.at9.frameSamples,
-                           instance.at9.superFrameSize, maxChannels,
-                           outputChannels, initializeBuffer->configData,
-                           (orbis::uint32_t)instance.outputFormat);
-          } else if (instance.codec == AJM_CODEC_AAC) {
-            struct InitializeBuffer {
-              orbis::uint32_t headerIndex;
-              orbis::uint32_t sampleRateIndex;
-            };
-            auto *initializeBuffer = (InitializeBuffer *)ctrl->pSidebandInput;
-            instance.aac.headerType =
-                AACHeaderType(initializeBuffer->headerIndex);
-            instance.aac.sampleRate =
-                AACFreq[initializeBuffer->sampleRateIndex];
-            if (instance.aac.headerType == AAC_RAW) {
-              avcodec_free_context(&instance.codecCtx);
-
-              AVCodecContext *codecCtx =
-                  avcodec_alloc_context3(instance.avCodec);
-              if (!codecCtx) {
-                ORBIS_LOG_FATAL("Failed to allocate codec context for raw aac");
-                std::abort();
-              }
-
-              orbis::uint32_t outputChannels =
-                  instance.maxChannels == AJM_CHANNEL_DEFAULT
-                      ? 2
-                      : instance.maxChannels;
-
-              AVChannelLayout chLayout;
-              av_channel_layout_default(&chLayout, outputChannels);
-              codecCtx->ch_layout = chLayout;
-              codecCtx->sample_rate = instance.aac.sampleRate;
-
-              if (int err = avcodec_open2(codecCtx, instance.avCodec, nullptr);
-                  err < 0) {
-                ORBIS_LOG_FATAL("Could not open codec for raw aac", err);
-                std::abort();
-              }
-
-              instance.codecCtx = codecCtx;
-            }
-            ORBIS_LOG_TODO(
-                "CONTROL_INITIALIZE AAC", (std::int16_t)instance.aac.headerType,
-                instance.aac.sampleRate, (std::int16_t)instance.maxChannels,
-                (orbis::uint32_t)instance.outputFormat);
-          }
-        }
-        if (ctrl->getFlags() & SIDEBAND_GAPLESS_DECODE) {
-          struct InitializeBuffer {
-            orbis::uint32_t totalSamples;
-            orbis::uint16_t skipSamples;
-            orbis::uint16_t totalSkippedSamples;
-          };
-
-          auto *initializeBuffer = (InitializeBuffer *)ctrl->pSidebandInput;
-          if (initializeBuffer->totalSamples > 0) {
-            instance.gapless.totalSamples = initializeBuffer->totalSamples;
-          }
-          if (initializeBuffer->skipSamples > 0) {
-            instance.gapless.skipSamples = initializeBuffer->skipSamples;
-          }
-          ORBIS_LOG_TODO("SIDEBAND_GAPLESS_DECODE",
-                         instance.gapless.skipSamples,
-                         instance.gapless.totalSamples);
-        }
+        batchJob.control = *(BatchJobControlBufferRa *)jobPtr;
         jobPtr += sizeof(BatchJobControlBufferRa);
         break;
       }
@@ -455,10 +1051,10 @@ ajm_ioctl_start_batch_buffer(orbis::Thread *, AjmDevice *device,
         // ORBIS_LOG_ERROR(__FUNCTION__, request, "BatchJobInputBufferRa",
         //                 job->opcode, job->szInputSize, job->pInput);
 
-        auto offset = instance.inputBuffer.size();
-        instance.inputBuffer.resize(offset + job->szInputSize);
+        auto offset = batchJob.input.size();
+        batchJob.input.resize(offset + job->szInputSize);
 
-        std::memcpy(instance.inputBuffer.data() + offset, job->pInput,
+        std::memcpy(batchJob.input.data() + offset, job->pInput,
                     job->szInputSize);
         // rx::hexdump({(std::byte*) job->pInput, job->szInputSize});
         jobPtr += sizeof(BatchJobInputBufferRa);
@@ -496,328 +1092,54 @@ ajm_ioctl_start_batch_buffer(orbis::Thread *, AjmDevice *device,
       }
     }
     ptr = jobPtr;
+  }
 
-    if (!runJob.control && instanceId >= 0xC000) {
-      auto *result = reinterpret_cast<AJMSidebandResult *>(runJob.pSideband);
-      result->result = 0;
-      result->codecResult = 0;
-      if (runJob.flags & SIDEBAND_STREAM) {
-        auto *stream =
-            reinterpret_cast<AJMSidebandStream *>(runJob.pSideband + 8);
-        stream->inputSize = instance.inputBuffer.size();
-        stream->outputSize = runJob.totalOutputSize;
-      }
-    } else if (!runJob.control) {
-      // orbis::uint32_t maxChannels =
-      //     instance.maxChannels == AJM_CHANNEL_DEFAULT ? 2
-      //                                                 :
-      //                                                 instance.maxChannels;
-      auto *result = reinterpret_cast<AJMSidebandResult *>(runJob.pSideband);
-      *result = {};
-
-      orbis::uint32_t totalDecodedBytes = 0;
-      orbis::uint32_t outputWritten = 0;
-      orbis::uint32_t framesProcessed = 0;
-      orbis::uint32_t samplesCount = 0;
-      if (!instance.inputBuffer.empty() && runJob.totalOutputSize != 0) {
-        instance.inputBuffer.reserve(instance.inputBuffer.size() +
-                                     AV_INPUT_BUFFER_PADDING_SIZE);
-
-        AVPacket *pkt = av_packet_alloc();
-        rx::atScopeExit _free_pkt([&] { av_packet_free(&pkt); });
-
-        AVFrame *frame = av_frame_alloc();
-        rx::atScopeExit _free_frame([&] { av_frame_free(&frame); });
-
-        do {
-          if (instance.codec == AJM_CODEC_At9 &&
-              instance.at9.frameSamples == 0) {
-            break;
-          }
-          if (totalDecodedBytes >= instance.inputBuffer.size()) {
-            break;
-          }
-
-          framesProcessed++;
-
-          std::uint32_t inputFrameSize = 0;
-          std::uint32_t outputBufferSize = 0;
-
-          if (instance.codec == AJM_CODEC_At9) {
-            inputFrameSize = 4;
-            outputBufferSize = av_samples_get_buffer_size(
-                nullptr, instance.at9.inputChannels, instance.at9.frameSamples,
-                ajmToAvFormat(instance.outputFormat), 0);
-          } else if (instance.codec == AJM_CODEC_MP3) {
-            if (instance.inputBuffer.size() - totalDecodedBytes < 4) {
-              result->result = AJM_RESULT_INVALID_DATA;
-              break;
-            }
-
-            inputFrameSize = get_mp3_data_size(
-                (orbis::uint8_t *)(instance.inputBuffer.data() +
-                                   totalDecodedBytes));
-            if (inputFrameSize == 0) {
-              result->result = AJM_RESULT_INVALID_DATA;
-              break;
-            }
-          } else if (instance.codec == AJM_CODEC_AAC) {
-            inputFrameSize = instance.inputBuffer.size() - totalDecodedBytes;
-          }
-
-          if (inputFrameSize >
-              instance.inputBuffer.size() - totalDecodedBytes) {
-            result->result |= AJM_RESULT_PARTIAL_INPUT;
-            break;
-          }
-
-          if (outputBufferSize > runJob.totalOutputSize - outputWritten) {
-            result->result |= AJM_RESULT_NOT_ENOUGH_ROOM;
-            break;
-          }
-
-          pkt->data =
-              (std::uint8_t *)instance.inputBuffer.data() + totalDecodedBytes;
-          pkt->size = inputFrameSize;
-
-          if (instance.codec == AJM_CODEC_At9) {
-            orbis::int32_t bytesUsed = 0;
-            instance.outputBuffer.resize(outputBufferSize);
-            int err =
-                Atrac9Decode(instance.at9.handle,
-                             instance.inputBuffer.data() + totalDecodedBytes,
-                             instance.outputBuffer.data(),
-                             instance.at9.outputFormat, &bytesUsed);
-            if (err != ERR_SUCCESS) {
-              rx::hexdump(
-                  std::span(instance.inputBuffer).subspan(totalDecodedBytes));
-              ORBIS_LOG_FATAL("Could not decode AT9 frame", err,
-                              instance.at9.estimatedSizeUsed,
-                              instance.at9.superFrameSize,
-                              instance.at9.frameSamples, instance.at9.handle,
-                              totalDecodedBytes, outputWritten);
-              result->codecResult = err;
-              result->result |= AJM_RESULT_CODEC_ERROR | AJM_RESULT_FATAL;
-              break;
-            }
-
-            instance.at9.estimatedSizeUsed =
-                static_cast<orbis::uint32_t>(bytesUsed);
-            instance.at9.superFrameDataLeft -= bytesUsed;
-            instance.at9.superFrameDataIdx++;
-            if (instance.at9.superFrameDataIdx ==
-                instance.at9.framesInSuperframe) {
-              instance.at9.estimatedSizeUsed += instance.at9.superFrameDataLeft;
-              instance.at9.superFrameDataIdx = 0;
-              instance.at9.superFrameDataLeft = instance.at9.superFrameSize;
-            }
-            samplesCount = instance.at9.frameSamples;
-            inputFrameSize = instance.at9.estimatedSizeUsed;
-            instance.lastDecode.channels =
-                AJMChannels(instance.at9.inputChannels);
-            instance.lastDecode.sampleRate = instance.at9.sampleRate;
-            // ORBIS_LOG_TODO("at9 decode", instance.at9.estimatedSizeUsed,
-            //                instance.at9.superFrameDataLeft,
-            //                instance.at9.superFrameDataIdx,
-            //                instance.at9.framesInSuperframe);
-          } else if (instance.codec == AJM_CODEC_MP3) {
-            int ret = avcodec_send_packet(instance.codecCtx, pkt);
-            if (ret < 0) {
-              ORBIS_LOG_FATAL("Error sending packet for decoding", ret);
-              std::abort();
-            }
-            ret = avcodec_receive_frame(instance.codecCtx, frame);
-            if (ret < 0) {
-              ORBIS_LOG_FATAL("Error during decoding MP3");
-              rx::hexdump(
-                  std::span(instance.inputBuffer).subspan(totalDecodedBytes));
-              std::abort();
-            }
-            outputBufferSize = av_samples_get_buffer_size(
-                nullptr, frame->ch_layout.nb_channels, frame->nb_samples,
-                ajmToAvFormat(instance.outputFormat), 0);
-
-            samplesCount = frame->nb_samples;
-            instance.lastDecode.channels =
-                AJMChannels(frame->ch_layout.nb_channels);
-            instance.lastDecode.sampleRate = frame->sample_rate;
-          } else if (instance.codec == AJM_CODEC_AAC) {
-            // HACK: to avoid writing a bunch of useless calls
-            // we simply call this method directly (but it can be very
-            // unstable)
-            int gotFrame;
-            int len = ffcodec(instance.codecCtx->codec)
-                          ->cb.decode(instance.codecCtx, frame, &gotFrame, pkt);
-            if (len < 0) {
-              ORBIS_LOG_FATAL("Error during decoding AAC");
-              rx::hexdump(
-                  std::span(instance.inputBuffer).subspan(totalDecodedBytes));
-              std::abort();
-            }
-            outputBufferSize = av_samples_get_buffer_size(
-                nullptr, frame->ch_layout.nb_channels, frame->nb_samples,
-                ajmToAvFormat(instance.outputFormat), 0);
-            samplesCount = frame->nb_samples;
-            inputFrameSize = len;
-            instance.lastDecode.channels =
-                AJMChannels(frame->ch_layout.nb_channels);
-            instance.lastDecode.sampleRate = frame->sample_rate;
-          }
-
-          if (inputFrameSize >
-              instance.inputBuffer.size() - totalDecodedBytes) {
-            result->result |= AJM_RESULT_PARTIAL_INPUT;
-            break;
-          }
+  const std::uint64_t hostPid = ::getpid();
 
-          if (outputBufferSize > runJob.totalOutputSize - outputWritten) {
-            result->result |= AJM_RESULT_NOT_ENOUGH_ROOM;
-            break;
-          }
+  std::lock_guard lock(device->mtx);
 
-          totalDecodedBytes += inputFrameSize;
+  removeExitedWorkerGroups(device);
 
-          if (instance.isNeedToSkipOutput()) {
-            instance.gapless.totalSkippedSamples += samplesCount;
-            continue;
-          }
+  auto &group = device->workerGroups[hostPid];
 
-          // at least three codecs outputs in float
-          // and mp3 support sample rate resample (TODO), so made resampling
-          // with swr
-          if (instance.codec != AJM_CODEC_At9) {
-            instance.outputBuffer.resize(outputBufferSize);
-
-            if (instance.resampler == nullptr) {
-              instance.resampler = swr_alloc();
-              auto resampler = instance.resampler;
-
-              AVChannelLayout chLayout;
-              av_channel_layout_default(&chLayout,
-                                        frame->ch_layout.nb_channels);
-              av_opt_set_chlayout(resampler, "in_chlayout", &chLayout, 0);
-              av_opt_set_chlayout(resampler, "out_chlayout", &chLayout, 0);
-              av_opt_set_int(resampler, "in_sample_rate", frame->sample_rate,
-                             0);
-              av_opt_set_int(resampler, "out_sample_rate", frame->sample_rate,
-                             0);
-              av_opt_set_sample_fmt(resampler, "in_sample_fmt",
-                                    ajmToAvFormat(AJM_FORMAT_FLOAT), 0);
-              av_opt_set_sample_fmt(resampler, "out_sample_fmt",
-                                    ajmToAvFormat(instance.outputFormat), 0);
-              if (swr_init(resampler) < 0) {
-                ORBIS_LOG_FATAL("Failed to initialize the resampling context");
-                std::abort();
-              }
-            }
+  if (group.workerCount == 0) {
+    auto workerCount =
+        std::clamp(std::thread::hardware_concurrency() / 4, 1u, 4u);
 
-            auto *outputBuffer = reinterpret_cast<orbis::uint8_t *>(
-                instance.outputBuffer.data());
-            int nb_samples = swr_convert(
-                instance.resampler, &outputBuffer, frame->nb_samples,
-                frame->extended_data, frame->nb_samples);
-            if (nb_samples != frame->nb_samples) {
-              ORBIS_LOG_FATAL("Error while converting");
-              std::abort();
-            }
-          }
+    std::lock_guard threadsLock(g_ajmThreadsMtx);
+    auto &threads = getAjmThreads()[device];
 
-          std::uint32_t bufferOutputWritten = 0;
-          for (std::size_t bufferOffset = 0;
-               auto buffer : runJob.outputBuffers) {
-            if (bufferOffset <= outputWritten &&
-                bufferOffset + buffer.size > outputWritten) {
-              auto byteOffset = outputWritten - bufferOffset;
-              auto size =
-                  std::min(buffer.size - byteOffset,
-                           instance.outputBuffer.size() - bufferOutputWritten);
-              ORBIS_RET_ON_ERROR(orbis::uwrite(
-                  buffer.pOutput + byteOffset,
-                  instance.outputBuffer.data() + bufferOutputWritten, size));
-
-              bufferOutputWritten += size;
-              outputWritten += size;
-
-              if (bufferOutputWritten >= instance.outputBuffer.size()) {
-                break;
-              }
-            }
+    for (unsigned i = 0; i < workerCount; ++i) {
+      auto workerThread = orbis::createThread(thread->tproc, "AJM Worker");
+      threads.emplace_back(workerEntry, device, hostPid, workerThread);
+    }
 
-            bufferOffset += buffer.size;
-          }
+    group.workerCount = workerCount;
+  }
 
-          instance.processedSamples += samplesCount;
-        } while ((runJob.flags & RUN_MULTIPLE_FRAMES) != 0);
-      }
+  args.result = 0;
+  args.batchId = device->batchId++;
 
-      orbis::int64_t currentSize = sizeof(AJMSidebandResult);
-
-      if (runJob.flags & SIDEBAND_STREAM) {
-        // ORBIS_LOG_TODO("SIDEBAND_STREAM", currentSize, outputWritten,
-        //                instance.processedSamples);
-        auto *stream = reinterpret_cast<AJMSidebandStream *>(runJob.pSideband +
-                                                             currentSize);
-        stream->inputSize = totalDecodedBytes;
-        stream->outputSize = outputWritten;
-        stream->decodedSamples = instance.processedSamples;
-        currentSize += sizeof(AJMSidebandStream);
-      }
+  // forget completed batches which were never waited
+  while (device->batches.size() >= kAjmMaxTrackedBatches &&
+         device->batches.begin()->second.pendingJobs == 0) {
+    device->batches.erase(device->batches.begin());
+  }
 
-      if (runJob.flags & SIDEBAND_FORMAT) {
-        // ORBIS_LOG_TODO("SIDEBAND_FORMAT", currentSize,
-        //                (std::uint16_t)instance.lastDecode.channels,
-        //                (std::uint16_t)instance.outputFormat,
-        //                instance.lastDecode.sampleRate);
-        auto *format = reinterpret_cast<AJMSidebandFormat *>(runJob.pSideband +
-                                                             currentSize);
-        format->channels = AJMChannels(instance.lastDecode.channels);
-        format->sampleRate = instance.lastDecode.sampleRate;
-        format->sampleFormat = instance.outputFormat;
-        // TODO: channel mask and bitrate
-        currentSize += sizeof(AJMSidebandFormat);
-      }
+  device->batches[args.batchId].pendingJobs = jobs.size();
+  device->batchCount++;
 
-      if (runJob.flags & SIDEBAND_GAPLESS_DECODE) {
-        // ORBIS_LOG_TODO("SIDEBAND_GAPLESS_DECODE", currentSize);
-        auto *gapless = reinterpret_cast<AJMSidebandGaplessDecode *>(
-            runJob.pSideband + currentSize);
-        gapless->skipSamples = instance.gapless.skipSamples;
-        gapless->totalSamples = instance.gapless.totalSamples;
-        gapless->totalSkippedSamples = instance.gapless.totalSkippedSamples;
-        currentSize += sizeof(AJMSidebandGaplessDecode);
-      }
+  for (auto &job : jobs) {
+    auto instanceId = job.instanceId;
+    job.batchId = args.batchId;
+    job.hostPid = hostPid;
 
-      if (runJob.flags & RUN_GET_CODEC_INFO) {
-        // ORBIS_LOG_TODO("RUN_GET_CODEC_INFO");
-        if (instance.codec == AJM_CODEC_At9) {
-          auto *info = reinterpret_cast<AJMAt9CodecInfoSideband *>(
-              runJob.pSideband + currentSize);
-          info->superFrameSize = instance.at9.superFrameSize;
-          info->framesInSuperFrame = instance.at9.framesInSuperframe;
-          info->frameSamples = instance.at9.frameSamples;
-          currentSize += sizeof(AJMAt9CodecInfoSideband);
-        } else if (instance.codec == AJM_CODEC_MP3) {
-          // TODO
-          auto *info = reinterpret_cast<AJMMP3CodecInfoSideband *>(
-              runJob.pSideband + currentSize);
-          currentSize += sizeof(AJMMP3CodecInfoSideband);
-        } else if (instance.codec == AJM_CODEC_AAC) {
-          // TODO
-          auto *info = reinterpret_cast<AJMAACCodecInfoSideband *>(
-              runJob.pSideband + currentSize);
-          info->heaac = instance.codecCtx->profile == FF_PROFILE_AAC_HE ||
-                        instance.codecCtx->profile == FF_PROFILE_AAC_HE_V2;
-          currentSize += sizeof(AJMAACCodecInfoSideband);
-        }
-      }
+    // TODO: handle unimplemented codecs, so auto create instance for now
+    auto &instance = device->instanceMap[instanceId];
+    instance.pendingJobs.push_back(std::move(job));
 
-      if (runJob.flags & RUN_MULTIPLE_FRAMES) {
-        // ORBIS_LOG_TODO("RUN_MULTIPLE_FRAMES", framesProcessed);
-        auto *multipleFrames = reinterpret_cast<AJMSidebandMultipleFrames *>(
-            runJob.pSideband + currentSize);
-        multipleFrames->framesProcessed = framesProcessed;
-        currentSize += sizeof(AJMSidebandMultipleFrames);
-      }
+    if (instance.ownerPid == 0) {
+      scheduleInstance(device, instanceId, instance);
     }
   }
 
@@ -839,7 +1161,46 @@ ajm_ioctl_wait_batch_buffer(orbis::Thread *thread, AjmDevice *device,
   // ORBIS_LOG_ERROR(__FUNCTION__, request, args.result, args.unk0,
   //                 args.batchId, args.timeout, args.batchError);
   // thread->where();
-  return {};
+
+  auto deadline = std::chrono::steady_clock::time_point::max();
+  if (args.timeout != kAjmWaitInfinite) {
+    deadline = std::chrono::steady_clock::now() +
+               std::chrono::microseconds(args.timeout);
+  }
+
+  std::lock_guard lock(device->mtx);
+
+  while (true) {
+    auto it = device->batches.find(args.batchId);
+    if (it == device->batches.end()) {
+      // unknown or already waited batch
+      return {};
+    }
+
+    if (it->second.pendingJobs == 0) {
+      device->batches.erase(it);
+      return {};
+    }
+
+    long ut = kAjmExitPollUs;
+    if (deadline != std::chrono::steady_clock::time_point::max()) {
+      ut = std::chrono::duration_cast<std::chrono::microseconds>(
+               deadline - std::chrono::steady_clock::now())
+               .count();
+      if (ut <= 0) {
+        return orbis::ErrorCode::TIMEDOUT;
+      }
+
+      ut = std::min(ut, kAjmExitPollUs);
+    }
+
+    orbis::scoped_unblock unblock;
+    if (device->batchCv.wait(device->mtx, ut) == std::errc::interrupted) {
+      return orbis::ErrorCode::INTR;
+    }
+
+    removeExitedWorkerGroups(device);
+  }
 }
 
 static const orbis::FileOps fileOps = {};
@@ -856,6 +1217,38 @@ AjmDevice::AjmDevice() {
   addIoctl<AJM_IOCTL_INSTANCE_SWITCH>(ajm_ioctl_instance_switch);
 }
 
+AjmDevice::~AjmDevice() {
+  {
+    std::lock_guard lock(mtx);
+    isStopping = true;
+
+    for (auto &[hostPid, group] : workerGroups) {
+      group.cv.notify_all(mtx);
+    }
+
+    // workers of other processes cannot be joined, wait until they leave the
+    // device. Groups of exited processes have no threads left
+    while (std::any_of(workerGroups.begin(), workerGroups.end(),
+                       [](auto &entry) {
+                         return entry.second.workerCount != 0 &&
+                                isHostProcessAlive(entry.first);
+                       })) {
+      batchCv.wait(mtx, 10000);
+    }
+  }
+
+  std::lock_guard threadsLock(g_ajmThreadsMtx);
+  auto &threads = getAjmThreads();
+
+  if (auto it = threads.find(this); it != threads.end()) {
+    for (auto &thread : it->second) {
+      thread.join();
+    }
+
+    threads.erase(it);
+  }
+}
+
 orbis::ErrorCode AjmDevice::open(rx::Ref<orbis::File> *file, const char *path,
                                  std::uint32_t flags, std::uint32_t mode,
                                  orbis::Thread *thread) {
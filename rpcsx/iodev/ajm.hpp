@@ -104,6 +104,15 @@ struct RunJob {
   bool control;
 };
 
+struct AjmJob {
+  orbis::uint32_t instanceId;
+  orbis::uint32_t batchId;
+  std::uint64_t hostPid; // guest buffers are only mapped in this process
+  RunJob run{};
+  BatchJobControlBufferRa control{};
+  orbis::kvector<std::byte> input;
+};
+
 // Thanks to mystical SirNickity with 1 post
 // https://hydrogenaud.io/index.php?topic=85125.msg747716#msg747716
 
@@ -344,6 +353,13 @@ struct Instance {
   orbis::uint32_t processedSamples;
   AJMSidebandFormat lastDecode;
 
+  // decoded by the single worker which owns the instance. Instance is owned
+  // by workers of one host process, 0 if the instance is idle
+  orbis::kdeque<AjmJob> pendingJobs;
+  std::uint64_t ownerPid = 0;
+  AVPacket *packet = nullptr;
+  AVFrame *frame = nullptr;
+
   bool isNeedToSkipOutput() {
     if (codec == AJM_CODEC_AAC && aac.isFrameSkipEnabled &&
         aac.framesSkipped < 2) {
@@ -360,6 +376,12 @@ struct Instance {
   }
 
   ~Instance() {
+    if (frame) {
+      av_frame_free(&frame);
+    }
+    if (packet) {
+      av_packet_free(&packet);
+    }
     if (resampler) {
       swr_free(&resampler);
     }
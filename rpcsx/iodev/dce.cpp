@@ -144,80 +144,76 @@ struct ResolutionStatus {
 // refreshRate = 0x23, result.refreshHz = 0x42b3d1ec( 89.91) REFRESH_RATE_89_91HZ
 // clang-format on
 
-static void runBridge(int vmId) {
-  std::thread{[=] {
-    pthread_setname_np(pthread_self(), "Bridge");
+static void applyCacheCommand(amdgpu::DeviceContext &gpuCtx, int vmId,
+                              std::uint64_t command) {
+  auto firstPage = static_cast<std::uint32_t>(command);
+  auto lastPage = firstPage + static_cast<std::uint32_t>(command >> 32) + 1;
 
-    auto gpu = amdgpu::DeviceCtl{orbis::g_context->gpuDevice};
-    auto &gpuCtx = gpu.getContext();
-    std::vector<std::uint64_t> fetchedCommands;
-    fetchedCommands.reserve(std::size(gpuCtx.cpuCacheCommands));
+  auto origVmProt =
+      vm::getPageProtection(std::uint64_t(firstPage) * rx::mem::pageSize);
+  int vmProt = 0;
 
-    std::vector<std::atomic<std::uint64_t> *> fetchedAtomics;
-    std::uint32_t prevIdleValue = 0;
-
-    while (true) {
-      if (gpuCtx.cpuCacheCommandsIdle[vmId].wait(prevIdleValue) !=
-          std::errc{}) {
-        continue;
-      }
+  if (origVmProt & vm::kMapProtCpuRead) {
+    vmProt |= PROT_READ;
+  }
+  if (origVmProt & vm::kMapProtCpuWrite) {
+    vmProt |= PROT_WRITE;
+  }
+  if (origVmProt & vm::kMapProtCpuExec) {
+    vmProt |= PROT_EXEC;
+  }
 
-      prevIdleValue =
-          gpuCtx.cpuCacheCommandsIdle[vmId].load(std::memory_order::acquire);
+  auto getPageProt = [&](std::uint64_t page) {
+    auto pageFlags =
+        gpuCtx.cachePages[vmId][page].load(std::memory_order::relaxed);
 
-      for (auto &command : gpuCtx.cpuCacheCommands[vmId]) {
-        std::uint64_t value = command.load(std::memory_order::relaxed);
+    if (pageFlags & amdgpu::kPageReadWriteLock) {
+      return vmProt & ~(PROT_READ | PROT_WRITE);
+    }
 
-        if (value != 0) {
-          fetchedCommands.push_back(value);
-          fetchedAtomics.push_back(&command);
-        }
-      }
+    if (pageFlags & amdgpu::kPageWriteWatch) {
+      return vmProt & ~PROT_WRITE;
+    }
 
-      if (fetchedCommands.empty()) {
-        continue;
-      }
+    return vmProt;
+  };
 
-      for (auto command : fetchedCommands) {
-        auto page = static_cast<std::uint32_t>(command);
-        auto count = static_cast<std::uint32_t>(command >> 32) + 1;
+  // pages of the range can have different flags, protect runs of pages with
+  // equal protection
+  std::uint64_t runPage = firstPage;
+  int runProt = getPageProt(firstPage);
 
-        auto pageFlags =
-            gpuCtx.cachePages[vmId][page].load(std::memory_order::relaxed);
+  for (std::uint64_t page = firstPage + 1; page <= lastPage; ++page) {
+    int pageProt = page < lastPage ? getPageProt(page) : -1;
 
-        auto address = static_cast<std::uint64_t>(page) * rx::mem::pageSize;
-        auto origVmProt = vm::getPageProtection(address);
-        int prot = 0;
+    if (pageProt == runProt) {
+      continue;
+    }
 
-        if (origVmProt & vm::kMapProtCpuRead) {
-          prot |= PROT_READ;
-        }
-        if (origVmProt & vm::kMapProtCpuWrite) {
-          prot |= PROT_WRITE;
-        }
-        if (origVmProt & vm::kMapProtCpuExec) {
-          prot |= PROT_EXEC;
-        }
+    if (::mprotect(reinterpret_cast<void *>(runPage * rx::mem::pageSize),
+                   rx::mem::pageSize * (page - runPage), runProt)) {
+      perror("protection failed");
+      std::abort();
+    }
 
-        if (pageFlags & amdgpu::kPageReadWriteLock) {
-          prot &= ~(PROT_READ | PROT_WRITE);
-        } else if (pageFlags & amdgpu::kPageWriteWatch) {
-          prot &= ~PROT_WRITE;
-        }
+    runPage = page;
+    runProt = pageProt;
+  }
+}
 
-        if (::mprotect(reinterpret_cast<void *>(address),
-                       rx::mem::pageSize * count, prot)) {
-          perror("protection failed");
-          std::abort();
-        }
-      }
+static void runBridge(int vmId) {
+  std::thread{[=] {
+    pthread_setname_np(pthread_self(), "Bridge");
 
-      for (auto fetchedAtomic : fetchedAtomics) {
-        fetchedAtomic->store(0, std::memory_order::release);
-      }
+    auto gpu = amdgpu::DeviceCtl{orbis::g_context->gpuDevice};
+    auto &gpuCtx = gpu.getContext();
+    auto &ring = gpuCtx.cpuCacheCommands[vmId];
+    std::uint32_t prevPushCount = 0;
 
-      fetchedCommands.clear();
-      fetchedAtomics.clear();
+    while (true) {
+      ring.processCommands(prevPushCount, [&](std::uint64_t command) {
+        applyCacheCommand(gpuCtx, vmId, command);
+      });
     }
   }}.detach();
 }
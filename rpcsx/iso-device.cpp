@@ -0,0 +1,1449 @@
+#include "iso-device.hpp"
+#include "orbis/KernelAllocator.hpp"
+#include "orbis/file.hpp"
+#include "orbis/stat.hpp"
+#include "orbis/uio.hpp"
+#include "orbis/utils/Logs.hpp"
+#include "rx/SharedMutex.hpp"
+#include "vm.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <mutex>
+#include <optional>
+#include <rx/align.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+constexpr std::uint64_t kSectorSize = 2048;
+constexpr std::uint64_t kSparseExtent = ~static_cast<std::uint64_t>(0);
+
+// Corrupted images must not make us allocate gigabytes for a directory
+constexpr std::uint64_t kMaxDirectorySize = 64 * 1024 * 1024;
+
+enum : std::uint16_t {
+  kUdfTagAnchor = 2,
+  kUdfTagPartition = 5,
+  kUdfTagLogicalVolume = 6,
+  kUdfTagTerminating = 8,
+  kUdfTagFileSet = 256,
+  kUdfTagFileIdentifier = 257,
+  kUdfTagAllocationExtent = 258,
+  kUdfTagFileEntry = 261,
+  kUdfTagExtendedFileEntry = 266,
+};
+
+template <typename T>
+T readLe(std::span<const std::byte> data, std::size_t offset) {
+  T result{};
+  if (offset + sizeof(T) <= data.size()) {
+    std::memcpy(&result, data.data() + offset, sizeof(T));
+  }
+  return result;
+}
+
+std::string foldCase(std::string_view name) {
+  std::string result(name);
+  for (auto &c : result) {
+    if (c >= 'A' && c <= 'Z') {
+      c += 'a' - 'A';
+    }
+  }
+  return result;
+}
+
+void appendUtf8(std::string &result, char32_t c) {
+  if (c < 0x80) {
+    result += static_cast<char>(c);
+  } else if (c < 0x800) {
+    result += static_cast<char>(0xc0 | (c >> 6));
+    result += static_cast<char>(0x80 | (c & 0x3f));
+  } else if (c < 0x10000) {
+    result += static_cast<char>(0xe0 | (c >> 12));
+    result += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+    result += static_cast<char>(0x80 | (c & 0x3f));
+  } else {
+    result += static_cast<char>(0xf0 | (c >> 18));
+    result += static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+    result += static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+    result += static_cast<char>(0x80 | (c & 0x3f));
+  }
+}
+
+// Joliet and 16 bit UDF names
+std::string decodeUcs2Be(std::span<const std::byte> data) {
+  std::string result;
+  char32_t highSurrogate = 0;
+
+  for (std::size_t i = 0; i + 1 < data.size(); i += 2) {
+    char32_t c = std::to_integer<char32_t>(data[i]) << 8 |
+                 std::to_integer<char32_t>(data[i + 1]);
+
+    if (c >= 0xd800 && c < 0xdc00) {
+      highSurrogate = c;
+      continue;
+    }
+
+    if (c >= 0xdc00 && c < 0xe000 && highSurrogate != 0) {
+      c = 0x10000 + ((highSurrogate - 0xd800) << 10) + (c - 0xdc00);
+    }
+
+    highSurrogate = 0;
+    appendUtf8(result, c);
+  }
+
+  return result;
+}
+
+// OSTA compressed unicode of UDF names
+std::string decodeCs0(std::span<const std::byte> data) {
+  if (data.empty()) {
+    return {};
+  }
+
+  auto compression = std::to_integer<unsigned>(data[0]);
+  data = data.subspan(1);
+
+  if (compression == 16 || compression == 255) {
+    return decodeUcs2Be(data);
+  }
+
+  std::string result;
+  for (auto c : data) {
+    appendUtf8(result, std::to_integer<char32_t>(c));
+  }
+  return result;
+}
+
+std::int64_t toUnixTime(int year, unsigned month, unsigned day, unsigned hour,
+                        unsigned minute, unsigned second) {
+  std::chrono::year_month_day date{std::chrono::year{year},
+                                   std::chrono::month{month},
+                                   std::chrono::day{day}};
+  if (!date.ok()) {
+    return 0;
+  }
+
+  return std::chrono::sys_seconds{std::chrono::sys_days{date}}
+             .time_since_epoch()
+             .count() +
+         hour * 3600 + minute * 60 + second;
+}
+
+// Recording date of ISO 9660 directory records
+std::int64_t decodeIsoTime(std::span<const std::byte> time) {
+  auto get = [&](int i) { return std::to_integer<unsigned>(time[i]); };
+  auto timezone = static_cast<std::int8_t>(time[6]);
+
+  return toUnixTime(1900 + get(0), get(1), get(2), get(3), get(4), get(5)) -
+         timezone * 15 * 60;
+}
+
+std::int64_t decodeUdfTime(std::span<const std::byte> time) {
+  auto typeAndTimezone = readLe<std::uint16_t>(time, 0);
+  auto year = readLe<std::int16_t>(time, 2);
+  auto get = [&](int i) { return std::to_integer<unsigned>(time[i]); };
+
+  // 12 bit signed offset in minutes, -2047 if not specified
+  std::int32_t timezone = typeAndTimezone & 0xfff;
+  if (timezone & 0x800) {
+    timezone -= 0x1000;
+  }
+
+  if (timezone == -2047) {
+    timezone = 0;
+  }
+
+  return toUnixTime(year, get(4), get(5), get(6), get(7), get(8)) -
+         timezone * 60;
+}
+
+// Read-only cache of the image. Data is cached in clusters spread over
+// independently locked shards. A miss loads the rest of the request with one
+// host read, extended by readahead when the file is read sequentially, so the
+// small reads of the guest become few large reads of the image
+class ImageCache {
+public:
+  static constexpr std::size_t kShardCount = 16;
+  static constexpr std::uint64_t kClusterSize = 64 * 1024;
+  static constexpr std::uint64_t kCacheSize = 32 * 1024 * 1024;
+  static constexpr std::uint64_t kReadaheadSize = 1024 * 1024;
+  static constexpr std::size_t kSlotsPerShard =
+      kCacheSize / kClusterSize / kShardCount;
+
+  struct Stats {
+    std::uint64_t hits;
+    std::uint64_t misses;
+    std::uint64_t hostReads;
+    std::uint64_t hostBytes;
+  };
+
+  ImageCache(int hostFd, std::uint64_t imageSize)
+      : mHostFd(hostFd), mImageSize(imageSize), mStorage(kCacheSize) {}
+
+  // Returns the number of bytes read, less than requested at the end of the
+  // image or on host read error
+  std::uint64_t read(std::uint64_t offset, void *data, std::uint64_t size,
+                     bool isSequential);
+
+  [[nodiscard]] std::uint64_t getImageSize() const { return mImageSize; }
+  [[nodiscard]] Stats getStats() const;
+
+private:
+  static constexpr std::uint64_t kNoCluster = ~static_cast<std::uint64_t>(0);
+
+  struct Slot {
+    std::uint64_t cluster = kNoCluster;
+    std::uint64_t size = 0;
+    std::uint64_t lastUse = 0;
+  };
+
+  struct Shard {
+    rx::shared_mutex mtx;
+    std::uint64_t useCounter = 0;
+    Slot slots[kSlotsPerShard];
+    orbis::kunmap<std::uint64_t, std::uint32_t> clusters; // slot by cluster
+  };
+
+  bool readCached(std::uint64_t cluster, std::uint64_t offset,
+                  std::uint64_t size, std::byte *data);
+  void insert(std::uint64_t cluster, const std::byte *data,
+              std::uint64_t size);
+  std::uint64_t readHost(std::uint64_t offset, void *data,
+                         std::uint64_t size);
+
+  std::byte *getSlotData(std::size_t shard, std::size_t slot) {
+    return mStorage.data() + (shard * kSlotsPerShard + slot) * kClusterSize;
+  }
+
+  int mHostFd;
+  std::uint64_t mImageSize;
+  Shard mShards[kShardCount];
+  orbis::kvector<std::byte> mStorage;
+
+  std::atomic<std::uint64_t> mHits{0};
+  std::atomic<std::uint64_t> mMisses{0};
+  std::atomic<std::uint64_t> mHostReads{0};
+  std::atomic<std::uint64_t> mHostBytes{0};
+};
+
+ImageCache::Stats ImageCache::getStats() const {
+  return {
+      .hits = mHits.load(std::memory_order::relaxed),
+      .misses = mMisses.load(std::memory_order::relaxed),
+      .hostReads = mHostReads.load(std::memory_order::relaxed),
+      .hostBytes = mHostBytes.load(std::memory_order::relaxed),
+  };
+}
+
+bool ImageCache::readCached(std::uint64_t cluster, std::uint64_t offset,
+                            std::uint64_t size, std::byte *data) {
+  auto shardIndex = cluster % kShardCount;
+  auto &shard = mShards[shardIndex];
+  std::lock_guard lock(shard.mtx);
+
+  auto it = shard.clusters.find(cluster);
+  if (it == shard.clusters.end()) {
+    return false;
+  }
+
+  auto &slot = shard.slots[it->second];
+  if (slot.size < offset + size) {
+    return false;
+  }
+
+  slot.lastUse = ++shard.useCounter;
+  std::memcpy(data, getSlotData(shardIndex, it->second) + offset, size);
+  return true;
+}
+
+void ImageCache::insert(std::uint64_t cluster, const std::byte *data,
+                        std::uint64_t size) {
+  auto shardIndex = cluster % kShardCount;
+  auto &shard = mShards[shardIndex];
+  std::lock_guard lock(shard.mtx);
+
+  std::size_t slotIndex;
+
+  if (auto it = shard.clusters.find(cluster); it != shard.clusters.end()) {
+    // loaded by another thread meanwhile
+    slotIndex = it->second;
+
+    if (shard.slots[slotIndex].size >= size) {
+      shard.slots[slotIndex].lastUse = ++shard.useCounter;
+      return;
+    }
+  } else {
+    // free slots were never used and go first
+    auto victim = std::ranges::min_element(shard.slots, {}, &Slot::lastUse);
+    slotIndex = victim - shard.slots;
+
+    if (victim->cluster != kNoCluster) {
+      shard.clusters.erase(victim->cluster);
+    }
+
+    shard.clusters.emplace(cluster, slotIndex);
+  }
+
+  auto &slot = shard.slots[slotIndex];
+  slot.cluster = cluster;
+  slot.size = size;
+  slot.lastUse = ++shard.useCounter;
+  std::memcpy(getSlotData(shardIndex, slotIndex), data, size);
+}
+
+std::uint64_t ImageCache::readHost(std::uint64_t offset, void *data,
+                                   std::uint64_t size) {
+  mHostReads.fetch_add(1, std::memory_order::relaxed);
+
+  std::uint64_t result = 0;
+  while (result < size) {
+    auto count = ::pread(mHostFd, static_cast<std::byte *>(data) + result,
+                         size - result, offset + result);
+
+    if (count < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (count <= 0) {
+      break;
+    }
+
+    result += count;
+  }
+
+  mHostBytes.fetch_add(result, std::memory_order::relaxed);
+  return result;
+}
+
+std::uint64_t ImageCache::read(std::uint64_t offset, void *data,
+                               std::uint64_t size, bool isSequential) {
+  if (offset >= mImageSize) {
+    return 0;
+  }
+
+  size = std::min(size, mImageSize - offset);
+
+  if (size > kCacheSize / 4) {
+    // would evict most of the cache
+    return readHost(offset, data, size);
+  }
+
+  auto output = static_cast<std::byte *>(data);
+  std::vector<std::byte> buffer;
+  std::uint64_t result = 0;
+
+  while (result < size) {
+    auto position = offset + result;
+    auto cluster = position / kClusterSize;
+    auto clusterOffset = position % kClusterSize;
+    auto count = std::min(kClusterSize - clusterOffset, size - result);
+
+    if (readCached(cluster, clusterOffset, count, output + result)) {
+      mHits.fetch_add(1, std::memory_order::relaxed);
+      result += count;
+      continue;
+    }
+
+    mMisses.fetch_add(1, std::memory_order::relaxed);
+
+    auto loadBegin = cluster * kClusterSize;
+    auto loadEnd = rx::alignUp(offset + size, kClusterSize);
+
+    if (isSequential) {
+      loadEnd += kReadaheadSize;
+    }
+
+    loadEnd = std::min(loadEnd, mImageSize);
+    buffer.resize(loadEnd - loadBegin);
+
+    auto loaded = readHost(loadBegin, buffer.data(), buffer.size());
+
+    for (std::uint64_t pos = 0; pos < loaded; pos += kClusterSize) {
+      insert(cluster + pos / kClusterSize, buffer.data() + pos,
+             std::min(kClusterSize, loaded - pos));
+    }
+
+    auto available = loaded > clusterOffset
+                         ? std::min(loaded - clusterOffset, size - result)
+                         : 0;
+    std::memcpy(output + result, buffer.data() + clusterOffset, available);
+    result += available;
+
+    if (loaded < buffer.size()) {
+      break;
+    }
+  }
+
+  return result;
+}
+
+struct Extent {
+  std::uint64_t offset; // in the image, kSparseExtent for unrecorded data
+  std::uint64_t size;
+};
+
+struct IsoNode {
+  orbis::kstring name;
+  bool isDir = false;
+  bool isResolved = false; // size and location are known
+  bool isListed = false;   // children are loaded
+  std::uint64_t size = 0;
+  std::int64_t mtime = 0;
+
+  // UDF file entry location, read on first use
+  std::uint16_t icbPartition = 0;
+  std::uint32_t icbBlock = 0;
+
+  orbis::kvector<Extent> extents;
+  orbis::kvector<std::byte> inlineData;
+  orbis::kvector<std::uint32_t> children;
+  orbis::kmap<orbis::kstring, std::uint32_t> childByName; // case folded
+};
+
+struct RockRidgeEntry {
+  std::string name;
+  bool hasName = false;
+  bool isRelocated = false;
+  std::optional<std::uint32_t> childLink;
+};
+
+struct IsoFsDevice : orbis::IoDevice {
+  enum class Format { Iso9660, Joliet, RockRidge, Udf };
+
+  IsoFsDevice(orbis::kstring imagePath, int hostFd, std::uint64_t imageSize)
+      : imagePath(std::move(imagePath)), mHostFd(hostFd),
+        mCache(hostFd, imageSize) {}
+  ~IsoFsDevice() override;
+
+  orbis::kstring imagePath;
+
+  // Detects the file system and creates the root directory node
+  bool mount();
+
+  orbis::ErrorCode open(rx::Ref<orbis::File> *file, const char *path,
+                        std::uint32_t flags, std::uint32_t mode,
+                        orbis::Thread *thread) override;
+
+  std::uint64_t readNode(const IsoNode &node, std::uint64_t offset,
+                         void *data, std::uint64_t size, bool isSequential);
+
+private:
+  std::optional<std::uint32_t> lookup(std::string_view path);
+  bool resolve(IsoNode &node);
+  bool list(IsoNode &dir);
+  void addChild(IsoNode &dir, IsoNode child);
+
+  bool readImage(std::uint64_t offset, void *data, std::uint64_t size) {
+    return mCache.read(offset, data, size, false) == size;
+  }
+
+  bool mountIso9660();
+  bool listIso9660(IsoNode &dir);
+  RockRidgeEntry parseRockRidge(std::span<const std::byte> systemUse);
+
+  bool mountUdf();
+  bool listUdf(IsoNode &dir);
+  bool resolveUdf(IsoNode &node);
+  bool mapUdfExtent(std::uint16_t partitionRef, std::uint32_t block,
+                    std::uint64_t size, orbis::kvector<Extent> &result);
+  bool readUdfBlock(std::uint16_t partitionRef, std::uint32_t block,
+                    std::span<std::byte> data);
+
+  struct UdfPartition {
+    std::uint16_t number = 0;
+    std::uint64_t start = 0; // offset of the physical partition in the image
+
+    // blocks of the metadata partition are stored in the metadata file
+    bool isMetadata = false;
+    std::uint32_t metadataFileBlock = 0;
+    orbis::kvector<Extent> metadataExtents;
+  };
+
+  int mHostFd;
+  ImageCache mCache;
+  Format mFormat = Format::Iso9660;
+
+  // Nodes are never removed, references stay valid while new nodes are added
+  rx::shared_mutex mNodesMtx;
+  orbis::kdeque<IsoNode> mNodes;
+
+  // bytes to skip at the start of system use areas, Rock Ridge only
+  std::uint32_t mSuspSkip = 0;
+
+  orbis::kvector<UdfPartition> mUdfPartitions; // by partition reference
+};
+
+struct IsoFile : orbis::File {
+  IsoNode *node = nullptr;
+  std::uint32_t ino = 0;
+  std::atomic<std::uint64_t> nextReadOffset{0};
+};
+
+IsoFsDevice::~IsoFsDevice() {
+  auto stats = mCache.getStats();
+
+  if (stats.hits + stats.misses != 0) {
+    std::string_view image = imagePath;
+    auto hostKiB = stats.hostBytes / 1024;
+    ORBIS_LOG_NOTICE("iso: image cache stats", image, stats.hits,
+                     stats.misses, stats.hostReads, hostKiB);
+  }
+
+  ::close(mHostFd);
+}
+
+bool IsoFsDevice::mount() {
+  // UDF bridge images also have ISO 9660 descriptors, UDF names are not
+  // limited and preferred
+  if (mountUdf()) {
+    mFormat = Format::Udf;
+    return true;
+  }
+
+  mUdfPartitions.clear();
+  return mountIso9660();
+}
+
+std::uint64_t IsoFsDevice::readNode(const IsoNode &node, std::uint64_t offset,
+                                    void *data, std::uint64_t size,
+                                    bool isSequential) {
+  if (offset >= node.size) {
+    return 0;
+  }
+
+  size = std::min(size, node.size - offset);
+  auto output = static_cast<std::byte *>(data);
+
+  if (!node.inlineData.empty()) {
+    size = std::min<std::uint64_t>(
+        size, node.inlineData.size() > offset
+                  ? node.inlineData.size() - offset
+                  : 0);
+    std::memcpy(output, node.inlineData.data() + offset, size);
+    return size;
+  }
+
+  std::uint64_t result = 0;
+
+  for (auto &extent : node.extents) {
+    if (result == size) {
+      break;
+    }
+
+    if (offset >= extent.size) {
+      offset -= extent.size;
+      continue;
+    }
+
+    auto count = std::min(extent.size - offset, size - result);
+
+    if (extent.offset == kSparseExtent) {
+      std::memset(output + result, 0, count);
+    } else if (auto read = mCache.read(extent.offset + offset, output + result,
+                                       count, isSequential);
+               read != count) {
+      return result + read;
+    }
+
+    result += count;
+    offset = 0;
+  }
+
+  return result;
+}
+
+std::optional<std::uint32_t> IsoFsDevice::lookup(std::string_view path) {
+  std::uint32_t index = 0;
+
+  while (!path.empty()) {
+    auto separator = path.find('/');
+    auto elem = path.substr(0, separator);
+    path.remove_prefix(separator == std::string_view::npos ? path.size()
+                                                           : separator + 1);
+
+    if (elem.empty() || elem == ".") {
+      continue;
+    }
+
+    auto &dir = mNodes[index];
+    if (!resolve(dir) || !dir.isDir || !list(dir)) {
+      return {};
+    }
+
+    // guest paths don't always match the case of the names
+    auto it = dir.childByName.find(std::string_view(foldCase(elem)));
+    if (it == dir.childByName.end()) {
+      return {};
+    }
+
+    index = it->second;
+  }
+
+  return index;
+}
+
+bool IsoFsDevice::resolve(IsoNode &node) {
+  if (node.isResolved) {
+    return true;
+  }
+
+  return mFormat == Format::Udf && resolveUdf(node);
+}
+
+bool IsoFsDevice::list(IsoNode &dir) {
+  if (dir.isListed) {
+    return true;
+  }
+
+  if (dir.size > kMaxDirectorySize) {
+    ORBIS_LOG_ERROR("iso: directory is too big", dir.size);
+    return false;
+  }
+
+  bool isListed =
+      mFormat == Format::Udf ? listUdf(dir) : listIso9660(dir);
+  dir.isListed = isListed;
+  return isListed;
+}
+
+void IsoFsDevice::addChild(IsoNode &dir, IsoNode child) {
+  auto key = foldCase(child.name);
+  if (child.name.empty() || dir.childByName.contains(std::string_view(key))) {
+    return;
+  }
+
+  auto index = static_cast<std::uint32_t>(mNodes.size());
+  mNodes.push_back(std::move(child));
+  dir.children.push_back(index);
+  dir.childByName.emplace(key, index);
+}
+
+bool IsoFsDevice::mountIso9660() {
+  std::optional<std::vector<std::byte>> primaryRoot;
+  std::optional<std::vector<std::byte>> jolietRoot;
+  std::byte desc[kSectorSize];
+
+  for (std::uint64_t sector = 16; sector < 16 + 64; ++sector) {
+    if (!readImage(sector * kSectorSize, desc, sizeof(desc)) ||
+        std::memcmp(desc + 1, "CD001", 5) != 0) {
+      break;
+    }
+
+    auto type = std::to_integer<unsigned>(desc[0]);
+    if (type == 255) {
+      break;
+    }
+
+    auto root = std::vector<std::byte>(desc + 156, desc + 156 + 34);
+
+    if (type == 1 && !primaryRoot) {
+      primaryRoot = std::move(root);
+    } else if (type == 2 && !jolietRoot &&
+               std::to_integer<unsigned>(desc[88]) == 0x25 &&
+               std::to_integer<unsigned>(desc[89]) == 0x2f) {
+      // UCS-2 level 1, 2 or 3 escape sequence
+      auto level = std::to_integer<unsigned>(desc[90]);
+      if (level == 0x40 || level == 0x43 || level == 0x45) {
+        jolietRoot = std::move(root);
+      }
+    }
+  }
+
+  if (!primaryRoot && !jolietRoot) {
+    return false;
+  }
+
+  auto createRoot = [&](std::span<const std::byte> record) {
+    auto &root = mNodes.emplace_back();
+    root.isDir = true;
+    root.isResolved = true;
+    root.size = readLe<std::uint32_t>(record, 10);
+    root.mtime = decodeIsoTime(record.subspan(18, 7));
+    root.extents.push_back(
+        {readLe<std::uint32_t>(record, 2) * kSectorSize, root.size});
+  };
+
+  if (primaryRoot) {
+    // Rock Ridge is announced by the SP entry of the root '.' record
+    std::byte first[kSectorSize];
+    auto rootSector = readLe<std::uint32_t>(*primaryRoot, 2);
+
+    if (readImage(rootSector * kSectorSize, first, sizeof(first))) {
+      auto recordLength = std::to_integer<std::size_t>(first[0]);
+      auto nameLength = std::to_integer<std::size_t>(first[32]);
+      auto systemUse = 33 + nameLength + (nameLength % 2 == 0 ? 1 : 0);
+
+      if (recordLength >= systemUse + 7 &&
+          std::memcmp(first + systemUse, "SP", 2) == 0 &&
+          std::to_integer<unsigned>(first[systemUse + 4]) == 0xbe &&
+          std::to_integer<unsigned>(first[systemUse + 5]) == 0xef) {
+        mFormat = Format::RockRidge;
+        mSuspSkip = std::to_integer<std::uint32_t>(first[systemUse + 6]);
+        createRoot(*primaryRoot);
+        return true;
+      }
+    }
+  }
+
+  if (jolietRoot) {
+    mFormat = Format::Joliet;
+    createRoot(*jolietRoot);
+    return true;
+  }
+
+  mFormat = Format::Iso9660;
+  createRoot(*primaryRoot);
+  return true;
+}
+
+RockRidgeEntry
+IsoFsDevice::parseRockRidge(std::span<const std::byte> systemUse) {
+  RockRidgeEntry result;
+  std::vector<std::byte> continuation;
+
+  // entries may continue in continuation areas, the count is limited to not
+  // loop forever on broken images
+  for (int areas = 0; areas < 16; ++areas) {
+    std::optional<std::uint64_t> nextOffset;
+    std::uint32_t nextSize = 0;
+    std::size_t pos = 0;
+
+    while (pos + 4 <= systemUse.size()) {
+      auto entry = systemUse.subspan(pos);
+      auto length = std::to_integer<std::size_t>(entry[2]);
+
+      if (length < 4 || length > entry.size()) {
+        break;
+      }
+
+      entry = entry.first(length);
+      pos += length;
+
+      auto signature =
+          std::string_view(reinterpret_cast<const char *>(entry.data()), 2);
+
+      if (signature == "NM" && length >= 5) {
+        // current and parent directory names are not used
+        if ((std::to_integer<unsigned>(entry[4]) & 6) == 0) {
+          result.name.append(reinterpret_cast<const char *>(entry.data()) + 5,
+                             length - 5);
+          result.hasName = true;
+        }
+      } else if (signature == "CE" && length >= 28) {
+        nextOffset = readLe<std::uint32_t>(entry, 4) * kSectorSize +
+                     readLe<std::uint32_t>(entry, 12);
+        nextSize = readLe<std::uint32_t>(entry, 20);
+      } else if (signature == "RE") {
+        result.isRelocated = true;
+      } else if (signature == "CL" && length >= 12) {
+        result.childLink = readLe<std::uint32_t>(entry, 4);
+      } else if (signature == "ST") {
+        break;
+      }
+    }
+
+    if (!nextOffset || nextSize > kSectorSize) {
+      break;
+    }
+
+    continuation.resize(nextSize);
+    if (!readImage(*nextOffset, continuation.data(), nextSize)) {
+      break;
+    }
+
+    systemUse = continuation;
+  }
+
+  return result;
+}
+
+bool IsoFsDevice::listIso9660(IsoNode &dir) {
+  std::vector<std::byte> data(dir.size);
+  if (readNode(dir, 0, data.data(), data.size(), false) != data.size()) {
+    return false;
+  }
+
+  std::span<const std::byte> records = data;
+  std::optional<std::uint32_t> multiExtentNode;
+  std::size_t pos = 0;
+
+  while (pos < records.size()) {
+    auto length = std::to_integer<std::size_t>(records[pos]);
+
+    if (length == 0) {
+      // records don't cross sector boundaries
+      pos = rx::alignUp(pos + 1, kSectorSize);
+      continue;
+    }
+
+    if (length < 34 || pos + length > records.size()) {
+      break;
+    }
+
+    auto record = records.subspan(pos, length);
+    pos += length;
+
+    auto nameLength = std::to_integer<std::size_t>(record[32]);
+    if (33 + nameLength > length) {
+      continue;
+    }
+
+    auto rawName = record.subspan(33, nameLength);
+    if (nameLength == 1 && std::to_integer<unsigned>(rawName[0]) <= 1) {
+      // current and parent directory
+      continue;
+    }
+
+    auto flags = std::to_integer<unsigned>(record[25]);
+    auto extentSector = readLe<std::uint32_t>(record, 2) +
+                        std::to_integer<std::uint32_t>(record[1]);
+    auto extentSize = readLe<std::uint32_t>(record, 10);
+
+    if (multiExtentNode) {
+      // next part of the file bigger than 4 GiB
+      auto &node = mNodes[*multiExtentNode];
+      node.extents.push_back({extentSector * kSectorSize, extentSize});
+      node.size += extentSize;
+
+      if ((flags & 0x80) == 0) {
+        multiExtentNode.reset();
+      }
+
+      continue;
+    }
+
+    IsoNode child;
+    child.isDir = (flags & 2) != 0;
+    child.isResolved = true;
+    child.isListed = !child.isDir;
+    child.size = extentSize;
+    child.mtime = decodeIsoTime(record.subspan(18, 7));
+
+    std::string name;
+
+    if (mFormat == Format::Joliet) {
+      name = decodeUcs2Be(rawName);
+    } else {
+      name.assign(reinterpret_cast<const char *>(rawName.data()), nameLength);
+    }
+
+    if (mFormat == Format::RockRidge) {
+      auto systemUse = 33 + nameLength + (nameLength % 2 == 0 ? 1 : 0);
+      auto entry = parseRockRidge(
+          systemUse + mSuspSkip < length
+              ? record.subspan(systemUse + mSuspSkip)
+              : std::span<const std::byte>{});
+
+      if (entry.isRelocated) {
+        // deep directory moved to rr_moved, listed at its original place
+        continue;
+      }
+
+      if (entry.childLink) {
+        // placeholder of the relocated directory, the size is stored in its
+        // own '.' record
+        std::byte first[34];
+        if (!readImage(*entry.childLink * kSectorSize, first, sizeof(first))) {
+          continue;
+        }
+
+        child.isDir = true;
+        child.isListed = false;
+        extentSector = *entry.childLink;
+        extentSize = readLe<std::uint32_t>(first, 10);
+        child.size = extentSize;
+      }
+
+      if (entry.hasName) {
+        name = std::move(entry.name);
+      }
+    }
+
+    if (mFormat != Format::RockRidge || name.contains(';')) {
+      // strip the version of ISO 9660 names
+      if (auto version = name.rfind(';'); version != std::string::npos) {
+        name.resize(version);
+      }
+
+      if (name.ends_with('.')) {
+        name.pop_back();
+      }
+    }
+
+    child.name = name;
+    child.extents.push_back({extentSector * kSectorSize, extentSize});
+
+    auto index = static_cast<std::uint32_t>(mNodes.size());
+    addChild(dir, std::move(child));
+
+    if ((flags & 0x80) != 0 && index < mNodes.size()) {
+      multiExtentNode = index;
+    }
+  }
+
+  return true;
+}
+
+bool IsoFsDevice::mountUdf() {
+  // the volume recognition sequence follows the ISO 9660 descriptors
+  bool hasNsr = false;
+
+  for (std::uint64_t sector = 16; sector < 16 + 64; ++sector) {
+    std::byte desc[8];
+    if (!readImage(sector * kSectorSize, desc, sizeof(desc))) {
+      break;
+    }
+
+    auto id = std::string_view(reinterpret_cast<const char *>(desc + 1), 5);
+    if (id == "NSR02" || id == "NSR03") {
+      hasNsr = true;
+      break;
+    }
+
+    if (id != "CD001" && id != "BEA01" && id != "TEA01" && id != "BOOT2" &&
+        id != "CDW02") {
+      break;
+    }
+  }
+
+  if (!hasNsr) {
+    return false;
+  }
+
+  std::vector<std::byte> block(kSectorSize);
+
+  if (!readImage(256 * kSectorSize, block.data(), block.size()) ||
+      readLe<std::uint16_t>(block, 0) != kUdfTagAnchor) {
+    ORBIS_LOG_ERROR("iso: UDF anchor not found");
+    return false;
+  }
+
+  auto vdsLength = readLe<std::uint32_t>(block, 16);
+  auto vdsSector = readLe<std::uint32_t>(block, 20);
+
+  std::vector<std::pair<std::uint16_t, std::uint32_t>> partitionStarts;
+  std::vector<std::byte> lvd;
+
+  for (std::uint32_t i = 0; i < std::min(vdsLength / kSectorSize, 256ul);
+       ++i) {
+    if (!readImage((vdsSector + i) * kSectorSize, block.data(),
+                   block.size())) {
+      return false;
+    }
+
+    auto tagId = readLe<std::uint16_t>(block, 0);
+
+    if (tagId == kUdfTagPartition) {
+      partitionStarts.emplace_back(readLe<std::uint16_t>(block, 22),
+                                   readLe<std::uint32_t>(block, 188));
+    } else if (tagId == kUdfTagLogicalVolume && lvd.empty()) {
+      lvd = block;
+    } else if (tagId == kUdfTagTerminating) {
+      break;
+    }
+  }
+
+  if (lvd.empty()) {
+    ORBIS_LOG_ERROR("iso: UDF logical volume not found");
+    return false;
+  }
+
+  auto blockSize = readLe<std::uint32_t>(lvd, 212);
+  if (blockSize != kSectorSize) {
+    ORBIS_LOG_ERROR("iso: unsupported UDF block size", blockSize);
+    return false;
+  }
+
+  auto getPartitionStart =
+      [&](std::uint16_t number) -> std::optional<std::uint64_t> {
+    for (auto [partitionNumber, start] : partitionStarts) {
+      if (partitionNumber == number) {
+        return start * kSectorSize;
+      }
+    }
+
+    return {};
+  };
+
+  auto mapCount = readLe<std::uint32_t>(lvd, 268);
+  std::size_t mapOffset = 440;
+
+  for (std::uint32_t i = 0; i < mapCount; ++i) {
+    // map type and length
+    if (mapOffset + 2 > lvd.size()) {
+      return false;
+    }
+
+    auto type = std::to_integer<unsigned>(lvd[mapOffset]);
+    auto length = std::to_integer<std::size_t>(lvd[mapOffset + 1]);
+
+    if (length == 0 || mapOffset + length > lvd.size()) {
+      return false;
+    }
+
+    auto map = std::span<const std::byte>(lvd).subspan(mapOffset, length);
+    mapOffset += length;
+
+    UdfPartition partition;
+
+    if (type == 1) {
+      partition.number = readLe<std::uint16_t>(map, 4);
+    } else if (type == 2) {
+      // type 2 maps are 64 bytes, identifier is at offset 5
+      if (map.size() < 64) {
+        return false;
+      }
+
+      auto id = std::string_view(reinterpret_cast<const char *>(&map[5]), 23);
+      partition.number = readLe<std::uint16_t>(map, 38);
+
+      if (id.starts_with("*UDF Metadata Partition")) {
+        partition.isMetadata = true;
+        partition.metadataFileBlock = readLe<std::uint32_t>(map, 40);
+      } else if (!id.starts_with("*UDF Sparable Partition")) {
+        // sparing tables remap defects of rewritable media, images have none
+        ORBIS_LOG_ERROR("iso: unsupported UDF partition map", id);
+        return false;
+      }
+    } else {
+      return false;
+    }
+
+    auto start = getPartitionStart(partition.number);
+    if (!start) {
+      return false;
+    }
+
+    partition.start = *start;
+    mUdfPartitions.push_back(std::move(partition));
+  }
+
+  for (auto &partition : mUdfPartitions) {
+    if (!partition.isMetadata) {
+      continue;
+    }
+
+    auto physical = std::ranges::find_if(mUdfPartitions, [&](auto &other) {
+      return !other.isMetadata && other.number == partition.number;
+    });
+
+    if (physical == mUdfPartitions.end()) {
+      return false;
+    }
+
+    IsoNode metadataFile;
+    metadataFile.icbPartition = physical - mUdfPartitions.begin();
+    metadataFile.icbBlock = partition.metadataFileBlock;
+
+    if (!resolveUdf(metadataFile)) {
+      ORBIS_LOG_ERROR("iso: failed to read UDF metadata file");
+      return false;
+    }
+
+    partition.metadataExtents = std::move(metadataFile.extents);
+  }
+
+  auto fileSetBlock = readLe<std::uint32_t>(lvd, 252);
+  auto fileSetPartition = readLe<std::uint16_t>(lvd, 256);
+
+  if (!readUdfBlock(fileSetPartition, fileSetBlock, block) ||
+      readLe<std::uint16_t>(block, 0) != kUdfTagFileSet) {
+    ORBIS_LOG_ERROR("iso: UDF file set not found");
+    return false;
+  }
+
+  auto &root = mNodes.emplace_back();
+  root.isDir = true;
+  root.icbBlock = readLe<std::uint32_t>(block, 404);
+  root.icbPartition = readLe<std::uint16_t>(block, 408);
+
+  if (!resolveUdf(root)) {
+    mNodes.clear();
+    return false;
+  }
+
+  return true;
+}
+
+bool IsoFsDevice::mapUdfExtent(std::uint16_t partitionRef,
+                               std::uint32_t block, std::uint64_t size,
+                               orbis::kvector<Extent> &result) {
+  if (partitionRef >= mUdfPartitions.size()) {
+    return false;
+  }
+
+  auto &partition = mUdfPartitions[partitionRef];
+  auto offset = std::uint64_t(block) * kSectorSize;
+
+  if (!partition.isMetadata) {
+    result.push_back({partition.start + offset, size});
+    return true;
+  }
+
+  for (auto extent : partition.metadataExtents) {
+    if (size == 0) {
+      break;
+    }
+
+    if (offset >= extent.size) {
+      offset -= extent.size;
+      continue;
+    }
+
+    auto count = std::min(extent.size - offset, size);
+    result.push_back({extent.offset == kSparseExtent ? kSparseExtent
+                                                     : extent.offset + offset,
+                      count});
+    size -= count;
+    offset = 0;
+  }
+
+  return size == 0;
+}
+
+bool IsoFsDevice::readUdfBlock(std::uint16_t partitionRef,
+                               std::uint32_t block,
+                               std::span<std::byte> data) {
+  orbis::kvector<Extent> extents;
+  if (!mapUdfExtent(partitionRef, block, data.size(), extents)) {
+    return false;
+  }
+
+  IsoNode view;
+  view.size = data.size();
+  view.extents = std::move(extents);
+  return readNode(view, 0, data.data(), data.size(), false) == data.size();
+}
+
+bool IsoFsDevice::resolveUdf(IsoNode &node) {
+  std::vector<std::byte> entry(kSectorSize);
+  if (!readUdfBlock(node.icbPartition, node.icbBlock, entry)) {
+    return false;
+  }
+
+  std::size_t adOffset;
+  std::size_t adLength;
+
+  switch (readLe<std::uint16_t>(entry, 0)) {
+  case kUdfTagFileEntry:
+    node.size = readLe<std::uint64_t>(entry, 56);
+    node.mtime = decodeUdfTime(std::span(entry).subspan(84, 12));
+    adOffset = 176 + readLe<std::uint32_t>(entry, 168);
+    adLength = readLe<std::uint32_t>(entry, 172);
+    break;
+
+  case kUdfTagExtendedFileEntry:
+    node.size = readLe<std::uint64_t>(entry, 56);
+    node.mtime = decodeUdfTime(std::span(entry).subspan(92, 12));
+    adOffset = 216 + readLe<std::uint32_t>(entry, 208);
+    adLength = readLe<std::uint32_t>(entry, 212);
+    break;
+
+  default:
+    return false;
+  }
+
+  if (adOffset + adLength > entry.size()) {
+    return false;
+  }
+
+  // file type 4 is a directory
+  node.isDir = std::to_integer<unsigned>(entry[27]) == 4;
+  node.extents.clear();
+
+  auto adType = readLe<std::uint16_t>(entry, 34) & 7;
+  std::span<const std::byte> ads = std::span(entry).subspan(adOffset, adLength);
+
+  if (adType == 3) {
+    // the data is embedded in the entry
+    node.inlineData.assign(ads.begin(), ads.end());
+    node.isResolved = true;
+    return true;
+  }
+
+  if (adType != 0 && adType != 1) {
+    ORBIS_LOG_ERROR("iso: unsupported UDF allocation descriptors", adType);
+    return false;
+  }
+
+  std::size_t adSize = adType == 0 ? 8 : 16;
+  std::vector<std::byte> continuation(kSectorSize);
+
+  for (int areas = 0; areas < 1024; ++areas) {
+    bool hasNext = false;
+
+    for (std::size_t pos = 0; pos + adSize <= ads.size(); pos += adSize) {
+      auto rawLength = readLe<std::uint32_t>(ads, pos);
+      auto length = rawLength & 0x3fff'ffff;
+      auto extentType = rawLength >> 30;
+      auto block = readLe<std::uint32_t>(ads, pos + 4);
+      auto partitionRef =
+          adType == 0 ? node.icbPartition : readLe<std::uint16_t>(ads, pos + 8);
+
+      if (length == 0) {
+        break;
+      }
+
+      if (extentType == 3) {
+        // descriptors continue in the allocation extent
+        if (!readUdfBlock(partitionRef, block, continuation) ||
+            readLe<std::uint16_t>(continuation, 0) !=
+                kUdfTagAllocationExtent) {
+          return false;
+        }
+
+        auto nextLength = readLe<std::uint32_t>(continuation, 20);
+        if (24 + nextLength > continuation.size()) {
+          return false;
+        }
+
+        ads = std::span(continuation).subspan(24, nextLength);
+        hasNext = true;
+        break;
+      }
+
+      if (extentType != 0) {
+        // allocated or not, nothing is recorded
+        node.extents.push_back({kSparseExtent, length});
+        continue;
+      }
+
+      if (!mapUdfExtent(partitionRef, block, length, node.extents)) {
+        return false;
+      }
+    }
+
+    if (!hasNext) {
+      break;
+    }
+  }
+
+  node.isResolved = true;
+  return true;
+}
+
+bool IsoFsDevice::listUdf(IsoNode &dir) {
+  std::vector<std::byte> data(dir.size);
+  if (readNode(dir, 0, data.data(), data.size(), false) != data.size()) {
+    return false;
+  }
+
+  std::span<const std::byte> ids = data;
+  std::size_t pos = 0;
+
+  while (pos + 38 <= ids.size()) {
+    auto id = ids.subspan(pos);
+    if (readLe<std::uint16_t>(id, 0) != kUdfTagFileIdentifier) {
+      break;
+    }
+
+    auto characteristics = std::to_integer<unsigned>(id[18]);
+    auto nameLength = std::to_integer<std::size_t>(id[19]);
+    auto implUseLength = readLe<std::uint16_t>(id, 36);
+    auto size = 38 + implUseLength + nameLength;
+
+    if (size > id.size()) {
+      break;
+    }
+
+    pos += rx::alignUp(size, 4);
+
+    // deleted and parent entries are skipped
+    if ((characteristics & (4 | 8)) != 0) {
+      continue;
+    }
+
+    IsoNode child;
+    child.name = decodeCs0(id.subspan(38 + implUseLength, nameLength));
+    child.isDir = (characteristics & 2) != 0;
+    child.isListed = !child.isDir;
+    child.icbBlock = readLe<std::uint32_t>(id, 24);
+    child.icbPartition = readLe<std::uint16_t>(id, 28);
+    addChild(dir, std::move(child));
+  }
+
+  return true;
+}
+
+orbis::ErrorCode iso_read(orbis::File *file, orbis::Uio *uio,
+                          orbis::Thread *) {
+  auto isoFile = static_cast<IsoFile *>(file);
+  auto &node = *isoFile->node;
+
+  if (node.isDir) {
+    return orbis::ErrorCode::ISDIR;
+  }
+
+  auto device = static_cast<IsoFsDevice *>(file->device.get());
+  bool isSequential = isoFile->nextReadOffset.load(
+                          std::memory_order::relaxed) == uio->offset;
+
+  for (auto vec : std::span(uio->iov, uio->iovcnt)) {
+    auto expected = uio->offset < node.size
+                        ? std::min(vec.len, node.size - uio->offset)
+                        : 0;
+    auto count = device->readNode(node, uio->offset, vec.base, vec.len,
+                                  isSequential);
+
+    if (count == 0 && expected != 0) {
+      return orbis::ErrorCode::IO;
+    }
+
+    uio->offset += count;
+    uio->resid -= count;
+
+    if (count != vec.len) {
+      break;
+    }
+  }
+
+  isoFile->nextReadOffset.store(uio->offset, std::memory_order::relaxed);
+  return {};
+}
+
+orbis::ErrorCode iso_stat(orbis::File *file, orbis::Stat *sb,
+                          orbis::Thread *) {
+  auto isoFile = static_cast<IsoFile *>(file);
+  auto &node = *isoFile->node;
+  auto time = orbis::timespec{
+      .sec = static_cast<std::uint64_t>(node.mtime),
+      .nsec = 0,
+  };
+
+  *sb = {};
+  sb->ino = isoFile->ino;
+  sb->mode = node.isDir ? S_IFDIR | 0555 : S_IFREG | 0444;
+  sb->nlink = 1;
+  sb->atim = time;
+  sb->mtim = time;
+  sb->ctim = time;
+  sb->birthtim = time;
+  sb->size = node.size;
+  sb->blocks = rx::alignUp(node.size, 512) / 512;
+  sb->blksize = ImageCache::kClusterSize;
+  return {};
+}
+
+orbis::ErrorCode iso_mmap(orbis::File *file, void **address,
+                          std::uint64_t size, std::int32_t prot,
+                          std::int32_t flags, std::int64_t offset,
+                          orbis::Thread *thread) {
+  auto isoFile = static_cast<IsoFile *>(file);
+  if (isoFile->node->isDir) {
+    return orbis::ErrorCode::ISDIR;
+  }
+
+  if ((flags & vm::kMapFlagShared) != 0 &&
+      (prot & vm::kMapProtCpuWrite) != 0) {
+    return orbis::ErrorCode::ACCES;
+  }
+
+  // the image can't be mapped directly, the contents are copied to private
+  // memory
+  auto result = vm::map(*address, size, prot | vm::kMapProtCpuWrite,
+                        (flags & ~vm::kMapFlagShared) | vm::kMapFlagPrivate |
+                            vm::kMapFlagAnonymous);
+
+  if (result == (void *)-1) {
+    return orbis::ErrorCode::NOMEM;
+  }
+
+  auto device = static_cast<IsoFsDevice *>(file->device.get());
+  device->readNode(*isoFile->node, offset, result, size, false);
+
+  if ((prot & vm::kMapProtCpuWrite) == 0) {
+    vm::protect(result, size, prot);
+  }
+
+  *address = result;
+  return {};
+}
+
+const orbis::FileOps isoOps = {
+    .read = iso_read,
+    .stat = iso_stat,
+    .mmap = iso_mmap,
+};
+} // namespace
+
+orbis::ErrorCode IsoFsDevice::open(rx::Ref<orbis::File> *file,
+                                   const char *path, std::uint32_t flags,
+                                   std::uint32_t mode, orbis::Thread *thread) {
+  if ((flags & (orbis::kOpenFlagWriteOnly | orbis::kOpenFlagReadWrite |
+                orbis::kOpenFlagCreat | orbis::kOpenFlagTrunc)) != 0) {
+    return orbis::ErrorCode::ROFS;
+  }
+
+  std::lock_guard lock(mNodesMtx);
+
+  auto index = lookup(path);
+  if (!index) {
+    return orbis::ErrorCode::NOENT;
+  }
+
+  auto &node = mNodes[*index];
+  if (!resolve(node)) {
+    return orbis::ErrorCode::IO;
+  }
+
+  if ((flags & orbis::kOpenFlagDirectory) != 0 && !node.isDir) {
+    return orbis::ErrorCode::NOTDIR;
+  }
+
+  auto result = orbis::knew<IsoFile>();
+
+  if (node.isDir) {
+    if (!list(node)) {
+      return orbis::ErrorCode::IO;
+    }
+
+    for (auto childIndex : node.children) {
+      auto &child = mNodes[childIndex];
+      auto &entry = result->dirEntries.emplace_back();
+      entry.fileno = childIndex + 1;
+      entry.reclen = sizeof(entry);
+      entry.type = child.isDir ? orbis::kDtDir : orbis::kDtReg;
+      entry.namlen = std::min(child.name.size(), sizeof(entry.name) - 1);
+      std::strncpy(entry.name, child.name.c_str(), sizeof(entry.name) - 1);
+    }
+  }
+
+  result->node = &node;
+  result->ino = *index + 1;
+  result->ops = &isoOps;
+  result->device = this;
+  *file = result;
+  return {};
+}
+
+orbis::IoDevice *createIsoIoDevice(const std::filesystem::path &imagePath) {
+  int hostFd = ::open(imagePath.c_str(), O_RDONLY);
+  if (hostFd < 0) {
+    return nullptr;
+  }
+
+  struct stat st;
+  if (::fstat(hostFd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    ::close(hostFd);
+    return nullptr;
+  }
+
+  auto device = orbis::knew<IsoFsDevice>(orbis::kstring(imagePath.string()),
+                                         hostFd, st.st_size);
+
+  if (!device->mount()) {
+    delete device;
+    return nullptr;
+  }
+
+  return device;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "orbis/IoDevice.hpp"
+#include <filesystem>
+
+// Read-only file system of an ISO 9660 (with Joliet or Rock Ridge names) or
+// UDF disc image. Returns nullptr if the image can't be opened or has no
+// supported file system
+orbis::IoDevice *createIsoIoDevice(const std::filesystem::path &imagePath);
@@ -950,6 +950,7 @@ rx::Ref<orbis::Module> rx::linker::loadModule(std::span<std::byte> image,
                                            : baseAddress + header.e_phoff;
   result->phNum = header.e_phnum;
   result->proc = process;
+  result->buildSymbolIndex();
 
   std::printf("Loaded module '%s' (%lx) from object '%s', address: %p - %p\n",
               result->moduleName, (unsigned long)result->attributes,
@@ -3,6 +3,7 @@
 #include "gpu/DeviceCtl.hpp"
 #include "io-device.hpp"
 #include "io-devices.hpp"
+#include "iso-device.hpp"
 #include "iodev/mbus.hpp"
 #include "iodev/mbus_av.hpp"
 #include "ipmi.hpp"
@@ -92,16 +93,10 @@ handle_signal(int sig, siginfo_t *info, void *ucontext) {
 
         if ((flags & amdgpu::kPageReadWriteLock) != 0) {
           if ((flags & amdgpu::kPageLazyLock) != 0) {
-            if (std::uint32_t gpuCommand = 0;
-                !gpuContext.gpuCacheCommand[vmid].compare_exchange_weak(
-                    gpuCommand, page)) {
+            if (!gpuContext.pushGpuCacheCommand(vmid, page)) {
               continue;
             }
 
-            gpuContext.gpuCacheCommandIdle.fetch_add(
-                1, std::memory_order::release);
-            gpuContext.gpuCacheCommandIdle.notify_all();
-
             while (!gpuContext.cachePages[vmid][page].compare_exchange_weak(
                 flags, flags & ~amdgpu::kPageLazyLock,
                 std::memory_order::relaxed)) {
@@ -760,13 +755,26 @@ static void usage(const char *argv0) {
   std::println("{} [<options>...] <virtual path to elf> [args...]", argv0);
   std::println("  options:");
   std::println("  --version, -v - print version");
-  std::println("    -m, --mount <host path> <virtual path>");
+  std::println("    -m, --mount <host path> <virtual path> - host path is a "
+               "directory or an ISO 9660/UDF image");
   std::println("    -o, --override <original module name> <virtual path to "
                "overriden module>");
   std::println("    --fw <path to firmware root>");
   std::println(
       "    --gpu <index> - specify physical gpu index to use, default is 0");
   std::println("    --disable-cache - disable cache of gpu resources");
+  std::println("    --shader-cache <host path> - persist converted shaders "
+               "in the specified directory");
+  std::println("    --shader-threads <count> - compile shaders on background "
+               "threads, default is 0 (inline)");
+  std::println("    --skip-draws-while-compiling - skip draws which use "
+               "shaders that are still compiling");
+  std::println("    --no-optimize-shaders - keep redundant instructions of "
+               "converted shaders");
+  std::println("    --gpu-capture <host path> - record GPU command stream to "
+               "the file, capture starts on F12");
+  std::println("    --gpu-capture-frames <count> - number of frames to "
+               "capture, default is 1");
   // std::println("    --presenter <window>");
   std::println("    --trace");
 }
@@ -922,6 +930,19 @@ int main(int argc, const char *argv[]) {
 
       std::println("mounting '{}' to virtual '{}'", argv[argIndex + 1],
                    argv[argIndex + 2]);
+      if (std::filesystem::is_regular_file(argv[argIndex + 1])) {
+        auto device = createIsoIoDevice(argv[argIndex + 1]);
+        if (device == nullptr) {
+          std::println(stderr, "Failed to mount image '{}'",
+                       argv[argIndex + 1]);
+          return 1;
+        }
+
+        vfs::mount(argv[argIndex + 2], device);
+        argIndex += 3;
+        continue;
+      }
+
       if (!std::filesystem::is_directory(argv[argIndex + 1])) {
         std::println(stderr, "Directory '{}' not exists", argv[argIndex + 1]);
         return 1;
@@ -999,6 +1020,63 @@ int main(int argc, const char *argv[]) {
       continue;
     }
 
+    if (argv[argIndex] == std::string_view("--shader-cache")) {
+      if (argc <= argIndex + 1) {
+        usage(argv[0]);
+        return 1;
+      }
+
+      rx::g_config.shaderCachePath = argv[argIndex + 1];
+      argIndex += 2;
+      continue;
+    }
+
+    if (argv[argIndex] == std::string_view("--shader-threads")) {
+      if (argc <= argIndex + 1) {
+        usage(argv[0]);
+        return 1;
+      }
+
+      rx::g_config.shaderCompilerThreads = std::atoi(argv[argIndex + 1]);
+      argIndex += 2;
+      continue;
+    }
+
+    if (argv[argIndex] ==
+        std::string_view("--skip-draws-while-compiling")) {
+      argIndex++;
+      rx::g_config.skipDrawsWhileCompiling = true;
+      continue;
+    }
+
+    if (argv[argIndex] == std::string_view("--no-optimize-shaders")) {
+      argIndex++;
+      rx::g_config.optimizeShaders = false;
+      continue;
+    }
+
+    if (argv[argIndex] == std::string_view("--gpu-capture")) {
+      if (argc <= argIndex + 1) {
+        usage(argv[0]);
+        return 1;
+      }
+
+      rx::g_config.gpuCapturePath = argv[argIndex + 1];
+      argIndex += 2;
+      continue;
+    }
+
+    if (argv[argIndex] == std::string_view("--gpu-capture-frames")) {
+      if (argc <= argIndex + 1) {
+        usage(argv[0]);
+        return 1;
+      }
+
+      rx::g_config.gpuCaptureFrames = std::atoi(argv[argIndex + 1]);
+      argIndex += 2;
+      continue;
+    }
+
     if (argv[argIndex] == std::string_view("--debug-gpu")) {
       argIndex++;
       rx::g_config.debugGpu = true;
@@ -1208,13 +1286,25 @@ int main(int argc, const char *argv[]) {
   if (!isSystem && !vfs::exists(guestArgv[0], mainThread) &&
       std::filesystem::exists(guestArgv[0])) {
     std::filesystem::path filePath(guestArgv[0]);
-    if (std::filesystem::is_directory(filePath)) {
-      filePath /= "eboot.bin";
-    }
 
-    vfs::mount("/app0",
-               createHostIoDevice(filePath.parent_path().c_str(), "/app0"));
-    guestArgv[0] = "/app0" / filePath.filename();
+    if (filePath.extension() == ".iso") {
+      auto device = createIsoIoDevice(filePath);
+      if (device == nullptr) {
+        std::println(stderr, "Failed to mount image '{}'", guestArgv[0]);
+        return 1;
+      }
+
+      vfs::mount("/app0", device);
+      guestArgv[0] = "/app0/eboot.bin";
+    } else {
+      if (std::filesystem::is_directory(filePath)) {
+        filePath /= "eboot.bin";
+      }
+
+      vfs::mount("/app0",
+                 createHostIoDevice(filePath.parent_path().c_str(), "/app0"));
+      guestArgv[0] = "/app0" / filePath.filename();
+    }
   }
 
   auto executableModule = rx::linker::loadModuleFile(guestArgv[0], mainThread);
@@ -7,6 +7,7 @@
 #include <filesystem>
 #include <map>
 #include <mutex>
+#include <shared_mutex>
 #include <string_view>
 
 static orbis::ErrorCode devfs_stat(orbis::File *file, orbis::Stat *sb,
@@ -60,24 +61,65 @@ struct ProcFs : orbis::IoDevice {
   }
 };
 
+// Mount points are stored as a tree of path components, so lookup is a walk
+// down the guest path which remembers the deepest mounted node
+struct MountNode {
+  std::map<std::string, MountNode, std::less<>> children;
+  rx::Ref<orbis::IoDevice> device;
+};
+
 static rx::shared_mutex gMountMtx;
-static std::map<std::string, rx::Ref<orbis::IoDevice>, std::greater<>>
-    gMountsMap;
+static MountNode gMountTree;
 static rx::Ref<DevFs> gDevFs;
 
+static MountNode &getMountNode(std::string_view mountPoint) {
+  auto node = &gMountTree;
+
+  while (!mountPoint.empty()) {
+    auto separator = mountPoint.find('/');
+    auto name = mountPoint.substr(0, separator);
+    mountPoint.remove_prefix(separator == std::string_view::npos
+                                 ? mountPoint.size()
+                                 : separator + 1);
+
+    if (name.empty()) {
+      continue;
+    }
+
+    auto it = node->children.find(name);
+    if (it == node->children.end()) {
+      it = node->children.emplace(std::string(name), MountNode{}).first;
+    }
+
+    node = &it->second;
+  }
+
+  return *node;
+}
+
+static void forEachMount(MountNode &node, auto &&fn) {
+  if (node.device != nullptr) {
+    fn(node.device);
+  }
+
+  for (auto &child : node.children) {
+    forEachMount(child.second, fn);
+  }
+}
+
 void vfs::fork() {
   std::lock_guard lock(gMountMtx);
 
   // NOTE: do not decrease reference counter, it managed by parent process
   auto parentDevFs = gDevFs.release();
 
-  for (auto &mount : gMountsMap) {
-    mount.second->incRef(); // increase reference for new process
-  }
+  forEachMount(gMountTree, [](rx::Ref<orbis::IoDevice> &device) {
+    device->incRef(); // increase reference for new process
+  });
 
   gDevFs = orbis::knew<DevFs>();
-  gMountsMap["/dev/"] = gDevFs;
-  gMountsMap["/proc/"] = orbis::knew<ProcFs>();
+  getMountNode("/dev/").device = gDevFs;
+  getMountNode("/proc/").device = orbis::knew<ProcFs>();
 
   for (auto &fs : parentDevFs->devices) {
     gDevFs->devices[fs.first] = fs.second;
@@ -86,13 +128,13 @@ void vfs::fork() {
 
 void vfs::initialize() {
   gDevFs = orbis::knew<DevFs>();
-  gMountsMap.emplace("/dev/", gDevFs);
-  gMountsMap.emplace("/proc/", orbis::knew<ProcFs>());
+  getMountNode("/dev/").device = gDevFs;
+  getMountNode("/proc/").device = orbis::knew<ProcFs>();
 }
 
 void vfs::deinitialize() {
   gDevFs = nullptr;
-  gMountsMap.clear();
+  gMountTree = {};
 }
 
 void vfs::addDevice(std::string name, orbis::IoDevice *device) {
@@ -104,59 +146,54 @@ std::pair<rx::Ref<orbis::IoDevice>, std::string>
 vfs::get(const std::filesystem::path &guestPath) {
   std::string normalPath = std::filesystem::path(guestPath).lexically_normal();
   std::string_view path = normalPath;
-  rx::Ref<orbis::IoDevice> device;
 
-  std::lock_guard lock(gMountMtx);
+  if (!path.starts_with('/')) {
+    return {};
+  }
 
-  if (gDevFs != nullptr) {
-    std::string_view devPath = "/dev/";
-    if (path.starts_with(devPath) ||
-        path == devPath.substr(0, devPath.size() - 1)) {
-      if (path.size() > devPath.size()) {
-        path.remove_prefix(devPath.size());
-      } else {
-        path = {};
-      }
+  std::shared_lock lock(gMountMtx);
 
-      return {gDevFs, std::string(path)};
-    }
-  }
+  auto node = &gMountTree;
+  rx::Ref<orbis::IoDevice> device = node->device;
+  std::string_view devicePath = path.substr(1);
 
-  for (auto &mount : gMountsMap) {
-    if (!path.starts_with(mount.first)) {
-      if (mount.first.size() - 1 != path.size() ||
-          !std::string_view(mount.first).starts_with(path)) {
-        continue;
-      }
+  while (!path.empty()) {
+    path.remove_prefix(1);
+
+    auto name = path.substr(0, path.find('/'));
+    auto it = node->children.find(name);
+    if (it == node->children.end()) {
+      break;
     }
 
-    device = mount.second;
-    if (path.size() > mount.first.length()) {
-      path.remove_prefix(mount.first.length());
-    } else {
-      path = {};
+    node = &it->second;
+    path.remove_prefix(name.size());
+
+    if (node->device != nullptr) {
+      device = node->device;
+      devicePath = path.empty() ? path : path.substr(1);
     }
-    return {mount.second, std::string(path)};
   }
 
-  return {};
+  if (device == nullptr) {
+    return {};
+  }
+
+  return {std::move(device), std::string(devicePath)};
 }
 
 orbis::SysResult vfs::mount(const std::filesystem::path &guestPath,
                             orbis::IoDevice *dev) {
   auto mp = guestPath.lexically_normal().string();
-  if (!mp.ends_with("/")) {
-    mp += "/";
-  }
 
   std::lock_guard lock(gMountMtx);
 
-  auto [it, inserted] = gMountsMap.emplace(std::move(mp), dev);
-
-  if (!inserted) {
+  auto &node = getMountNode(mp);
+  if (node.device != nullptr) {
     return orbis::ErrorCode::EXIST;
   }
 
+  node.device = dev;
   return {};
 }
 
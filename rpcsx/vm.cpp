@@ -691,33 +691,69 @@ void vm::fork(std::uint64_t pid) {
     std::abort();
   }
 
-  for (auto address = kMinAddress; address < kMaxAddress;
-       address += kPageSize) {
-    auto prot = gBlocks[(address >> kBlockShift) - kFirstBlock].getProtection(
-        (address & kBlockMask) >> vm::kPageShift);
-
-    if (prot & kShared) {
-      continue;
+  // Copy the inherited memory into the new shared memory object. Only
+  // allocated private pages are visited and contiguous pages with equal
+  // protection are copied and remapped with a single operation.
+  std::uint64_t runAddress = 0;
+  std::uint64_t runSize = 0;
+  int runProt = 0;
+
+  auto flushRun = [&] {
+    if (runSize == 0) {
+      return;
     }
 
-    if (prot & kMapProtCpuAll) {
-      auto mapping = rx::mem::map(nullptr, kPageSize, PROT_WRITE, MAP_SHARED,
-                                  gMemoryShm, address - kMinAddress);
-      assert(mapping != MAP_FAILED);
+    auto source = reinterpret_cast<void *>(runAddress);
+    auto mapping = rx::mem::map(nullptr, runSize, PROT_WRITE, MAP_SHARED,
+                                gMemoryShm, runAddress - kMinAddress);
+    assert(mapping != MAP_FAILED);
 
-      rx::mem::protect(reinterpret_cast<void *>(address), kPageSize, PROT_READ);
-      std::memcpy(mapping, reinterpret_cast<void *>(address), kPageSize);
-      rx::mem::unmap(mapping, kPageSize);
-      rx::mem::unmap(reinterpret_cast<void *>(address), kPageSize);
+    rx::mem::protect(source, runSize, PROT_READ);
+    std::memcpy(mapping, source, runSize);
+    rx::mem::unmap(mapping, runSize);
 
-      mapping = rx::mem::map(reinterpret_cast<void *>(address), kPageSize,
-                             prot & kMapProtCpuAll, MAP_FIXED | MAP_SHARED,
-                             gMemoryShm, address - kMinAddress);
-      assert(mapping != MAP_FAILED);
-    }
+    // MAP_FIXED replaces the inherited mapping of the parent's memory
+    mapping = rx::mem::map(source, runSize, runProt, MAP_FIXED | MAP_SHARED,
+                           gMemoryShm, runAddress - kMinAddress);
+    assert(mapping != MAP_FAILED);
+    runSize = 0;
+  };
+
+  for (std::uint64_t blockIndex = 0; blockIndex < kBlockCount; ++blockIndex) {
+    auto &block = gBlocks[blockIndex];
+    auto blockAddress = (kFirstBlock + blockIndex) << kBlockShift;
+
+    for (std::uint64_t groupIndex = 0; groupIndex < kGroupsInBlock;
+         ++groupIndex) {
+      auto &group = block.groups[groupIndex];
+      auto pagesMask = group.allocated & ~group.shared &
+                       (group.readable | group.writable | group.executable);
+
+      while (pagesMask != 0) {
+        auto page = groupIndex * kGroupSize + std::countr_zero(pagesMask);
+        pagesMask &= pagesMask - 1;
+
+        auto address = blockAddress + (page << kPageShift);
+        int prot = block.getProtection(page) & kMapProtCpuAll;
 
-    // TODO: copy gpu memory?
+        if (runSize != 0 &&
+            (prot != runProt || runAddress + runSize != address)) {
+          flushRun();
+        }
+
+        if (runSize == 0) {
+          runAddress = address;
+          runProt = prot;
+        }
+
+        runSize += kPageSize;
+      }
+    }
   }
+
+  flushRun();
+
+  // TODO: copy gpu memory?
 }
 
 void vm::reset() {
@@ -36,7 +36,8 @@ class MemoryAreaTable : public InvalidationHandleT {
 
 public:
   class iterator {
-    using map_iterator = typename std::map<std::uint64_t, Kind>::iterator;
+    using map_iterator =
+        typename std::map<std::uint64_t, Kind>::const_iterator;
     map_iterator it;
 
   public:
@@ -61,8 +62,8 @@ public:
     bool operator!=(iterator other) const { return it != other.it; }
   };
 
-  iterator begin() { return iterator(mAreas.begin()); }
-  iterator end() { return iterator(mAreas.end()); }
+  iterator begin() const { return iterator(mAreas.begin()); }
+  iterator end() const { return iterator(mAreas.end()); }
 
   void clear() { mAreas.clear(); }
 
@@ -0,0 +1,483 @@
+#include "amdgpu/tiler_cpu.hpp"
+#include "gnm/gnm.hpp"
+#include "gnm/pm4.hpp"
+#include "gpu/Capture.hpp"
+#include "gpu/Device.hpp"
+#include "orbis/KernelAllocator.hpp"
+#include "orbis/KernelObject.hpp"
+#include "rx/Config.hpp"
+#include "rx/die.hpp"
+#include "rx/format.hpp"
+#include "rx/mem.hpp"
+#include "rx/print.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <pthread.h>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <thread>
+#include <vector>
+
+using namespace amdgpu;
+
+using Clock = std::chrono::steady_clock;
+
+static void usage(std::FILE *out, const char *argv0) {
+  rx::println(out, "usage: {} [options...] <capture>", argv0);
+  rx::println(out, "  options:");
+  rx::println(out, "    --gpu <index> - specify physical gpu index to use");
+  rx::println(out, "    --validate - enable validation layers");
+  rx::println(out, "    --loops <count> - replay capture multiple times");
+  rx::println(out, "    --dump-targets <directory> - write detiled color "
+                   "targets of every frame");
+}
+
+static std::uint64_t toMicroseconds(std::chrono::nanoseconds duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+// Acknowledges page protection updates of the cache. There is no guest to
+// protect, memory writes of the capture are reported by invalidatePages
+static void runCacheCommandsDrain(Device *device, int vmId) {
+  std::thread{[=] {
+    pthread_setname_np(pthread_self(), "Bridge");
+
+    auto &ring = device->cpuCacheCommands[vmId];
+    std::uint32_t prevPushCount = 0;
+
+    while (true) {
+      ring.processCommands(prevPushCount, [](std::uint64_t) {});
+    }
+  }}.detach();
+}
+
+static void invalidatePages(Device *device, int vmId, rx::AddressRange range) {
+  auto firstPage = range.beginAddress() / rx::mem::pageSize;
+  auto lastPage =
+      (range.endAddress() + rx::mem::pageSize - 1) / rx::mem::pageSize;
+
+  modifyPageFlags(device->cachePages[vmId], firstPage, lastPage,
+                  kPageInvalidated, kPageWriteWatch);
+}
+
+static void mapMemory(int vmId, rx::AddressRange range) {
+  auto memory = RemoteMemory{vmId};
+  auto prot = PROT_READ | PROT_WRITE;
+  auto flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE;
+
+  if (::mmap(memory.getPointer(range.beginAddress()), range.size(), prot,
+             flags, -1, 0) != MAP_FAILED) {
+    return;
+  }
+
+  if (errno != EEXIST) {
+    rx::die("failed to map memory {}-{} of vm {}",
+            memory.getPointer(range.beginAddress()),
+            memory.getPointer(range.endAddress()), vmId);
+  }
+
+  // partially overlaps with previous mappings, fill the holes only
+  for (auto address = range.beginAddress(); address < range.endAddress();
+       address += rx::mem::pageSize) {
+    ::mmap(memory.getPointer(address), rx::mem::pageSize, prot, flags, -1, 0);
+  }
+}
+
+static bool isIdle(GraphicsPipe &pipe) {
+  auto isEmpty = [](const Ring &ring) { return ring.rptr == ring.wptr; };
+
+  return isEmpty(pipe.ceQueue) && std::ranges::all_of(pipe.deQueues, isEmpty) &&
+         std::ranges::all_of(pipe.delayedRings, isEmpty);
+}
+
+static bool isIdle(ComputePipe &pipe, int queueId) {
+  auto lock = pipe.lockQueue(queueId);
+
+  return pipe.queues[0][queueId].rptr == pipe.queues[0][queueId].wptr &&
+         pipe.queues[1][queueId].rptr == pipe.queues[1][queueId].wptr;
+}
+
+// Drops packets which wait for the state produced outside of the capture,
+// the rest of the frame is replayed anyway
+static void skipPendingRings(GraphicsPipe &pipe) {
+  auto skip = [](Ring &ring) { ring.rptr = ring.wptr; };
+
+  skip(pipe.ceQueue);
+  std::ranges::for_each(pipe.deQueues, skip);
+  std::ranges::for_each(pipe.delayedRings, skip);
+}
+
+static void skipPendingRings(ComputePipe &pipe, int queueId) {
+  auto lock = pipe.lockQueue(queueId);
+
+  pipe.queues[0][queueId].rptr = pipe.queues[0][queueId].wptr;
+  pipe.queues[1][queueId].rptr = pipe.queues[1][queueId].wptr;
+}
+
+struct Replayer {
+  Device *device;
+  CaptureReader reader;
+  PacketStats stats;
+  std::optional<CaptureRecord> pendingPacket;
+  std::vector<std::uint32_t> computePacket;
+  std::vector<std::chrono::nanoseconds> frameTimes;
+  Clock::time_point frameStartTime = Clock::now();
+  std::uint64_t packetCount = 0;
+  std::uint64_t skippedCount = 0;
+  std::uint64_t memoryBytes = 0;
+  std::string dumpPath;
+  int dumpVmId = -1;
+  bool isFirstLoop = true;
+
+  // compute packets are replayed one by one as the whole level 0 ring of
+  // the queue, registers are taken from the recorded doorbell
+  void submitComputePacket(const CaptureRecord &record) {
+    auto &pipe = device->computePipes[record.pipe];
+    auto lock = pipe.lockQueue(record.queue);
+
+    computePacket.assign(record.packet.begin(), record.packet.end());
+    pipe.queues[1][record.queue] = Ring::createFromRange(
+        record.vmId, computePacket.data(), computePacket.size(), 0,
+        RemoteMemory{record.vmId}.getPointer<std::uint32_t>(record.doorbell));
+  }
+
+  void flushPacket() {
+    if (!pendingPacket) {
+      return;
+    }
+
+    auto record = *pendingPacket;
+    bool isCompute = record.type == CaptureRecordType::ComputePacket;
+
+    if (isCompute) {
+      submitComputePacket(record);
+    } else {
+      device->submitGfxCommand(record.pipe, record.packet);
+    }
+
+    pendingPacket.reset();
+    ++packetCount;
+
+    auto isDone = [&] {
+      return isCompute ? isIdle(device->computePipes[record.pipe], record.queue)
+                       : isIdle(device->graphicsPipes[record.pipe]);
+    };
+
+    auto startTime = Clock::now();
+
+    while (true) {
+      device->processPipes();
+
+      if (isDone()) {
+        break;
+      }
+
+      if (Clock::now() - startTime > std::chrono::seconds(1)) {
+        rx::println(stderr, "pm4-replay: {} pipe {} stalled, skipping packet",
+                    isCompute ? "compute" : "graphics", record.pipe);
+
+        if (isCompute) {
+          skipPendingRings(device->computePipes[record.pipe], record.queue);
+        } else {
+          skipPendingRings(device->graphicsPipes[record.pipe]);
+        }
+
+        ++skippedCount;
+        break;
+      }
+    }
+  }
+
+  void endFrame() {
+    flushPacket();
+
+    for (auto &pipe : device->computePipes) {
+      pipe.scheduler.wait();
+    }
+
+    for (auto &pipe : device->graphicsPipes) {
+      pipe.scheduler.wait();
+    }
+
+    auto now = Clock::now();
+    frameTimes.push_back(now - frameStartTime);
+    frameStartTime = now;
+
+    if (!dumpPath.empty() && dumpVmId >= 0) {
+      dumpColorTargets(frameTimes.size() - 1);
+    }
+  }
+
+  // Reads color targets back from the cache and detiles them on the CPU.
+  // Images are written as raw rows of elements
+  void dumpColorTargets(std::size_t frame) {
+    auto memory = RemoteMemory{dumpVmId};
+
+    for (auto &pipe : device->graphicsPipes) {
+      for (std::size_t index = 0; index < std::size(pipe.context.cbColor);
+           ++index) {
+        auto &cbColor = pipe.context.cbColor[index];
+
+        if (cbColor.info.dfmt == gnm::kDataFormatInvalid) {
+          continue;
+        }
+
+        std::uint32_t pitch = ((cbColor.pitch & 0x7ff) + 1) * kMicroTileWidth;
+        std::uint32_t height = ((cbColor.slice & 0x3fffff) + 1) *
+                               kMicroTileWidth * kMicroTileHeight / pitch;
+        auto address = static_cast<std::uint64_t>(cbColor.base) << 8;
+        auto tileMode =
+            cbColor.info.linearGeneral
+                ? TileMode{.raw = 0}
+                : getDefaultTileModes()[cbColor.attrib.tileModeIndex];
+
+        auto info = computeSurfaceInfo(tileMode, gnm::TextureType::Dim2D,
+                                       cbColor.info.dfmt, pitch, height, 1,
+                                       pitch, 0, 1, 0, 1, false);
+
+        device->caches[dumpVmId].flush(
+            pipe.scheduler,
+            rx::AddressRange::fromBeginSize(address, info.totalTiledSize));
+
+        CpuTiler tiler(gnm::TextureType::Dim2D, false, cbColor.info.dfmt,
+                       tileMode, info.macroTileMode, 0, 0, pitch, height, 1,
+                       pitch);
+        std::vector<std::byte> image(tiler.getLinearSize());
+        tiler.detileRows(image.data(), memory.getPointer(address), 0,
+                         tiler.getTileRowCount());
+
+        auto path = rx::format("{}/frame{}-pipe{}-cb{}-{}x{}-dfmt{}.raw",
+                               dumpPath, frame, &pipe - device->graphicsPipes,
+                               index, pitch, height,
+                               static_cast<unsigned>(cbColor.info.dfmt));
+        std::ofstream(path, std::ios::binary)
+            .write(reinterpret_cast<const char *>(image.data()), image.size());
+      }
+    }
+  }
+
+  void applyMemory(const CaptureRecord &record) {
+    auto blob = reader.getBlob(record.blob);
+    if (blob.size() != record.range.size()) {
+      rx::println(stderr, "pm4-replay: missing memory content {}-{}",
+                  record.range.beginAddress(), record.range.endAddress());
+      return;
+    }
+
+    auto memory = RemoteMemory{record.vmId};
+    auto data = memory.getPointer<std::byte>(record.range.beginAddress());
+
+    // unchanged ranges are recorded on every cache read, writing them again
+    // would invalidate the whole cache
+    if (std::memcmp(data, blob.data(), blob.size()) == 0) {
+      return;
+    }
+
+    std::memcpy(data, blob.data(), blob.size());
+    invalidatePages(device, record.vmId, record.range);
+    memoryBytes += blob.size();
+  }
+
+  void applyRegisters(const CaptureRecord &record) {
+    auto &pipe = device->graphicsPipes[record.pipe];
+
+    std::span<std::byte> blocks[]{
+        std::as_writable_bytes(std::span(&pipe.sh, 1)),
+        std::as_writable_bytes(std::span(&pipe.context, 1)),
+        std::as_writable_bytes(std::span(&pipe.uConfig, 1)),
+        std::as_writable_bytes(std::span(pipe.constantMemory)),
+    };
+
+    for (std::size_t i = 0; i < std::size(blocks); ++i) {
+      auto blob = reader.getBlob(record.registers[i]);
+
+      if (blob.size() != blocks[i].size()) {
+        rx::die("pm4-replay: unexpected register block size {}, expected {}",
+                blob.size(), blocks[i].size());
+      }
+
+      std::memcpy(blocks[i].data(), blob.data(), blob.size());
+    }
+  }
+
+  void replay() {
+    reader.rewind();
+    frameStartTime = Clock::now();
+
+    CaptureRecord record;
+    while (reader.next(record)) {
+      bool isCompute = record.type == CaptureRecordType::ComputePacket;
+      auto pipeCount =
+          isCompute ? Device::kComputePipeCount : Device::kGfxPipeCount;
+
+      if (record.pipe < 0 || record.pipe >= pipeCount) {
+        rx::die("pm4-replay: invalid pipe index {}", record.pipe);
+      }
+
+      if (isCompute &&
+          (record.queue < 0 || record.queue >= ComputePipe::kQueueCount)) {
+        rx::die("pm4-replay: invalid compute queue {}", record.queue);
+      }
+
+      bool hasVmId = record.type == CaptureRecordType::Process ||
+                     record.type == CaptureRecordType::MapMemory ||
+                     record.type == CaptureRecordType::Memory || isCompute;
+
+      if (hasVmId &&
+          (record.vmId < 0 || record.vmId >= Device::kMaxProcessCount)) {
+        rx::die("pm4-replay: invalid vm id {}", record.vmId);
+      }
+
+      switch (record.type) {
+      case CaptureRecordType::Process:
+        if (isFirstLoop) {
+          device->processInfo[record.pid].vmId = record.vmId;
+          runCacheCommandsDrain(device, record.vmId);
+          dumpVmId = record.vmId;
+        }
+        break;
+
+      case CaptureRecordType::MapMemory:
+        if (isFirstLoop) {
+          mapMemory(record.vmId, record.range);
+        }
+        break;
+
+      case CaptureRecordType::Memory:
+        // memory state observed by the pending packet
+        applyMemory(record);
+        break;
+
+      case CaptureRecordType::Registers:
+        flushPacket();
+        applyRegisters(record);
+        break;
+
+      case CaptureRecordType::Packet:
+      case CaptureRecordType::ComputePacket:
+        flushPacket();
+        pendingPacket = record;
+        break;
+
+      case CaptureRecordType::FrameEnd:
+        endFrame();
+        break;
+
+      case CaptureRecordType::Blob:
+        break;
+      }
+    }
+
+    flushPacket();
+    isFirstLoop = false;
+  }
+
+  void printStats() {
+    rx::println("pm4-replay: {} packets, {} skipped, {} KiB of memory updates",
+                packetCount, skippedCount, memoryBytes / 1024);
+
+    for (std::size_t i = 0; i < frameTimes.size(); ++i) {
+      rx::println("frame {}: {} us", i, toMicroseconds(frameTimes[i]));
+    }
+
+    std::vector<int> opcodes;
+    for (int op = 0; op < 256; ++op) {
+      if (stats.count[op] != 0) {
+        opcodes.push_back(op);
+      }
+    }
+
+    std::ranges::sort(opcodes, std::greater{},
+                      [&](int op) { return stats.time[op]; });
+
+    rx::println("{:<32} {:>10} {:>12} {:>10}", "packet", "count", "total us",
+                "avg ns");
+
+    for (auto op : opcodes) {
+      rx::println("{:<32} {:>10} {:>12} {:>10}", gnm::pm4OpcodeToString(op),
+                  stats.count[op], toMicroseconds(stats.time[op]),
+                  stats.time[op].count() / stats.count[op]);
+    }
+  }
+};
+
+int main(int argc, const char *argv[]) {
+  const char *capturePath = nullptr;
+  const char *dumpPath = "";
+  unsigned loops = 1;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+
+    if (arg == "-h" || arg == "--help") {
+      usage(stdout, argv[0]);
+      return 0;
+    }
+
+    if (arg == "--validate") {
+      rx::g_config.validateGpu = true;
+      continue;
+    }
+
+    if (arg == "--gpu" && i + 1 < argc) {
+      rx::g_config.gpuIndex = std::atoi(argv[++i]);
+      continue;
+    }
+
+    if (arg == "--loops" && i + 1 < argc) {
+      loops = std::max(std::atoi(argv[++i]), 1);
+      continue;
+    }
+
+    if (arg == "--dump-targets" && i + 1 < argc) {
+      dumpPath = argv[++i];
+      continue;
+    }
+
+    if (capturePath != nullptr) {
+      usage(stderr, argv[0]);
+      return 1;
+    }
+
+    capturePath = argv[i];
+  }
+
+  if (capturePath == nullptr) {
+    usage(stderr, argv[0]);
+    return 1;
+  }
+
+  rx::g_config.headlessGpu = true;
+
+  orbis::initializeAllocator();
+  orbis::constructAllGlobals();
+
+  auto device = orbis::knew<Device>();
+
+  Replayer replayer{.device = device, .dumpPath = dumpPath};
+  if (!replayer.reader.open(capturePath)) {
+    return 1;
+  }
+
+  for (auto &pipe : device->computePipes) {
+    pipe.packetStats = &replayer.stats;
+  }
+
+  for (auto &pipe : device->graphicsPipes) {
+    pipe.packetStats = &replayer.stats;
+  }
+
+  for (unsigned i = 0; i < loops; ++i) {
+    replayer.replay();
+  }
+
+  replayer.printStats();
+  return 0;
+}
@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <cstddef>
 #include <cstdio>
 #include <filesystem>
@@ -166,6 +167,7 @@ struct InputParam {
 #ifdef GCN
   std::string semanticPath;
   std::optional<shader::gcn::Stage> gcnStage;
+  bool optimize = false;
 #endif
 };
 
@@ -290,6 +292,7 @@ static shader::ir::Region parseIsa(shader::ir::Context &context,
 
   shader::gcn::Context isaContext;
   shader::gcn::Environment env;
+  env.optimize = inputParam.optimize;
   auto ir = shader::gcn::deserialize(
       isaContext, env, gcnSemanticInfo, 0,
       [&](std::uint64_t address) -> std::uint32_t {
@@ -409,6 +412,80 @@ parseFile(shader::ir::Context &context, InputParam &inputParam,
   return {};
 }
 
+#ifdef GCN
+// Converts every shader with shader::optimize disabled and enabled. Shaders
+// which fail to convert without the optimizer are skipped, optimized output
+// must pass validation
+static int compareOptimizer(const InputParam &inputParam,
+                            OutputParam outputParam,
+                            const std::filesystem::path &input) {
+  std::vector<std::filesystem::path> files;
+
+  if (std::filesystem::is_directory(input)) {
+    for (auto &entry : std::filesystem::recursive_directory_iterator(input)) {
+      if (entry.is_regular_file() && entry.path().extension() == ".sb") {
+        files.push_back(entry.path());
+      }
+    }
+
+    std::ranges::sort(files);
+  } else {
+    files.push_back(input);
+  }
+
+  outputParam.type = OutputType::SpirvBinary;
+
+  std::size_t skipped = 0;
+  std::size_t failed = 0;
+  std::size_t totalWords[2] = {};
+
+  for (auto &path : files) {
+    std::size_t words[2] = {};
+    bool isValid[2] = {};
+
+    for (bool optimize : {false, true}) {
+      auto param = inputParam;
+      param.optimize = optimize;
+
+      shader::ir::Context context;
+      if (auto ir = parseFile(context, param, outputParam, path)) {
+        auto spv = shader::spv::serialize(*ir);
+        isValid[optimize] = shader::spv::validate(spv);
+        words[optimize] = spv.size();
+      }
+
+      if (!isValid[optimize]) {
+        break;
+      }
+    }
+
+    if (!isValid[false]) {
+      std::fprintf(stderr, "%s: skipped, conversion failed\n",
+                   path.string().c_str());
+      skipped++;
+      continue;
+    }
+
+    if (!isValid[true]) {
+      std::fprintf(stderr, "%s: optimized shader is invalid\n",
+                   path.string().c_str());
+      failed++;
+      continue;
+    }
+
+    std::printf("%s: %zu -> %zu words\n", path.string().c_str(), words[false],
+                words[true]);
+    totalWords[false] += words[false];
+    totalWords[true] += words[true];
+  }
+
+  std::printf("%zu shaders, %zu skipped, %zu failed, %zu -> %zu words\n",
+              files.size(), skipped, failed, totalWords[false],
+              totalWords[true]);
+  return failed == 0 ? 0 : 1;
+}
+#endif
+
 void usage(std::FILE *out, const char *argv0) {
   std::fprintf(out, "usage: %s [options] -i <input file> [-o <output file>]\n",
                argv0);
@@ -419,6 +496,11 @@ void usage(std::FILE *out, const char *argv0) {
   std::fprintf(out, "    --input-type <glsl|spirv-bin|sb|isa>\n");
   std::fprintf(out, "    --semantic <semantic file>\n");
   std::fprintf(out, "    --input-isa-stage <isa-stage>\n");
+  std::fprintf(out, "    --optimize-isa - run shader::optimize on converted "
+                    "isa\n");
+  std::fprintf(out, "    --compare-optimizer - convert the input shader or "
+                    "every .sb file of the input directory with and without "
+                    "shader::optimize and validate both\n");
 #else
   std::fprintf(out, "    --input-type <glsl|spirv-bin>\n");
 #endif
@@ -468,6 +550,9 @@ int main(int argc, const char *argv[]) {
   const char *outputFile = nullptr;
   InputParam inputParam;
   OutputParam outputParam;
+#ifdef GCN
+  bool compareOptimizerMode = false;
+#endif
 
   for (int i = 1; i < argc; ++i) {
     if (argv[i] == std::string_view("-h") ||
@@ -486,6 +571,18 @@ int main(int argc, const char *argv[]) {
       continue;
     }
 
+#ifdef GCN
+    if (argv[i] == std::string_view{"--optimize-isa"}) {
+      inputParam.optimize = true;
+      continue;
+    }
+
+    if (argv[i] == std::string_view{"--compare-optimizer"}) {
+      compareOptimizerMode = true;
+      continue;
+    }
+#endif
+
     if (argv[i] == std::string_view{"-O0"}) {
       outputParam.optLevel = 0;
       continue;
@@ -571,6 +668,12 @@ int main(int argc, const char *argv[]) {
     return 1;
   }
 
+#ifdef GCN
+  if (compareOptimizerMode) {
+    return compareOptimizer(inputParam, outputParam, inputFile);
+  }
+#endif
+
   if (!outputParam.type) {
     outputParam.type = OutputType::Ir;
   }
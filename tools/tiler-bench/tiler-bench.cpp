@@ -0,0 +1,371 @@
+#include "amdgpu/tiler.hpp"
+#include "amdgpu/tiler_cpu.hpp"
+#include "gnm/gnm.hpp"
+#include "rx/print.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string_view>
+#include <vector>
+
+using namespace amdgpu;
+
+using Clock = std::chrono::steady_clock;
+
+static void usage(std::FILE *out, const char *argv0) {
+  rx::println(out, "usage: {} [options...]", argv0);
+  rx::println(out, "  options:");
+  rx::println(out, "    --verify-only - skip the benchmark");
+  rx::println(out, "    --loops <count> - benchmark iterations");
+}
+
+struct Surface {
+  gnm::TextureType type;
+  gnm::DataFormat dfmt;
+  TileMode tileMode;
+  MacroTileMode macroTileMode;
+  int mipLevel;
+  int arraySlice;
+  int width;
+  int height;
+  int depth;
+  int pitch;
+};
+
+static MacroTileMode getMacroTileMode(TileMode tileMode, gnm::DataFormat dfmt) {
+  auto bitsPerElement = getBitsPerElement(dfmt);
+  if (getTexelsPerElement(dfmt) > 1) {
+    bitsPerElement *= bitsPerElement == 1 ? 8 : 16;
+  }
+
+  return getDefaultMacroTileModes()[computeMacroTileIndex(tileMode,
+                                                          bitsPerElement, 1)];
+}
+
+// Reference conversion: full address computation for every element
+struct PerElementTiler {
+  Surface surface;
+  std::uint32_t elementSize;
+  std::uint32_t elemWidth;
+  std::uint32_t elemHeight;
+  std::uint32_t elemDepth;
+  std::vector<std::uint64_t> offsets;
+
+  explicit PerElementTiler(const Surface &surface) : surface(surface) {
+    auto bitsPerElement = getBitsPerElement(surface.dfmt);
+    auto texelsPerElement = getTexelsPerElement(surface.dfmt);
+    auto width = std::max(surface.width >> surface.mipLevel, 1);
+    auto height = std::max(surface.height >> surface.mipLevel, 1);
+
+    if (texelsPerElement > 1) {
+      bitsPerElement *= texelsPerElement;
+      width = std::max((width + 3) / 4, 1);
+      height = std::max((height + 3) / 4, 1);
+    }
+
+    elementSize = bitsPerElement / 8;
+    elemWidth = width;
+    elemHeight = height;
+    elemDepth = surface.type == gnm::TextureType::Dim3D
+                    ? std::max(surface.depth >> surface.mipLevel, 1)
+                    : 1;
+  }
+
+  std::uint64_t getOffset(std::uint32_t x, std::uint32_t y,
+                          std::uint32_t z) const {
+    return getTiledOffset(surface.type, false, 0, surface.dfmt,
+                          surface.tileMode, surface.macroTileMode,
+                          surface.mipLevel, surface.arraySlice, surface.width,
+                          surface.height, surface.depth, surface.pitch, x, y,
+                          z, 0) /
+           8;
+  }
+
+  void computeOffsets() {
+    offsets.clear();
+    offsets.reserve(std::size_t(elemWidth) * elemHeight * elemDepth);
+
+    for (std::uint32_t z = 0; z < elemDepth; ++z) {
+      for (std::uint32_t y = 0; y < elemHeight; ++y) {
+        for (std::uint32_t x = 0; x < elemWidth; ++x) {
+          offsets.push_back(getOffset(x, y, z));
+        }
+      }
+    }
+  }
+
+  std::uint64_t getTiledSize() const {
+    return std::ranges::max(offsets) + elementSize;
+  }
+
+  void detile(std::byte *dst, const std::byte *src) const {
+    std::uint64_t linearOffset = 0;
+
+    for (std::uint32_t z = 0; z < elemDepth; ++z) {
+      for (std::uint32_t y = 0; y < elemHeight; ++y) {
+        for (std::uint32_t x = 0; x < elemWidth; ++x) {
+          std::memcpy(dst + linearOffset, src + getOffset(x, y, z),
+                      elementSize);
+          linearOffset += elementSize;
+        }
+      }
+    }
+  }
+};
+
+static bool isSupported(TileMode tileMode, gnm::DataFormat dfmt) {
+  auto bitsPerElement = getBitsPerElement(dfmt) * getTexelsPerElement(dfmt);
+  auto arrayMode = tileMode.arrayMode();
+
+  switch (arrayMode) {
+  case kArrayModeLinearGeneral:
+  case kArrayModeLinearAligned:
+    // linear offsets of block compressed surfaces are not per block
+    return getTexelsPerElement(dfmt) == 1;
+  default:
+    break;
+  }
+
+  switch (tileMode.microTileMode()) {
+  case kMicroTileModeDisplay:
+    return bitsPerElement <= 64 && getMicroTileThickness(arrayMode) == 1;
+  case kMicroTileModeThin:
+  case kMicroTileModeDepth:
+    return true;
+  case kMicroTileModeThick:
+    return getMicroTileThickness(arrayMode) > 1;
+  default:
+    return false;
+  }
+}
+
+static bool verify(const Surface &surface, std::mt19937 &rng,
+                   bool &isTileChecked) {
+  PerElementTiler reference(surface);
+  reference.computeOffsets();
+
+  auto tiledSize = reference.getTiledSize();
+  auto linearSize = reference.offsets.size() * reference.elementSize;
+
+  std::vector<std::byte> tiled(tiledSize);
+  std::ranges::generate(tiled, [&] { return std::byte(rng()); });
+
+  std::vector<std::byte> expected(linearSize);
+  std::vector<std::byte> actual(linearSize);
+  reference.detile(expected.data(), tiled.data());
+  detileSurface(actual.data(), tiled.data(), surface.type, false,
+                surface.dfmt, surface.tileMode, surface.macroTileMode,
+                surface.mipLevel, surface.arraySlice, surface.width,
+                surface.height, surface.depth, surface.pitch);
+
+  if (expected != actual) {
+    return false;
+  }
+
+  // tiling is checked only if every element has its own location
+  auto sortedOffsets = reference.offsets;
+  std::ranges::sort(sortedOffsets);
+  isTileChecked =
+      std::ranges::adjacent_find(sortedOffsets, [&](auto lhs, auto rhs) {
+        return rhs - lhs < reference.elementSize;
+      }) == sortedOffsets.end();
+
+  if (!isTileChecked) {
+    return true;
+  }
+
+  std::vector<std::byte> retiled(tiledSize);
+  tileSurface(retiled.data(), expected.data(), surface.type, false,
+              surface.dfmt, surface.tileMode, surface.macroTileMode,
+              surface.mipLevel, surface.arraySlice, surface.width,
+              surface.height, surface.depth, surface.pitch);
+
+  for (auto offset : reference.offsets) {
+    if (std::memcmp(retiled.data() + offset, tiled.data() + offset,
+                    reference.elementSize) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int runVerification() {
+  static constexpr gnm::DataFormat kFormats[] = {
+      gnm::kDataFormat8,          gnm::kDataFormat16,
+      gnm::kDataFormat8_8_8_8,    gnm::kDataFormat32_32,
+      gnm::kDataFormat32_32_32_32, gnm::kDataFormatBc1,
+      gnm::kDataFormatBc3,
+  };
+
+  struct Extent {
+    gnm::TextureType type;
+    int width;
+    int height;
+    int depth;
+    int pitch;
+  };
+
+  static constexpr Extent kExtents[] = {
+      {gnm::TextureType::Dim2D, 200, 120, 1, 1024},
+      {gnm::TextureType::Dim2D, 640, 520, 1, 1024},
+      {gnm::TextureType::Dim3D, 96, 64, 12, 256},
+  };
+
+  std::mt19937 rng;
+  int configCount = 0;
+  int tileCheckCount = 0;
+  int failureCount = 0;
+  auto tileModes = getDefaultTileModes();
+
+  for (std::size_t tileModeIndex = 0; tileModeIndex < tileModes.size();
+       ++tileModeIndex) {
+    auto tileMode = tileModes[tileModeIndex];
+
+    for (auto dfmt : kFormats) {
+      if (!isSupported(tileMode, dfmt)) {
+        continue;
+      }
+
+      for (auto &extent : kExtents) {
+        for (int mipLevel = 0; mipLevel < 3; ++mipLevel) {
+          Surface surface{
+              .type = extent.type,
+              .dfmt = dfmt,
+              .tileMode = tileMode,
+              .macroTileMode = getMacroTileMode(tileMode, dfmt),
+              .mipLevel = mipLevel,
+              .arraySlice = 0,
+              .width = extent.width,
+              .height = extent.height,
+              .depth = extent.depth,
+              .pitch = extent.pitch,
+          };
+
+          bool isTileChecked = false;
+          ++configCount;
+
+          if (!verify(surface, rng, isTileChecked)) {
+            rx::println(stderr,
+                        "tiler-bench: mismatch: tile mode {}, format {}, "
+                        "{}x{}x{}, mip {}",
+                        tileModeIndex, static_cast<unsigned>(dfmt),
+                        extent.width, extent.height, extent.depth, mipLevel);
+            ++failureCount;
+          } else if (isTileChecked) {
+            ++tileCheckCount;
+          }
+        }
+      }
+    }
+  }
+
+  rx::println("tiler-bench: {} configurations verified, {} with tiling, {} "
+              "failed",
+              configCount, tileCheckCount, failureCount);
+  return failureCount;
+}
+
+static double toMilliseconds(Clock::duration duration) {
+  return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+static void runBenchmark(int loops) {
+  struct Case {
+    const char *name;
+    int tileModeIndex;
+  };
+
+  static constexpr Case kCases[] = {
+      {"linear", 8},
+      {"1d thin", 9},
+      {"2d thin", 10},
+  };
+
+  constexpr int kWidth = 3840;
+  constexpr int kHeight = 2160;
+
+  rx::println("{:<10} {:>14} {:>14} {:>10} {:>10}", "mode", "per-element ms",
+              "bulk ms", "speedup", "bulk GB/s");
+
+  for (auto &benchCase : kCases) {
+    auto tileMode = getDefaultTileModes()[benchCase.tileModeIndex];
+
+    Surface surface{
+        .type = gnm::TextureType::Dim2D,
+        .dfmt = gnm::kDataFormat8_8_8_8,
+        .tileMode = tileMode,
+        .macroTileMode = getMacroTileMode(tileMode, gnm::kDataFormat8_8_8_8),
+        .mipLevel = 0,
+        .arraySlice = 0,
+        .width = kWidth,
+        .height = kHeight,
+        .depth = 1,
+        .pitch = kWidth,
+    };
+
+    PerElementTiler reference(surface);
+    std::vector<std::byte> tiled(std::size_t(kWidth) * kHeight * 8);
+    std::vector<std::byte> linear(std::size_t(kWidth) * kHeight * 4);
+
+    auto referenceStart = Clock::now();
+    for (int i = 0; i < loops; ++i) {
+      reference.detile(linear.data(), tiled.data());
+    }
+    auto referenceTime = (Clock::now() - referenceStart) / loops;
+
+    auto bulkStart = Clock::now();
+    for (int i = 0; i < loops; ++i) {
+      detileSurface(linear.data(), tiled.data(), surface.type, false,
+                    surface.dfmt, surface.tileMode, surface.macroTileMode, 0,
+                    0, kWidth, kHeight, 1, kWidth);
+    }
+    auto bulkTime = (Clock::now() - bulkStart) / loops;
+
+    rx::println("{:<10} {:>14.2f} {:>14.2f} {:>9.1f}x {:>10.2f}",
+                benchCase.name, toMilliseconds(referenceTime),
+                toMilliseconds(bulkTime),
+                toMilliseconds(referenceTime) / toMilliseconds(bulkTime),
+                linear.size() / toMilliseconds(bulkTime) / 1e6);
+  }
+}
+
+int main(int argc, const char *argv[]) {
+  bool verifyOnly = false;
+  int loops = 10;
+
+  for (int i = 1; i < argc; ++i) {
+    std::string_view arg = argv[i];
+
+    if (arg == "-h" || arg == "--help") {
+      usage(stdout, argv[0]);
+      return 0;
+    }
+
+    if (arg == "--verify-only") {
+      verifyOnly = true;
+      continue;
+    }
+
+    if (arg == "--loops" && i + 1 < argc) {
+      loops = std::max(std::atoi(argv[++i]), 1);
+      continue;
+    }
+
+    usage(stderr, argv[0]);
+    return 1;
+  }
+
+  if (runVerification() != 0) {
+    return 1;
+  }
+
+  if (!verifyOnly) {
+    runBenchmark(loops);
+  }
+
+  return 0;
+}